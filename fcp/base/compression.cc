@@ -16,87 +16,236 @@
 
 #include "fcp/base/compression.h"
 
+#include <algorithm>
 #include <cstddef>
+#include <memory>
 #include <string>
+#include <utility>
 
+#include "absl/memory/memory.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/cord.h"
+#include "absl/strings/cord_buffer.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
-#include "google/protobuf/io/gzip_stream.h"
-#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "absl/types/span.h"
+#include "zlib.h"
 
 namespace fcp {
-using ::google::protobuf::io::ArrayInputStream;
-using ::google::protobuf::io::GzipInputStream;
-using ::google::protobuf::io::GzipOutputStream;
-using ::google::protobuf::io::StringOutputStream;
+namespace {
+// Makes deflate and inflate produce and consume gzip, rather than zlib, data.
+constexpr int kGzipWindowBits = MAX_WBITS + 16;
+// zlib's default, which trades memory for speed.
+constexpr int kMemLevel = 8;
+// The size of the buffer which compressed data is produced into.
+constexpr size_t kBufferSize = 16 * 1024;
+// The most data handed to zlib at once, as its sizes are 32-bit.
+constexpr size_t kMaxZlibInputSize = size_t{1} << 30;
 
-absl::StatusOr<std::string> CompressWithGzip(
-    absl::string_view uncompressed_data) {
-  int starting_pos = 0;
-  size_t str_size = uncompressed_data.length();
-  size_t in_size = str_size;
-  std::string output;
-  StringOutputStream string_output_stream(&output);
-  GzipOutputStream::Options options;
-  options.format = GzipOutputStream::GZIP;
-  GzipOutputStream compressed_stream(&string_output_stream, options);
-  void* out;
-  int out_size;
-  while (starting_pos < str_size) {
-    if (!compressed_stream.Next(&out, &out_size) || out_size <= 0) {
+int ToZlibStrategy(GzipCompressionOptions::Strategy strategy) {
+  switch (strategy) {
+    case GzipCompressionOptions::Strategy::kDefault:
+      return Z_DEFAULT_STRATEGY;
+    case GzipCompressionOptions::Strategy::kFiltered:
+      return Z_FILTERED;
+    case GzipCompressionOptions::Strategy::kHuffmanOnly:
+      return Z_HUFFMAN_ONLY;
+    case GzipCompressionOptions::Strategy::kRle:
+      return Z_RLE;
+  }
+  return Z_DEFAULT_STRATEGY;
+}
+
+// Returns zlib's description of the last error on the stream, which is more
+// specific than the one for the error code, if there is one.
+const char* ZlibErrorMessage(const z_stream& stream, int error) {
+  return stream.msg != nullptr ? stream.msg : zError(error);
+}
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<GzipCompressor>> GzipCompressor::Create(
+    const GzipCompressionOptions& options) {
+  // Value-initialization sets zalloc, zfree and opaque to Z_NULL, which makes
+  // zlib use its default allocator.
+  auto stream = std::make_unique<z_stream>();
+  int result =
+      deflateInit2(stream.get(), options.level, Z_DEFLATED, kGzipWindowBits,
+                   kMemLevel, ToZlibStrategy(options.strategy));
+  if (result == Z_STREAM_ERROR) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid gzip compression level: ", options.level));
+  }
+  if (result != Z_OK) {
+    return absl::InternalError(
+        absl::StrCat("Failed to initialize gzip compression: ",
+                     ZlibErrorMessage(*stream, result)));
+  }
+  return absl::WrapUnique(new GzipCompressor(std::move(stream)));
+}
+
+GzipCompressor::GzipCompressor(std::unique_ptr<z_stream_s> stream)
+    : stream_(std::move(stream)) {}
+
+GzipCompressor::~GzipCompressor() { deflateEnd(stream_.get()); }
+
+absl::Status GzipCompressor::Append(absl::string_view data,
+                                    std::string* output) {
+  if (finished_) {
+    return absl::FailedPreconditionError(
+        "Data appended to a finished GzipCompressor");
+  }
+  while (!data.empty()) {
+    size_t size = std::min(data.size(), kMaxZlibInputSize);
+    stream_->next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream_->avail_in = static_cast<uInt>(size);
+    data.remove_prefix(size);
+    absl::Status status = Deflate(Z_NO_FLUSH, output);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status GzipCompressor::Finish(std::string* output) {
+  if (finished_) {
+    return absl::FailedPreconditionError("GzipCompressor already finished");
+  }
+  finished_ = true;
+  stream_->next_in = nullptr;
+  stream_->avail_in = 0;
+  return Deflate(Z_FINISH, output);
+}
+
+absl::Status GzipCompressor::Deflate(int flush, std::string* output) {
+  char buffer[kBufferSize];
+  // deflate has consumed all input, and produced all output it can, once it
+  // leaves some of the output buffer unused.
+  do {
+    stream_->next_out = reinterpret_cast<Bytef*>(buffer);
+    stream_->avail_out = kBufferSize;
+    int result = deflate(stream_.get(), flush);
+    // Z_BUF_ERROR merely means that no progress was possible.
+    if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
       return absl::InternalError(
           absl::StrCat("An error has occurred during compression: ",
-                       compressed_stream.ZlibErrorMessage()));
+                       ZlibErrorMessage(*stream_, result)));
     }
+    output->append(buffer, kBufferSize - stream_->avail_out);
+  } while (stream_->avail_out == 0);
+  return absl::OkStatus();
+}
 
-    if (in_size <= out_size) {
-      uncompressed_data.copy(static_cast<char*>(out), in_size, starting_pos);
-      // Ensure that the stream's output buffer is truncated to match the total
-      // amount of data.
-      compressed_stream.BackUp(out_size - static_cast<int>(in_size));
-      break;
-    }
-    uncompressed_data.copy(static_cast<char*>(out), out_size, starting_pos);
-    starting_pos += out_size;
-    in_size -= out_size;
+absl::StatusOr<std::unique_ptr<GzipDecompressor>> GzipDecompressor::Create() {
+  auto stream = std::make_unique<z_stream>();
+  int result = inflateInit2(stream.get(), kGzipWindowBits);
+  if (result != Z_OK) {
+    return absl::InternalError(
+        absl::StrCat("Failed to initialize gzip decompression: ",
+                     ZlibErrorMessage(*stream, result)));
+  }
+  return absl::WrapUnique(new GzipDecompressor(std::move(stream)));
+}
+
+GzipDecompressor::GzipDecompressor(std::unique_ptr<z_stream_s> stream)
+    : stream_(std::move(stream)) {}
+
+GzipDecompressor::~GzipDecompressor() { inflateEnd(stream_.get()); }
+
+absl::Status GzipDecompressor::Append(absl::string_view data,
+                                      absl::Cord* output) {
+  while (!data.empty()) {
+    size_t size = std::min(data.size(), kMaxZlibInputSize);
+    stream_->next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream_->avail_in = static_cast<uInt>(size);
+    data.remove_prefix(size);
+    bool output_full;
+    // Keep going while there's input left, or inflate may have more output
+    // than fit into the last buffer.
+    do {
+      if (stream_->avail_in > 0) {
+        in_stream_ = true;
+      }
+      // Inflate straight into the Cord's memory, rather than copying the
+      // output into it.
+      absl::CordBuffer buffer = output->GetAppendBuffer(kBufferSize);
+      absl::Span<char> available = buffer.available();
+      stream_->next_out = reinterpret_cast<Bytef*>(available.data());
+      stream_->avail_out = static_cast<uInt>(available.size());
+      int result = inflate(stream_.get(), Z_NO_FLUSH);
+      output_full = stream_->avail_out == 0;
+      buffer.IncreaseLengthBy(available.size() - stream_->avail_out);
+      output->Append(std::move(buffer));
+      if (result == Z_STREAM_END) {
+        // Anything that follows is another gzip stream.
+        in_stream_ = false;
+        inflateReset(stream_.get());
+      } else if (result != Z_OK && result != Z_BUF_ERROR) {
+        return absl::InternalError(
+            absl::StrCat("An error has occurred during decompression: ",
+                         ZlibErrorMessage(*stream_, result)));
+      }
+    } while (stream_->avail_in > 0 || output_full);
   }
+  return absl::OkStatus();
+}
+
+absl::Status GzipDecompressor::Finish() {
+  if (in_stream_) {
+    return absl::InternalError(
+        "An error has occurred during decompression: unexpected end of data");
+  }
+  return absl::OkStatus();
+}
 
-  if (!compressed_stream.Close()) {
-    return absl::InternalError(absl::StrCat(
-        "Failed to close the stream: ", compressed_stream.ZlibErrorMessage()));
+absl::StatusOr<std::string> CompressWithGzip(
+    absl::string_view uncompressed_data,
+    const GzipCompressionOptions& options) {
+  absl::StatusOr<std::unique_ptr<GzipCompressor>> compressor =
+      GzipCompressor::Create(options);
+  if (!compressor.ok()) {
+    return compressor.status();
+  }
+  std::string output;
+  absl::Status status = (*compressor)->Append(uncompressed_data, &output);
+  if (status.ok()) {
+    status = (*compressor)->Finish(&output);
+  }
+  if (!status.ok()) {
+    return status;
   }
   return output;
 }
 
 absl::StatusOr<absl::Cord> UncompressWithGzip(
     absl::string_view compressed_data) {
-  absl::Cord out;
-  const void* buffer;
-  int size;
-  ArrayInputStream sub_stream(compressed_data.data(),
-                              static_cast<int>(compressed_data.size()));
-  GzipInputStream input_stream(&sub_stream, GzipInputStream::GZIP);
-
-  while (input_stream.Next(&buffer, &size)) {
-    if (size <= -1) {
-      return absl::InternalError(
-          "Uncompress failed: invalid input size returned by the "
-          "GzipInputStream.");
+  // Wraps rather than copies the data, which outlives the Cord.
+  return UncompressWithGzip(
+      absl::MakeCordFromExternal(compressed_data, [] {}));
+}
+
+absl::StatusOr<absl::Cord> UncompressWithGzip(
+    const absl::Cord& compressed_data) {
+  absl::StatusOr<std::unique_ptr<GzipDecompressor>> decompressor =
+      GzipDecompressor::Create();
+  if (!decompressor.ok()) {
+    return decompressor.status();
+  }
+  absl::Cord output;
+  for (absl::string_view chunk : compressed_data.Chunks()) {
+    absl::Status status = (*decompressor)->Append(chunk, &output);
+    if (!status.ok()) {
+      return status;
     }
-    out.Append(absl::string_view(reinterpret_cast<const char*>(buffer), size));
   }
-
-  if (input_stream.ZlibErrorMessage() != nullptr) {
-    // Some real error happened during decompression.
-    return absl::InternalError(
-        absl::StrCat("An error has occurred during decompression:",
-                     input_stream.ZlibErrorMessage()));
+  absl::Status status = (*decompressor)->Finish();
+  if (!status.ok()) {
+    return status;
   }
-
-  return out;
+  return output;
 }
 
 }  // namespace fcp
@@ -17,16 +17,113 @@
 #ifndef FCP_BASE_COMPRESSION_H_
 #define FCP_BASE_COMPRESSION_H_
 
+#include <memory>
+#include <string>
+
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
 
+// Forward declaration of zlib's stream state, so that zlib.h needn't be
+// included here.
+struct z_stream_s;
+
 namespace fcp {
 
+// Settings which trade compression speed for compressed size.
+struct GzipCompressionOptions {
+  // How the data is expected to look, see the zlib documentation of
+  // deflateInit2 for details.
+  enum class Strategy {
+    kDefault,
+    // Mostly small values with a somewhat random distribution.
+    kFiltered,
+    // Huffman coding only, i.e. no string matching.
+    kHuffmanOnly,
+    // Long runs of the same value, e.g. mostly zero tensors.
+    kRle,
+  };
+
+  // From 1 (fastest) to 9 (smallest output), 0 for no compression at all, or
+  // -1 for zlib's default, which is currently 6.
+  int level = -1;
+  Strategy strategy = Strategy::kDefault;
+};
+
 absl::StatusOr<std::string> CompressWithGzip(
-    absl::string_view uncompressed_data);
+    absl::string_view uncompressed_data,
+    const GzipCompressionOptions& options = {});
 absl::StatusOr<absl::Cord> UncompressWithGzip(
     absl::string_view compressed_data);
+// Same as above, but decompresses the Cord's chunks as they are, rather than
+// requiring a flat copy of the compressed data.
+absl::StatusOr<absl::Cord> UncompressWithGzip(
+    const absl::Cord& compressed_data);
+
+// Compresses data with gzip as it becomes available, so that neither the
+// uncompressed nor the compressed data need to be held in memory in their
+// entirety.
+//
+// This class is not thread safe.
+class GzipCompressor {
+ public:
+  // Returns an INVALID_ARGUMENT error if the options are invalid.
+  static absl::StatusOr<std::unique_ptr<GzipCompressor>> Create(
+      const GzipCompressionOptions& options = {});
+  ~GzipCompressor();
+
+  // GzipCompressor is neither copyable nor movable.
+  GzipCompressor(const GzipCompressor&) = delete;
+  GzipCompressor& operator=(const GzipCompressor&) = delete;
+
+  // Compresses `data`, and appends as much compressed data as is ready to
+  // `output`. Due to buffering within zlib, this is often nothing at all.
+  absl::Status Append(absl::string_view data, std::string* output);
+
+  // Appends the remaining compressed data to `output`. No more data may be
+  // appended afterwards.
+  absl::Status Finish(std::string* output);
+
+ private:
+  explicit GzipCompressor(std::unique_ptr<z_stream_s> stream);
+
+  absl::Status Deflate(int flush, std::string* output);
+
+  std::unique_ptr<z_stream_s> stream_;
+  bool finished_ = false;
+};
+
+// Decompresses gzip data as it becomes available, e.g. as it is received over
+// the network. Concatenated gzip streams are decompressed into the
+// concatenation of their data, as with UncompressWithGzip.
+//
+// This class is not thread safe.
+class GzipDecompressor {
+ public:
+  static absl::StatusOr<std::unique_ptr<GzipDecompressor>> Create();
+  ~GzipDecompressor();
+
+  // GzipDecompressor is neither copyable nor movable.
+  GzipDecompressor(const GzipDecompressor&) = delete;
+  GzipDecompressor& operator=(const GzipDecompressor&) = delete;
+
+  // Decompresses the next piece of compressed data, and appends the resulting
+  // data to `output`. Returns an error if the compressed data is invalid.
+  absl::Status Append(absl::string_view data, absl::Cord* output);
+
+  // Returns an error if the compressed data ended in the middle of a gzip
+  // stream. No data at all is treated as an empty stream.
+  absl::Status Finish();
+
+ private:
+  explicit GzipDecompressor(std::unique_ptr<z_stream_s> stream);
+
+  std::unique_ptr<z_stream_s> stream_;
+  // Whether the stream contains data which isn't part of a complete gzip
+  // stream yet.
+  bool in_stream_ = false;
+};
 
 }  // namespace fcp
 
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/string_view.h"
+#include "fcp/base/compression.h"
+#include "fcp/base/monitoring.h"
+
+// Open-source version of benchmarking library
+#include "benchmark//benchmark.h"
+
+namespace fcp {
+namespace {
+
+using Strategy = GzipCompressionOptions::Strategy;
+
+// The payloads are about the size of a small model's checkpoint.
+constexpr size_t kNumValues = 1 << 20;
+
+enum Payload {
+  // Trained model weights, i.e. floats with few repeated bytes.
+  kWeights,
+  // A model update in which most values haven't changed.
+  kSparseUpdate,
+  // A model update which has been quantized to few distinct values.
+  kQuantizedUpdate,
+};
+
+std::string CreatePayload(Payload payload) {
+  std::mt19937 rng(42);
+  std::normal_distribution<float> normal(0.0f, 0.05f);
+  std::bernoulli_distribution changed(0.05);
+  std::uniform_int_distribution<int> quantized(-8, 7);
+  std::string data(kNumValues * sizeof(float), '\0');
+  for (size_t i = 0; i < kNumValues; ++i) {
+    float value = 0.0f;
+    switch (payload) {
+      case kWeights:
+        value = normal(rng);
+        break;
+      case kSparseUpdate:
+        value = changed(rng) ? normal(rng) : 0.0f;
+        break;
+      case kQuantizedUpdate:
+        value = quantized(rng) / 256.0f;
+        break;
+    }
+    std::memcpy(&data[i * sizeof(float)], &value, sizeof(float));
+  }
+  return data;
+}
+
+// Reports the compressed size as a fraction of the uncompressed size.
+void SetCompressionRatio(benchmark::State& state, size_t uncompressed_size,
+                         size_t compressed_size) {
+  state.counters["ratio"] =
+      static_cast<double>(compressed_size) / uncompressed_size;
+}
+
+// Compresses payload state.range(0) at level state.range(1) with strategy
+// state.range(2).
+void BM_CompressWithGzip(benchmark::State& state) {
+  std::string data = CreatePayload(static_cast<Payload>(state.range(0)));
+  GzipCompressionOptions options{
+      .level = static_cast<int>(state.range(1)),
+      .strategy = static_cast<Strategy>(state.range(2))};
+  size_t compressed_size = 0;
+  for (auto s : state) {
+    absl::StatusOr<std::string> compressed = CompressWithGzip(data, options);
+    FCP_CHECK_STATUS(compressed.status());
+    compressed_size = compressed->size();
+    benchmark::DoNotOptimize(compressed);
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+  SetCompressionRatio(state, data.size(), compressed_size);
+}
+
+BENCHMARK(BM_CompressWithGzip)
+    ->ArgsProduct({{kWeights, kSparseUpdate, kQuantizedUpdate},
+                   {1, 6, 9},
+                   {static_cast<int>(Strategy::kDefault),
+                    static_cast<int>(Strategy::kFiltered),
+                    static_cast<int>(Strategy::kRle)}});
+
+// Compresses payload state.range(0) in pieces of state.range(1) bytes, as e.g.
+// an upload would, with the default options.
+void BM_GzipCompressorAppend(benchmark::State& state) {
+  std::string data = CreatePayload(static_cast<Payload>(state.range(0)));
+  const size_t piece_size = state.range(1);
+  for (auto s : state) {
+    absl::StatusOr<std::unique_ptr<GzipCompressor>> compressor =
+        GzipCompressor::Create();
+    FCP_CHECK_STATUS(compressor.status());
+    std::string compressed;
+    for (size_t offset = 0; offset < data.size(); offset += piece_size) {
+      FCP_CHECK_STATUS((*compressor)->Append(
+          absl::string_view(data).substr(offset, piece_size), &compressed));
+    }
+    FCP_CHECK_STATUS((*compressor)->Finish(&compressed));
+    benchmark::DoNotOptimize(compressed);
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+
+BENCHMARK(BM_GzipCompressorAppend)
+    ->ArgsProduct({{kWeights, kSparseUpdate}, {4096, 65536}});
+
+// Decompresses payload state.range(0), held in a Cord of 16 KiB chunks like a
+// received HTTP response body.
+void BM_UncompressWithGzip(benchmark::State& state) {
+  std::string data = CreatePayload(static_cast<Payload>(state.range(0)));
+  absl::StatusOr<std::string> compressed = CompressWithGzip(data);
+  FCP_CHECK_STATUS(compressed.status());
+  absl::Cord compressed_cord;
+  for (size_t offset = 0; offset < compressed->size(); offset += 16384) {
+    compressed_cord.Append(compressed->substr(offset, 16384));
+  }
+  for (auto s : state) {
+    absl::StatusOr<absl::Cord> uncompressed =
+        UncompressWithGzip(compressed_cord);
+    FCP_CHECK_STATUS(uncompressed.status());
+    benchmark::DoNotOptimize(uncompressed);
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+  SetCompressionRatio(state, data.size(), compressed->size());
+}
+
+BENCHMARK(BM_UncompressWithGzip)
+    ->Arg(kWeights)
+    ->Arg(kSparseUpdate)
+    ->Arg(kQuantizedUpdate);
+
+}  // namespace
+}  // namespace fcp
@@ -16,13 +16,33 @@
 
 #include "fcp/base/compression.h"
 
+#include <cstddef>
+#include <memory>
+#include <string>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/string_view.h"
 #include "fcp/testing/testing.h"
 
 namespace fcp::base {
 namespace {
 
+using ::testing::Gt;
+using ::testing::Lt;
+
+// Returns somewhat compressible data, which is different at every offset.
+std::string CreateData(size_t size) {
+  std::string data(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = static_cast<char>((i * i) % 13 + i / 1000);
+  }
+  return data;
+}
+
 TEST(CompressionTest, CompressDecompressEmptyString) {
   auto compressed = CompressWithGzip("");
   ASSERT_OK(compressed);
@@ -43,5 +63,137 @@ TEST(CompressionTest, CompressDecompressNonEmptyString) {
 
   EXPECT_EQ(*uncompressed, data);
 }
+
+TEST(CompressionTest, CompressDecompressWithOptions) {
+  std::string data = CreateData(100000);
+  for (GzipCompressionOptions::Strategy strategy :
+       {GzipCompressionOptions::Strategy::kDefault,
+        GzipCompressionOptions::Strategy::kFiltered,
+        GzipCompressionOptions::Strategy::kHuffmanOnly,
+        GzipCompressionOptions::Strategy::kRle}) {
+    for (int level = -1; level <= 9; ++level) {
+      absl::StatusOr<std::string> compressed = CompressWithGzip(
+          data, {.level = level, .strategy = strategy});
+      ASSERT_OK(compressed);
+      absl::StatusOr<absl::Cord> uncompressed = UncompressWithGzip(*compressed);
+      ASSERT_OK(uncompressed);
+      EXPECT_EQ(*uncompressed, data);
+    }
+  }
+}
+
+TEST(CompressionTest, CompressionLevelTradesSpeedForSize) {
+  std::string data = CreateData(100000);
+  absl::StatusOr<std::string> stored = CompressWithGzip(data, {.level = 0});
+  absl::StatusOr<std::string> fastest = CompressWithGzip(data, {.level = 1});
+  absl::StatusOr<std::string> smallest = CompressWithGzip(data, {.level = 9});
+  ASSERT_OK(stored);
+  ASSERT_OK(fastest);
+  ASSERT_OK(smallest);
+  EXPECT_THAT(stored->size(), Gt(data.size()));
+  EXPECT_THAT(fastest->size(), Lt(data.size()));
+  EXPECT_THAT(smallest->size(), Lt(fastest->size()));
+}
+
+TEST(CompressionTest, InvalidCompressionLevel) {
+  EXPECT_THAT(CompressWithGzip("foobar", {.level = 10}),
+              IsCode(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(GzipCompressor::Create({.level = -2}),
+              IsCode(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(CompressionTest, StreamingCompression) {
+  std::string data = CreateData(1000000);
+  absl::StatusOr<std::unique_ptr<GzipCompressor>> compressor =
+      GzipCompressor::Create();
+  ASSERT_OK(compressor);
+  std::string compressed;
+  for (size_t offset = 0; offset < data.size(); offset += 1000) {
+    ASSERT_OK((*compressor)->Append(
+        absl::string_view(data).substr(offset, 1000), &compressed));
+  }
+  // Compressed data is produced before all data has been appended.
+  EXPECT_THAT(compressed.size(), Gt(0));
+  ASSERT_OK((*compressor)->Finish(&compressed));
+
+  EXPECT_EQ(compressed, *CompressWithGzip(data));
+  EXPECT_THAT((*compressor)->Append("foo", &compressed),
+              IsCode(absl::StatusCode::kFailedPrecondition));
+  EXPECT_THAT((*compressor)->Finish(&compressed),
+              IsCode(absl::StatusCode::kFailedPrecondition));
+}
+
+TEST(CompressionTest, StreamingDecompression) {
+  std::string data = CreateData(100000);
+  absl::StatusOr<std::string> compressed = CompressWithGzip(data);
+  ASSERT_OK(compressed);
+  absl::StatusOr<std::unique_ptr<GzipDecompressor>> decompressor =
+      GzipDecompressor::Create();
+  ASSERT_OK(decompressor);
+  absl::Cord uncompressed;
+  for (char c : *compressed) {
+    ASSERT_OK((*decompressor)->Append(absl::string_view(&c, 1), &uncompressed));
+  }
+  ASSERT_OK((*decompressor)->Finish());
+  EXPECT_EQ(uncompressed, data);
+}
+
+TEST(CompressionTest, DecompressHighlyCompressedData) {
+  // The uncompressed data is many times the size of the decompressor's
+  // buffers.
+  std::string data(10000000, '\0');
+  absl::StatusOr<std::string> compressed = CompressWithGzip(data);
+  ASSERT_OK(compressed);
+  absl::StatusOr<absl::Cord> uncompressed = UncompressWithGzip(*compressed);
+  ASSERT_OK(uncompressed);
+  EXPECT_EQ(*uncompressed, data);
+}
+
+TEST(CompressionTest, DecompressCord) {
+  std::string data = CreateData(100000);
+  absl::StatusOr<std::string> compressed = CompressWithGzip(data);
+  ASSERT_OK(compressed);
+  absl::Cord compressed_cord;
+  for (size_t offset = 0; offset < compressed->size(); offset += 100) {
+    compressed_cord.Append(compressed->substr(offset, 100));
+  }
+  absl::StatusOr<absl::Cord> uncompressed = UncompressWithGzip(compressed_cord);
+  ASSERT_OK(uncompressed);
+  EXPECT_EQ(*uncompressed, data);
+}
+
+TEST(CompressionTest, DecompressConcatenatedStreams) {
+  absl::StatusOr<std::string> foo = CompressWithGzip("foo");
+  absl::StatusOr<std::string> bar = CompressWithGzip("bar");
+  ASSERT_OK(foo);
+  ASSERT_OK(bar);
+  absl::StatusOr<absl::Cord> uncompressed = UncompressWithGzip(*foo + *bar);
+  ASSERT_OK(uncompressed);
+  EXPECT_EQ(*uncompressed, "foobar");
+}
+
+TEST(CompressionTest, DecompressEmptyData) {
+  absl::StatusOr<absl::Cord> uncompressed = UncompressWithGzip("");
+  ASSERT_OK(uncompressed);
+  EXPECT_EQ(*uncompressed, "");
+}
+
+TEST(CompressionTest, DecompressTruncatedDataFails) {
+  absl::StatusOr<std::string> compressed = CompressWithGzip(CreateData(1000));
+  ASSERT_OK(compressed);
+  compressed->pop_back();
+  EXPECT_THAT(UncompressWithGzip(*compressed),
+              IsCode(absl::StatusCode::kInternal));
+}
+
+TEST(CompressionTest, DecompressInvalidDataFails) {
+  absl::StatusOr<std::string> compressed = CompressWithGzip("foobar");
+  ASSERT_OK(compressed);
+  EXPECT_THAT(UncompressWithGzip("foobar"),
+              IsCode(absl::StatusCode::kInternal));
+  EXPECT_THAT(UncompressWithGzip(*compressed + "foobar"),
+              IsCode(absl::StatusCode::kInternal));
+}
+
 }  // namespace
 }  // namespace fcp::base
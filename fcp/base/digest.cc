@@ -16,46 +16,157 @@
 
 #include "fcp/base/digest.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
 
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/message_lite.h"
 #include "absl/functional/function_ref.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
 #include "fcp/base/monitoring.h"
-#include "openssl/base.h"
-#include "openssl/digest.h"
+#include "fcp/base/scheduler.h"
+#include "openssl/sha.h"
 
 namespace fcp {
 
 namespace {
-static std::string ComputeSHA256(
-    absl::FunctionRef<void(EVP_MD_CTX*)> digest_updater) {
-  bssl::ScopedEVP_MD_CTX mdctx;
-  const EVP_MD* sha256_md = EVP_sha256();
-  FCP_CHECK(EVP_DigestInit_ex(mdctx.get(), sha256_md, nullptr));
-
-  // Let the callback update the digest.
-  digest_updater(mdctx.get());
-
-  std::string result(EVP_MD_size(sha256_md), '\0');
-  FCP_CHECK(EVP_DigestFinal_ex(
-      mdctx.get(), reinterpret_cast<uint8_t*>(result.data()), nullptr));
-  return result;
+// Messages up to this size are serialized into a buffer on the stack before
+// being hashed. Larger ones are hashed in pieces of this size.
+constexpr size_t kMessageBufferSize = 4096;
+
+// Feeds everything written to it to a Sha256Hasher.
+class HashingOutputStream : public google::protobuf::io::CopyingOutputStream {
+ public:
+  explicit HashingOutputStream(Sha256Hasher* hasher) : hasher_(hasher) {}
+
+  bool Write(const void* buffer, int size) override {
+    hasher_->Update(
+        absl::string_view(static_cast<const char*>(buffer), size));
+    return true;
+  }
+
+ private:
+  Sha256Hasher* hasher_;
+};
+
+void UpdateWithUint64(Sha256Hasher& hasher, uint64_t value) {
+  char bytes[8];
+  for (char& byte : bytes) {
+    byte = static_cast<char>(value & 0xff);
+    value >>= 8;
+  }
+  hasher.Update(absl::string_view(bytes, sizeof(bytes)));
+}
+
+// Implements ComputeChunkedSHA256, where hash_chunk(i, hasher) appends the
+// i-th chunk of the data to the hasher.
+std::string ComputeChunkedSHA256(
+    size_t data_size, size_t chunk_size, Scheduler* scheduler,
+    absl::FunctionRef<void(size_t, Sha256Hasher&)> hash_chunk) {
+  FCP_CHECK(chunk_size > 0);
+  size_t num_chunks = (data_size + chunk_size - 1) / chunk_size;
+  std::string chunk_digests(num_chunks * SHA256_DIGEST_LENGTH, '\0');
+  // The calling thread hashes alongside the tasks scheduled, if any.
+  ParallelFor(scheduler, num_chunks,
+              [hash_chunk = &hash_chunk,
+               chunk_digests = chunk_digests.data()](size_t chunk) {
+                Sha256Hasher hasher;
+                (*hash_chunk)(chunk, hasher);
+                std::string digest = hasher.Finalize();
+                std::copy(digest.begin(), digest.end(),
+                          chunk_digests + chunk * SHA256_DIGEST_LENGTH);
+              });
+
+  Sha256Hasher hasher;
+  UpdateWithUint64(hasher, chunk_size);
+  UpdateWithUint64(hasher, data_size);
+  hasher.Update(chunk_digests);
+  return hasher.Finalize();
 }
 }  // namespace
 
 std::string ComputeSHA256(absl::string_view data) {
-  return ComputeSHA256([&data](EVP_MD_CTX* mdctx) {
-    FCP_CHECK(EVP_DigestUpdate(mdctx, data.data(), data.length()));
-  });
+  Sha256Hasher hasher;
+  hasher.Update(data);
+  return hasher.Finalize();
 }
 
 std::string ComputeSHA256(const absl::Cord& data) {
-  return ComputeSHA256([&data](EVP_MD_CTX* mdctx) {
-    for (auto chunk : data.Chunks()) {
-      FCP_CHECK(EVP_DigestUpdate(mdctx, chunk.data(), chunk.length()));
-    }
-  });
+  Sha256Hasher hasher;
+  hasher.Update(data);
+  return hasher.Finalize();
+}
+
+std::string ComputeSHA256(const google::protobuf::MessageLite& message) {
+  Sha256Hasher hasher;
+  hasher.Update(message);
+  return hasher.Finalize();
+}
+
+struct Sha256Hasher::State {
+  SHA256_CTX ctx;
+};
+
+Sha256Hasher::Sha256Hasher() : state_(std::make_unique<State>()) {
+  FCP_CHECK(SHA256_Init(&state_->ctx));
+}
+
+Sha256Hasher::~Sha256Hasher() = default;
+Sha256Hasher::Sha256Hasher(Sha256Hasher&&) = default;
+Sha256Hasher& Sha256Hasher::operator=(Sha256Hasher&&) = default;
+
+void Sha256Hasher::Update(absl::string_view data) {
+  FCP_CHECK(SHA256_Update(&state_->ctx, data.data(), data.length()));
+}
+
+void Sha256Hasher::Update(const absl::Cord& data) {
+  for (absl::string_view chunk : data.Chunks()) {
+    Update(chunk);
+  }
+}
+
+void Sha256Hasher::Update(const google::protobuf::MessageLite& message) {
+  size_t size = message.ByteSizeLong();
+  if (size <= kMessageBufferSize) {
+    char buffer[kMessageBufferSize];
+    FCP_CHECK(message.SerializePartialToArray(buffer, static_cast<int>(size)));
+    Update(absl::string_view(buffer, size));
+    return;
+  }
+  HashingOutputStream stream(this);
+  google::protobuf::io::CopyingOutputStreamAdaptor adaptor(&stream,
+                                                           kMessageBufferSize);
+  FCP_CHECK(message.SerializePartialToZeroCopyStream(&adaptor));
+  FCP_CHECK(adaptor.Flush());
+}
+
+std::string Sha256Hasher::Finalize() {
+  std::string result(SHA256_DIGEST_LENGTH, '\0');
+  FCP_CHECK(SHA256_Final(reinterpret_cast<uint8_t*>(result.data()),
+                         &state_->ctx));
+  FCP_CHECK(SHA256_Init(&state_->ctx));
+  return result;
+}
+
+std::string ComputeChunkedSHA256(absl::string_view data, size_t chunk_size,
+                                 Scheduler* scheduler) {
+  return ComputeChunkedSHA256(
+      data.size(), chunk_size, scheduler,
+      [data, chunk_size](size_t chunk, Sha256Hasher& hasher) {
+        hasher.Update(data.substr(chunk * chunk_size, chunk_size));
+      });
+}
+
+std::string ComputeChunkedSHA256(const absl::Cord& data, size_t chunk_size,
+                                 Scheduler* scheduler) {
+  return ComputeChunkedSHA256(
+      data.size(), chunk_size, scheduler,
+      [&data, chunk_size](size_t chunk, Sha256Hasher& hasher) {
+        hasher.Update(data.Subcord(chunk * chunk_size, chunk_size));
+      });
 }
 }  // namespace fcp
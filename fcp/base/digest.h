@@ -17,10 +17,14 @@
 #ifndef FCP_BASE_DIGEST_H_
 #define FCP_BASE_DIGEST_H_
 
+#include <cstddef>
+#include <memory>
 #include <string>
 
+#include "google/protobuf/message_lite.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
+#include "fcp/base/scheduler.h"
 
 namespace fcp {
 // Returns the SHA256 hash for the given data. Note that the return value
@@ -29,6 +33,59 @@ std::string ComputeSHA256(const absl::Cord& data);
 // Returns the SHA256 hash for the given data. Note that the return value
 // contains raw digest bytes, and not a human-readable hex-encoded string.
 std::string ComputeSHA256(absl::string_view data);
+// Returns the SHA256 hash of the serialized message, i.e. the same as
+// ComputeSHA256(message.SerializeAsString()), but without holding the whole
+// serialized message in memory.
+std::string ComputeSHA256(const google::protobuf::MessageLite& message);
+
+// Computes a SHA256 hash incrementally, for data which arrives in pieces, e.g.
+// from the network or a file. Hashing the pieces in order results in the same
+// hash as ComputeSHA256 over their concatenation.
+//
+// This class is not thread safe.
+class Sha256Hasher {
+ public:
+  Sha256Hasher();
+  ~Sha256Hasher();
+
+  // Sha256Hasher is moveable but not copyable. A moved-from hasher must not be
+  // used.
+  Sha256Hasher(Sha256Hasher&&);
+  Sha256Hasher& operator=(Sha256Hasher&&);
+  Sha256Hasher(const Sha256Hasher&) = delete;
+  Sha256Hasher& operator=(const Sha256Hasher&) = delete;
+
+  // Appends data to the hashed data.
+  void Update(absl::string_view data);
+  void Update(const absl::Cord& data);
+  // Appends the serialized message to the hashed data, without holding the
+  // whole serialized message in memory.
+  void Update(const google::protobuf::MessageLite& message);
+
+  // Returns the raw SHA256 digest of all data appended since construction or
+  // the last call to Finalize(), and resets the hasher so that it can be used
+  // to hash new data.
+  std::string Finalize();
+
+ private:
+  // Holds the OpenSSL hashing state, which is kept out of this header.
+  struct State;
+  std::unique_ptr<State> state_;
+};
+
+// Returns a digest of the given data, computed by hashing chunks of
+// `chunk_size` bytes with SHA256 in parallel on `scheduler` (if set) and the
+// calling thread, and then hashing the chunk digests, along with the chunk
+// size and data size, together.
+//
+// This is meant for integrity checks of large local data, such as
+// checkpoints. The result is NOT the SHA256 hash of the data, and depends on
+// `chunk_size`, so it can only be compared to digests computed by this
+// function with the same chunk size. `chunk_size` must be positive.
+std::string ComputeChunkedSHA256(absl::string_view data, size_t chunk_size,
+                                 Scheduler* scheduler);
+std::string ComputeChunkedSHA256(const absl::Cord& data, size_t chunk_size,
+                                 Scheduler* scheduler);
 }  // namespace fcp
 
 #endif  // FCP_BASE_DIGEST_H_
@@ -16,16 +16,34 @@
 
 #include "fcp/base/digest.h"
 
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "google/protobuf/wrappers.pb.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/escaping.h"
+#include "absl/strings/string_view.h"
+#include "fcp/base/scheduler.h"
 
 namespace fcp::base {
 namespace {
 using testing::BeginEndDistanceIs;
 using testing::Ge;
 
+// Returns data which is different at every offset, so that any chunk mix-up
+// changes its digest.
+std::string CreateData(size_t size) {
+  std::string data(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = static_cast<char>(i * 31 + i / 251);
+  }
+  return data;
+}
+
 TEST(DigestTest, HashOverEmptyStringIsCorrect) {
   EXPECT_EQ(absl::BytesToHexString(ComputeSHA256("")),
             "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
@@ -66,5 +84,93 @@ TEST(DigestTest, HashOverNonEmptyCordWithMultipleChunksIsCorrect) {
             "d8a99ca286ff7a93ed9388ecb36c3da3b55a1f198924aa47bb9698a78dd185f4");
 }
 
+TEST(DigestTest, HasherOverPiecesMatchesHashOverWhole) {
+  Sha256Hasher hasher;
+  hasher.Update("foo");
+  hasher.Update("");
+  hasher.Update(absl::Cord("bar"));
+  EXPECT_EQ(absl::BytesToHexString(hasher.Finalize()),
+            "c3ab8ff13720e8ad9047dd39466b3c8974e592c2fa383d4a3960714caef0c4f2");
+}
+
+TEST(DigestTest, HasherCanBeReusedAfterFinalize) {
+  Sha256Hasher hasher;
+  hasher.Update("foobar");
+  hasher.Finalize();
+  EXPECT_EQ(absl::BytesToHexString(hasher.Finalize()),
+            "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  hasher.Update("bazfoz");
+  EXPECT_EQ(absl::BytesToHexString(hasher.Finalize()),
+            "9491b1103aa3c2cecd90b4cb4cc500441784fc1162a15f3db24f58eda5819fd6");
+}
+
+TEST(DigestTest, MovedHasherKeepsHashedData) {
+  Sha256Hasher hasher;
+  hasher.Update("foo");
+  Sha256Hasher moved_hasher(std::move(hasher));
+  moved_hasher.Update("bar");
+  EXPECT_EQ(absl::BytesToHexString(moved_hasher.Finalize()),
+            "c3ab8ff13720e8ad9047dd39466b3c8974e592c2fa383d4a3960714caef0c4f2");
+}
+
+TEST(DigestTest, HashOverMessageMatchesHashOverSerializedMessage) {
+  // Both a message small enough to be serialized in one go, and one large
+  // enough to be serialized in pieces.
+  for (size_t size : {0, 100, 100000}) {
+    google::protobuf::BytesValue message;
+    message.set_value(CreateData(size));
+    EXPECT_EQ(ComputeSHA256(message),
+              ComputeSHA256(message.SerializeAsString()));
+
+    Sha256Hasher hasher;
+    hasher.Update("prefix");
+    hasher.Update(message);
+    EXPECT_EQ(hasher.Finalize(),
+              ComputeSHA256("prefix" + message.SerializeAsString()));
+  }
+}
+
+TEST(DigestTest, ChunkedHashHashesChunkDigests) {
+  std::string data = CreateData(2500);
+  std::string chunked_digest =
+      ComputeChunkedSHA256(data, /*chunk_size=*/1024, /*scheduler=*/nullptr);
+
+  Sha256Hasher hasher;
+  // The little endian chunk size and data size.
+  hasher.Update(absl::string_view("\x00\x04\0\0\0\0\0\0", 8));
+  hasher.Update(absl::string_view("\xc4\x09\0\0\0\0\0\0", 8));
+  hasher.Update(ComputeSHA256(data.substr(0, 1024)));
+  hasher.Update(ComputeSHA256(data.substr(1024, 1024)));
+  hasher.Update(ComputeSHA256(data.substr(2048)));
+  EXPECT_EQ(chunked_digest, hasher.Finalize());
+  EXPECT_NE(chunked_digest, ComputeSHA256(data));
+}
+
+TEST(DigestTest, ChunkedHashIsIndependentOfSchedulerAndRepresentation) {
+  std::string data = CreateData(1000000);
+  absl::Cord cord;
+  // Cord chunks that don't line up with the hashed chunks.
+  for (size_t offset = 0; offset < data.size(); offset += 3000) {
+    cord.Append(data.substr(offset, 3000));
+  }
+  std::unique_ptr<Scheduler> scheduler = CreateThreadPoolScheduler(4);
+
+  std::string digest = ComputeChunkedSHA256(data, 4096, nullptr);
+  EXPECT_EQ(ComputeChunkedSHA256(data, 4096, scheduler.get()), digest);
+  EXPECT_EQ(ComputeChunkedSHA256(cord, 4096, nullptr), digest);
+  EXPECT_EQ(ComputeChunkedSHA256(cord, 4096, scheduler.get()), digest);
+  EXPECT_NE(ComputeChunkedSHA256(data, 8192, scheduler.get()), digest);
+  scheduler->WaitUntilIdle();
+}
+
+TEST(DigestTest, ChunkedHashOverEmptyData) {
+  std::unique_ptr<Scheduler> scheduler = CreateThreadPoolScheduler(2);
+  EXPECT_EQ(ComputeChunkedSHA256("", 16, scheduler.get()),
+            ComputeSHA256(std::string(16, '\0').replace(0, 1, "\x10")));
+  EXPECT_EQ(ComputeChunkedSHA256(absl::Cord(), 16, nullptr),
+            ComputeChunkedSHA256("", 16, nullptr));
+  scheduler->WaitUntilIdle();
+}
+
 }  // namespace
 }  // namespace fcp::base
@@ -28,6 +28,10 @@
 
 #ifdef _WIN32
 #include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 
 #include "absl/strings/str_cat.h"
@@ -85,6 +89,42 @@ absl::StatusOr<absl::Cord> ReadFileToCord(absl::string_view file_name) {
   return internal::ReadFile<absl::Cord>(file_name);
 }
 
+absl::StatusOr<absl::Cord> MapFileToCord(absl::string_view file_name) {
+#ifdef _WIN32
+  return ReadFileToCord(file_name);
+#else
+  auto file_name_str = std::string(file_name);
+  int fd = open(file_name_str.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return absl::InternalError(
+        absl::StrCat("cannot read file ", file_name_str));
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    return absl::InternalError(
+        absl::StrCat("cannot stat file ", file_name_str));
+  }
+  size_t size = static_cast<size_t>(info.st_size);
+  if (size == 0) {
+    // mmap() doesn't support empty mappings.
+    close(fd);
+    return absl::Cord();
+  }
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file, so the descriptor isn't
+  // needed anymore.
+  close(fd);
+  if (data == MAP_FAILED) {
+    return absl::InternalError(
+        absl::StrCat("cannot map file ", file_name_str));
+  }
+  return absl::MakeCordFromExternal(
+      absl::string_view(static_cast<const char*>(data), size),
+      [data, size](absl::string_view) { munmap(data, size); });
+#endif
+}
+
 absl::Status WriteStringToFile(absl::string_view file_name,
                                absl::string_view content) {
   auto file_name_str = std::string(file_name);
@@ -49,6 +49,15 @@ absl::StatusOr<std::string> ReadFileToString(absl::string_view file_name);
  */
 absl::StatusOr<absl::Cord> ReadFileToCord(absl::string_view file_name);
 
+/**
+ * Maps file content into absl::Cord without copying it, where supported. The
+ * returned Cord references a read-only mapping of the file which is released
+ * once the Cord and all its copies are destroyed. The file must not be
+ * modified in place while the Cord is alive; replacing or deleting it is safe.
+ * Falls back to ReadFileToCord() on platforms without mmap.
+ */
+absl::StatusOr<absl::Cord> MapFileToCord(absl::string_view file_name);
+
 /**
  * Writes string content into file.
  */
@@ -16,6 +16,9 @@
 
 #include "fcp/base/platform.h"
 
+#include <cstdio>
+#include <string>
+
 #include "gtest/gtest.h"
 #include "absl/strings/cord.h"
 #include "fcp/base/base_name.h"
@@ -64,6 +67,34 @@ TEST(PlatformTest, ReadWriteCord) {
   ASSERT_EQ(status_or_cord.value(), "Ein Text");
 }
 
+TEST(PlatformTest, MapCord) {
+  auto file = TemporaryTestFile(".dat");
+  std::string content(4096, 'x');
+  content.append("Ein Text");
+  ASSERT_EQ(WriteStringToFile(file, content).code(), OK);
+  auto status_or_cord = MapFileToCord(file);
+  ASSERT_TRUE(status_or_cord.ok()) << status_or_cord.status();
+  ASSERT_EQ(status_or_cord.value(), content);
+}
+
+TEST(PlatformTest, MapEmptyCord) {
+  auto file = TemporaryTestFile(".dat");
+  ASSERT_EQ(WriteStringToFile(file, "").code(), OK);
+  auto status_or_cord = MapFileToCord(file);
+  ASSERT_TRUE(status_or_cord.ok()) << status_or_cord.status();
+  ASSERT_TRUE(status_or_cord.value().empty());
+}
+
+TEST(PlatformTest, MapCordOutlivesFile) {
+  auto file = TemporaryTestFile(".dat");
+  std::string content(4096, 'y');
+  ASSERT_EQ(WriteStringToFile(file, content).code(), OK);
+  auto status_or_cord = MapFileToCord(file);
+  ASSERT_TRUE(status_or_cord.ok()) << status_or_cord.status();
+  ASSERT_EQ(std::remove(file.c_str()), 0);
+  ASSERT_EQ(status_or_cord.value(), content);
+}
+
 TEST(PlatformTest, ReadStringFails) {
   ASSERT_FALSE(ReadFileToString("foobarbaz").ok());
 }
@@ -72,6 +103,10 @@ TEST(PlatformTest, ReadCordFails) {
   ASSERT_FALSE(ReadFileToCord("foobarbaz").ok());
 }
 
+TEST(PlatformTest, MapCordFails) {
+  ASSERT_FALSE(MapFileToCord("foobarbaz").ok());
+}
+
 TEST(PlatformTest, BaseName) {
   ASSERT_EQ(BaseName(ConcatPath("foo", "bar.x")), "bar.x");
 }
@@ -16,7 +16,10 @@
 
 #include "fcp/base/scheduler.h"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstddef>
 #include <functional>
 #include <memory>
 #include <queue>
@@ -26,6 +29,8 @@
 
 #include "absl/synchronization/blocking_counter.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 
 namespace fcp {
 
@@ -202,4 +207,104 @@ std::unique_ptr<Scheduler> CreateThreadPoolScheduler(std::size_t thread_count) {
   return std::make_unique<ThreadPoolScheduler>(thread_count);
 }
 
+namespace {
+
+// State of a ParallelFor, shared with the tasks it schedules, as those may
+// only run after the ParallelFor has returned.
+class ParallelForState {
+ public:
+  using TaskTimesObserver =
+      std::function<void(absl::Duration wait_time, absl::Duration run_time)>;
+
+  ParallelForState(std::size_t count, std::function<void(std::size_t)> function,
+                   TaskTimesObserver task_times_observer)
+      : count_(count),
+        function_(std::move(function)),
+        task_times_observer_(std::move(task_times_observer)) {}
+
+  // Claims and runs indices until none are left.
+  void Run() { MarkCompleted(RunIndices()); }
+
+  // Like Run(), but for a task scheduled at scheduled_time, whose times are
+  // reported to the observer if there is one.
+  void RunScheduled(absl::Time scheduled_time) {
+    if (!task_times_observer_) {
+      Run();
+      return;
+    }
+    absl::Time start_time = absl::Now();
+    std::size_t completed = RunIndices();
+    // A task which found no index left isn't reported, as the ParallelFor may
+    // have returned already, and the observer may be gone. Otherwise, the
+    // ParallelFor waits for the report, as it comes before MarkCompleted.
+    if (completed > 0) {
+      task_times_observer_(start_time - scheduled_time,
+                           absl::Now() - start_time);
+    }
+    MarkCompleted(completed);
+  }
+
+  void WaitUntilCompleted() {
+    absl::MutexLock lock(&mutex_);
+    mutex_.Await(absl::Condition(this, &ParallelForState::IsCompleted));
+  }
+
+  bool has_task_times_observer() const {
+    return static_cast<bool>(task_times_observer_);
+  }
+
+ private:
+  // Returns the number of indices run.
+  std::size_t RunIndices() {
+    std::size_t completed = 0;
+    for (std::size_t i = next_.fetch_add(1); i < count_;
+         i = next_.fetch_add(1)) {
+      function_(i);
+      ++completed;
+    }
+    return completed;
+  }
+
+  void MarkCompleted(std::size_t completed) {
+    if (completed > 0) {
+      absl::MutexLock lock(&mutex_);
+      completed_ += completed;
+    }
+  }
+
+  bool IsCompleted() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return completed_ == count_;
+  }
+
+  const std::size_t count_;
+  const std::function<void(std::size_t)> function_;
+  const TaskTimesObserver task_times_observer_;
+  std::atomic<std::size_t> next_ = 0;
+  absl::Mutex mutex_;
+  std::size_t completed_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+}  // namespace
+
+void ParallelFor(Scheduler* scheduler, std::size_t count,
+                 std::function<void(std::size_t)> function,
+                 const ParallelForOptions& options) {
+  auto state = std::make_shared<ParallelForState>(count, std::move(function),
+                                                  options.task_times_observer);
+  if (scheduler != nullptr) {
+    // The calling thread runs alongside the scheduled tasks.
+    std::size_t num_threads = std::min(count, options.max_tasks + 1);
+    // Only read the clock if the task times are observed.
+    absl::Time scheduled_time = state->has_task_times_observer()
+                                    ? absl::Now()
+                                    : absl::InfinitePast();
+    for (std::size_t i = 1; i < num_threads; ++i) {
+      scheduler->Schedule(
+          [state, scheduled_time] { state->RunScheduled(scheduled_time); });
+    }
+  }
+  state->Run();
+  state->WaitUntilCompleted();
+}
+
 }  // namespace fcp
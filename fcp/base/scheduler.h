@@ -25,9 +25,11 @@
  * tasks and futures.
  */
 
+#include <cstddef>
 #include <functional>
 #include <memory>
 
+#include "absl/time/time.h"
 #include "fcp/base/monitoring.h"
 #include "fcp/base/move_to_lambda.h"
 
@@ -105,6 +107,42 @@ class Scheduler {
  */
 std::unique_ptr<Scheduler> CreateThreadPoolScheduler(std::size_t thread_count);
 
+/**
+ * Options for ParallelFor.
+ */
+struct ParallelForOptions {
+  /**
+   * The maximum number of tasks handed to the scheduler. Each task keeps
+   * claiming indices until none are left, so there is no point in having many
+   * more tasks than the scheduler has threads.
+   */
+  std::size_t max_tasks = 64;
+
+  /**
+   * If set, called by each scheduled task which ran at least one index, with
+   * the time the task spent waiting for a thread of the scheduler and the
+   * time it then spent running. Tasks which found no index left aren't
+   * reported, as ParallelFor may have returned already. Must be thread-safe.
+   */
+  std::function<void(absl::Duration wait_time, absl::Duration run_time)>
+      task_times_observer;
+};
+
+/**
+ * Calls function(i) for each i in [0, count) and returns once all calls have
+ * completed. The calls are spread over tasks scheduled on the scheduler, and
+ * the calling thread takes part in them too, so this makes progress even if
+ * the scheduler is busy or only runs its tasks later. If the scheduler is
+ * null, all calls are made on the calling thread.
+ *
+ * The function must be safe to call concurrently. It must not itself call
+ * ParallelFor on the same scheduler, as the tasks of the inner call could then
+ * be stuck behind those of the outer one.
+ */
+void ParallelFor(Scheduler* scheduler, std::size_t count,
+                 std::function<void(std::size_t)> function,
+                 const ParallelForOptions& options = {});
+
 }  // namespace fcp
 
 #endif  // FCP_BASE_SCHEDULER_H_
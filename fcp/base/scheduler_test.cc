@@ -17,11 +17,17 @@
 #include "fcp/base/scheduler.h"
 
 #include <atomic>
+#include <cstddef>
 #include <cstdlib>  // for std::rand
+#include <functional>
+#include <utility>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/synchronization/blocking_counter.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "fcp/base/monitoring.h"
 #include "fcp/testing/testing.h"
 
@@ -122,6 +128,95 @@ TEST(Worker, TasksAreExecutedSequentially) {
   }
 }
 
+// A scheduler which only runs its tasks when asked to.
+class DeferredScheduler : public Scheduler {
+ public:
+  void Schedule(std::function<void()> task) override {
+    tasks_.push_back(std::move(task));
+  }
+  void WaitUntilIdle() override { RunTasks(); }
+
+  void RunTasks() {
+    for (const auto& task : tasks_) {
+      task();
+    }
+    tasks_.clear();
+  }
+
+  std::size_t num_tasks() const { return tasks_.size(); }
+
+ private:
+  std::vector<std::function<void()>> tasks_;
+};
+
+// Tests that ParallelFor calls the function once per index.
+TEST(ParallelFor, RunsEachIndexOnce) {
+  auto pool = CreateThreadPoolScheduler(4);
+  std::vector<std::atomic<int>> calls(1000);
+  ParallelFor(pool.get(), calls.size(),
+              [&calls](std::size_t i) { calls[i]++; });
+  for (const auto& count : calls) {
+    ASSERT_EQ(count.load(), 1);
+  }
+  pool->WaitUntilIdle();
+}
+
+// Tests that ParallelFor runs everything on the calling thread without a
+// scheduler, and does nothing for an empty range.
+TEST(ParallelFor, WithoutScheduler) {
+  int sum = 0;
+  ParallelFor(nullptr, 10, [&sum](std::size_t i) { sum += i; });
+  ASSERT_EQ(sum, 45);
+  ParallelFor(nullptr, 0, [](std::size_t) { FCP_CHECK(false); });
+}
+
+// Tests that ParallelFor completes when the scheduler only runs its tasks
+// after ParallelFor has returned, and that it caps the number of tasks.
+TEST(ParallelFor, WithDeferredScheduler) {
+  DeferredScheduler scheduler;
+  ParallelForOptions options;
+  options.max_tasks = 3;
+  int sum = 0;
+  ParallelFor(&scheduler, 10, [&sum](std::size_t i) { sum += i; }, options);
+  ASSERT_EQ(sum, 45);
+  ASSERT_EQ(scheduler.num_tasks(), 3);
+  // The deferred tasks find no work left.
+  scheduler.RunTasks();
+  ASSERT_EQ(sum, 45);
+}
+
+// A scheduler which runs its tasks right away, on the scheduling thread.
+class InlineScheduler : public Scheduler {
+ public:
+  void Schedule(std::function<void()> task) override { task(); }
+  void WaitUntilIdle() override {}
+};
+
+// Tests that ParallelFor reports the times of the scheduled tasks which ran
+// some indices, and only of those.
+TEST(ParallelFor, ReportsTaskTimesOfTasksThatRan) {
+  // The first scheduled task takes all the indices, so the other tasks and
+  // the calling thread find no work left.
+  InlineScheduler scheduler;
+  std::vector<absl::Duration> run_times;
+  ParallelForOptions options;
+  options.task_times_observer = [&run_times](absl::Duration wait_time,
+                                             absl::Duration run_time) {
+    run_times.push_back(run_time);
+  };
+  int sum = 0;
+  ParallelFor(
+      &scheduler, 10,
+      [&sum](std::size_t i) {
+        absl::SleepFor(absl::Milliseconds(1));
+        sum += i;
+      },
+      options);
+  ASSERT_EQ(sum, 45);
+  ASSERT_EQ(run_times.size(), 1);
+  ASSERT_GE(run_times[0], absl::Milliseconds(10));
+}
+
 }  // namespace
 
 }  // namespace base
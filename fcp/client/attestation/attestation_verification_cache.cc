@@ -0,0 +1,90 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fcp/client/attestation/attestation_verification_cache.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "fcp/base/clock.h"
+
+namespace fcp::client::attestation {
+
+AttestationVerificationCache::AttestationVerificationCache(
+    size_t max_entries, absl::Duration max_age, Clock* clock)
+    : max_entries_(max_entries), max_age_(max_age), clock_(*clock) {}
+
+std::optional<AttestationVerificationCache::Verification>
+AttestationVerificationCache::Get(absl::string_view key) {
+  absl::Time now = clock_.Now();
+  absl::MutexLock lock(&mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return std::nullopt;
+  }
+  if (it->second.expiration_time <= now) {
+    entries_.erase(it);
+    return std::nullopt;
+  }
+  return it->second.verification;
+}
+
+void AttestationVerificationCache::Put(
+    absl::string_view key, Verification verification,
+    std::optional<absl::Time> expiration_time) {
+  absl::Time now = clock_.Now();
+  absl::Time entry_expiration_time = now + max_age_;
+  if (expiration_time.has_value()) {
+    entry_expiration_time = std::min(entry_expiration_time, *expiration_time);
+  }
+  if (max_entries_ == 0 || entry_expiration_time <= now) {
+    return;
+  }
+  absl::MutexLock lock(&mutex_);
+  if (!entries_.contains(key)) {
+    MakeRoom(now);
+  }
+  entries_.insert_or_assign(
+      key, Entry{.verification = std::move(verification),
+                 .expiration_time = entry_expiration_time});
+}
+
+void AttestationVerificationCache::MakeRoom(absl::Time now) {
+  if (entries_.size() < max_entries_) {
+    return;
+  }
+  absl::erase_if(entries_, [now](const auto& entry) {
+    return entry.second.expiration_time <= now;
+  });
+  if (entries_.size() < max_entries_) {
+    return;
+  }
+  // There are only a few entries, so a linear scan is cheap enough.
+  auto soonest = std::min_element(
+      entries_.begin(), entries_.end(), [](const auto& a, const auto& b) {
+        return a.second.expiration_time < b.second.expiration_time;
+      });
+  entries_.erase(soonest);
+}
+
+}  // namespace fcp::client::attestation
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FCP_CLIENT_ATTESTATION_ATTESTATION_VERIFICATION_CACHE_H_
+#define FCP_CLIENT_ATTESTATION_ATTESTATION_VERIFICATION_CACHE_H_
+
+#include <cstddef>
+#include <optional>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "fcp/base/clock.h"
+#include "fcp/confidentialcompute/cose.h"
+#include "fcp/protos/confidentialcompute/verification_record.pb.h"
+
+namespace fcp::client::attestation {
+
+// A bounded cache of the outcomes of successful attestation verifications, so
+// that a verifier which is presented with the same attestation
+// evidence, endorsements, access policy and public key again needn't repeat
+// the verification.
+//
+// The cache is keyed by an opaque digest of everything that determines the
+// outcome of a verification, which the verifier computes. It can therefore be
+// shared between verifiers, and should be kept for as long as the same server
+// configuration is likely to be presented again, e.g. across tasks.
+//
+// This class is thread safe.
+class AttestationVerificationCache {
+ public:
+  // An entry is dropped `max_age` after it was added, so that evidence and
+  // endorsements which were valid then aren't trusted indefinitely. Once
+  // `max_entries` entries are cached, adding another one evicts the entry
+  // which expires soonest.
+  explicit AttestationVerificationCache(
+      size_t max_entries = 16, absl::Duration max_age = absl::Hours(1),
+      Clock* clock = Clock::RealClock());
+
+  // AttestationVerificationCache is neither copyable nor movable.
+  AttestationVerificationCache(const AttestationVerificationCache&) = delete;
+  AttestationVerificationCache& operator=(
+      const AttestationVerificationCache&) = delete;
+
+  // The outcome of a successful verification.
+  struct Verification {
+    // The verified public key.
+    confidential_compute::OkpKey public_key;
+    // The record which was logged for the verification, so that it can be
+    // logged again when the cached outcome is used.
+    confidentialcompute::AttestationVerificationRecord record;
+  };
+
+  // Returns the outcome of the verification with the given key, or
+  // std::nullopt if there is no such entry, or it has expired.
+  std::optional<Verification> Get(absl::string_view key);
+
+  // Caches the outcome of the verification with the given key.
+  // `expiration_time` is when the public key itself expires, if it does; the
+  // entry expires then at the latest.
+  void Put(absl::string_view key, Verification verification,
+           std::optional<absl::Time> expiration_time);
+
+ private:
+  struct Entry {
+    Verification verification;
+    absl::Time expiration_time;
+  };
+
+  // Evicts expired entries, and then the entry which expires soonest if there
+  // still is no room for another one.
+  void MakeRoom(absl::Time now) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const size_t max_entries_;
+  const absl::Duration max_age_;
+  Clock& clock_;
+  absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, Entry> entries_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace fcp::client::attestation
+
+#endif  // FCP_CLIENT_ATTESTATION_ATTESTATION_VERIFICATION_CACHE_H_
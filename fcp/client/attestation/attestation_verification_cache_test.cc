@@ -0,0 +1,143 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fcp/client/attestation/attestation_verification_cache.h"
+
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/time/time.h"
+#include "fcp/base/simulated_clock.h"
+#include "fcp/confidentialcompute/cose.h"
+#include "fcp/protos/confidentialcompute/verification_record.pb.h"
+#include "fcp/testing/testing.h"
+
+namespace fcp::client::attestation {
+namespace {
+
+using ::fcp::confidential_compute::OkpKey;
+using ::fcp::confidentialcompute::AttestationVerificationRecord;
+using ::testing::Eq;
+using ::testing::Field;
+using ::testing::Optional;
+
+using Verification = AttestationVerificationCache::Verification;
+
+Verification CreateKey(std::string key_id) {
+  return Verification{
+      .public_key = OkpKey{.key_id = std::move(key_id), .x = "public key"}};
+}
+
+auto HasKeyId(std::string key_id) {
+  return Optional(Field(&Verification::public_key,
+                        Field(&OkpKey::key_id, Eq(key_id))));
+}
+
+class AttestationVerificationCacheTest : public testing::Test {
+ protected:
+  SimulatedClock clock_{absl::FromUnixSeconds(1000)};
+  AttestationVerificationCache cache_{/*max_entries=*/2,
+                                      /*max_age=*/absl::Minutes(10), &clock_};
+};
+
+TEST_F(AttestationVerificationCacheTest, GetReturnsPutKey) {
+  EXPECT_THAT(cache_.Get("a"), Eq(std::nullopt));
+  cache_.Put("a", CreateKey("key a"), std::nullopt);
+  cache_.Put("b", CreateKey("key b"), std::nullopt);
+
+  EXPECT_THAT(cache_.Get("a"), HasKeyId("key a"));
+  EXPECT_THAT(cache_.Get("b"), HasKeyId("key b"));
+  EXPECT_THAT(cache_.Get("c"), Eq(std::nullopt));
+}
+
+TEST_F(AttestationVerificationCacheTest, GetReturnsRecord) {
+  Verification verification = CreateKey("key a");
+  verification.record.mutable_data_access_policy()->add_transforms();
+  AttestationVerificationRecord expected_record = verification.record;
+  cache_.Put("a", std::move(verification), std::nullopt);
+
+  EXPECT_THAT(cache_.Get("a"), Optional(Field(&Verification::record,
+                                              EqualsProto(expected_record))));
+}
+
+TEST_F(AttestationVerificationCacheTest, PutReplacesEntry) {
+  cache_.Put("a", CreateKey("old key"), std::nullopt);
+  cache_.Put("a", CreateKey("new key"), std::nullopt);
+  cache_.Put("b", CreateKey("key b"), std::nullopt);
+
+  EXPECT_THAT(cache_.Get("a"), HasKeyId("new key"));
+  EXPECT_THAT(cache_.Get("b"), HasKeyId("key b"));
+}
+
+TEST_F(AttestationVerificationCacheTest, EntriesExpireAfterMaxAge) {
+  cache_.Put("a", CreateKey("key a"), std::nullopt);
+  clock_.AdvanceTime(absl::Minutes(9));
+  EXPECT_THAT(cache_.Get("a"), HasKeyId("key a"));
+  clock_.AdvanceTime(absl::Minutes(1));
+  EXPECT_THAT(cache_.Get("a"), Eq(std::nullopt));
+}
+
+TEST_F(AttestationVerificationCacheTest, EntriesExpireWithPublicKey) {
+  cache_.Put("a", CreateKey("key a"), clock_.Now() + absl::Minutes(1));
+  // An expiration time past the maximum age doesn't extend it.
+  cache_.Put("b", CreateKey("key b"), clock_.Now() + absl::Hours(1));
+  clock_.AdvanceTime(absl::Minutes(1));
+  EXPECT_THAT(cache_.Get("a"), Eq(std::nullopt));
+  EXPECT_THAT(cache_.Get("b"), HasKeyId("key b"));
+  clock_.AdvanceTime(absl::Minutes(9));
+  EXPECT_THAT(cache_.Get("b"), Eq(std::nullopt));
+}
+
+TEST_F(AttestationVerificationCacheTest, ExpiredKeyIsNotCached) {
+  cache_.Put("a", CreateKey("key a"), clock_.Now());
+  EXPECT_THAT(cache_.Get("a"), Eq(std::nullopt));
+}
+
+TEST_F(AttestationVerificationCacheTest, EvictsExpiredEntriesFirst) {
+  cache_.Put("a", CreateKey("key a"), std::nullopt);
+  clock_.AdvanceTime(absl::Minutes(5));
+  cache_.Put("b", CreateKey("key b"), clock_.Now() + absl::Minutes(1));
+  clock_.AdvanceTime(absl::Minutes(2));
+  cache_.Put("c", CreateKey("key c"), std::nullopt);
+
+  EXPECT_THAT(cache_.Get("a"), HasKeyId("key a"));
+  EXPECT_THAT(cache_.Get("b"), Eq(std::nullopt));
+  EXPECT_THAT(cache_.Get("c"), HasKeyId("key c"));
+}
+
+TEST_F(AttestationVerificationCacheTest, EvictsEntryWhichExpiresSoonest) {
+  cache_.Put("a", CreateKey("key a"), std::nullopt);
+  cache_.Put("b", CreateKey("key b"), clock_.Now() + absl::Minutes(5));
+  cache_.Put("c", CreateKey("key c"), std::nullopt);
+
+  EXPECT_THAT(cache_.Get("a"), HasKeyId("key a"));
+  EXPECT_THAT(cache_.Get("b"), Eq(std::nullopt));
+  EXPECT_THAT(cache_.Get("c"), HasKeyId("key c"));
+}
+
+TEST(AttestationVerificationCacheNoEntriesTest, CachesNothing) {
+  SimulatedClock clock;
+  AttestationVerificationCache cache(/*max_entries=*/0, absl::Hours(1),
+                                     &clock);
+  cache.Put("a", CreateKey("key a"), std::nullopt);
+  EXPECT_THAT(cache.Get("a"), Eq(std::nullopt));
+}
+
+}  // namespace
+}  // namespace fcp::client::attestation
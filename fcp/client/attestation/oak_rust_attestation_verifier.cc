@@ -17,6 +17,8 @@
 #include "fcp/client/attestation/oak_rust_attestation_verifier.h"
 
 #include <cstdint>
+#include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 
@@ -33,8 +35,10 @@
 #include "absl/strings/escaping.h"
 #include "absl/strings/substitute.h"
 #include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "fcp/base/digest.h"
 #include "fcp/base/monitoring.h"
+#include "fcp/client/attestation/attestation_verification_cache.h"
 #include "fcp/client/rust/oak_attestation_verification_ffi.h"
 #include "fcp/confidentialcompute/cose.h"
 #include "fcp/confidentialcompute/crypto.h"
@@ -53,13 +57,90 @@ using ::fcp::confidential_compute::OkpKey;
 using ::fcp::confidentialcompute::DataAccessPolicy;
 using ::google::internal::federatedcompute::v1::ConfidentialEncryptionConfig;
 using ::oak::attestation::v1::AttestationResults;
+using ::oak::attestation::v1::ReferenceValues;
 
 // See https://www.iana.org/assignments/cose/cose.xhtml.
 constexpr int64_t kAlgorithmES256 = -7;
 
+OakRustAttestationVerifier::OakRustAttestationVerifier(
+    ReferenceValues public_key_reference_values,
+    absl::flat_hash_set<std::string> allowlisted_access_policy_hashes,
+    absl::AnyInvocable<
+        void(const fcp::confidentialcompute::AttestationVerificationRecord&)>
+        record_logger,
+    std::shared_ptr<AttestationVerificationCache> cache)
+    : public_key_reference_values_(std::move(public_key_reference_values)),
+      reference_values_digest_(ComputeSHA256(public_key_reference_values_)),
+      allowlisted_access_policy_hashes_(
+          std::move(allowlisted_access_policy_hashes)),
+      record_logger_(std::move(record_logger)),
+      cache_(std::move(cache)) {}
+
 absl::StatusOr<OkpKey> OakRustAttestationVerifier::Verify(
     const absl::Cord& access_policy,
     const ConfidentialEncryptionConfig& encryption_config) {
+  if (cache_ == nullptr) {
+    FCP_ASSIGN_OR_RETURN(UncachedVerification verification,
+                         VerifyUncached(access_policy, encryption_config));
+    record_logger_(verification.record);
+    return *std::move(verification.cwt.public_key);
+  }
+
+  absl::Time start_time = absl::Now();
+  std::string access_policy_digest = ComputeSHA256(access_policy);
+  std::string cache_key =
+      ComputeCacheKey(access_policy_digest, encryption_config);
+  // The cache may be shared with verifiers with other allowlists, so the
+  // access policy must be checked against this verifier's allowlist either
+  // way. If it isn't allowlisted, the verification below reports why.
+  std::optional<AttestationVerificationCache::Verification> cached =
+      cache_->Get(cache_key);
+  if (cached.has_value() &&
+      allowlisted_access_policy_hashes_.contains(
+          absl::BytesToHexString(access_policy_digest))) {
+    FCP_LOG(INFO) << "Attestation verification cache hit, took "
+                  << absl::ToDoubleMilliseconds(absl::Now() - start_time)
+                  << " ms.";
+    // Every successful verification is logged, so that the logs show which
+    // server binaries the data is going to be uploaded to for each task.
+    record_logger_(cached->record);
+    return std::move(cached->public_key);
+  }
+
+  absl::StatusOr<UncachedVerification> verification =
+      VerifyUncached(access_policy, encryption_config);
+  FCP_LOG(INFO) << "Attestation verification cache miss, took "
+                << absl::ToDoubleMilliseconds(absl::Now() - start_time)
+                << " ms.";
+  FCP_RETURN_IF_ERROR(verification);
+  record_logger_(verification->record);
+  OkpKey public_key = *verification->cwt.public_key;
+  cache_->Put(cache_key,
+              {.public_key = public_key,
+               .record = std::move(verification->record)},
+              verification->cwt.expiration_time);
+  return public_key;
+}
+
+std::string OakRustAttestationVerifier::ComputeCacheKey(
+    absl::string_view access_policy_digest,
+    const ConfidentialEncryptionConfig& encryption_config) const {
+  // All inputs which the outcome of a verification depends on are hashed
+  // separately, so that the concatenation of their fixed size digests is
+  // unambiguous.
+  Sha256Hasher hasher;
+  hasher.Update(reference_values_digest_);
+  hasher.Update(access_policy_digest);
+  hasher.Update(ComputeSHA256(encryption_config.attestation_evidence()));
+  hasher.Update(ComputeSHA256(encryption_config.attestation_endorsements()));
+  hasher.Update(ComputeSHA256(encryption_config.public_key()));
+  return hasher.Finalize();
+}
+
+absl::StatusOr<OakRustAttestationVerifier::UncachedVerification>
+OakRustAttestationVerifier::VerifyUncached(
+    const absl::Cord& access_policy,
+    const ConfidentialEncryptionConfig& encryption_config) {
   // Validate the attestation evidence provided in the encryption config, using
   // the `public_key_reference_values_` provided to us at construction time.
   FCP_ASSIGN_OR_RETURN(
@@ -149,10 +230,10 @@ absl::StatusOr<OkpKey> OakRustAttestationVerifier::Verify(
   // Verification of the attestation evidence, the access policy, and the public
   // encryption key's signature succeeded!
 
-  // We now log the key information we used to perform the verification to the
-  // provided logger. This allows someone observing these logs to replay the
-  // same verification, as well as look up the binaries that will process the
-  // encrypted data. See the
+  // We now record the key information we used to perform the verification, to
+  // be logged to the provided logger. This allows someone observing these logs
+  // to replay the same verification, as well as look up the binaries that will
+  // process the encrypted data. See the
   // AttestationVerificationRecordContainsEnoughInfoToReplayVerification test in
   // oak_rust_attestation_verifier_test.cc for an example of how this
   // information can be used for that purpose.
@@ -163,13 +244,13 @@ absl::StatusOr<OkpKey> OakRustAttestationVerifier::Verify(
       encryption_config.attestation_endorsements();
   *verification_record.mutable_data_access_policy() =
       std::move(parsed_access_policy);
-  record_logger_(verification_record);
 
-  // Return the public key with which the caller can now safely encrypt data
-  // to be uploaded. Only the attested server binary will have access to the
-  // decryption key, and the it will only allow the decryption key to be
-  // used by binaries/applications allowed by the data access policy.
-  return *std::move(cwt->public_key);
+  // Return the CWT with the public key with which the caller can now safely
+  // encrypt data to be uploaded. Only the attested server binary will have
+  // access to the decryption key, and the it will only allow the decryption
+  // key to be used by binaries/applications allowed by the data access policy.
+  return UncachedVerification{.cwt = *std::move(cwt),
+                              .record = std::move(verification_record)};
 }
 
 }  // namespace fcp::client::attestation
@@ -17,13 +17,15 @@
 #ifndef FCP_CLIENT_ATTESTATION_OAK_RUST_ATTESTATION_VERIFIER_H_
 #define FCP_CLIENT_ATTESTATION_OAK_RUST_ATTESTATION_VERIFIER_H_
 
+#include <memory>
 #include <string>
-#include <utility>
 
 #include "absl/container/flat_hash_set.h"
 #include "absl/functional/any_invocable.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/cord.h"
+#include "absl/strings/string_view.h"
+#include "fcp/client/attestation/attestation_verification_cache.h"
 #include "fcp/client/attestation/attestation_verifier.h"
 #include "fcp/confidentialcompute/cose.h"
 #include "fcp/protos/confidentialcompute/verification_record.pb.h"
@@ -44,16 +46,22 @@ class OakRustAttestationVerifier : public AttestationVerifier {
   //
   // The `record_logger` parameter will be called with a record of every
   // successful attestation verification.
+  //
+  // If `cache` is set, the public keys yielded by successful verifications are
+  // cached in it, and a verification of the same attestation evidence,
+  // endorsements, access policy and public key as a cached one returns the
+  // cached key rather than being repeated. `record_logger` is called on every
+  // successful verification either way, with the record that the original
+  // verification produced.
+  // The cache may be shared with other verifiers, including ones with other
+  // reference values and allowlists.
   OakRustAttestationVerifier(
       oak::attestation::v1::ReferenceValues public_key_reference_values,
       absl::flat_hash_set<std::string> allowlisted_access_policy_hashes,
       absl::AnyInvocable<
           void(const fcp::confidentialcompute::AttestationVerificationRecord&)>
-          record_logger)
-      : public_key_reference_values_(std::move(public_key_reference_values)),
-        allowlisted_access_policy_hashes_(
-            std::move(allowlisted_access_policy_hashes)),
-        record_logger_(std::move(record_logger)) {}
+          record_logger,
+      std::shared_ptr<AttestationVerificationCache> cache = nullptr);
 
   absl::StatusOr<::fcp::confidential_compute::OkpKey> Verify(
       const absl::Cord& access_policy,
@@ -61,11 +69,34 @@ class OakRustAttestationVerifier : public AttestationVerifier {
           ConfidentialEncryptionConfig& encryption_config) override;
 
  private:
+  struct UncachedVerification {
+    // The verified CWT holding the public key.
+    ::fcp::confidential_compute::OkpCwt cwt;
+    // The record to pass to `record_logger_`.
+    fcp::confidentialcompute::AttestationVerificationRecord record;
+  };
+
+  // Performs the actual verification, without logging its record.
+  absl::StatusOr<UncachedVerification> VerifyUncached(
+      const absl::Cord& access_policy,
+      const google::internal::federatedcompute::v1::
+          ConfidentialEncryptionConfig& encryption_config);
+
+  // Returns the key under which the outcome of verifying the given inputs is
+  // cached.
+  std::string ComputeCacheKey(
+      absl::string_view access_policy_digest,
+      const google::internal::federatedcompute::v1::
+          ConfidentialEncryptionConfig& encryption_config) const;
+
   oak::attestation::v1::ReferenceValues public_key_reference_values_;
+  // The SHA256 digest of the serialized `public_key_reference_values_`.
+  std::string reference_values_digest_;
   absl::flat_hash_set<std::string> allowlisted_access_policy_hashes_;
   absl::AnyInvocable<void(
       const fcp::confidentialcompute::AttestationVerificationRecord&)>
       record_logger_;
+  std::shared_ptr<AttestationVerificationCache> cache_;
 };
 
 }  // namespace fcp::client::attestation
@@ -1,6 +1,8 @@
 #include "fcp/client/attestation/oak_rust_attestation_verifier.h"
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -11,6 +13,7 @@
 #include "absl/strings/string_view.h"
 #include "absl/time/clock.h"
 #include "fcp/base/digest.h"
+#include "fcp/client/attestation/attestation_verification_cache.h"
 #include "fcp/client/attestation/log_attestation_records.h"
 #include "fcp/client/attestation/test_values.h"
 #include "fcp/client/rust/oak_attestation_verification_ffi.h"
@@ -32,6 +35,7 @@ using ::fcp::client::attestation::test_values::GetKnownValidEncryptionConfig;
 using ::fcp::client::attestation::test_values::GetKnownValidReferenceValues;
 using ::fcp::client::attestation::test_values::GetSkipAllReferenceValues;
 using ::fcp::confidential_compute::OkpCwt;
+using ::fcp::confidential_compute::OkpKey;
 using ::google::internal::federatedcompute::v1::ConfidentialEncryptionConfig;
 using ::oak::attestation::v1::ReferenceValues;
 using ::testing::HasSubstr;
@@ -249,6 +253,116 @@ TEST(OakRustAttestationTest, KnownEncryptionConfigAndEmptyReferencevalues) {
               HasSubstr("Attestation verification failed"));
 }
 
+TEST(OakRustAttestationTest, CachedVerificationLogsRecord) {
+  ConfidentialEncryptionConfig encryption_config =
+      GetKnownValidEncryptionConfig();
+  ReferenceValues reference_values = GetKnownValidReferenceValues();
+
+  // Create a valid access policy proto with some non-default content.
+  confidentialcompute::DataAccessPolicy access_policy = PARSE_TEXT_PROTO(R"pb(
+    transforms {
+      src: 0
+      application { tag: "foo" }
+    }
+  )pb");
+  auto access_policy_bytes = access_policy.SerializeAsString();
+
+  std::vector<confidentialcompute::AttestationVerificationRecord> records;
+  OakRustAttestationVerifier verifier(
+      reference_values,
+      {absl::BytesToHexString(ComputeSHA256(access_policy_bytes))},
+      [&records](
+          const confidentialcompute::AttestationVerificationRecord& record) {
+        records.push_back(record);
+      },
+      std::make_shared<AttestationVerificationCache>());
+
+  absl::StatusOr<OkpKey> result =
+      verifier.Verify(absl::Cord(access_policy_bytes), encryption_config);
+  ASSERT_OK(result);
+  ASSERT_EQ(records.size(), 1);
+  EXPECT_THAT(records[0].data_access_policy(), EqualsProto(access_policy));
+
+  // The second verification of the same inputs is served from the cache, and
+  // logs the same record as the first one.
+  absl::StatusOr<OkpKey> cached_result =
+      verifier.Verify(absl::Cord(access_policy_bytes), encryption_config);
+  ASSERT_OK(cached_result);
+  EXPECT_EQ(cached_result->key_id, result->key_id);
+  EXPECT_EQ(cached_result->x, result->x);
+  ASSERT_EQ(records.size(), 2);
+  EXPECT_THAT(records[1], EqualsProto(records[0]));
+}
+
+TEST(OakRustAttestationTest, SharedCacheDoesNotBypassPolicyAllowlist) {
+  ConfidentialEncryptionConfig encryption_config =
+      GetKnownValidEncryptionConfig();
+  ReferenceValues reference_values = GetKnownValidReferenceValues();
+
+  // Create a valid access policy proto with some non-default content.
+  confidentialcompute::DataAccessPolicy access_policy = PARSE_TEXT_PROTO(R"pb(
+    transforms {
+      src: 0
+      application { tag: "foo" }
+    }
+  )pb");
+  auto access_policy_bytes = access_policy.SerializeAsString();
+
+  auto cache = std::make_shared<AttestationVerificationCache>();
+  OakRustAttestationVerifier verifier(
+      reference_values,
+      {absl::BytesToHexString(ComputeSHA256(access_policy_bytes))},
+      LogPrettyPrintedVerificationRecord, cache);
+  ASSERT_OK(
+      verifier.Verify(absl::Cord(access_policy_bytes), encryption_config));
+
+  // A verifier sharing the cache must still reject the access policy if it
+  // isn't in its own allowlist.
+  OakRustAttestationVerifier other_verifier(
+      reference_values, {"mismatching policy hash"},
+      LogPrettyPrintedVerificationRecord, cache);
+  auto result =
+      other_verifier.Verify(absl::Cord(access_policy_bytes), encryption_config);
+  EXPECT_THAT(result.status(), IsCode(absl::StatusCode::kFailedPrecondition));
+  EXPECT_THAT(result.status().message(),
+              HasSubstr("Data access policy not in allowlist"));
+}
+
+TEST(OakRustAttestationTest, SharedCacheDoesNotBypassReferenceValues) {
+  ConfidentialEncryptionConfig encryption_config =
+      GetKnownValidEncryptionConfig();
+  ReferenceValues reference_values = GetKnownValidReferenceValues();
+
+  // Create a valid access policy proto with some non-default content.
+  confidentialcompute::DataAccessPolicy access_policy = PARSE_TEXT_PROTO(R"pb(
+    transforms {
+      src: 0
+      application { tag: "foo" }
+    }
+  )pb");
+  auto access_policy_bytes = access_policy.SerializeAsString();
+
+  auto cache = std::make_shared<AttestationVerificationCache>();
+  OakRustAttestationVerifier verifier(
+      reference_values,
+      {absl::BytesToHexString(ComputeSHA256(access_policy_bytes))},
+      LogPrettyPrintedVerificationRecord, cache);
+  ASSERT_OK(
+      verifier.Verify(absl::Cord(access_policy_bytes), encryption_config));
+
+  // A verifier sharing the cache must still verify the evidence against its
+  // own reference values, which here are invalid.
+  OakRustAttestationVerifier other_verifier(
+      ReferenceValues(),
+      {absl::BytesToHexString(ComputeSHA256(access_policy_bytes))},
+      LogPrettyPrintedVerificationRecord, cache);
+  auto result =
+      other_verifier.Verify(absl::Cord(access_policy_bytes), encryption_config);
+  EXPECT_THAT(result.status(), IsCode(absl::StatusCode::kFailedPrecondition));
+  EXPECT_THAT(result.status().message(),
+              HasSubstr("Attestation verification failed"));
+}
+
 // Tests whether the AttestationVerificationRecord emitted by the
 // OakRustAttestationVerifier contains sufficient information to allow someone
 // to re-do the verification (e.g. on their computer, by calling into the Oak
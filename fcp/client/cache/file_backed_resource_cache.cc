@@ -35,6 +35,7 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/cord.h"
+#include "absl/strings/escaping.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
@@ -57,6 +58,18 @@ constexpr char kCacheManifestFileName[] = "cache_manifest.pb";
 constexpr char kParentDir[] = "fcp";
 // Cached files will be saved in <cache directory>/fcp/cache.
 constexpr char kCacheDir[] = "cache";
+// Content-addressed files are named <prefix><hex encoded SHA-256 digest>.
+constexpr char kContentAddressedFilePrefix[] = "sha256-";
+constexpr int kSha256DigestSizeBytes = 32;
+
+namespace {
+
+std::string ContentAddressedFileName(absl::string_view content_digest) {
+  return absl::StrCat(kContentAddressedFilePrefix,
+                      absl::BytesToHexString(content_digest));
+}
+
+}  // namespace
 
 absl::StatusOr<CacheManifest> FileBackedResourceCache::ReadInternal() {
   absl::StatusOr<const CacheManifest*> data = pds_->Read();
@@ -102,7 +115,8 @@ absl::StatusOr<std::unique_ptr<FileBackedResourceCache>>
 FileBackedResourceCache::Create(absl::string_view base_dir,
                                 absl::string_view cache_dir,
                                 LogManager* log_manager, fcp::Clock* clock,
-                                int64_t max_cache_size_bytes) {
+                                int64_t max_cache_size_bytes,
+                                bool enable_content_addressed_storage) {
   // Create <cache root>/fcp.
   // Unfortunately NDK's flavor of std::filesystem::path does not support using
   // absl::string_view.
@@ -148,7 +162,8 @@ FileBackedResourceCache::Create(absl::string_view base_dir,
   std::unique_ptr<FileBackedResourceCache> resource_cache =
       absl::WrapUnique(new FileBackedResourceCache(
           std::move(pds), std::move(file_storage), cache_dir_path,
-          manifest_path, log_manager, clock, max_cache_size_bytes));
+          manifest_path, log_manager, clock, max_cache_size_bytes,
+          enable_content_addressed_storage));
   {
     absl::MutexLock lock(&resource_cache->mutex_);
     FCP_RETURN_IF_ERROR(resource_cache->Initialize());
@@ -157,35 +172,87 @@ FileBackedResourceCache::Create(absl::string_view base_dir,
   return resource_cache;
 }
 
+FileBackedResourceCache::~FileBackedResourceCache() {
+  absl::MutexLock lock(&mutex_);
+  if (pending_manifest_updates_ > 0) {
+    absl::Status status = FlushManifest();
+    if (!status.ok()) {
+      FCP_LOG(INFO) << "Failed to flush manifest: " << status;
+    }
+  }
+}
+
+absl::Status FileBackedResourceCache::FlushManifest() {
+  pending_manifest_updates_ = 0;
+  return WriteInternal(std::make_unique<CacheManifest>(manifest_));
+}
+
 absl::Status FileBackedResourceCache::Put(absl::string_view cache_id,
                                           const absl::Cord& resource,
                                           const google::protobuf::Any& metadata,
                                           absl::Duration max_age) {
   absl::MutexLock lock(&mutex_);
+  std::string cache_id_str(cache_id);
+  return PutInternal(cache_id_str, cache_id_str, /*content_digest=*/"",
+                     resource, metadata, max_age);
+}
 
+absl::Status FileBackedResourceCache::PutWithDigest(
+    absl::string_view cache_id, absl::string_view content_digest,
+    const absl::Cord& resource, const google::protobuf::Any& metadata,
+    absl::Duration max_age) {
+  if (!enable_content_addressed_storage_) {
+    return Put(cache_id, resource, metadata, max_age);
+  }
+  if (content_digest.size() != kSha256DigestSizeBytes) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid content digest for ", cache_id));
+  }
+  absl::MutexLock lock(&mutex_);
+  return PutInternal(std::string(cache_id),
+                     ContentAddressedFileName(content_digest), content_digest,
+                     resource, metadata, max_age);
+}
+
+absl::Status FileBackedResourceCache::PutInternal(
+    const std::string& cache_id, const std::string& file_name,
+    absl::string_view content_digest, const absl::Cord& resource,
+    const google::protobuf::Any& metadata, absl::Duration max_age) {
   if (resource.size() > max_cache_size_bytes_ / 2) {
     return absl::ResourceExhaustedError(absl::StrCat(cache_id, " too large"));
   }
 
-  FCP_ASSIGN_OR_RETURN(CacheManifest manifest, ReadInternal());
-  FCP_RETURN_IF_ERROR(CleanUp(resource.size(), manifest));
-
-  std::string cache_id_str(cache_id);
-  std::filesystem::path cached_file_path = cache_dir_path_ / cache_id_str;
+  // Expire entries first, since that may remove an existing entry for
+  // cache_id, or the last entry referencing a content-addressed file.
+  FCP_RETURN_IF_ERROR(RemoveExpiredEntries());
+  if (manifest_.cache().contains(cache_id)) {
+    // Like the manifest entry, the resource file of an existing entry is
+    // kept. Writing the resource to a file no entry references would strand
+    // it until the next CleanUp().
+    return absl::OkStatus();
+  }
+  // A content-addressed file that is already stored doesn't take up any
+  // additional space, and mustn't be evicted to make room for itself.
+  int64_t additional_size_bytes =
+      stored_files_.contains(file_name) ? 0 : resource.size();
+  FCP_RETURN_IF_ERROR(EvictLeastRecentlyUsed(
+      max_cache_size_bytes_ - additional_size_bytes, file_name));
+
+  std::filesystem::path cached_file_path = cache_dir_path_ / file_name;
   absl::Time now = clock_.Now();
   absl::Time expiry = now + max_age;
   CachedResource cached_resource;
-  cached_resource.set_file_name(cache_id_str);
+  cached_resource.set_file_name(file_name);
   *cached_resource.mutable_metadata() = metadata;
   *cached_resource.mutable_expiry_time() =
       TimeUtil::ConvertAbslToProtoTimestamp(expiry);
   *cached_resource.mutable_last_accessed_time() =
       TimeUtil::ConvertAbslToProtoTimestamp(now);
+  cached_resource.set_content_digest(std::string(content_digest));
 
   // Write the manifest back to disk before we write the file.
-  manifest.mutable_cache()->insert({cache_id_str, cached_resource});
-  FCP_RETURN_IF_ERROR(
-      WriteInternal(std::make_unique<CacheManifest>(std::move(manifest))));
+  AddEntry(cache_id, std::move(cached_resource), resource.size());
+  FCP_RETURN_IF_ERROR(FlushManifest());
 
   // Write file if it doesn't exist.
   std::error_code exists_error;
@@ -209,6 +276,23 @@ absl::Status FileBackedResourceCache::Put(absl::string_view cache_id,
   return absl::OkStatus();
 }
 
+bool FileBackedResourceCache::AddEntry(const std::string& cache_id,
+                                       CachedResource cached_resource,
+                                       int64_t size_bytes) {
+  std::string file_name = cached_resource.file_name();
+  if (!manifest_.mutable_cache()
+           ->insert({cache_id, std::move(cached_resource)})
+           .second) {
+    return false;
+  }
+  StoredFile& stored_file = stored_files_[file_name];
+  if (stored_file.num_references++ == 0) {
+    stored_file.size_bytes = size_bytes;
+    cache_size_bytes_ += size_bytes;
+  }
+  return true;
+}
+
 absl::StatusOr<FileBackedResourceCache::ResourceAndMetadata>
 FileBackedResourceCache::Get(absl::string_view cache_id,
                              std::optional<absl::Duration> max_age) {
@@ -219,15 +303,29 @@ FileBackedResourceCache::Get(absl::string_view cache_id,
     log_manager_.LogDiag(diag_code);
   };
   absl::MutexLock lock(&mutex_);
-  FCP_ASSIGN_OR_RETURN(CacheManifest manifest, ReadInternal());
 
   std::string cache_id_str(cache_id);
-  if (!manifest.cache().contains(cache_id_str)) {
+  auto it = manifest_.mutable_cache()->find(cache_id_str);
+  if (it == manifest_.mutable_cache()->end()) {
     return absl::NotFoundError(absl::StrCat(cache_id, " not found"));
   }
-  CachedResource cached_resource = manifest.cache().at(cache_id_str);
-  std::filesystem::path cached_file_path = cache_dir_path_ / cache_id_str;
-  google::protobuf::Any metadata = cached_resource.metadata();
+  CachedResource& cached_resource = it->second;
+  std::filesystem::path cached_file_path =
+      cache_dir_path_ / cached_resource.file_name();
+
+  // Map the file rather than reading it, so that the returned Cord doesn't
+  // hold a copy of the resource. Files are never modified in place once
+  // written, so the mapping stays valid even if the entry is evicted while the
+  // Cord is still in use.
+  absl::StatusOr<absl::Cord> contents =
+      MapFileToCord(cached_file_path.string());
+  if (!contents.ok()) {
+    log_manager_.LogDiag(ProdDiagCode::RESOURCE_CACHE_RESOURCE_READ_FAILED);
+    FCP_RETURN_IF_ERROR(RemoveEntry(cache_id_str));
+    // Treat as not found, the resource should be fetched again.
+    return absl::NotFoundError(absl::StrCat(cache_id, " not found"));
+  }
+
   absl::Time now = clock_.Now();
   *cached_resource.mutable_last_accessed_time() =
       TimeUtil::ConvertAbslToProtoTimestamp(now);
@@ -236,32 +334,72 @@ FileBackedResourceCache::Get(absl::string_view cache_id,
     *cached_resource.mutable_expiry_time() =
         TimeUtil::ConvertAbslToProtoTimestamp(expiry);
   }
+  google::protobuf::Any metadata = cached_resource.metadata();
+
+  // Only persist the updated access time once enough updates have piled up.
+  // Losing them on a crash only affects the LRU order and expiry of entries.
+  if (++pending_manifest_updates_ >= kMaxPendingManifestUpdates) {
+    FCP_RETURN_IF_ERROR(FlushManifest());
+  }
+
+  // We've reached the end, this is a hit! The absl::Cleanup above has a
+  // reference to diag_code, so we update it to CACHE_HIT here.
+  diag_code = DebugDiagCode::RESOURCE_CACHE_HIT;
+  return FileBackedResourceCache::ResourceAndMetadata{*std::move(contents),
+                                                      std::move(metadata)};
+}
+
+absl::StatusOr<FileBackedResourceCache::ResourceAndMetadata>
+FileBackedResourceCache::GetByDigest(absl::string_view content_digest,
+                                     absl::string_view cache_id,
+                                     absl::Duration max_age) {
+  if (!enable_content_addressed_storage_) {
+    return absl::NotFoundError(
+        "Content-addressed storage is disabled for this cache");
+  }
+  absl::MutexLock lock(&mutex_);
+  std::string file_name = ContentAddressedFileName(content_digest);
+  if (!stored_files_.contains(file_name)) {
+    return absl::NotFoundError(absl::StrCat(cache_id, " not found by digest"));
+  }
+  // Find any entry referencing the file, to take the metadata from.
+  const CachedResource* existing_resource = nullptr;
+  for (const auto& [id, resource] : manifest_.cache()) {
+    if (resource.file_name() == file_name) {
+      existing_resource = &resource;
+      break;
+    }
+  }
+  if (existing_resource == nullptr) {
+    return absl::InternalError(
+        absl::StrCat("No manifest entry references ", file_name));
+  }
+  google::protobuf::Any metadata = existing_resource->metadata();
 
   absl::StatusOr<absl::Cord> contents =
-      ReadFileToCord(cached_file_path.string());
+      MapFileToCord((cache_dir_path_ / file_name).string());
   if (!contents.ok()) {
     log_manager_.LogDiag(ProdDiagCode::RESOURCE_CACHE_RESOURCE_READ_FAILED);
-    manifest.mutable_cache()->erase(cache_id_str);
-    std::error_code error;
-    std::filesystem::remove(cached_file_path, error);
-    if (error.value() != 0) {
-      return absl::InternalError(error.message());
-    }
-    // Treat as not found, the resource should be fetched again.
-    return absl::NotFoundError(absl::StrCat(cache_id, " not found"));
+    return absl::NotFoundError(absl::StrCat(cache_id, " not found by digest"));
   }
 
-  manifest.mutable_cache()->erase(cache_id_str);
-  manifest.mutable_cache()->insert({cache_id_str, cached_resource});
-
-  absl::Status status =
-      WriteInternal(std::make_unique<CacheManifest>(std::move(manifest)));
-  if (!status.ok()) return status;
+  absl::Time now = clock_.Now();
+  CachedResource cached_resource;
+  cached_resource.set_file_name(file_name);
+  *cached_resource.mutable_metadata() = metadata;
+  *cached_resource.mutable_expiry_time() =
+      TimeUtil::ConvertAbslToProtoTimestamp(now + max_age);
+  *cached_resource.mutable_last_accessed_time() =
+      TimeUtil::ConvertAbslToProtoTimestamp(now);
+  cached_resource.set_content_digest(std::string(content_digest));
+  if (AddEntry(std::string(cache_id), std::move(cached_resource),
+               contents->size())) {
+    FCP_RETURN_IF_ERROR(FlushManifest());
+  }
 
-  // We've reached the end, this is a hit! The absl::Cleanup above has a
-  // reference to diag_code, so we update it to CACHE_HIT here.
-  diag_code = DebugDiagCode::RESOURCE_CACHE_HIT;
-  return FileBackedResourceCache::ResourceAndMetadata{*contents, metadata};
+  log_manager_.LogDiag(DebugDiagCode::RESOURCE_CACHE_DIGEST_HIT);
+  return FileBackedResourceCache::ResourceAndMetadata{*std::move(contents),
+                                                      std::move(metadata)};
 }
 
 absl::Status FileBackedResourceCache::Initialize() {
@@ -299,14 +437,15 @@ absl::Status FileBackedResourceCache::Initialize() {
         absl::StrCat(errorInInitializePrefix,
                      "Failed to read manifest: ", manifest.status().message()));
   }
-  auto cleanup_status = CleanUp(std::nullopt, *manifest);
+  manifest_ = *std::move(manifest);
+  auto cleanup_status = CleanUp();
   if (!cleanup_status.ok()) {
     log_manager_.LogDiag(ProdDiagCode::RESOURCE_CACHE_INIT_FAILED_CLEANUP);
     return absl::InternalError(absl::StrCat(
         errorInInitializePrefix,
         "Failed to clean up resource cache: ", cleanup_status.message()));
   }
-  auto write_status = WriteInternal(std::make_unique<CacheManifest>(*manifest));
+  auto write_status = FlushManifest();
   if (!write_status.ok()) {
     return absl::InternalError(absl::StrCat(
         errorInInitializePrefix,
@@ -315,8 +454,7 @@ absl::Status FileBackedResourceCache::Initialize() {
   return absl::OkStatus();
 }
 
-absl::Status FileBackedResourceCache::CleanUp(
-    std::optional<int64_t> reserved_space_bytes, CacheManifest& manifest) {
+absl::Status FileBackedResourceCache::CleanUp() {
   // Expire any cached resources past their expiry.
   // Clean up any files that are not tracked in the manifest.
   // Clean up any manifest entries that point to nonexistent files.
@@ -343,12 +481,9 @@ absl::Status FileBackedResourceCache::CleanUp(
     cache_dir_files.insert(cache_dir_path_ / file);
   }
 
-  int64_t max_allowed_size_bytes = max_cache_size_bytes_;
-  max_allowed_size_bytes -= reserved_space_bytes.value_or(0);
-
   std::set<std::string> cache_ids_to_delete;
   absl::Time now = clock_.Now();
-  for (const auto& [id, resource] : manifest.cache()) {
+  for (const auto& [id, resource] : manifest_.cache()) {
     absl::Time expiry =
         TimeUtil::ConvertProtoToAbslTime(resource.expiry_time());
     std::filesystem::path resource_file =
@@ -362,14 +497,18 @@ absl::Status FileBackedResourceCache::CleanUp(
         cache_dir_files.find(resource_file) != cache_dir_files.end();
     if (expiry < now || !cached_resource_exists) {
       cache_ids_to_delete.insert(id);
-    } else {
-      cache_dir_files.erase(resource_file);
     }
   }
 
   // Then delete CacheManifest entries.
   for (const auto& cache_id : cache_ids_to_delete) {
-    manifest.mutable_cache()->erase(cache_id);
+    manifest_.mutable_cache()->erase(cache_id);
+  }
+
+  // Any file that is still referenced by an entry must be kept. Several entries
+  // may reference the same content-addressed file.
+  for (const auto& [id, resource] : manifest_.cache()) {
+    cache_dir_files.erase(cache_dir_path_ / resource.file_name());
   }
 
   // Then delete files.
@@ -390,18 +529,16 @@ absl::Status FileBackedResourceCache::CleanUp(
 
   FCP_RETURN_IF_ERROR(filesystem_status);
 
-  // If we still exceed the allowed size of the cache, delete entries until
-  // we're under the allowed size, sorted by least recently used.
-
-  // Build up a list of (cache_id, least recently used timestamp) and compute
-  // the total size of the cache.
-  std::vector<std::pair<std::string, absl::Time>> cache_id_lru;
-  cache_id_lru.reserve(manifest.cache().size());
-  uintmax_t cache_dir_size = 0;
-
-  for (const auto& [id, resource] : manifest.cache()) {
-    cache_id_lru.emplace_back(std::make_pair(
-        id, TimeUtil::ConvertProtoToAbslTime(resource.last_accessed_time())));
+  // Compute the size of each remaining resource file, which is then tracked in
+  // memory for as long as the cache is alive.
+  stored_files_.clear();
+  cache_size_bytes_ = 0;
+  for (const auto& [id, resource] : manifest_.cache()) {
+    StoredFile& stored_file = stored_files_[resource.file_name()];
+    if (stored_file.num_references++ > 0) {
+      // We already computed the size of this file for another entry.
+      continue;
+    }
     std::filesystem::path resource_file =
         cache_dir_path_ / resource.file_name();
     // We calculate the sum of tracked files instead of taking the file_size()
@@ -434,7 +571,8 @@ absl::Status FileBackedResourceCache::CleanUp(
       std::error_code ignored_remove_error;
       std::filesystem::remove(resource_file, ignored_remove_error);
     } else {
-      cache_dir_size += size;
+      stored_file.size_bytes = static_cast<int64_t>(size);
+      cache_size_bytes_ += static_cast<int64_t>(size);
     }
   }
 
@@ -442,43 +580,91 @@ absl::Status FileBackedResourceCache::CleanUp(
 
   // Then, if the cache is bigger than the allowed size, delete entries ordered
   // by least recently used until we're below the threshold.
-  if (cache_dir_size > max_allowed_size_bytes) {
-    std::sort(cache_id_lru.begin(), cache_id_lru.end(),
-              [](std::pair<std::string, absl::Time> first,
-                 std::pair<std::string, absl::Time> second) -> bool {
-                // Sort by least recently used timestamp.
-                return first.second < second.second;
-              });
-    for (auto const& [cache_id, timestamp] : cache_id_lru) {
-      std::string id_to_remove = cache_id;
-      std::filesystem::path file_to_remove =
-          cache_dir_path_ / manifest.cache().at(id_to_remove).file_name();
-      manifest.mutable_cache()->erase(id_to_remove);
-      std::error_code remove_error;
-      uintmax_t file_size =
-          std::filesystem::file_size(file_to_remove, remove_error);
-      if (remove_error.value() != 0 && filesystem_status.ok()) {
-        log_manager_.LogDiag(
-            ProdDiagCode::RESOURCE_CACHE_CLEANUP_FAILED_TO_GET_FILE_SIZE);
-        filesystem_status = absl::InternalError(absl::StrCat(
-            "Error getting file size. Error code: ", remove_error.value(),
-            ", message: ", remove_error.message()));
-      }
-      std::filesystem::remove(file_to_remove, remove_error);
-      if (remove_error.value() != 0 && filesystem_status.ok()) {
-        log_manager_.LogDiag(
-            ProdDiagCode::RESOURCE_CACHE_CLEANUP_FAILED_TO_GET_FILE_SIZE);
-        filesystem_status = absl::InternalError(absl::StrCat(
-            "Failed to delete file. Error code: ", remove_error.value(),
-            ", message: ", remove_error.message()));
-      }
-      cache_dir_size -= file_size;
-      if (cache_dir_size < max_allowed_size_bytes) break;
+  return EvictLeastRecentlyUsed(max_cache_size_bytes_);
+}
+
+absl::Status FileBackedResourceCache::RemoveExpiredEntries() {
+  std::vector<std::string> cache_ids_to_delete;
+  absl::Time now = clock_.Now();
+  for (const auto& [id, resource] : manifest_.cache()) {
+    if (TimeUtil::ConvertProtoToAbslTime(resource.expiry_time()) < now) {
+      cache_ids_to_delete.push_back(id);
     }
   }
+  absl::Status filesystem_status = absl::OkStatus();
+  for (const auto& cache_id : cache_ids_to_delete) {
+    absl::Status status = RemoveEntry(cache_id);
+    if (!status.ok() && filesystem_status.ok()) {
+      filesystem_status = status;
+    }
+  }
+  return filesystem_status;
+}
 
-  FCP_RETURN_IF_ERROR(filesystem_status);
+absl::Status FileBackedResourceCache::EvictLeastRecentlyUsed(
+    int64_t max_allowed_size_bytes, absl::string_view pinned_file_name) {
+  if (cache_size_bytes_ <= max_allowed_size_bytes) {
+    return absl::OkStatus();
+  }
+
+  // Build up a list of (cache_id, least recently used timestamp), sorted by
+  // least recently used.
+  std::vector<std::pair<std::string, absl::Time>> cache_id_lru;
+  cache_id_lru.reserve(manifest_.cache().size());
+  for (const auto& [id, resource] : manifest_.cache()) {
+    if (!pinned_file_name.empty() && resource.file_name() == pinned_file_name) {
+      continue;
+    }
+    cache_id_lru.emplace_back(std::make_pair(
+        id, TimeUtil::ConvertProtoToAbslTime(resource.last_accessed_time())));
+  }
+  std::sort(cache_id_lru.begin(), cache_id_lru.end(),
+            [](const std::pair<std::string, absl::Time>& first,
+               const std::pair<std::string, absl::Time>& second) -> bool {
+              // Sort by least recently used timestamp.
+              return first.second < second.second;
+            });
+
+  absl::Status filesystem_status = absl::OkStatus();
+  for (auto const& [cache_id, timestamp] : cache_id_lru) {
+    absl::Status status = RemoveEntry(cache_id);
+    if (!status.ok() && filesystem_status.ok()) {
+      filesystem_status = status;
+    }
+    if (cache_size_bytes_ < max_allowed_size_bytes) break;
+  }
+
+  return filesystem_status;
+}
 
+absl::Status FileBackedResourceCache::RemoveEntry(const std::string& cache_id) {
+  auto it = manifest_.mutable_cache()->find(cache_id);
+  if (it == manifest_.mutable_cache()->end()) {
+    return absl::OkStatus();
+  }
+  std::string file_name = it->second.file_name();
+  manifest_.mutable_cache()->erase(it);
+  pending_manifest_updates_++;
+  auto file_it = stored_files_.find(file_name);
+  if (file_it != stored_files_.end()) {
+    if (--file_it->second.num_references > 0) {
+      // The file is still referenced by another entry with the same content.
+      return absl::OkStatus();
+    }
+    cache_size_bytes_ -= file_it->second.size_bytes;
+    stored_files_.erase(file_it);
+  }
+
+  std::filesystem::path file_to_remove = cache_dir_path_ / file_name;
+  std::error_code remove_error;
+  std::filesystem::remove(file_to_remove, remove_error);
+  if (remove_error.value() != 0) {
+    log_manager_.LogDiag(
+        ProdDiagCode::RESOURCE_CACHE_CLEANUP_FAILED_TO_DELETE_CACHED_FILE);
+    return absl::InternalError(absl::StrCat(
+        "Failed to delete file. Error code: ", remove_error.value(),
+        ", message: ", remove_error.message()));
+  }
   return absl::OkStatus();
 }
 
@@ -21,10 +21,12 @@
 #include <filesystem>  // NOLINT(build/c++17)
 #include <memory>
 #include <optional>
+#include <string>
 #include <utility>
 
 #include "google/protobuf/any.pb.h"
 #include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/cord.h"
@@ -47,6 +49,17 @@ namespace cache {
  * resource payload is stored as an individual file in a directory, along with a
  * ProtoDataStore manifest that tracks each entry.
  *
+ * The manifest is read once at creation and then kept in memory. Cache hits
+ * only update the in-memory manifest, and these updates are persisted in
+ * batches (and when the cache is destroyed), so that a hit doesn't have to
+ * rewrite the manifest. Cached resources are returned as Cords backed by a
+ * memory mapping of the resource file rather than by a copy of its contents.
+ *
+ * If content-addressed storage is enabled, resources stored via
+ * PutWithDigest() are written to a file named after their digest, and every
+ * manifest entry with the same digest references that one file. A file is
+ * only deleted once the last entry referencing it is removed.
+ *
  * FileBackedResourceCache is thread safe.
  */
 class FileBackedResourceCache : public ResourceCache {
@@ -64,9 +77,13 @@ class FileBackedResourceCache : public ResourceCache {
   // `max_cache_size_bytes` / 2.
   //
   // Deletes any stored resources past expiry.
+  //
+  // If `enable_content_addressed_storage` is false, PutWithDigest() behaves
+  // like Put() and GetByDigest() always returns NOT_FOUND.
   static absl::StatusOr<std::unique_ptr<FileBackedResourceCache>> Create(
       absl::string_view base_dir, absl::string_view cache_dir,
-      LogManager* log_manager, fcp::Clock* clock, int64_t max_cache_size_bytes);
+      LogManager* log_manager, fcp::Clock* clock, int64_t max_cache_size_bytes,
+      bool enable_content_addressed_storage = false);
 
   // Implementation of `ResourceCache::Put`.
   //
@@ -87,7 +104,29 @@ class FileBackedResourceCache : public ResourceCache {
                                           std::optional<absl::Duration> max_age)
       override ABSL_LOCKS_EXCLUDED(mutex_);
 
-  ~FileBackedResourceCache() override = default;
+  // Implementation of `ResourceCache::SupportsContentAddressedStorage`.
+  bool SupportsContentAddressedStorage() const override {
+    return enable_content_addressed_storage_;
+  }
+
+  // Implementation of `ResourceCache::PutWithDigest`.
+  //
+  // Returns the same errors as Put(), and INVALID_ARGUMENT if
+  // `content_digest` isn't a SHA-256 digest.
+  absl::Status PutWithDigest(absl::string_view cache_id,
+                             absl::string_view content_digest,
+                             const absl::Cord& resource,
+                             const google::protobuf::Any& metadata,
+                             absl::Duration max_age) override
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Implementation of `ResourceCache::GetByDigest`.
+  absl::StatusOr<ResourceAndMetadata> GetByDigest(
+      absl::string_view content_digest, absl::string_view cache_id,
+      absl::Duration max_age) override ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Persists any pending manifest updates.
+  ~FileBackedResourceCache() override ABSL_LOCKS_EXCLUDED(mutex_);
 
   // FileBackedResourceCache is neither copyable nor movable.
   FileBackedResourceCache(const FileBackedResourceCache&) = delete;
@@ -98,20 +137,36 @@ class FileBackedResourceCache : public ResourceCache {
       std::unique_ptr<protostore::ProtoDataStore<CacheManifest>> pds,
       std::unique_ptr<protostore::FileStorage> storage,
       std::filesystem::path cache_dir_path, std::filesystem::path manifest_path,
-      LogManager* log_manager, Clock* clock, const int64_t max_cache_size_bytes)
+      LogManager* log_manager, Clock* clock, const int64_t max_cache_size_bytes,
+      bool enable_content_addressed_storage)
       : storage_(std::move(storage)),
         pds_(std::move(pds)),
         cache_dir_path_(cache_dir_path),
         manifest_path_(manifest_path),
         log_manager_(*log_manager),
         clock_(*clock),
-        max_cache_size_bytes_(max_cache_size_bytes) {}
+        max_cache_size_bytes_(max_cache_size_bytes),
+        enable_content_addressed_storage_(enable_content_addressed_storage) {}
+
+  // The size of a resource file, and the number of manifest entries
+  // referencing it.
+  struct StoredFile {
+    int64_t size_bytes = 0;
+    int num_references = 0;
+  };
+
+  // The number of in-memory manifest updates made by Get() after which the
+  // manifest is written back to disk.
+  static constexpr int kMaxPendingManifestUpdates = 16;
 
   absl::StatusOr<CacheManifest> ReadInternal()
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   absl::Status WriteInternal(std::unique_ptr<CacheManifest> manifest)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Writes the in-memory manifest to disk and clears the pending update count.
+  absl::Status FlushManifest() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   // Initializes the CacheManifest ProtoDataStore db if necessesary, then runs
   // CleanUp().
   absl::Status Initialize() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
@@ -121,14 +176,45 @@ class FileBackedResourceCache : public ResourceCache {
 
   // TTLs any cached resources stored past their expiry, then deletes any
   // stranded files without matching manifest entries, and any entries without
-  // matching resource files. If `reserved_space_bytes` is set, cleans up
-  // resources sorted by least recently used until the cache size is less than
-  // `max_cache_size_bytes_ - reserved_space_bytes`.
-  // This modifies the passed `manifest`.
-  absl::Status CleanUp(std::optional<int64_t> reserved_space_bytes,
-                       CacheManifest& manifest)
+  // matching resource files. Recomputes the size of each tracked resource from
+  // the cache dir, then cleans up resources sorted by least recently used until
+  // the cache size is less than `max_cache_size_bytes_`.
+  // This modifies the in-memory manifest, but doesn't persist it.
+  absl::Status CleanUp() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // TTLs any cached resources stored past their expiry. Unlike CleanUp(), this
+  // relies on the in-memory manifest and doesn't scan the cache dir.
+  // This modifies the in-memory manifest, but doesn't persist it.
+  absl::Status RemoveExpiredEntries() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Deletes cached resources sorted by least recently used until the cache
+  // size is less than `max_allowed_size_bytes`. Entries referencing
+  // `pinned_file_name`, if it is set, are kept.
+  absl::Status EvictLeastRecentlyUsed(int64_t max_allowed_size_bytes,
+                                      absl::string_view pinned_file_name = "")
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Removes the entry for `cache_id` from the in-memory manifest, and deletes
+  // its resource file if no other entry references it.
+  absl::Status RemoveEntry(const std::string& cache_id)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Shared implementation of Put() and PutWithDigest(). Stores `resource` in
+  // `file_name` unless that file already exists. Does nothing if there already
+  // is an entry for `cache_id`.
+  absl::Status PutInternal(const std::string& cache_id,
+                           const std::string& file_name,
+                           absl::string_view content_digest,
+                           const absl::Cord& resource,
+                           const google::protobuf::Any& metadata,
+                           absl::Duration max_age)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Adds a manifest entry for `cache_id` referencing `file_name`, unless an
+  // entry for `cache_id` already exists. Returns true if the entry was added.
+  bool AddEntry(const std::string& cache_id, CachedResource cached_resource,
+                int64_t size_bytes) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   // Unused, but must be kept alive for longer than pds_.
   std::unique_ptr<protostore::FileStorage> storage_;
   std::unique_ptr<protostore::ProtoDataStore<CacheManifest>> pds_
@@ -138,7 +224,18 @@ class FileBackedResourceCache : public ResourceCache {
   LogManager& log_manager_;
   Clock& clock_;
   const int64_t max_cache_size_bytes_;
+  const bool enable_content_addressed_storage_;
   absl::Mutex mutex_;
+  // In-memory copy of the manifest. This is the source of truth while the
+  // cache is alive, and is written back to pds_ by FlushManifest().
+  CacheManifest manifest_ ABSL_GUARDED_BY(mutex_);
+  // The number of updates made to manifest_ since it was last persisted.
+  int pending_manifest_updates_ ABSL_GUARDED_BY(mutex_) = 0;
+  // The resource files referenced by manifest_, keyed by file name.
+  absl::flat_hash_map<std::string, StoredFile> stored_files_
+      ABSL_GUARDED_BY(mutex_);
+  // The sum of the sizes of stored_files_.
+  int64_t cache_size_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
 };
 
 // Used by the class and in tests only.
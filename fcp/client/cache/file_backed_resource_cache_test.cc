@@ -27,8 +27,12 @@
 #include "absl/status/statusor.h"
 #include "absl/strings/cord.h"
 #include "absl/time/time.h"
+#include "fcp/base/digest.h"
 #include "fcp/base/monitoring.h"
+#include "fcp/base/platform.h"
 #include "fcp/base/simulated_clock.h"
+#include "fcp/base/time_util.h"
+#include "fcp/client/cache/cache_manifest.pb.h"
 #include "fcp/client/diag_codes.pb.h"
 #include "fcp/client/selector_context.pb.h"
 #include "fcp/client/test_helpers.h"
@@ -183,6 +187,236 @@ TEST_F(FileBackedResourceCacheTest, CacheFileCloseReinitializeFileStillCached) {
   }
 }
 
+TEST_F(FileBackedResourceCacheTest, GetPersistsAccessTimeOnDestruction) {
+  std::string manifest_after_put;
+  {
+    auto resource_cache = FileBackedResourceCache::Create(
+        root_files_dir_, root_cache_dir_, &log_manager_, &clock_,
+        kMaxCacheSizeBytes);
+    ASSERT_OK(resource_cache);
+    ASSERT_OK(
+        (*resource_cache)->Put(kKey1, Resource1(), Metadata(), absl::Hours(1)));
+    auto manifest = ReadFileToString(manifest_path_.string());
+    ASSERT_OK(manifest);
+    manifest_after_put = *manifest;
+
+    clock_.AdvanceTime(absl::Minutes(1));
+    EXPECT_CALL(log_manager_, LogDiag(DebugDiagCode::RESOURCE_CACHE_HIT));
+    ASSERT_OK((*resource_cache)->Get(kKey1, std::nullopt));
+
+    // A single hit only updates the in-memory manifest.
+    manifest = ReadFileToString(manifest_path_.string());
+    ASSERT_OK(manifest);
+    EXPECT_EQ(*manifest, manifest_after_put);
+  }
+
+  // Destroying the cache persists the updated access time.
+  auto manifest = ReadFileToString(manifest_path_.string());
+  ASSERT_OK(manifest);
+  CacheManifest parsed_manifest;
+  ASSERT_TRUE(parsed_manifest.ParseFromString(*manifest));
+  ASSERT_TRUE(parsed_manifest.cache().contains(kKey1));
+  EXPECT_EQ(TimeUtil::ConvertProtoToAbslTime(
+                parsed_manifest.cache().at(kKey1).last_accessed_time()),
+            clock_.Now());
+}
+
+TEST_F(FileBackedResourceCacheTest, ResourceOutlivesEviction) {
+  // Use a resource large enough to not be copied into the Cord.
+  absl::Cord large_resource(std::string(4096, 'x'));
+  auto resource_cache = FileBackedResourceCache::Create(
+      root_files_dir_, root_cache_dir_, &log_manager_, &clock_,
+      kMaxCacheSizeBytes);
+  ASSERT_OK(resource_cache);
+  ASSERT_OK((*resource_cache)
+                ->Put(kKey1, large_resource, Metadata(), absl::Minutes(1)));
+  EXPECT_CALL(log_manager_, LogDiag(DebugDiagCode::RESOURCE_CACHE_HIT));
+  absl::StatusOr<FileBackedResourceCache::ResourceAndMetadata> cached_resource =
+      (*resource_cache)->Get(kKey1, std::nullopt);
+  ASSERT_OK(cached_resource);
+
+  // Expire the first resource, so that it gets deleted by the next Put.
+  clock_.AdvanceTime(absl::Minutes(2));
+  ASSERT_OK(
+      (*resource_cache)->Put(kKey2, Resource2(), Metadata(), absl::Hours(1)));
+  ASSERT_FALSE(std::filesystem::exists(cache_dir_ / kKey1));
+
+  EXPECT_EQ((*cached_resource).resource, large_resource);
+}
+
+TEST_F(FileBackedResourceCacheTest, PutWithDigestStoresContentOnce) {
+  auto resource_cache = FileBackedResourceCache::Create(
+      root_files_dir_, root_cache_dir_, &log_manager_, &clock_,
+      kMaxCacheSizeBytes, /*enable_content_addressed_storage=*/true);
+  ASSERT_OK(resource_cache);
+  EXPECT_TRUE((*resource_cache)->SupportsContentAddressedStorage());
+  std::string digest = ComputeSHA256(Resource1());
+  ASSERT_OK((*resource_cache)
+                ->PutWithDigest(kKey1, digest, Resource1(), Metadata(),
+                                absl::Hours(1)));
+  ASSERT_OK((*resource_cache)
+                ->PutWithDigest(kKey2, digest, Resource1(), Metadata(),
+                                absl::Hours(1)));
+  EXPECT_EQ(NumFilesInDir(cache_dir_), 1);
+
+  EXPECT_CALL(log_manager_, LogDiag(DebugDiagCode::RESOURCE_CACHE_HIT))
+      .Times(2);
+  absl::StatusOr<FileBackedResourceCache::ResourceAndMetadata> cached_resource =
+      (*resource_cache)->Get(kKey1, std::nullopt);
+  ASSERT_OK(cached_resource);
+  EXPECT_EQ(Resource1(), (*cached_resource).resource);
+  cached_resource = (*resource_cache)->Get(kKey2, std::nullopt);
+  ASSERT_OK(cached_resource);
+  EXPECT_EQ(Resource1(), (*cached_resource).resource);
+}
+
+TEST_F(FileBackedResourceCacheTest, PutWithInvalidDigestFails) {
+  auto resource_cache = FileBackedResourceCache::Create(
+      root_files_dir_, root_cache_dir_, &log_manager_, &clock_,
+      kMaxCacheSizeBytes, /*enable_content_addressed_storage=*/true);
+  ASSERT_OK(resource_cache);
+  ASSERT_THAT((*resource_cache)
+                  ->PutWithDigest(kKey1, "not a digest", Resource1(),
+                                  Metadata(), absl::Hours(1)),
+              IsCode(INVALID_ARGUMENT));
+}
+
+TEST_F(FileBackedResourceCacheTest, SharedContentKeptUntilLastEntryExpires) {
+  std::string digest = ComputeSHA256(Resource1());
+  {
+    auto resource_cache = FileBackedResourceCache::Create(
+        root_files_dir_, root_cache_dir_, &log_manager_, &clock_,
+        kMaxCacheSizeBytes, /*enable_content_addressed_storage=*/true);
+    ASSERT_OK(resource_cache);
+    ASSERT_OK((*resource_cache)
+                  ->PutWithDigest(kKey1, digest, Resource1(), Metadata(),
+                                  absl::Minutes(1)));
+    ASSERT_OK((*resource_cache)
+                  ->PutWithDigest(kKey2, digest, Resource1(), Metadata(),
+                                  absl::Hours(1)));
+  }
+
+  // Expire the first entry, the second one still references the content.
+  clock_.AdvanceTime(absl::Minutes(2));
+  {
+    auto resource_cache = FileBackedResourceCache::Create(
+        root_files_dir_, root_cache_dir_, &log_manager_, &clock_,
+        kMaxCacheSizeBytes, /*enable_content_addressed_storage=*/true);
+    ASSERT_OK(resource_cache);
+    EXPECT_EQ(NumFilesInDir(cache_dir_), 1);
+    EXPECT_CALL(log_manager_, LogDiag(DebugDiagCode::RESOURCE_CACHE_MISS));
+    ASSERT_THAT((*resource_cache)->Get(kKey1, std::nullopt),
+                IsCode(NOT_FOUND));
+    EXPECT_CALL(log_manager_, LogDiag(DebugDiagCode::RESOURCE_CACHE_HIT));
+    absl::StatusOr<FileBackedResourceCache::ResourceAndMetadata>
+        cached_resource = (*resource_cache)->Get(kKey2, std::nullopt);
+    ASSERT_OK(cached_resource);
+    EXPECT_EQ(Resource1(), (*cached_resource).resource);
+  }
+
+  // Once the last entry expires the content is deleted too.
+  clock_.AdvanceTime(absl::Hours(2));
+  {
+    auto resource_cache = FileBackedResourceCache::Create(
+        root_files_dir_, root_cache_dir_, &log_manager_, &clock_,
+        kMaxCacheSizeBytes, /*enable_content_addressed_storage=*/true);
+    ASSERT_OK(resource_cache);
+    EXPECT_EQ(NumFilesInDir(cache_dir_), 0);
+  }
+}
+
+TEST_F(FileBackedResourceCacheTest, PutWithDigestKeepsExistingEntry) {
+  auto resource_cache = FileBackedResourceCache::Create(
+      root_files_dir_, root_cache_dir_, &log_manager_, &clock_,
+      kMaxCacheSizeBytes, /*enable_content_addressed_storage=*/true);
+  ASSERT_OK(resource_cache);
+  ASSERT_OK(
+      (*resource_cache)->Put(kKey1, Resource1(), Metadata(), absl::Hours(1)));
+  ASSERT_OK((*resource_cache)
+                ->PutWithDigest(kKey1, ComputeSHA256(Resource2()),
+                                Resource2(), Metadata(), absl::Hours(1)));
+  // No file is written for the content that no entry references.
+  EXPECT_EQ(NumFilesInDir(cache_dir_), 1);
+
+  EXPECT_CALL(log_manager_, LogDiag(DebugDiagCode::RESOURCE_CACHE_HIT));
+  absl::StatusOr<FileBackedResourceCache::ResourceAndMetadata> cached_resource =
+      (*resource_cache)->Get(kKey1, std::nullopt);
+  ASSERT_OK(cached_resource);
+  EXPECT_EQ(Resource1(), (*cached_resource).resource);
+}
+
+TEST_F(FileBackedResourceCacheTest, PutWithDigestAfterSharedContentExpires) {
+  auto resource_cache = FileBackedResourceCache::Create(
+      root_files_dir_, root_cache_dir_, &log_manager_, &clock_,
+      kMaxCacheSizeBytes, /*enable_content_addressed_storage=*/true);
+  ASSERT_OK(resource_cache);
+  std::string digest = ComputeSHA256(Resource1());
+  ASSERT_OK((*resource_cache)
+                ->PutWithDigest(kKey1, digest, Resource1(), Metadata(),
+                                absl::Minutes(1)));
+  clock_.AdvanceTime(absl::Minutes(2));
+  // The expired entry and its file are removed before the content is stored
+  // again, rather than the new entry referencing a deleted file.
+  ASSERT_OK((*resource_cache)
+                ->PutWithDigest(kKey2, digest, Resource1(), Metadata(),
+                                absl::Hours(1)));
+  EXPECT_EQ(NumFilesInDir(cache_dir_), 1);
+
+  EXPECT_CALL(log_manager_, LogDiag(DebugDiagCode::RESOURCE_CACHE_MISS));
+  ASSERT_THAT((*resource_cache)->Get(kKey1, std::nullopt), IsCode(NOT_FOUND));
+  EXPECT_CALL(log_manager_, LogDiag(DebugDiagCode::RESOURCE_CACHE_HIT));
+  absl::StatusOr<FileBackedResourceCache::ResourceAndMetadata> cached_resource =
+      (*resource_cache)->Get(kKey2, std::nullopt);
+  ASSERT_OK(cached_resource);
+  EXPECT_EQ(Resource1(), (*cached_resource).resource);
+}
+
+TEST_F(FileBackedResourceCacheTest, GetByDigest) {
+  auto resource_cache = FileBackedResourceCache::Create(
+      root_files_dir_, root_cache_dir_, &log_manager_, &clock_,
+      kMaxCacheSizeBytes, /*enable_content_addressed_storage=*/true);
+  ASSERT_OK(resource_cache);
+  std::string digest = ComputeSHA256(Resource1());
+  ASSERT_THAT((*resource_cache)->GetByDigest(digest, kKey2, absl::Hours(1)),
+              IsCode(NOT_FOUND));
+  ASSERT_OK((*resource_cache)
+                ->PutWithDigest(kKey1, digest, Resource1(), Metadata(),
+                                absl::Hours(1)));
+
+  EXPECT_CALL(log_manager_, LogDiag(DebugDiagCode::RESOURCE_CACHE_DIGEST_HIT));
+  absl::StatusOr<FileBackedResourceCache::ResourceAndMetadata> cached_resource =
+      (*resource_cache)->GetByDigest(digest, kKey2, absl::Hours(1));
+  ASSERT_OK(cached_resource);
+  EXPECT_EQ(Resource1(), (*cached_resource).resource);
+  SelectorContext stored_metadata;
+  (*cached_resource).metadata.UnpackTo(&stored_metadata);
+  EXPECT_THAT(SampleStoredMetadata(), EqualsProto(stored_metadata));
+
+  // The resource is now also cached under the new id.
+  EXPECT_CALL(log_manager_, LogDiag(DebugDiagCode::RESOURCE_CACHE_HIT));
+  ASSERT_OK((*resource_cache)->Get(kKey2, std::nullopt));
+  EXPECT_EQ(NumFilesInDir(cache_dir_), 1);
+}
+
+TEST_F(FileBackedResourceCacheTest, ContentAddressedStorageDisabled) {
+  auto resource_cache = FileBackedResourceCache::Create(
+      root_files_dir_, root_cache_dir_, &log_manager_, &clock_,
+      kMaxCacheSizeBytes);
+  ASSERT_OK(resource_cache);
+  EXPECT_FALSE((*resource_cache)->SupportsContentAddressedStorage());
+  std::string digest = ComputeSHA256(Resource1());
+  ASSERT_OK((*resource_cache)
+                ->PutWithDigest(kKey1, digest, Resource1(), Metadata(),
+                                absl::Hours(1)));
+  ASSERT_OK((*resource_cache)
+                ->PutWithDigest(kKey2, digest, Resource1(), Metadata(),
+                                absl::Hours(1)));
+  // Each resource is stored in its own file.
+  EXPECT_EQ(NumFilesInDir(cache_dir_), 2);
+  ASSERT_THAT((*resource_cache)->GetByDigest(digest, kKey3, absl::Hours(1)),
+              IsCode(NOT_FOUND));
+}
+
 TEST_F(FileBackedResourceCacheTest, CacheTooBigFileReturnsResourceExhausted) {
   auto resource_cache = FileBackedResourceCache::Create(
       root_files_dir_, root_cache_dir_, &log_manager_, &clock_,
@@ -66,6 +66,39 @@ class ResourceCache {
   // - NOT_FOUND - if cache_id not in ResourceCache
   virtual absl::StatusOr<ResourceAndMetadata> Get(
       absl::string_view cache_id, std::optional<absl::Duration> max_age) = 0;
+
+  // Returns whether PutWithDigest() and GetByDigest() make use of content
+  // digests. If not, callers needn't compute the digest of a resource before
+  // storing it.
+  virtual bool SupportsContentAddressedStorage() const { return false; }
+
+  // Stores resource under key cache_id, like Put(), and additionally records
+  // that its bytes have the given SHA-256 `content_digest` (raw digest bytes).
+  // Implementations which support content-addressed storage keep a single
+  // copy of the bytes for all cache ids stored with the same digest, and make
+  // it available to GetByDigest(). By default the digest is ignored.
+  virtual absl::Status PutWithDigest(absl::string_view cache_id,
+                                     absl::string_view content_digest,
+                                     const absl::Cord& resource,
+                                     const google::protobuf::Any& metadata,
+                                     absl::Duration max_age) {
+    return Put(cache_id, resource, metadata, max_age);
+  }
+
+  // Returns a resource previously stored with the given SHA-256
+  // `content_digest` under any cache id, along with its stored metadata. On
+  // success the resource is also stored under `cache_id`, with the given
+  // `max_age`, so that subsequent Get() calls for `cache_id` find it.
+  // Returns Ok on success
+  // On error, returns
+  // - INTERNAL - unexpected error.
+  // - NOT_FOUND - if no resource with the digest is in the ResourceCache, or
+  //   if the implementation doesn't support content-addressed storage.
+  virtual absl::StatusOr<ResourceAndMetadata> GetByDigest(
+      absl::string_view content_digest, absl::string_view cache_id,
+      absl::Duration max_age) {
+    return absl::NotFoundError("Content-addressed lookups are not supported");
+  }
 };
 
 }  // namespace cache
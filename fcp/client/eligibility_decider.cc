@@ -24,15 +24,19 @@
 
 #include "google/protobuf/duration.pb.h"
 #include "google/protobuf/timestamp.pb.h"
+#include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
+#include "absl/synchronization/blocking_counter.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "fcp/base/clock.h"
 #include "fcp/base/digest.h"
 #include "fcp/base/monitoring.h"
+#include "fcp/base/scheduler.h"
 #include "fcp/base/time_util.h"
 #include "fcp/client/engine/common.h"
 #include "fcp/client/engine/example_iterator_factory.h"
@@ -182,16 +186,57 @@ engine::ExampleIteratorFactory* FindExampleIteratorFactory(
   return nullptr;
 }
 
+// The number of examples counted for a given query during a single
+// eligibility computation.
+struct ExampleCount {
+  int64_t count = 0;
+  // Whether `count` is the total number of examples for the query, rather than
+  // a lower bound because counting stopped early.
+  bool is_total = false;
+};
+
+// Example counts keyed by the serialized selector and selector context of the
+// query, so that policies with identical selectors share a single count.
+//
+// Data availability policies on different example iterator factories may be
+// evaluated concurrently, so the cache is thread-safe. A given query is always
+// handled by the same factory, so its count is never computed concurrently.
+class ExampleCountCache {
+ public:
+  std::optional<ExampleCount> Get(const std::string& key) {
+    absl::MutexLock lock(&mutex_);
+    auto it = counts_.find(key);
+    if (it == counts_.end()) {
+      return std::nullopt;
+    }
+    return it->second;
+  }
+
+  void Put(const std::string& key, ExampleCount count) {
+    absl::MutexLock lock(&mutex_);
+    counts_[key] = count;
+  }
+
+ private:
+  absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, ExampleCount> counts_
+      ABSL_GUARDED_BY(mutex_);
+};
+
 // Returns true if the client has enough data to satisfy the policy, otherwise
 // returns false. Returns an error status for exceptional cases.
+//
+// `iterator_factory` is the factory which handles the policy's selector, or
+// null if the client doesn't host one.
+//
+// Only the number of examples is computed, and it is remembered in
+// `example_counts` so that later policies with the same selector don't query
+// the example store again, unless they need a larger number of examples.
 absl::StatusOr<bool> ComputeDataAvailabilityEligibility(
     const DataAvailabilityPolicy& data_availability_policy,
-    std::vector<engine::ExampleIteratorFactory*> example_iterator_factories,
-    const Flags& flags) {
+    engine::ExampleIteratorFactory* iterator_factory, const Flags& flags,
+    ExampleCountCache& example_counts) {
   const ExampleSelector& selector = data_availability_policy.selector();
-  engine::ExampleIteratorFactory* iterator_factory =
-      FindExampleIteratorFactory(selector, example_iterator_factories);
-
   if (iterator_factory == nullptr) {
     // The client does not host an iterator factory that can handle the given
     // selector.
@@ -209,8 +254,7 @@ absl::StatusOr<bool> ComputeDataAvailabilityEligibility(
     // separate task thus having a separate identifier.
     selector_context.mutable_computation_properties()
         ->mutable_eligibility_eval()
-        ->set_computation_id(
-            ComputeSHA256(selector.criteria().SerializeAsString()));
+        ->set_computation_id(ComputeSHA256(selector.criteria()));
   }
   bool use_example_query_result_format =
       flags.use_example_query_result_for_data_avail() &&
@@ -221,44 +265,40 @@ absl::StatusOr<bool> ComputeDataAvailabilityEligibility(
             QueryTimeComputationProperties::EXAMPLE_QUERY_RESULT);
   }
 
-  FCP_ASSIGN_OR_RETURN(
-      std::unique_ptr<ExampleIterator> iterator,
-      iterator_factory->CreateExampleIterator(selector, selector_context));
   int32_t min_example_count = data_availability_policy.min_example_count();
+  std::string cache_key = absl::StrCat(selector.SerializeAsString(),
+                                       selector_context.SerializeAsString());
+  std::optional<ExampleCount> cached_count = example_counts.Get(cache_key);
+  if (cached_count.has_value() &&
+      (cached_count->is_total || cached_count->count >= min_example_count)) {
+    return cached_count->count >= min_example_count;
+  }
+
+  ExampleCount example_count;
   if (use_example_query_result_format) {
+    // The single ExampleQueryResult carries the total number of examples in
+    // its stats.
+    FCP_ASSIGN_OR_RETURN(
+        std::unique_ptr<ExampleIterator> iterator,
+        iterator_factory->CreateExampleIterator(selector, selector_context));
     FCP_ASSIGN_OR_RETURN(std::string result, iterator->Next());
     ExampleQueryResult example_query_result;
     if (!example_query_result.ParseFromString(result)) {
       return absl::InvalidArgumentError("Failed to parse ExampleQueryResult");
     }
-    return example_query_result.stats().example_count_for_logs() >=
-           min_example_count;
+    example_count.count = example_query_result.stats().example_count_for_logs();
+    example_count.is_total = true;
   } else {
-    int examples_returned = 0;
-    while (examples_returned < min_example_count) {
-      absl::StatusOr<std::string> example = iterator->Next();
-      // Next() returns the example bytestring on success, and:
-      //  - CANCELLED if the call got interrupted.
-      //  - INVALID_ARGUMENT if some other error occurred, e.g. I/O.
-      //  - OUT_OF_RANGE if the end of the iterator was reached.
-      //
-      // Only on success and OUT_OF_RANGE should we continue execution.
-      if (example.ok()) {
-        examples_returned++;
-        continue;
-      }
-      if (absl::IsOutOfRange(example.status())) {
-        // No more examples, and the client did not return a sufficient amount
-        // to satisfy the policy.
-        return false;
-      }
-      // By here, the example is not ok, and the status is unexpected.
-      return example.status();
-    }
+    // CountExamples() returns CANCELLED if the call got interrupted, or
+    // INVALID_ARGUMENT if some other error occurred, e.g. I/O.
+    FCP_ASSIGN_OR_RETURN(example_count.count,
+                         iterator_factory->CountExamples(
+                             selector, selector_context, min_example_count));
+    example_count.is_total = example_count.count < min_example_count;
   }
+  example_counts.Put(cache_key, example_count);
 
-  // Enough examples returned!
-  return true;
+  return example_count.count >= min_example_count;
 }
 
 // An iterator that passes the name of the policy implementation to be executed
@@ -406,6 +446,274 @@ absl::flat_hash_set<std::string> ComputeMinimumSeparationPolicyEligibility(
   return eligibility_results;
 }
 
+// A single policy evaluation, and its outcome once the policy was evaluated.
+struct PolicyEvaluation {
+  const EligibilityPolicyEvalSpec* policy_spec = nullptr;
+  // The tasks to evaluate the policy for.
+  absl::flat_hash_set<std::string> task_names;
+  // For data availability policies, the factory which handles the policy's
+  // selector, if any. Factories are looked up before any policy is evaluated,
+  // since they aren't required to be thread-safe.
+  engine::ExampleIteratorFactory* example_iterator_factory = nullptr;
+  // The tasks which are eligible according to the policy, or the error that
+  // occurred while evaluating the policy.
+  absl::StatusOr<absl::flat_hash_set<std::string>> eligible_task_names;
+  absl::Duration duration;
+};
+
+// The state shared by all policy evaluations of a single eligibility
+// computation.
+struct PolicyEvaluationContext {
+  const opstats::OpStatsSequence& opstats_sequence;
+  Clock& clock;
+  const std::vector<engine::ExampleIteratorFactory*>&
+      example_iterator_factories;
+  EetPlanRunner& eet_plan_runner;
+  const Flags& flags;
+  ExampleCountCache& example_counts;
+};
+
+// Whether evaluating the policy depends on the outcome of the policies before
+// it, so that it can't be evaluated concurrently with them.
+bool DependsOnEarlierPolicies(const EligibilityPolicyEvalSpec& policy_spec) {
+  // A TfCustomPolicy plan is given the names of the tasks that are still
+  // eligible.
+  return policy_spec.policy_type_case() ==
+         EligibilityPolicyEvalSpec::PolicyTypeCase::kTfCustomPolicy;
+}
+
+// Whether evaluating the policy queries the example stores, so that it can't
+// be evaluated concurrently with a TfCustomPolicy plan, which may query them
+// as well.
+bool UsesExampleStores(const EligibilityPolicyEvalSpec& policy_spec) {
+  return policy_spec.policy_type_case() ==
+         EligibilityPolicyEvalSpec::PolicyTypeCase::kDataAvailabilityPolicy;
+}
+
+// Evaluates a single policy, and stores its outcome in `evaluation`.
+void ComputePolicyEligibility(PolicyEvaluation& evaluation,
+                              const PolicyEvaluationContext& context) {
+  const EligibilityPolicyEvalSpec& policy_spec = *evaluation.policy_spec;
+  absl::Time start_time = context.clock.Now();
+  switch (policy_spec.policy_type_case()) {
+    case EligibilityPolicyEvalSpec::PolicyTypeCase::kSworPolicy:
+      evaluation.eligible_task_names = ComputePerTaskSworEligibility(
+          policy_spec.swor_policy(), evaluation.task_names,
+          context.opstats_sequence, context.clock);
+      break;
+    case EligibilityPolicyEvalSpec::PolicyTypeCase::kDataAvailabilityPolicy: {
+      absl::StatusOr<bool> data_is_available =
+          ComputeDataAvailabilityEligibility(
+              policy_spec.data_availability_policy(),
+              evaluation.example_iterator_factory, context.flags,
+              context.example_counts);
+      if (!data_is_available.ok()) {
+        evaluation.eligible_task_names = data_is_available.status();
+      } else if (*data_is_available) {
+        // Data is available for all tasks that use this policy.
+        evaluation.eligible_task_names = evaluation.task_names;
+      } else {
+        // No tasks are eligible.
+        evaluation.eligible_task_names = absl::flat_hash_set<std::string>();
+      }
+    } break;
+    case EligibilityPolicyEvalSpec::PolicyTypeCase::kTfCustomPolicy:
+      evaluation.eligible_task_names = ComputeTfCustomPolicyEligibility(
+          policy_spec, evaluation.task_names,
+          context.example_iterator_factories, context.eet_plan_runner);
+      break;
+    case EligibilityPolicyEvalSpec::PolicyTypeCase::kMinSepPolicy:
+      evaluation.eligible_task_names =
+          ComputeMinimumSeparationPolicyEligibility(
+              policy_spec.min_sep_policy(), evaluation.task_names,
+              context.opstats_sequence, context.clock, context.flags);
+      break;
+    default:
+      // Should never happen, because we pre-filtered based on unimplemented
+      // policies.
+      evaluation.eligible_task_names = absl::InternalError(
+          absl::StrCat("Unexpected policy kind during eval: ",
+                       policy_spec.policy_type_case()));
+  }
+  evaluation.duration = context.clock.Now() - start_time;
+}
+
+// Removes the tasks which aren't in `eligible_tasks` anymore from the tasks
+// the policy is evaluated for.
+void RestrictToEligibleTasks(
+    PolicyEvaluation& evaluation,
+    const absl::flat_hash_set<std::string>& eligible_tasks) {
+  absl::erase_if(evaluation.task_names,
+                 [&eligible_tasks](const std::string& policy_task_name) {
+                   return !eligible_tasks.contains(policy_task_name);
+                 });
+}
+
+// Logs the outcome of the policy evaluation, and removes the tasks which are
+// not eligible according to the policy from `eligible_tasks`.
+void MergePolicyEvaluation(const PolicyEvaluation& evaluation,
+                           PhaseLogger& phase_logger,
+                           absl::flat_hash_set<std::string>& eligible_tasks) {
+  phase_logger.LogEligibilityEvalPolicyLatency(evaluation.duration);
+  if (!evaluation.eligible_task_names.ok()) {
+    // None of the tasks are eligible if the policy couldn't be evaluated.
+    phase_logger.LogEligibilityEvalComputationErrorNonfatal(
+        evaluation.eligible_task_names.status());
+  }
+  // If a task name is in the evaluated task names but not in the eligible task
+  // names, the runtime is not eligible for that task.
+  for (const std::string& task_name : evaluation.task_names) {
+    if (!evaluation.eligible_task_names.ok() ||
+        !evaluation.eligible_task_names->contains(task_name)) {
+      eligible_tasks.erase(task_name);
+    }
+  }
+}
+
+// Merges the outcome of a policy which was evaluated before the outcome of the
+// policies before it was known, as if it had been evaluated after them: only
+// the tasks which are still eligible are merged, and nothing is logged if
+// there are none. The outcome of such a policy for a task doesn't depend on
+// the other tasks it was evaluated for.
+void MergeEarlyPolicyEvaluation(
+    PolicyEvaluation& evaluation, PhaseLogger& phase_logger,
+    absl::flat_hash_set<std::string>& eligible_tasks) {
+  RestrictToEligibleTasks(evaluation, eligible_tasks);
+  if (evaluation.task_names.empty()) {
+    return;
+  }
+  MergePolicyEvaluation(evaluation, phase_logger, eligible_tasks);
+}
+
+// Returns the thread pool used to evaluate policies concurrently. Pools are
+// created on first use and shared by all eligibility computations, so that
+// their threads aren't started for every computation.
+Scheduler& GetPolicyEvaluationScheduler(int num_threads) {
+  ABSL_CONST_INIT static absl::Mutex mutex(absl::kConstInit);
+  static auto* schedulers =
+      new absl::flat_hash_map<int, std::unique_ptr<Scheduler>>();
+  absl::MutexLock lock(&mutex);
+  std::unique_ptr<Scheduler>& scheduler = (*schedulers)[num_threads];
+  if (scheduler == nullptr) {
+    scheduler = CreateThreadPoolScheduler(num_threads);
+  }
+  return *scheduler;
+}
+
+// Starts evaluating the policies on `scheduler`, and returns a counter which
+// reaches zero once all of them have been evaluated. Data availability
+// policies on the same example iterator factory are evaluated one after
+// another, since factories aren't required to be thread-safe. All other
+// policies are evaluated concurrently.
+std::unique_ptr<absl::BlockingCounter> StartPolicyEvaluations(
+    const std::vector<PolicyEvaluation*>& evaluations, Scheduler& scheduler,
+    const PolicyEvaluationContext& context) {
+  std::vector<std::vector<PolicyEvaluation*>> groups;
+  absl::flat_hash_map<engine::ExampleIteratorFactory*, int> factory_groups;
+  for (PolicyEvaluation* evaluation : evaluations) {
+    if (evaluation->example_iterator_factory == nullptr) {
+      groups.push_back({evaluation});
+      continue;
+    }
+    auto [it, inserted] = factory_groups.try_emplace(
+        evaluation->example_iterator_factory, groups.size());
+    if (inserted) {
+      groups.emplace_back();
+    }
+    groups[it->second].push_back(evaluation);
+  }
+
+  auto done = std::make_unique<absl::BlockingCounter>(groups.size());
+  for (const std::vector<PolicyEvaluation*>& group : groups) {
+    scheduler.Schedule([group, &context, done = done.get()]() {
+      for (PolicyEvaluation* evaluation : group) {
+        ComputePolicyEligibility(*evaluation, context);
+      }
+      done->DecrementCount();
+    });
+  }
+  return done;
+}
+
+// Evaluates the policies concurrently on `scheduler`, with the same outcome
+// and logging as evaluating them one after another.
+//
+// Policies which don't depend on the outcome of the policies before them are
+// evaluated for all the tasks they apply to, and merged in order once they've
+// all been evaluated, see MergeEarlyPolicyEvaluation(). A policy which does
+// depend on them is only evaluated once they've been merged. While it is
+// evaluated, the following policies which don't query the example stores are
+// evaluated as well.
+void ComputePolicyEligibilitiesConcurrently(
+    std::vector<PolicyEvaluation>& evaluations, Scheduler& scheduler,
+    const PolicyEvaluationContext& context, PhaseLogger& phase_logger,
+    absl::flat_hash_set<std::string>& eligible_tasks) {
+  auto next_dependent_policy = [&evaluations](int index) {
+    while (index < evaluations.size() &&
+           !DependsOnEarlierPolicies(*evaluations[index].policy_spec)) {
+      ++index;
+    }
+    return index;
+  };
+  // The evaluations started while the previous dependent policy was evaluated.
+  std::unique_ptr<absl::BlockingCounter> started_early;
+  int begin = 0;
+  while (true) {
+    int end = next_dependent_policy(begin);
+    std::vector<PolicyEvaluation*> independent_evaluations;
+    for (int i = begin; i < end; ++i) {
+      if (started_early != nullptr &&
+          !UsesExampleStores(*evaluations[i].policy_spec)) {
+        continue;
+      }
+      // Policies whose tasks are all ineligible already are never merged, so
+      // they needn't be evaluated.
+      RestrictToEligibleTasks(evaluations[i], eligible_tasks);
+      if (!evaluations[i].task_names.empty()) {
+        independent_evaluations.push_back(&evaluations[i]);
+      }
+    }
+    StartPolicyEvaluations(independent_evaluations, scheduler, context)
+        ->Wait();
+    if (started_early != nullptr) {
+      started_early->Wait();
+      started_early.reset();
+    }
+    for (int i = begin; i < end; ++i) {
+      MergeEarlyPolicyEvaluation(evaluations[i], phase_logger, eligible_tasks);
+    }
+    if (end == evaluations.size() || eligible_tasks.empty()) {
+      return;
+    }
+
+    PolicyEvaluation& dependent_evaluation = evaluations[end];
+    begin = end + 1;
+    RestrictToEligibleTasks(dependent_evaluation, eligible_tasks);
+    if (dependent_evaluation.task_names.empty()) {
+      continue;
+    }
+    std::vector<PolicyEvaluation*> overlapping_evaluations;
+    for (int i = begin, next_end = next_dependent_policy(begin); i < next_end;
+         ++i) {
+      if (UsesExampleStores(*evaluations[i].policy_spec)) {
+        continue;
+      }
+      RestrictToEligibleTasks(evaluations[i], eligible_tasks);
+      if (!evaluations[i].task_names.empty()) {
+        overlapping_evaluations.push_back(&evaluations[i]);
+      }
+    }
+    started_early =
+        StartPolicyEvaluations(overlapping_evaluations, scheduler, context);
+    ComputePolicyEligibility(dependent_evaluation, context);
+    MergePolicyEvaluation(dependent_evaluation, phase_logger, eligible_tasks);
+    if (eligible_tasks.empty()) {
+      started_early->Wait();
+      return;
+    }
+  }
+}
+
 }  // namespace
 
 absl::StatusOr<TaskEligibilityInfo> ComputeEligibility(
@@ -512,6 +820,10 @@ absl::StatusOr<TaskEligibilityInfo> ComputeEligibility(
     eligible_tasks.insert(task_info.task_name());
   }
 
+  // Example counts computed by data availability policies, shared by all
+  // policies evaluated below.
+  ExampleCountCache example_counts;
+
   // If we have any task names that use unimplemented policies, remove them from
   // eligible_tasks.
   if (!task_names_using_unimplemented_policies.empty()) {
@@ -521,111 +833,62 @@ absl::StatusOr<TaskEligibilityInfo> ComputeEligibility(
     });
   }
 
-  // For each policy:
-  // 1. If eligible tasks is now empty due to the previous iteration, quit
-  // early.
-  // 2. Get task names from policy_name_to_task_names.
-  // 3. Intersect with eligible_tasks to get the set of tasks names that we
-  // should use to compute eligibility for this policy.
-  // 4. Call compute x policy, get back a set of task names. This set will only
-  // contain tasks that are still eligible according to the policy computation
-  // we just did.
-  // 5. Remove all tasks from eligible_tasks that are not eligible according to
-  // the policy computation.
-
+  // policy_name_to_task_names contains our map of *implemented* policies to the
+  // tasks that use them. Policies which aren't in the map aren't evaluated.
+  std::vector<PolicyEvaluation> evaluations;
   for (const EligibilityPolicyEvalSpec& policy_spec :
        population_eligibility_spec.eligibility_policies()) {
-    // Check if there are no more eligible tasks due to previous policy
-    // computations. If so, there's no point in continuing to evaluate policies.
-    if (eligible_tasks.empty()) {
-      break;
-    }
-
-    // policy_name_to_task_names contains our map of *implemented* policies to
-    // the tasks that use them. First check if it's in the map. If not, there's
-    // no point in evaulating this policy.
     if (!policy_name_to_task_names.contains(policy_spec.name())) {
       continue;
     }
-
-    // The task names this policy applies to.
-    absl::flat_hash_set<std::string> policy_task_names =
-        policy_name_to_task_names.at(policy_spec.name());
-    // Remove those tasks that already aren't eligible anymore.
-    absl::erase_if(policy_task_names,
-                   [&eligible_tasks](const std::string& policy_task_name) {
-                     return !eligible_tasks.contains(policy_task_name);
-                   });
-
-    // If policy_task_names is now empty, there's no need to compute eligibility
-    // for this policy.
-    if (policy_task_names.empty()) {
-      continue;
+    PolicyEvaluation evaluation;
+    evaluation.policy_spec = &policy_spec;
+    evaluation.task_names = policy_name_to_task_names.at(policy_spec.name());
+    if (policy_spec.has_data_availability_policy()) {
+      evaluation.example_iterator_factory = FindExampleIteratorFactory(
+          policy_spec.data_availability_policy().selector(),
+          example_iterator_factories);
     }
-
-    absl::flat_hash_set<std::string> eligible_policy_task_names;
-    switch (policy_spec.policy_type_case()) {
-      case EligibilityPolicyEvalSpec::PolicyTypeCase::kSworPolicy:
-        eligible_policy_task_names = ComputePerTaskSworEligibility(
-            policy_spec.swor_policy(), policy_task_names, opstats_sequence,
-            clock);
-        break;
-      case EligibilityPolicyEvalSpec::PolicyTypeCase::kDataAvailabilityPolicy:
-        // Need to wrap initialization of local variables in a case statement.
-        {
-          absl::StatusOr<bool> data_is_available =
-              ComputeDataAvailabilityEligibility(
-                  policy_spec.data_availability_policy(),
-                  example_iterator_factories, *flags);
-          if (data_is_available.ok()) {
-            if (*data_is_available) {
-              // Data is available for all tasks that use this policy.
-              eligible_policy_task_names = policy_task_names;
-            }
-            // No tasks are eligible, so leave eligible_policy_task_names empty.
-          } else {
-            phase_logger.LogEligibilityEvalComputationErrorNonfatal(
-                data_is_available.status());
-            // No tasks are eligible, so leave eligible_policy_task_names
-            // empty. Below, we'll remove them from the overall eligible
-            // tasks.
-          }
-        }
+    evaluations.push_back(std::move(evaluation));
+  }
+  PolicyEvaluationContext context = {
+      .opstats_sequence = opstats_sequence,
+      .clock = clock,
+      .example_iterator_factories = example_iterator_factories,
+      .eet_plan_runner = eet_plan_runner,
+      .flags = *flags,
+      .example_counts = example_counts};
+
+  if (flags->eligibility_policy_evaluation_threads() > 1) {
+    ComputePolicyEligibilitiesConcurrently(
+        evaluations,
+        GetPolicyEvaluationScheduler(
+            flags->eligibility_policy_evaluation_threads()),
+        context, phase_logger, eligible_tasks);
+  } else {
+    // For each policy:
+    // 1. If eligible tasks is now empty due to the previous iteration, quit
+    // early.
+    // 2. Intersect the policy's task names with eligible_tasks to get the set
+    // of tasks names that we should use to compute eligibility for this
+    // policy.
+    // 3. Call compute x policy, get back a set of task names. This set will
+    // only contain tasks that are still eligible according to the policy
+    // computation we just did.
+    // 4. Remove all tasks from eligible_tasks that are not eligible according
+    // to the policy computation.
+    for (PolicyEvaluation& evaluation : evaluations) {
+      if (eligible_tasks.empty()) {
         break;
-      case EligibilityPolicyEvalSpec::PolicyTypeCase::kTfCustomPolicy: {
-        absl::StatusOr<absl::flat_hash_set<std::string>> tf_policy_task_names =
-            ComputeTfCustomPolicyEligibility(policy_spec, policy_task_names,
-                                             example_iterator_factories,
-                                             eet_plan_runner);
-        if (tf_policy_task_names.ok()) {
-          eligible_policy_task_names = *tf_policy_task_names;
-        } else {
-          phase_logger.LogEligibilityEvalComputationErrorNonfatal(
-              tf_policy_task_names.status());
-          // No tasks are eligible, so leave eligible_policy_task_names empty.
-          // Below, we'll remove them from the overall eligible tasks.
-        }
-      } break;
-      case EligibilityPolicyEvalSpec::PolicyTypeCase::kMinSepPolicy: {
-        eligible_policy_task_names = ComputeMinimumSeparationPolicyEligibility(
-            policy_spec.min_sep_policy(), policy_task_names, opstats_sequence,
-            clock, *flags);
-      } break;
-      default:
-        // Should never happen, because we pre-filtered above based on
-        // unimplemented policy.
-        return absl::InternalError(
-            absl::StrCat("Unexpected policy kind during eval: ",
-                         policy_spec.policy_type_case()));
-    }
-
-    // Merge computed eligible tasks with overall eligible tasks. If a task name
-    // is in policy_task_names but not in eligible_policy_task_names,
-    // the runtime is not eligible for that task.
-    for (const std::string& task_name : policy_task_names) {
-      if (!eligible_policy_task_names.contains(task_name)) {
-        eligible_tasks.erase(task_name);
       }
+      RestrictToEligibleTasks(evaluation, eligible_tasks);
+      // If there are no tasks left, there's no need to compute eligibility for
+      // this policy.
+      if (evaluation.task_names.empty()) {
+        continue;
+      }
+      ComputePolicyEligibility(evaluation, context);
+      MergePolicyEvaluation(evaluation, phase_logger, eligible_tasks);
     }
   }
 
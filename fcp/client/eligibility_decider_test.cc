@@ -16,6 +16,7 @@
 
 #include "fcp/client/eligibility_decider.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -26,9 +27,12 @@
 #include "google/protobuf/timestamp.pb.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/base/thread_annotations.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "fcp/base/simulated_clock.h"
 #include "fcp/client/diag_codes.pb.h"
@@ -49,11 +53,14 @@ namespace client {
 using ::google::internal::federated::plan::EligibilityPolicyEvalSpec;
 using ::google::internal::federated::plan::ExampleSelector;
 using ::google::internal::federated::plan::PopulationEligibilitySpec;
+using ::google::internal::federatedml::v2::TaskWeight;
 using ::testing::_;
 using ::testing::DoAll;
+using ::testing::ElementsAre;
 using ::testing::Eq;
 using ::testing::NiceMock;
 using ::testing::Return;
+using ::testing::UnorderedElementsAre;
 
 PopulationEligibilitySpec GenNoPoliciesSpec(int num_tasks) {
   PopulationEligibilitySpec spec;
@@ -438,6 +445,410 @@ TEST_F(EligibilityDeciderTest, DataAvailabilityPolicyComputationErrorNonfatal) {
   ASSERT_EQ(eligibility_result->task_weights().at(0).weight(), 0.0f);
 }
 
+// An ExampleIteratorFactory which counts examples without creating iterators.
+// It handles all selectors, or only those for `collection_uri` if given.
+class CountingExampleIteratorFactory : public engine::ExampleIteratorFactory {
+ public:
+  explicit CountingExampleIteratorFactory(int64_t num_examples,
+                                          std::string collection_uri = "")
+      : num_examples_(num_examples),
+        collection_uri_(std::move(collection_uri)) {}
+
+  bool CanHandle(const ExampleSelector& example_selector) override {
+    return collection_uri_.empty() ||
+           example_selector.collection_uri() == collection_uri_;
+  }
+  absl::StatusOr<std::unique_ptr<ExampleIterator>> CreateExampleIterator(
+      const ExampleSelector& example_selector) override {
+    return absl::InternalError("Example payloads should not be read");
+  }
+  absl::StatusOr<int64_t> CountExamples(const ExampleSelector& example_selector,
+                                        const SelectorContext& selector_context,
+                                        int64_t max_count) override {
+    max_counts_.push_back(max_count);
+    return std::min(num_examples_, max_count);
+  }
+  bool ShouldCollectStats() override { return true; }
+
+  // The `max_count` of each CountExamples() call.
+  std::vector<int64_t> max_counts_;
+
+ private:
+  int64_t num_examples_;
+  std::string collection_uri_;
+};
+
+void AddDataAvailabilityPolicy(PopulationEligibilitySpec& spec,
+                               absl::string_view name,
+                               absl::string_view collection_uri,
+                               int32_t min_example_count) {
+  EligibilityPolicyEvalSpec* da_spec =
+      spec.mutable_eligibility_policies()->Add();
+  da_spec->set_name(std::string(name));
+  da_spec->set_min_version(1);
+  da_spec->mutable_data_availability_policy()->set_min_example_count(
+      min_example_count);
+  *da_spec->mutable_data_availability_policy()
+       ->mutable_selector()
+       ->mutable_collection_uri() = std::string(collection_uri);
+}
+
+TEST_F(EligibilityDeciderTest, DataAvailabilityPolicyOnlyCountsExamples) {
+  PopulationEligibilitySpec spec;
+  AddDataAvailabilityPolicy(spec, "da_policy_3_examples", "app:/padam_padam",
+                            3);
+  PopulationEligibilitySpec::TaskInfo* task_info =
+      spec.mutable_task_info()->Add();
+  task_info->set_task_name("single_task_1");
+  task_info->set_task_assignment_mode(
+      PopulationEligibilitySpec::TaskInfo::TASK_ASSIGNMENT_MODE_MULTIPLE);
+  task_info->mutable_eligibility_policy_indices()->Add(0);
+
+  CountingExampleIteratorFactory example_iterator_factory(5);
+  absl::StatusOr<TaskEligibilityInfo> eligibility_result = ComputeEligibility(
+      spec, mock_log_manager_, mock_phase_logger_, GenOpstatsSequence(), clock_,
+      {&example_iterator_factory}, mock_eet_plan_runner_, &mock_flags_);
+  ASSERT_OK(eligibility_result);
+  ASSERT_EQ(eligibility_result->task_weights_size(), 1);
+  ASSERT_EQ(eligibility_result->task_weights().at(0).weight(), 1.0f);
+  EXPECT_THAT(example_iterator_factory.max_counts_, ElementsAre(3));
+}
+
+TEST_F(EligibilityDeciderTest, DataAvailabilityPoliciesShareExampleCounts) {
+  PopulationEligibilitySpec spec;
+  AddDataAvailabilityPolicy(spec, "da_policy_2_examples", "app:/padam_padam",
+                            2);
+  AddDataAvailabilityPolicy(spec, "da_policy_1_example", "app:/padam_padam",
+                            1);
+  AddDataAvailabilityPolicy(spec, "da_policy_4_examples", "app:/padam_padam",
+                            4);
+  AddDataAvailabilityPolicy(spec, "da_policy_10_examples", "app:/padam_padam",
+                            10);
+  AddDataAvailabilityPolicy(spec, "da_policy_6_examples", "app:/padam_padam",
+                            6);
+  for (int i = 0; i < 5; ++i) {
+    PopulationEligibilitySpec::TaskInfo* task_info =
+        spec.mutable_task_info()->Add();
+    task_info->set_task_name(absl::StrCat("task_", i));
+    task_info->set_task_assignment_mode(
+        PopulationEligibilitySpec::TaskInfo::TASK_ASSIGNMENT_MODE_MULTIPLE);
+    task_info->mutable_eligibility_policy_indices()->Add(i);
+  }
+
+  CountingExampleIteratorFactory example_iterator_factory(5);
+  absl::StatusOr<TaskEligibilityInfo> eligibility_result = ComputeEligibility(
+      spec, mock_log_manager_, mock_phase_logger_, GenOpstatsSequence(), clock_,
+      {&example_iterator_factory}, mock_eet_plan_runner_, &mock_flags_);
+  ASSERT_OK(eligibility_result);
+  ASSERT_EQ(eligibility_result->task_weights_size(), 5);
+  EXPECT_EQ(eligibility_result->task_weights().at(0).weight(), 1.0f);
+  EXPECT_EQ(eligibility_result->task_weights().at(1).weight(), 1.0f);
+  EXPECT_EQ(eligibility_result->task_weights().at(2).weight(), 1.0f);
+  EXPECT_EQ(eligibility_result->task_weights().at(3).weight(), 0.0f);
+  EXPECT_EQ(eligibility_result->task_weights().at(4).weight(), 0.0f);
+  // The store is only queried again when a policy needs more examples than
+  // were counted before, and not at all once all examples were counted.
+  EXPECT_THAT(example_iterator_factory.max_counts_, ElementsAre(2, 4, 10));
+}
+
+TEST_F(EligibilityDeciderTest, IndependentPoliciesEvaluatedConcurrently) {
+  EXPECT_CALL(mock_flags_, eligibility_policy_evaluation_threads())
+      .WillRepeatedly(Return(4));
+  PopulationEligibilitySpec spec;
+  // Policies 0-2 don't depend on each other and are evaluated concurrently.
+  AddDataAvailabilityPolicy(spec, "da_policy_3_examples", "app:/padam_padam",
+                            3);
+  AddDataAvailabilityPolicy(spec, "da_policy_10_examples", "app:/padam_padam",
+                            10);
+  EligibilityPolicyEvalSpec* min_sep_spec =
+      spec.mutable_eligibility_policies()->Add();
+  min_sep_spec->set_name("min_sep_policy");
+  min_sep_spec->set_min_version(1);
+  min_sep_spec->mutable_min_sep_policy()->set_current_index(10);
+  min_sep_spec->mutable_min_sep_policy()->set_minimum_separation(1);
+  // The TfCustomPolicy depends on the outcome of the policies before it.
+  EligibilityPolicyEvalSpec* tf_spec =
+      spec.mutable_eligibility_policies()->Add();
+  tf_spec->set_name("tf_custom_policy");
+  tf_spec->set_min_version(1);
+  *tf_spec->mutable_tf_custom_policy()->mutable_arguments() = "hi";
+  // Evaluated after the TfCustomPolicy.
+  AddDataAvailabilityPolicy(spec, "da_policy_4_examples", "app:/padam_padam",
+                            4);
+
+  std::vector<std::vector<int>> task_policy_indices = {
+      {0, 2, 3, 4}, {0, 3}, {1, 3}, {2}};
+  for (int i = 0; i < task_policy_indices.size(); ++i) {
+    PopulationEligibilitySpec::TaskInfo* task_info =
+        spec.mutable_task_info()->Add();
+    task_info->set_task_name(absl::StrCat("task_", i));
+    task_info->set_task_assignment_mode(
+        PopulationEligibilitySpec::TaskInfo::TASK_ASSIGNMENT_MODE_MULTIPLE);
+    for (int policy_index : task_policy_indices[i]) {
+      task_info->mutable_eligibility_policy_indices()->Add(policy_index);
+    }
+  }
+
+  std::vector<std::string> tf_policy_task_names;
+  engine::PlanResult plan_result(engine::PlanOutcome::kSuccess,
+                                 absl::OkStatus());
+  EXPECT_CALL(mock_eet_plan_runner_, RunPlan(_))
+      .WillOnce(DoAll(
+          [&tf_policy_task_names](
+              std::vector<engine::ExampleIteratorFactory*> factory_pointers) {
+            ExampleSelector neet_selector;
+            *neet_selector.mutable_collection_uri() =
+                "internal:/eligibility_context";
+            absl::StatusOr<std::unique_ptr<ExampleIterator>> iterator =
+                factory_pointers[0]->CreateExampleIterator(neet_selector);
+            ASSERT_OK(iterator);
+            absl::StatusOr<std::string> serialized_example =
+                (*iterator)->Next();
+            ASSERT_OK(serialized_example);
+            tensorflow::Example example;
+            ASSERT_TRUE(example.ParseFromString(*serialized_example));
+            for (const std::string& task_name : example.features()
+                                                    .feature()
+                                                    .at("task_names")
+                                                    .bytes_list()
+                                                    .value()) {
+              tf_policy_task_names.push_back(task_name);
+            }
+          },
+          Return(std::move(plan_result))));
+  TaskEligibilityInfo tf_custom_policy_output;
+  tf_custom_policy_output.set_version(1);
+  auto* task_weight = tf_custom_policy_output.add_task_weights();
+  task_weight->set_task_name("task_0");
+  task_weight->set_weight(1.0f);
+  EXPECT_CALL(mock_eet_plan_runner_, ParseOutput(_))
+      .WillOnce(Return(tf_custom_policy_output));
+  EXPECT_CALL(mock_phase_logger_, LogEligibilityEvalPolicyLatency(_)).Times(5);
+
+  CountingExampleIteratorFactory example_iterator_factory(5);
+  absl::StatusOr<TaskEligibilityInfo> eligibility_result = ComputeEligibility(
+      spec, mock_log_manager_, mock_phase_logger_, GenOpstatsSequence(), clock_,
+      {&example_iterator_factory}, mock_eet_plan_runner_, &mock_flags_);
+  ASSERT_OK(eligibility_result);
+  ASSERT_EQ(eligibility_result->task_weights_size(), 4);
+  EXPECT_EQ(eligibility_result->task_weights().at(0).weight(), 1.0f);
+  EXPECT_EQ(eligibility_result->task_weights().at(1).weight(), 0.0f);
+  EXPECT_EQ(eligibility_result->task_weights().at(2).weight(), 0.0f);
+  EXPECT_EQ(eligibility_result->task_weights().at(3).weight(), 1.0f);
+  // task_2 was already ineligible when the TfCustomPolicy was evaluated.
+  EXPECT_THAT(tf_policy_task_names, UnorderedElementsAre("task_0", "task_1"));
+  EXPECT_THAT(example_iterator_factory.max_counts_, ElementsAre(3, 10));
+}
+
+// Returns the task names passed to a TfCustomPolicy plan through the
+// eligibility context example iterator.
+std::vector<std::string> ReadNeetContextTaskNames(
+    std::vector<engine::ExampleIteratorFactory*> factory_pointers) {
+  ExampleSelector neet_selector;
+  *neet_selector.mutable_collection_uri() = "internal:/eligibility_context";
+  absl::StatusOr<std::unique_ptr<ExampleIterator>> iterator =
+      factory_pointers[0]->CreateExampleIterator(neet_selector);
+  if (!iterator.ok()) {
+    return {};
+  }
+  absl::StatusOr<std::string> serialized_example = (*iterator)->Next();
+  tensorflow::Example example;
+  if (!serialized_example.ok() ||
+      !example.ParseFromString(*serialized_example)) {
+    return {};
+  }
+  const auto& task_names =
+      example.features().feature().at("task_names").bytes_list().value();
+  std::vector<std::string> result(task_names.begin(), task_names.end());
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+// The outcome of an eligibility computation, and what it logged.
+struct EligibilityComputationLog {
+  std::vector<float> task_weights;
+  std::vector<absl::Status> errors;
+  int num_policy_latencies = 0;
+  std::vector<std::string> tf_policy_task_names;
+};
+
+// Computes eligibility for `spec` using `num_threads` threads. Data
+// availability policies for "app:/five_examples" and "app:/two_examples" are
+// served by separate example iterator factories.
+EligibilityComputationLog ComputeEligibilityWithThreads(
+    const PopulationEligibilitySpec& spec, int num_threads,
+    const TaskEligibilityInfo& tf_custom_policy_output) {
+  EligibilityComputationLog log;
+  NiceMock<MockLogManager> log_manager;
+  NiceMock<MockPhaseLogger> phase_logger;
+  ON_CALL(phase_logger, LogEligibilityEvalComputationErrorNonfatal(_))
+      .WillByDefault(
+          [&log](absl::Status error) { log.errors.push_back(error); });
+  ON_CALL(phase_logger, LogEligibilityEvalPolicyLatency(_))
+      .WillByDefault([&log](absl::Duration) { ++log.num_policy_latencies; });
+  NiceMock<MockEetPlanRunner> eet_plan_runner;
+  ON_CALL(eet_plan_runner, RunPlan(_))
+      .WillByDefault(
+          [&log](std::vector<engine::ExampleIteratorFactory*> factories) {
+            log.tf_policy_task_names = ReadNeetContextTaskNames(factories);
+            return engine::PlanResult(engine::PlanOutcome::kSuccess,
+                                      absl::OkStatus());
+          });
+  ON_CALL(eet_plan_runner, ParseOutput(_))
+      .WillByDefault(Return(tf_custom_policy_output));
+  NiceMock<MockFlags> flags;
+  ON_CALL(flags, eligibility_policy_evaluation_threads())
+      .WillByDefault(Return(num_threads));
+  SimulatedClock clock;
+  CountingExampleIteratorFactory five_examples_factory(5, "app:/five_examples");
+  CountingExampleIteratorFactory two_examples_factory(2, "app:/two_examples");
+
+  absl::StatusOr<TaskEligibilityInfo> eligibility_result = ComputeEligibility(
+      spec, log_manager, phase_logger, GenOpstatsSequence(), clock,
+      {&five_examples_factory, &two_examples_factory}, eet_plan_runner, &flags);
+  if (eligibility_result.ok()) {
+    for (const TaskWeight& task_weight : eligibility_result->task_weights()) {
+      log.task_weights.push_back(task_weight.weight());
+    }
+  }
+  return log;
+}
+
+TEST_F(EligibilityDeciderTest,
+       ConcurrentEvaluationMatchesSequentialEvaluation) {
+  PopulationEligibilitySpec spec;
+  AddDataAvailabilityPolicy(spec, "da_policy_0", "app:/five_examples", 3);
+  // No factory handles this selector, so this policy fails.
+  AddDataAvailabilityPolicy(spec, "da_policy_1", "app:/unknown", 1);
+  AddDataAvailabilityPolicy(spec, "da_policy_2", "app:/two_examples", 10);
+  // All tasks using this policy are ineligible by the time it'd be evaluated.
+  EligibilityPolicyEvalSpec* min_sep_spec =
+      spec.mutable_eligibility_policies()->Add();
+  min_sep_spec->set_name("min_sep_policy_3");
+  min_sep_spec->set_min_version(1);
+  min_sep_spec->mutable_min_sep_policy()->set_current_index(10);
+  min_sep_spec->mutable_min_sep_policy()->set_minimum_separation(1);
+  EligibilityPolicyEvalSpec* tf_spec =
+      spec.mutable_eligibility_policies()->Add();
+  tf_spec->set_name("tf_custom_policy_4");
+  tf_spec->set_min_version(1);
+  *tf_spec->mutable_tf_custom_policy()->mutable_arguments() = "hi";
+  AddDataAvailabilityPolicy(spec, "da_policy_5", "app:/two_examples", 1);
+  *spec.mutable_eligibility_policies()->Add() = *min_sep_spec;
+  spec.mutable_eligibility_policies(6)->set_name("min_sep_policy_6");
+  // All tasks using this policy are ineligible by the time it'd be evaluated,
+  // so its failure isn't logged.
+  AddDataAvailabilityPolicy(spec, "da_policy_7", "app:/unknown", 1);
+
+  std::vector<std::vector<int>> task_policy_indices = {
+      {0, 4, 5, 6}, {0, 1, 3}, {0, 2, 3}, {2, 4}, {4, 6, 7}};
+  for (int i = 0; i < task_policy_indices.size(); ++i) {
+    PopulationEligibilitySpec::TaskInfo* task_info =
+        spec.mutable_task_info()->Add();
+    task_info->set_task_name(absl::StrCat("task_", i));
+    task_info->set_task_assignment_mode(
+        PopulationEligibilitySpec::TaskInfo::TASK_ASSIGNMENT_MODE_MULTIPLE);
+    for (int policy_index : task_policy_indices[i]) {
+      task_info->mutable_eligibility_policy_indices()->Add(policy_index);
+    }
+  }
+  TaskEligibilityInfo tf_custom_policy_output;
+  tf_custom_policy_output.set_version(1);
+  TaskWeight* task_weight = tf_custom_policy_output.add_task_weights();
+  task_weight->set_task_name("task_0");
+  task_weight->set_weight(1.0f);
+
+  EligibilityComputationLog sequential =
+      ComputeEligibilityWithThreads(spec, 1, tf_custom_policy_output);
+  EXPECT_THAT(sequential.task_weights, ElementsAre(1.0f, 0, 0, 0, 0));
+  EXPECT_EQ(sequential.errors.size(), 1);
+  // Policies 3 and 7 aren't evaluated.
+  EXPECT_EQ(sequential.num_policy_latencies, 6);
+  EXPECT_THAT(sequential.tf_policy_task_names, ElementsAre("task_0", "task_4"));
+
+  EligibilityComputationLog concurrent =
+      ComputeEligibilityWithThreads(spec, 4, tf_custom_policy_output);
+  EXPECT_EQ(concurrent.task_weights, sequential.task_weights);
+  EXPECT_EQ(concurrent.errors, sequential.errors);
+  EXPECT_EQ(concurrent.num_policy_latencies, sequential.num_policy_latencies);
+  EXPECT_EQ(concurrent.tf_policy_task_names, sequential.tf_policy_task_names);
+}
+
+// Tracks how many example iterator factories are counting examples.
+struct CountRendezvous {
+  absl::Mutex mutex;
+  int num_counting ABSL_GUARDED_BY(mutex) = 0;
+};
+
+// A CountingExampleIteratorFactory which only counts examples once
+// `num_factories` factories sharing the rendezvous are counting at once.
+class RendezvousExampleIteratorFactory : public CountingExampleIteratorFactory {
+ public:
+  RendezvousExampleIteratorFactory(int64_t num_examples,
+                                   std::string collection_uri,
+                                   CountRendezvous* rendezvous,
+                                   int num_factories)
+      : CountingExampleIteratorFactory(num_examples, std::move(collection_uri)),
+        rendezvous_(rendezvous),
+        num_factories_(num_factories) {}
+
+  absl::StatusOr<int64_t> CountExamples(const ExampleSelector& example_selector,
+                                        const SelectorContext& selector_context,
+                                        int64_t max_count) override {
+    {
+      absl::MutexLock lock(&rendezvous_->mutex);
+      rendezvous_->num_counting++;
+      auto all_counting = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(
+                              rendezvous_->mutex) {
+        return rendezvous_->num_counting >= num_factories_;
+      };
+      if (!rendezvous_->mutex.AwaitWithTimeout(absl::Condition(&all_counting),
+                                               absl::Seconds(10))) {
+        return absl::DeadlineExceededError(
+            "Data availability policies weren't evaluated concurrently");
+      }
+    }
+    return CountingExampleIteratorFactory::CountExamples(
+        example_selector, selector_context, max_count);
+  }
+
+ private:
+  CountRendezvous* rendezvous_;
+  const int num_factories_;
+};
+
+TEST_F(EligibilityDeciderTest,
+       DataAvailabilityPoliciesOnDifferentFactoriesEvaluatedConcurrently) {
+  EXPECT_CALL(mock_flags_, eligibility_policy_evaluation_threads())
+      .WillRepeatedly(Return(4));
+  PopulationEligibilitySpec spec;
+  AddDataAvailabilityPolicy(spec, "da_policy_first", "app:/first", 3);
+  AddDataAvailabilityPolicy(spec, "da_policy_second", "app:/second", 3);
+  for (int i = 0; i < 2; ++i) {
+    PopulationEligibilitySpec::TaskInfo* task_info =
+        spec.mutable_task_info()->Add();
+    task_info->set_task_name(absl::StrCat("task_", i));
+    task_info->set_task_assignment_mode(
+        PopulationEligibilitySpec::TaskInfo::TASK_ASSIGNMENT_MODE_MULTIPLE);
+    task_info->mutable_eligibility_policy_indices()->Add(i);
+  }
+
+  // Each factory only counts examples once both are counting, so both tasks
+  // are only eligible if the policies are evaluated concurrently.
+  CountRendezvous rendezvous;
+  RendezvousExampleIteratorFactory first_factory(5, "app:/first", &rendezvous,
+                                                 /*num_factories=*/2);
+  RendezvousExampleIteratorFactory second_factory(5, "app:/second", &rendezvous,
+                                                  /*num_factories=*/2);
+  absl::StatusOr<TaskEligibilityInfo> eligibility_result = ComputeEligibility(
+      spec, mock_log_manager_, mock_phase_logger_, GenOpstatsSequence(), clock_,
+      {&first_factory, &second_factory}, mock_eet_plan_runner_, &mock_flags_);
+  ASSERT_OK(eligibility_result);
+  ASSERT_EQ(eligibility_result->task_weights_size(), 2);
+  EXPECT_EQ(eligibility_result->task_weights().at(0).weight(), 1.0f);
+  EXPECT_EQ(eligibility_result->task_weights().at(1).weight(), 1.0f);
+}
+
 TEST_F(EligibilityDeciderTest, TfCustomPolicyEnabledRunsSuccessfully) {
   PopulationEligibilitySpec spec;
 
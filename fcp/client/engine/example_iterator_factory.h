@@ -16,9 +16,12 @@
 #ifndef FCP_CLIENT_ENGINE_EXAMPLE_ITERATOR_FACTORY_H_
 #define FCP_CLIENT_ENGINE_EXAMPLE_ITERATOR_FACTORY_H_
 
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <string>
 
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "fcp/client/selector_context.pb.h"
 #include "fcp/client/simple_task_environment.h"
@@ -61,6 +64,28 @@ class ExampleIteratorFactory {
     return SelectorContext::default_instance();
   };
 
+  // Returns the number of examples an iterator for the given query would
+  // return, but stops counting once `max_count` examples were found, i.e. the
+  // result is never larger than `max_count`.
+  //
+  // The default implementation creates an iterator and skips over the
+  // examples with ExampleIterator::Skip(), so the payloads are only read if the
+  // iterator doesn't override that. Implementations which can count examples
+  // without creating an iterator at all may override this method instead.
+  virtual absl::StatusOr<int64_t> CountExamples(
+      const google::internal::federated::plan::ExampleSelector&
+          example_selector,
+      const SelectorContext& selector_context, int64_t max_count) {
+    absl::StatusOr<std::unique_ptr<ExampleIterator>> iterator =
+        CreateExampleIterator(example_selector, selector_context);
+    if (!iterator.ok()) {
+      return iterator.status();
+    }
+    absl::StatusOr<int64_t> count = (*iterator)->Skip(max_count);
+    (*iterator)->Close();
+    return count;
+  }
+
   // Whether stats should be generated and logged into the OpStats database for
   // iterators created by this factory.
   virtual bool ShouldCollectStats() = 0;
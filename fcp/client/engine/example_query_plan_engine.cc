@@ -16,11 +16,11 @@
 
 #include "fcp/client/engine/example_query_plan_engine.h"
 
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 #include <memory>
 #include <string>
-#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -28,6 +28,7 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "fcp/base/monitoring.h"
+#include "fcp/base/scheduler.h"
 #include "fcp/client/converters.h"
 #include "fcp/client/engine/common.h"
 #include "fcp/client/engine/example_iterator_factory.h"
@@ -38,6 +39,8 @@
 #include "fcp/client/opstats/opstats_logger.h"
 #include "fcp/client/simple_task_environment.h"
 #include "fcp/protos/plan.pb.h"
+#include "google/protobuf/arena.h"
+#include "google/protobuf/repeated_ptr_field.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_slice.h"
 #include "tensorflow/core/platform/tstring.h"
@@ -76,19 +79,30 @@ absl::Status WriteSlice(tf::checkpoint::TensorSliceWriter& slice_writer,
   return slice_writer.Add(name, shape, slice, data);
 }
 
-// Returns a map of (vector name) -> tuple(output name, vector spec).
-absl::flat_hash_map<std::string,
-                    std::tuple<std::string, ExampleQuerySpec::OutputVectorSpec>>
-GetOutputVectorSpecs(const ExampleQuerySpec::ExampleQuery& example_query) {
-  absl::flat_hash_map<
-      std::string, std::tuple<std::string, ExampleQuerySpec::OutputVectorSpec>>
-      map;
-  for (auto const& [output_name, output_vector_spec] :
-       example_query.output_vector_specs()) {
-    map[output_vector_spec.vector_name()] =
-        std::make_tuple(output_name, output_vector_spec);
+// Writes a one-dimensional string tensor using the slice writer. The tstrings
+// passed to the writer are views of `values`, so the strings aren't copied.
+absl::Status WriteStringSlice(
+    tf::checkpoint::TensorSliceWriter& slice_writer, const std::string& name,
+    const google::protobuf::RepeatedPtrField<std::string>& values) {
+  std::vector<tf::tstring> tf_string_vector(values.size());
+  for (int i = 0; i < values.size(); ++i) {
+    tf_string_vector[i].assign_as_view(values.Get(i));
   }
-  return map;
+  return WriteSlice(slice_writer, name, values.size(), tf_string_vector.data());
+}
+
+// Returns the values of the vector named by `output_vector_spec` in the
+// example query result. The returned pointer is owned by the result.
+absl::StatusOr<const ExampleQueryResult::VectorData::Values*> FindOutputVector(
+    const ExampleQueryResult& example_query_result,
+    const ExampleQuerySpec::OutputVectorSpec& output_vector_spec) {
+  auto it = example_query_result.vector_data().vectors().find(
+      output_vector_spec.vector_name());
+  if (it == example_query_result.vector_data().vectors().end()) {
+    return absl::DataLossError(
+        "Expected value not found in the example query result");
+  }
+  return &it->second;
 }
 
 absl::Status CheckOutputVectorDataType(
@@ -105,27 +119,21 @@ absl::Status CheckOutputVectorDataType(
 // must be the same as example_query_spec.example_queries.
 absl::Status WriteCheckpoint(
     const std::string& output_checkpoint_filename,
-    const std::vector<ExampleQueryResult>& example_query_results,
+    const std::vector<const ExampleQueryResult*>& example_query_results,
     const ExampleQuerySpec& example_query_spec) {
   tf::checkpoint::TensorSliceWriter slice_writer(
       output_checkpoint_filename,
       tf::checkpoint::CreateTableTensorSliceBuilder);
   for (int i = 0; i < example_query_results.size(); ++i) {
-    const ExampleQueryResult& example_query_result = example_query_results[i];
+    const ExampleQueryResult& example_query_result = *example_query_results[i];
     const ExampleQuerySpec::ExampleQuery& example_query =
         example_query_spec.example_queries()[i];
-    for (auto const& [vector_name, vector_tuple] :
-         GetOutputVectorSpecs(example_query)) {
-      std::string output_name = std::get<0>(vector_tuple);
-      ExampleQuerySpec::OutputVectorSpec output_vector_spec =
-          std::get<1>(vector_tuple);
-      auto it = example_query_result.vector_data().vectors().find(vector_name);
-      if (it == example_query_result.vector_data().vectors().end()) {
-        return absl::DataLossError(
-            "Expected value not found in the example query result");
-      }
-      const ExampleQueryResult::VectorData::Values values = it->second;
-      absl::Status status;
+    for (auto const& [output_name, output_vector_spec] :
+         example_query.output_vector_specs()) {
+      FCP_ASSIGN_OR_RETURN(
+          const ExampleQueryResult::VectorData::Values* values_ptr,
+          FindOutputVector(example_query_result, output_vector_spec));
+      const ExampleQueryResult::VectorData::Values& values = *values_ptr;
       if (values.has_int32_values()) {
         FCP_RETURN_IF_ERROR(CheckOutputVectorDataType(
             output_vector_spec, ExampleQuerySpec::OutputVectorSpec::INT32));
@@ -143,13 +151,8 @@ absl::Status WriteCheckpoint(
       } else if (values.has_string_values()) {
         FCP_RETURN_IF_ERROR(CheckOutputVectorDataType(
             output_vector_spec, ExampleQuerySpec::OutputVectorSpec::STRING));
-        int64_t size = values.string_values().value_size();
-        std::vector<tf::tstring> tf_string_vector;
-        for (const auto& value : values.string_values().value()) {
-          tf_string_vector.emplace_back(value);
-        }
-        FCP_RETURN_IF_ERROR(WriteSlice(slice_writer, output_name, size,
-                                       tf_string_vector.data()));
+        FCP_RETURN_IF_ERROR(WriteStringSlice(slice_writer, output_name,
+                                             values.string_values().value()));
       } else if (values.has_bool_values()) {
         FCP_RETURN_IF_ERROR(CheckOutputVectorDataType(
             output_vector_spec, ExampleQuerySpec::OutputVectorSpec::BOOL));
@@ -174,13 +177,8 @@ absl::Status WriteCheckpoint(
       } else if (values.has_bytes_values()) {
         FCP_RETURN_IF_ERROR(CheckOutputVectorDataType(
             output_vector_spec, ExampleQuerySpec::OutputVectorSpec::BYTES));
-        int64_t size = values.bytes_values().value_size();
-        std::vector<tf::tstring> tf_string_vector;
-        for (const auto& value : values.string_values().value()) {
-          tf_string_vector.emplace_back(value);
-        }
-        FCP_RETURN_IF_ERROR(WriteSlice(slice_writer, output_name, size,
-                                       tf_string_vector.data()));
+        FCP_RETURN_IF_ERROR(WriteStringSlice(slice_writer, output_name,
+                                             values.bytes_values().value()));
       } else {
         return absl::DataLossError(
             "Unexpected data type in the example query result");
@@ -194,23 +192,18 @@ absl::Status WriteCheckpoint(
 // query results order must be the same as example_query_spec.example_queries.
 absl::Status GenerateAggregationTensors(
     CheckpointBuilder& checkpoint_builder,
-    const std::vector<ExampleQueryResult>& example_query_results,
+    const std::vector<const ExampleQueryResult*>& example_query_results,
     const ExampleQuerySpec& example_query_spec) {
   for (int i = 0; i < example_query_results.size(); ++i) {
-    const ExampleQueryResult& example_query_result = example_query_results[i];
+    const ExampleQueryResult& example_query_result = *example_query_results[i];
     const ExampleQuerySpec::ExampleQuery& example_query =
         example_query_spec.example_queries()[i];
-    for (auto const& [vector_name, vector_tuple] :
-         GetOutputVectorSpecs(example_query)) {
-      std::string output_name = std::get<0>(vector_tuple);
-      ExampleQuerySpec::OutputVectorSpec output_vector_spec =
-          std::get<1>(vector_tuple);
-      auto it = example_query_result.vector_data().vectors().find(vector_name);
-      if (it == example_query_result.vector_data().vectors().end()) {
-        return absl::DataLossError(
-            "Expected value not found in the example query result");
-      }
-      const ExampleQueryResult::VectorData::Values values = it->second;
+    for (auto const& [output_name, output_vector_spec] :
+         example_query.output_vector_specs()) {
+      FCP_ASSIGN_OR_RETURN(
+          const ExampleQueryResult::VectorData::Values* values_ptr,
+          FindOutputVector(example_query_result, output_vector_spec));
+      const ExampleQueryResult::VectorData::Values& values = *values_ptr;
       Tensor tensor;
       if (values.has_int32_values()) {
         FCP_RETURN_IF_ERROR(CheckOutputVectorDataType(
@@ -278,61 +271,125 @@ ExampleQueryPlanEngine::ExampleQueryPlanEngine(
     : example_iterator_factories_(example_iterator_factories),
       opstats_logger_(opstats_logger),
       flags_(*flags),
-      example_iterator_query_recorder_(example_iterator_query_recorder) {}
+      example_iterator_query_recorder_(example_iterator_query_recorder) {
+  // At most one query per factory runs at a time, so more threads than
+  // factories would never be used.
+  const int parallelism =
+      std::min<int>(flags_.example_query_parallelism(),
+                    example_iterator_factories_.size());
+  if (parallelism > 1) {
+    scheduler_ = CreateThreadPoolScheduler(parallelism);
+  }
+}
+
+absl::StatusOr<const ExampleQueryResult*>
+ExampleQueryPlanEngine::RunExampleQuery(
+    const ExampleQuerySpec::ExampleQuery& example_query,
+    ExampleIteratorFactory* example_iterator_factory,
+    SingleExampleIteratorQueryRecorder* single_query_recorder,
+    google::protobuf::Arena& arena,
+    std::atomic<int64_t>* total_example_size_bytes) {
+  const ExampleSelector& selector = example_query.example_selector();
+  FCP_ASSIGN_OR_RETURN(
+      std::unique_ptr<ExampleIterator> example_iterator,
+      example_iterator_factory->CreateExampleIterator(selector));
+
+  ExampleIteratorStatus example_iterator_status;
+
+  std::atomic<int> unused_example_count = 0;
+  auto dataset_iterator = std::make_unique<DatasetIterator>(
+      std::move(example_iterator), opstats_logger_, single_query_recorder,
+      &unused_example_count, total_example_size_bytes,
+      &example_iterator_status, selector.collection_uri(),
+      /*collect_stats=*/example_iterator_factory->ShouldCollectStats());
+
+  FCP_ASSIGN_OR_RETURN(std::string example_query_result_str,
+                       dataset_iterator->GetNext());
+
+  // The results are parsed onto an arena, since large results consist of many
+  // small allocations (e.g. one per string value) which are all freed together
+  // once the checkpoint has been written.
+  auto* example_query_result =
+      google::protobuf::Arena::Create<ExampleQueryResult>(&arena);
+  if (!example_query_result->ParseFromString(example_query_result_str)) {
+    return absl::DataLossError("Unexpected example query result format");
+  }
+  return example_query_result;
+}
 
 PlanResult ExampleQueryPlanEngine::RunPlan(
     const ExampleQuerySpec& example_query_spec,
     const std::string& output_checkpoint_filename) {
-  std::vector<ExampleQueryResult> example_query_results;
+  google::protobuf::Arena arena;
   std::atomic<int> total_example_count = 0;
   std::atomic<int64_t> total_example_size_bytes = 0;
 
-  for (const auto& example_query : example_query_spec.example_queries()) {
-    ExampleSelector selector = example_query.example_selector();
+  const int num_queries = example_query_spec.example_queries_size();
+  std::vector<absl::StatusOr<const ExampleQueryResult*>> query_results(
+      num_queries);
+  // Queries on the same factory are run one after another on that factory's
+  // worker, and only queries on different factories overlap. Dataset stats are
+  // aggregated per collection by the opstats logger, so the order in which
+  // concurrent queries report them doesn't matter.
+  absl::flat_hash_map<ExampleIteratorFactory*, std::unique_ptr<Worker>>
+      workers;
+  for (int i = 0; i < num_queries; ++i) {
+    const ExampleQuerySpec::ExampleQuery& example_query =
+        example_query_spec.example_queries(i);
     ExampleIteratorFactory* example_iterator_factory =
-        FindExampleIteratorFactory(selector, example_iterator_factories_);
+        FindExampleIteratorFactory(example_query.example_selector(),
+                                   example_iterator_factories_);
     if (example_iterator_factory == nullptr) {
-      return PlanResult(PlanOutcome::kExampleIteratorError,
-                        absl::InternalError(
-                            "Could not find suitable ExampleIteratorFactory"));
-    }
-    absl::StatusOr<std::unique_ptr<ExampleIterator>> example_iterator =
-        example_iterator_factory->CreateExampleIterator(selector);
-    if (!example_iterator.ok()) {
-      return PlanResult(PlanOutcome::kExampleIteratorError,
-                        example_iterator.status());
+      query_results[i] =
+          absl::InternalError("Could not find suitable ExampleIteratorFactory");
+      break;
     }
+    // Queries are recorded here rather than when they run, so that they're
+    // recorded in plan order even if they finish out of order.
     SingleExampleIteratorQueryRecorder* single_query_recorder = nullptr;
     if (example_iterator_query_recorder_) {
-      single_query_recorder =
-          example_iterator_query_recorder_->RecordQuery(selector);
+      single_query_recorder = example_iterator_query_recorder_->RecordQuery(
+          example_query.example_selector());
     }
-
-    ExampleIteratorStatus example_iterator_status;
-
-    std::atomic<int> unused_example_count = 0;
-    auto dataset_iterator = std::make_unique<DatasetIterator>(
-        std::move(*example_iterator), opstats_logger_, single_query_recorder,
-        &unused_example_count, &total_example_size_bytes,
-        &example_iterator_status, selector.collection_uri(),
-        /*collect_stats=*/example_iterator_factory->ShouldCollectStats());
-
-    absl::StatusOr<std::string> example_query_result_str =
-        dataset_iterator->GetNext();
-    if (!example_query_result_str.ok()) {
-      return PlanResult(PlanOutcome::kExampleIteratorError,
-                        example_query_result_str.status());
+    if (scheduler_ == nullptr) {
+      query_results[i] =
+          RunExampleQuery(example_query, example_iterator_factory,
+                          single_query_recorder, arena,
+                          &total_example_size_bytes);
+      if (!query_results[i].ok()) {
+        // Don't run the remaining queries, since the plan fails anyway.
+        break;
+      }
+      continue;
+    }
+    std::unique_ptr<Worker>& worker = workers[example_iterator_factory];
+    if (worker == nullptr) {
+      worker = scheduler_->CreateWorker();
     }
+    worker->Schedule([this, i, &example_query, example_iterator_factory,
+                      single_query_recorder, &arena, &total_example_size_bytes,
+                      &query_results]() {
+      query_results[i] =
+          RunExampleQuery(example_query, example_iterator_factory,
+                          single_query_recorder, arena,
+                          &total_example_size_bytes);
+    });
+  }
+  if (scheduler_ != nullptr) {
+    scheduler_->WaitUntilIdle();
+  }
 
-    ExampleQueryResult example_query_result;
-    if (!example_query_result.ParseFromString(*example_query_result_str)) {
-      return PlanResult(
-          PlanOutcome::kExampleIteratorError,
-          absl::DataLossError("Unexpected example query result format"));
+  // Merge the results in the order of the spec, so that the first failing
+  // query determines the outcome regardless of the order queries finished in.
+  std::vector<const ExampleQueryResult*> example_query_results;
+  for (const auto& query_result : query_results) {
+    if (!query_result.ok()) {
+      return PlanResult(PlanOutcome::kExampleIteratorError,
+                        query_result.status());
     }
     total_example_count +=
-        example_query_result.stats().example_count_for_logs();
-    example_query_results.push_back(std::move(example_query_result));
+        (*query_result)->stats().example_count_for_logs();
+    example_query_results.push_back(*query_result);
   }
 
   PlanResult plan_result(PlanOutcome::kSuccess, absl::OkStatus());
@@ -16,14 +16,22 @@
 #ifndef FCP_CLIENT_ENGINE_EXAMPLE_QUERY_PLAN_ENGINE_H_
 #define FCP_CLIENT_ENGINE_EXAMPLE_QUERY_PLAN_ENGINE_H_
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "absl/status/statusor.h"
+#include "fcp/base/scheduler.h"
 #include "fcp/client/engine/common.h"
 #include "fcp/client/engine/example_iterator_factory.h"
 #include "fcp/client/example_iterator_query_recorder.h"
 #include "fcp/client/flags.h"
+#include "fcp/client/example_query_result.pb.h"
 #include "fcp/client/opstats/opstats_logger.h"
+#include "fcp/protos/plan.pb.h"
+#include "google/protobuf/arena.h"
 #include "tensorflow_federated/cc/core/impl/aggregation/protocol/federated_compute_checkpoint_builder.h"
 
 namespace fcp {
@@ -40,18 +48,37 @@ class ExampleQueryPlanEngine {
       ExampleIteratorQueryRecorder* example_iterator_query_recorder);
 
   // Runs a plan and writes an output into a checkpoint at the given path.
+  // Queries served by different ExampleIteratorFactory instances are run
+  // concurrently, up to the limit set by Flags::example_query_parallelism().
+  // Queries served by the same factory always run one after another, since
+  // factories aren't required to be thread-safe. Results are always written,
+  // and queries recorded, in the order of the ExampleQuerySpec.
   ::fcp::client::engine::PlanResult RunPlan(
       const google::internal::federated::plan::ExampleQuerySpec&
           example_query_spec,
       const std::string& output_checkpoint_filename);
 
  private:
+  // Runs a single example query using `example_iterator_factory`, and returns
+  // its result parsed onto `arena`. `single_query_recorder` may be null. Safe
+  // to call concurrently for queries using different factories.
+  absl::StatusOr<const ExampleQueryResult*> RunExampleQuery(
+      const google::internal::federated::plan::ExampleQuerySpec::ExampleQuery&
+          example_query,
+      ExampleIteratorFactory* example_iterator_factory,
+      SingleExampleIteratorQueryRecorder* single_query_recorder,
+      google::protobuf::Arena& arena,
+      std::atomic<int64_t>* total_example_size_bytes);
+
   std::vector<ExampleIteratorFactory*> example_iterator_factories_;
   ::fcp::client::opstats::OpStatsLogger* opstats_logger_;
   tensorflow_federated::aggregation::FederatedComputeCheckpointBuilderFactory
       federated_compute_checkpoint_builder_factory_;
   const Flags& flags_;
   ExampleIteratorQueryRecorder* example_iterator_query_recorder_;
+  // Runs queries concurrently. Created once per engine, and only if more than
+  // one query can run at a time; null otherwise.
+  std::unique_ptr<Scheduler> scheduler_;
 };
 }  // namespace engine
 }  // namespace client
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <filesystem>  // NOLINT(build/c++17)
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "gmock/gmock.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "fcp/base/monitoring.h"
+#include "fcp/client/engine/common.h"
+#include "fcp/client/engine/example_iterator_factory.h"
+#include "fcp/client/engine/example_query_plan_engine.h"
+#include "fcp/client/example_query_result.pb.h"
+#include "fcp/client/simple_task_environment.h"
+#include "fcp/client/test_helpers.h"
+#include "fcp/protos/plan.pb.h"
+#include "fcp/testing/testing.h"
+
+// Open-source version of benchmarking library
+#include "benchmark//benchmark.h"
+
+namespace fcp {
+namespace client {
+namespace engine {
+namespace {
+
+using ::google::internal::federated::plan::ExampleQuerySpec;
+using ::google::internal::federated::plan::ExampleSelector;
+using ::testing::NiceMock;
+using ::testing::Return;
+
+constexpr char kCollectionUri[] = "app:/test_collection";
+constexpr char kStringVectorName[] = "vector1";
+constexpr char kIntVectorName[] = "vector2";
+constexpr char kStringTensorName[] = "tensor1";
+constexpr char kIntTensorName[] = "tensor2";
+
+// Returns a single serialized ExampleQueryResult, without copying a whole
+// Dataset per query as SimpleExampleIterator would.
+class SingleExampleIterator : public ExampleIterator {
+ public:
+  explicit SingleExampleIterator(const std::string* example)
+      : example_(example) {}
+
+  absl::StatusOr<std::string> Next() override {
+    if (done_) {
+      return absl::OutOfRangeError("");
+    }
+    done_ = true;
+    return *example_;
+  }
+
+  void Close() override {}
+
+ private:
+  const std::string* example_;
+  bool done_ = false;
+};
+
+ExampleQuerySpec CreateSpec() {
+  ExampleQuerySpec::OutputVectorSpec string_vector_spec;
+  string_vector_spec.set_vector_name(kStringVectorName);
+  string_vector_spec.set_data_type(ExampleQuerySpec::OutputVectorSpec::STRING);
+  ExampleQuerySpec::OutputVectorSpec int_vector_spec;
+  int_vector_spec.set_vector_name(kIntVectorName);
+  int_vector_spec.set_data_type(ExampleQuerySpec::OutputVectorSpec::INT64);
+
+  ExampleQuerySpec spec;
+  ExampleQuerySpec::ExampleQuery* example_query = spec.add_example_queries();
+  example_query->mutable_example_selector()->set_collection_uri(
+      kCollectionUri);
+  (*example_query->mutable_output_vector_specs())[kStringTensorName] =
+      string_vector_spec;
+  (*example_query->mutable_output_vector_specs())[kIntTensorName] =
+      int_vector_spec;
+  return spec;
+}
+
+// Returns a serialized ExampleQueryResult with `num_rows` rows in each of its
+// string and int64 vectors.
+std::string CreateExample(int64_t num_rows) {
+  ExampleQueryResult result;
+  auto& vectors = *result.mutable_vector_data()->mutable_vectors();
+  auto* int_values = vectors[kIntVectorName].mutable_int64_values();
+  auto* string_values = vectors[kStringVectorName].mutable_string_values();
+  int_values->mutable_value()->Reserve(num_rows);
+  string_values->mutable_value()->Reserve(num_rows);
+  for (int64_t i = 0; i < num_rows; ++i) {
+    int_values->add_value(i);
+    string_values->add_value(absl::StrCat("value", i));
+  }
+  return result.SerializeAsString();
+}
+
+// Runs a plan with a single query whose result has `state.range(0)` rows in
+// each of its vectors. The results are written to a TF v1 checkpoint, or, if
+// `state.range(1)` is set, to a federated compute wire format checkpoint.
+void BM_RunPlan(benchmark::State& state) {
+  const int64_t num_rows = state.range(0);
+  const bool use_lightweight_wire_format = state.range(1) != 0;
+  const ExampleQuerySpec spec = CreateSpec();
+  const std::string example = CreateExample(num_rows);
+  const std::string output_checkpoint_filename =
+      (std::filesystem::path(testing::TempDir()) / "bench_output.ckpt")
+          .string();
+
+  FunctionalExampleIteratorFactory example_iterator_factory(
+      [&example](const ExampleSelector& selector) {
+        return std::make_unique<SingleExampleIterator>(&example);
+      });
+  NiceMock<MockOpStatsLogger> opstats_logger;
+  NiceMock<MockFlags> flags;
+  ON_CALL(flags, enable_lightweight_client_report_wire_format())
+      .WillByDefault(Return(use_lightweight_wire_format));
+  ExampleQueryPlanEngine plan_engine(
+      {&example_iterator_factory}, &opstats_logger, &flags,
+      /*example_iterator_query_recorder=*/nullptr);
+
+  for (auto s : state) {
+    PlanResult result = plan_engine.RunPlan(spec, output_checkpoint_filename);
+    FCP_CHECK(result.outcome == PlanOutcome::kSuccess)
+        << result.original_status;
+    benchmark::DoNotOptimize(result.federated_compute_checkpoint);
+  }
+  state.SetItemsProcessed(state.iterations() * num_rows);
+  state.SetBytesProcessed(state.iterations() * example.size());
+}
+
+BENCHMARK(BM_RunPlan)
+    ->ArgsProduct({{1000, 100000, 1000000, 10000000}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace engine
+}  // namespace client
+}  // namespace fcp
@@ -33,10 +33,15 @@
 #include "absl/strings/cord.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "fcp/client/client_runner.h"
 #include "fcp/client/engine/common.h"
 #include "fcp/client/engine/example_iterator_factory.h"
+#include "fcp/client/example_iterator_query_recorder.h"
 #include "fcp/client/example_query_result.pb.h"
+#include "fcp/client/selector_context.pb.h"
 #include "fcp/client/simple_task_environment.h"
 #include "fcp/client/test_helpers.h"
 #include "fcp/protos/plan.pb.h"
@@ -164,6 +169,55 @@ class TwoExampleIteratorsFactory : public ExampleIteratorFactory {
   std::string second_collection_uri_;
 };
 
+// MockFlags which allow example queries to run concurrently.
+class ParallelExampleQueriesMockFlags : public MockFlags {
+ public:
+  int32_t example_query_parallelism() const override { return 2; }
+};
+
+// Tracks how many example queries have started reading results.
+struct QueryRendezvous {
+  absl::Mutex mu;
+  int num_started ABSL_GUARDED_BY(mu) = 0;
+};
+
+// An iterator which, before returning its first example, waits until
+// `num_queries` iterators sharing the same rendezvous have been read from.
+class RendezvousExampleIterator : public ExampleIterator {
+ public:
+  RendezvousExampleIterator(std::unique_ptr<ExampleIterator> iterator,
+                            QueryRendezvous* rendezvous, int num_queries)
+      : iterator_(std::move(iterator)),
+        rendezvous_(rendezvous),
+        num_queries_(num_queries) {}
+
+  absl::StatusOr<std::string> Next() override {
+    if (!waited_) {
+      waited_ = true;
+      absl::MutexLock lock(&rendezvous_->mu);
+      rendezvous_->num_started++;
+      auto all_started = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(
+                             rendezvous_->mu) {
+        return rendezvous_->num_started == num_queries_;
+      };
+      if (!rendezvous_->mu.AwaitWithTimeout(absl::Condition(&all_started),
+                                            absl::Seconds(10))) {
+        return absl::DeadlineExceededError(
+            "Example queries weren't run concurrently");
+      }
+    }
+    return iterator_->Next();
+  }
+
+  void Close() override { iterator_->Close(); }
+
+ private:
+  std::unique_ptr<ExampleIterator> iterator_;
+  QueryRendezvous* rendezvous_;
+  const int num_queries_;
+  bool waited_ = false;
+};
+
 absl::StatusOr<absl::flat_hash_map<std::string, tf::Tensor>> ReadTensors(
     std::string checkpoint_path) {
   absl::flat_hash_map<std::string, tf::Tensor> tensors;
@@ -306,6 +360,46 @@ TEST_F(ExampleQueryPlanEngineTest, PlanSucceeds) {
   }
 }
 
+TEST_F(ExampleQueryPlanEngineTest, PlanSucceedsWithBytesValues) {
+  Initialize();
+  (*client_only_plan_.mutable_phase()
+        ->mutable_example_query_spec()
+        ->mutable_example_queries(0)
+        ->mutable_output_vector_specs())[kOutputStringTensorName]
+      .set_data_type(ExampleQuerySpec::OutputVectorSpec::BYTES);
+  ExampleQueryResult::VectorData::Values bytes_values;
+  bytes_values.mutable_bytes_values()->add_value(std::string("\x00\x01", 2));
+  bytes_values.mutable_bytes_values()->add_value("bytes");
+  (*example_query_result_.mutable_vector_data()
+        ->mutable_vectors())[kOutputStringVectorName] = bytes_values;
+  std::string example = example_query_result_.SerializeAsString();
+  dataset_.mutable_client_data(0)->set_example(0, example);
+
+  EXPECT_CALL(mock_opstats_logger_,
+              UpdateDatasetStats(kCollectionUri, num_examples_,
+                                 static_cast<int64_t>(example.size())));
+  EXPECT_CALL(mock_flags_, enable_lightweight_client_report_wire_format())
+      .WillOnce(testing::Return(false));
+  ExampleQueryPlanEngine plan_engine(
+      {example_iterator_factory_.get()}, &mock_opstats_logger_, &mock_flags_,
+      /*example_iterator_query_recorder=*/nullptr);
+  engine::PlanResult result =
+      plan_engine.RunPlan(client_only_plan_.phase().example_query_spec(),
+                          output_checkpoint_filename_);
+
+  EXPECT_THAT(result.outcome, PlanOutcome::kSuccess);
+
+  auto tensors = ReadTensors(output_checkpoint_filename_);
+  ASSERT_OK(tensors);
+  tf::Tensor bytes_tensor = tensors.value()[kOutputStringTensorName];
+  ASSERT_EQ(bytes_tensor.shape(), tf::TensorShape({2}));
+  ASSERT_EQ(bytes_tensor.dtype(), tf::DT_STRING);
+  auto bytes_data = static_cast<tf::tstring*>(bytes_tensor.data());
+  EXPECT_EQ(static_cast<std::string>(bytes_data[0]),
+            std::string("\x00\x01", 2));
+  EXPECT_EQ(static_cast<std::string>(bytes_data[1]), "bytes");
+}
+
 TEST_F(ExampleQueryPlanEngineTest, MultipleQueries) {
   Initialize();
 
@@ -420,6 +514,147 @@ TEST_F(ExampleQueryPlanEngineTest, MultipleQueries) {
             "another_string_value");
 }
 
+TEST_F(ExampleQueryPlanEngineTest, MultipleQueriesRunConcurrently) {
+  Initialize();
+
+  ExampleQuerySpec::OutputVectorSpec float_vector_spec;
+  float_vector_spec.set_vector_name("float_vector");
+  float_vector_spec.set_data_type(ExampleQuerySpec::OutputVectorSpec::FLOAT);
+  ExampleQuerySpec::ExampleQuery second_example_query;
+  second_example_query.mutable_example_selector()->set_collection_uri(
+      "app:/second_collection");
+  (*second_example_query.mutable_output_vector_specs())["float_tensor"] =
+      float_vector_spec;
+  client_only_plan_.mutable_phase()
+      ->mutable_example_query_spec()
+      ->mutable_example_queries()
+      ->Add(std::move(second_example_query));
+
+  ExampleQueryResult second_example_query_result;
+  ExampleQueryResult::VectorData::Values float_values;
+  float_values.mutable_float_values()->add_value(0.24f);
+  (*second_example_query_result.mutable_vector_data()
+        ->mutable_vectors())["float_vector"] = float_values;
+  Dataset::ClientDataset dataset;
+  dataset.set_client_id("second_client_id");
+  dataset.add_example(second_example_query_result.SerializeAsString());
+  Dataset second_dataset;
+  second_dataset.mutable_client_data()->Add(std::move(dataset));
+
+  // Each query's iterator blocks until both queries have started, so the plan
+  // only succeeds if the queries are run concurrently. Each collection is
+  // served by its own factory, since queries on the same factory aren't run
+  // concurrently.
+  QueryRendezvous rendezvous;
+  FunctionalExampleIteratorFactory first_factory(
+      [](const ExampleSelector& selector) {
+        return selector.collection_uri() == kCollectionUri;
+      },
+      [&dataset = dataset_, &rendezvous](const ExampleSelector& selector) {
+        return std::make_unique<RendezvousExampleIterator>(
+            std::make_unique<SimpleExampleIterator>(dataset), &rendezvous,
+            /*num_queries=*/2);
+      },
+      /*should_collect_stats=*/false);
+  FunctionalExampleIteratorFactory second_factory(
+      [](const ExampleSelector& selector) {
+        return selector.collection_uri() == "app:/second_collection";
+      },
+      [&dataset = second_dataset,
+       &rendezvous](const ExampleSelector& selector) {
+        return std::make_unique<RendezvousExampleIterator>(
+            std::make_unique<SimpleExampleIterator>(dataset), &rendezvous,
+            /*num_queries=*/2);
+      },
+      /*should_collect_stats=*/false);
+
+  StrictMock<ParallelExampleQueriesMockFlags> mock_flags;
+  EXPECT_CALL(mock_flags, enable_lightweight_client_report_wire_format())
+      .WillOnce(testing::Return(false));
+
+  ExampleIteratorQueryRecorderImpl query_recorder{SelectorContext()};
+  ExampleQueryPlanEngine plan_engine({&first_factory, &second_factory},
+                                     &mock_opstats_logger_, &mock_flags,
+                                     &query_recorder);
+  engine::PlanResult result =
+      plan_engine.RunPlan(client_only_plan_.phase().example_query_spec(),
+                          output_checkpoint_filename_);
+
+  ASSERT_THAT(result.outcome, PlanOutcome::kSuccess);
+
+  // Queries are recorded in plan order, regardless of which finished first.
+  ExampleIteratorQueries queries = query_recorder.StopRecordingAndGetQueries();
+  ASSERT_EQ(queries.query_size(), 2);
+  EXPECT_EQ(queries.query(0).collection_uri(), kCollectionUri);
+  EXPECT_EQ(queries.query(1).collection_uri(), "app:/second_collection");
+
+  auto tensors = ReadTensors(output_checkpoint_filename_);
+  ASSERT_OK(tensors);
+  tf::Tensor int_tensor = tensors.value()[kOutputIntTensorName];
+  ASSERT_EQ(int_tensor.shape(), tf::TensorShape({2}));
+  tf::Tensor float_tensor = tensors.value()["float_tensor"];
+  ASSERT_EQ(float_tensor.shape(), tf::TensorShape({1}));
+  ASSERT_EQ(static_cast<float*>(float_tensor.data())[0], 0.24f);
+}
+
+TEST_F(ExampleQueryPlanEngineTest, QueriesOnSameFactoryRunOneAfterAnother) {
+  Initialize();
+  ExampleQuerySpec::ExampleQuery example_query =
+      client_only_plan_.phase().example_query_spec().example_queries(0);
+  (*example_query.mutable_output_vector_specs())["another_string_tensor"] =
+      example_query.output_vector_specs().at(kOutputStringTensorName);
+  example_query.mutable_output_vector_specs()->erase(kOutputStringTensorName);
+  example_query.mutable_output_vector_specs()->erase(kOutputIntTensorName);
+  client_only_plan_.mutable_phase()
+      ->mutable_example_query_spec()
+      ->mutable_example_queries()
+      ->Add(std::move(example_query));
+
+  // Both queries are served by the first factory, which records whether they
+  // ever overlap. The second factory only serves to enable parallelism.
+  absl::Mutex mu;
+  int num_active_queries = 0;
+  bool overlapped = false;
+  FunctionalExampleIteratorFactory first_factory(
+      [](const ExampleSelector& selector) { return true; },
+      [&dataset = dataset_, &mu, &num_active_queries,
+       &overlapped](const ExampleSelector& selector)
+          -> absl::StatusOr<std::unique_ptr<ExampleIterator>> {
+        {
+          absl::MutexLock lock(&mu);
+          overlapped |= ++num_active_queries > 1;
+        }
+        // Give an overlapping query time to start.
+        absl::SleepFor(absl::Milliseconds(50));
+        absl::MutexLock lock(&mu);
+        --num_active_queries;
+        return std::make_unique<SimpleExampleIterator>(dataset);
+      },
+      /*should_collect_stats=*/false);
+  FunctionalExampleIteratorFactory second_factory(
+      [](const ExampleSelector& selector) { return false; },
+      [](const ExampleSelector& selector)
+          -> absl::StatusOr<std::unique_ptr<ExampleIterator>> {
+        return absl::InternalError("Unexpected query");
+      },
+      /*should_collect_stats=*/false);
+
+  StrictMock<ParallelExampleQueriesMockFlags> mock_flags;
+  EXPECT_CALL(mock_flags, enable_lightweight_client_report_wire_format())
+      .WillOnce(testing::Return(false));
+
+  ExampleQueryPlanEngine plan_engine(
+      {&first_factory, &second_factory}, &mock_opstats_logger_, &mock_flags,
+      /*example_iterator_query_recorder=*/nullptr);
+  engine::PlanResult result =
+      plan_engine.RunPlan(client_only_plan_.phase().example_query_spec(),
+                          output_checkpoint_filename_);
+
+  ASSERT_THAT(result.outcome, PlanOutcome::kSuccess);
+  absl::MutexLock lock(&mu);
+  EXPECT_FALSE(overlapped);
+}
+
 TEST_F(ExampleQueryPlanEngineTest, OutputVectorSpecMissingInResult) {
   Initialize();
 
@@ -75,17 +75,19 @@ class TrainingDatasetProvider
       ExampleIteratorQueryRecorder* example_iterator_query_recorder,
       std::atomic<int>* total_example_count,
       std::atomic<int64_t>* total_example_size_bytes,
-      ExampleIteratorStatus* example_iterator_status)
+      ExampleIteratorStatus* example_iterator_status,
+      const ExternalDatasetPrefetchOptions& prefetch_options)
       : example_iterator_factories_(example_iterator_factories),
         opstats_logger_(opstats_logger),
         example_iterator_query_recorder_(example_iterator_query_recorder),
         total_example_count_(total_example_count),
         total_example_size_bytes_(total_example_size_bytes),
-        example_iterator_status_(example_iterator_status) {}
+        example_iterator_status_(example_iterator_status),
+        prefetch_options_(prefetch_options) {}
 
   absl::StatusOr<std::unique_ptr<ExternalDataset>> MakeDataset(
       ExampleSelector selector) final {
-    return ExternalDataset::FromFunction(
+    std::unique_ptr<ExternalDataset> dataset = ExternalDataset::FromFunction(
         [example_iterator_factories = example_iterator_factories_,
          opstats_logger = opstats_logger_,
          example_iterator_query_recorder = example_iterator_query_recorder_,
@@ -124,6 +126,7 @@ class TrainingDatasetProvider
               /*collect_stats=*/
               example_iterator_factory->ShouldCollectStats());
         });
+    return WithPrefetching(std::move(dataset), prefetch_options_);
   }
 
  private:
@@ -133,6 +136,7 @@ class TrainingDatasetProvider
   std::atomic<int>* total_example_count_;
   std::atomic<int64_t>* total_example_size_bytes_;
   ExampleIteratorStatus* example_iterator_status_;
+  const ExternalDatasetPrefetchOptions prefetch_options_;
 };
 
 }  // namespace
@@ -173,28 +177,50 @@ absl::StatusOr<std::string> DatasetIterator::GetNext() {
     return absl::OutOfRangeError("End of iterator reached");
   }
   absl::StatusOr<std::string> example = example_iterator_->Next();
-  absl::StatusCode error_code = example.status().code();
-  example_iterator_status_->SetStatus(example.status());
-  if (error_code == absl::StatusCode::kOutOfRange) {
+  OnIteratorStatus(example.status());
+  if (example.ok()) {
+    OnElementsConsumed(1, example->size());
+  }
+  return example;
+}
+
+absl::Status DatasetIterator::GetNextBatch(int max_elements,
+                                           std::vector<std::string>& elements) {
+  absl::MutexLock locked(&iterator_lock_);
+  if (iterator_finished_) {
+    return absl::OutOfRangeError("End of iterator reached");
+  }
+  absl::Status status = example_iterator_->NextBatch(max_elements, elements);
+  OnIteratorStatus(status);
+  return status;
+}
+
+void DatasetIterator::Cancel() { example_iterator_->Cancel(); }
+
+void DatasetIterator::OnIteratorStatus(const absl::Status& status) {
+  example_iterator_status_->SetStatus(status);
+  if (status.code() == absl::StatusCode::kOutOfRange) {
     example_iterator_->Close();
     iterator_finished_ = true;
   }
-  if (example.ok()) {
-    if (single_query_recorder_) {
+}
+
+void DatasetIterator::OnElementsConsumed(int num_elements,
+                                         int64_t size_bytes) {
+  if (single_query_recorder_) {
+    for (int i = 0; i < num_elements; ++i) {
       single_query_recorder_->Increment();
     }
-    // If we're not forwarding an OUT_OF_RANGE to the caller, record example
-    // stats for metrics logging.
-    if (collect_stats_) {
-      // TODO: b/184863488 - Consider reducing logic duplication in
-      // cross-dataset and single-dataset example stat variables.
-      *total_example_count_ += 1;
-      *total_example_size_bytes_ += example->size();
-      example_count_ += 1;
-      example_size_bytes_ += example->size();
-    }
   }
-  return example;
+  // Record example stats for metrics logging.
+  if (collect_stats_) {
+    // TODO: b/184863488 - Consider reducing logic duplication in
+    // cross-dataset and single-dataset example stat variables.
+    *total_example_count_ += num_elements;
+    *total_example_size_bytes_ += size_bytes;
+    example_count_ += num_elements;
+    example_size_bytes_ += size_bytes;
+  }
 }
 
 void ExampleIteratorStatus::SetStatus(absl::Status status) {
@@ -221,14 +247,16 @@ HostObjectRegistration AddDatasetTokenToInputs(
     const std::string& dataset_token_tensor_name,
     std::atomic<int>* total_example_count,
     std::atomic<int64_t>* total_example_size_bytes,
-    ExampleIteratorStatus* example_iterator_status) {
+    ExampleIteratorStatus* example_iterator_status,
+    const ExternalDatasetPrefetchOptions& prefetch_options) {
   // Register the TrainingDatasetProvider with the global
   // ExternalDatasetProviderRegistry.
   auto host_registration = fcp::ExternalDatasetProviderRegistry::Register(
       std::make_shared<TrainingDatasetProvider>(
           example_iterator_factories, opstats_logger,
           example_iterator_query_recorder, total_example_count,
-          total_example_size_bytes, example_iterator_status));
+          total_example_size_bytes, example_iterator_status,
+          prefetch_options));
   // Pack the token returned from registering the provider into a string
   // tensor. TensorFlow will use that token via the ExternalDatasetOp to create
   // datasets and iterators.
@@ -249,14 +277,16 @@ HostObjectRegistration AddDatasetTokenToInputsForTfLite(
     const std::string& dataset_token_tensor_name,
     std::atomic<int>* total_example_count,
     std::atomic<int64_t>* total_example_size_bytes,
-    ExampleIteratorStatus* example_iterator_status) {
+    ExampleIteratorStatus* example_iterator_status,
+    const ExternalDatasetPrefetchOptions& prefetch_options) {
   // Registers the TrainingDatasetProvider with the global
   // ExternalDatasetProviderRegistry.
   auto host_registration = fcp::ExternalDatasetProviderRegistry::Register(
       std::make_shared<TrainingDatasetProvider>(
           example_iterator_factories, opstats_logger,
           example_iterator_query_recorder, total_example_count,
-          total_example_size_bytes, example_iterator_status));
+          total_example_size_bytes, example_iterator_status,
+          prefetch_options));
   // Adds the token returned from registering the provider to the map of inputs.
   // TfLite will use that token via the ExternalDatasetOp to create
   // datasets and iterators.
@@ -264,6 +294,15 @@ HostObjectRegistration AddDatasetTokenToInputsForTfLite(
   return host_registration;
 }
 
+ExternalDatasetPrefetchOptions GetExampleDatasetPrefetchOptions(
+    const Flags& flags) {
+  // DatasetIterator serializes the calls to the example iterator, which isn't
+  // required to be thread-safe, so more than one thread per dataset wouldn't
+  // read any more examples at a time.
+  return {.buffer_size = flags.example_prefetch_buffer_size(),
+          .num_threads = 1};
+}
+
 std::unique_ptr<::fcp::client::opstats::OpStatsLogger> CreateOpStatsLogger(
     const std::string& base_dir, const Flags* flags, LogManager* log_manager,
     const std::string& session_name, const std::string& population_name) {
@@ -39,6 +39,7 @@
 #include "fcp/client/simple_task_environment.h"
 #include "fcp/tensorflow/external_dataset.h"
 #include "fcp/tensorflow/host_object.h"
+#include "fcp/tensorflow/prefetching_external_dataset.h"
 #include "tensorflow/core/framework/tensor.h"
 
 // On Error Handling
@@ -114,9 +115,26 @@ class DatasetIterator : public ExternalDatasetIterator {
   // Returns the next entry from the dataset.
   absl::StatusOr<std::string> GetNext() final;
 
+  // Returns up to `max_elements` entries from the dataset, taking the iterator
+  // lock once per batch. The entries are only counted in the example stats once
+  // they're reported through OnElementsConsumed().
+  absl::Status GetNextBatch(int max_elements,
+                            std::vector<std::string>& elements) final;
+
+  // Updates the example stats for entries returned by GetNextBatch().
+  void OnElementsConsumed(int num_elements, int64_t size_bytes) final;
+
+  // Forwards the cancellation to the example iterator, without waiting for the
+  // iterator lock, which a blocked GetNext() or GetNextBatch() call holds.
+  void Cancel() final;
+
  private:
-  std::unique_ptr<ExampleIterator> example_iterator_
-      ABSL_GUARDED_BY(iterator_lock_);
+  // Updates the iterator status after the example iterator returned `status`.
+  void OnIteratorStatus(const absl::Status& status)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(iterator_lock_);
+
+  // Only called with `iterator_lock_` held, except for Cancel().
+  const std::unique_ptr<ExampleIterator> example_iterator_;
   opstats::OpStatsLogger* opstats_logger_;
   SingleExampleIteratorQueryRecorder* single_query_recorder_;
   absl::Time iterator_start_time_;
@@ -140,7 +158,9 @@ class DatasetIterator : public ExternalDatasetIterator {
 // For each example query issued by the plan at runtime, the given
 // `example_iterator_factories` parameter will be iterated and the first
 // iterator factory that can handle the given query will be used to create the
-// example iterator to handle that query.
+// example iterator to handle that query. If prefetching is enabled by
+// `prefetch_options`, examples are read ahead of the plan on background
+// threads.
 HostObjectRegistration AddDatasetTokenToInputs(
     std::vector<ExampleIteratorFactory*> example_iterator_factories,
     ::fcp::client::opstats::OpStatsLogger* opstats_logger,
@@ -149,7 +169,8 @@ HostObjectRegistration AddDatasetTokenToInputs(
     const std::string& dataset_token_tensor_name,
     std::atomic<int>* total_example_count,
     std::atomic<int64_t>* total_example_size_bytes,
-    ExampleIteratorStatus* example_iterator_status);
+    ExampleIteratorStatus* example_iterator_status,
+    const ExternalDatasetPrefetchOptions& prefetch_options = {});
 
 // Sets up an ExternalDatasetProvider that is registered with the global
 // HostObjectRegistry. Adds a string representing the HostObjectRegistration
@@ -159,7 +180,9 @@ HostObjectRegistration AddDatasetTokenToInputs(
 // For each example query issued by the plan at runtime, the given
 // `example_iterator_factories` parameter will be iterated and the first
 // iterator factory that can handle the given query will be used to create the
-// example iterator to handle that query.
+// example iterator to handle that query. If prefetching is enabled by
+// `prefetch_options`, examples are read ahead of the plan on background
+// threads.
 HostObjectRegistration AddDatasetTokenToInputsForTfLite(
     std::vector<ExampleIteratorFactory*> example_iterator_factories,
     ::fcp::client::opstats::OpStatsLogger* opstats_logger,
@@ -168,7 +191,13 @@ HostObjectRegistration AddDatasetTokenToInputsForTfLite(
     const std::string& dataset_token_tensor_name,
     std::atomic<int>* total_example_count,
     std::atomic<int64_t>* total_example_size_bytes,
-    ExampleIteratorStatus* example_iterator_status);
+    ExampleIteratorStatus* example_iterator_status,
+    const ExternalDatasetPrefetchOptions& prefetch_options = {});
+
+// Returns the options for prefetching examples from the datasets of a plan, as
+// configured by `flags`.
+ExternalDatasetPrefetchOptions GetExampleDatasetPrefetchOptions(
+    const Flags& flags);
 
 // If opstats is enabled, this method attempts to create an opstats logger
 // backed by a database within base_dir and prepares to record information for a
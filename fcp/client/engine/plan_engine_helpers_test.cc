@@ -0,0 +1,157 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fcp/client/engine/plan_engine_helpers.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "fcp/client/example_iterator_query_recorder.h"
+#include "fcp/client/simple_task_environment.h"
+#include "fcp/client/test_helpers.h"
+#include "fcp/tensorflow/external_dataset.h"
+#include "fcp/tensorflow/prefetching_external_dataset.h"
+#include "fcp/testing/testing.h"
+
+namespace fcp::client::engine {
+namespace {
+
+using ::google::internal::federated::plan::ExampleSelector;
+using ::testing::ElementsAre;
+using ::testing::StrictMock;
+
+// Blocks in Next() until cancelled.
+class BlockingExampleIterator : public ExampleIterator {
+ public:
+  absl::StatusOr<std::string> Next() override {
+    blocked_.Notify();
+    absl::MutexLock lock(&mu_);
+    mu_.Await(absl::Condition(&cancelled_));
+    return absl::CancelledError("");
+  }
+
+  void Cancel() override {
+    absl::MutexLock lock(&mu_);
+    cancelled_ = true;
+  }
+
+  void Close() override {}
+
+  void WaitUntilBlocked() { blocked_.WaitForNotification(); }
+
+ private:
+  absl::Notification blocked_;
+  absl::Mutex mu_;
+  bool cancelled_ ABSL_GUARDED_BY(mu_) = false;
+};
+
+class DatasetIteratorTest : public testing::Test {
+ protected:
+  std::unique_ptr<DatasetIterator> CreateDatasetIterator(
+      std::unique_ptr<ExampleIterator> example_iterator) {
+    return std::make_unique<DatasetIterator>(
+        std::move(example_iterator), /*opstats_logger=*/nullptr,
+        /*single_query_recorder=*/nullptr, &total_example_count_,
+        &total_example_size_bytes_, &example_iterator_status_,
+        "app:/test_collection", /*collect_stats=*/false);
+  }
+
+  std::atomic<int> total_example_count_ = 0;
+  std::atomic<int64_t> total_example_size_bytes_ = 0;
+  ExampleIteratorStatus example_iterator_status_;
+};
+
+TEST_F(DatasetIteratorTest, BatchedExamplesAreCountedOnceConsumed) {
+  StrictMock<MockOpStatsLogger> opstats_logger;
+  ExampleSelector selector;
+  selector.set_collection_uri("app:/test_collection");
+  SingleExampleIteratorQueryRecorderImpl query_recorder(selector);
+  auto iterator = std::make_unique<DatasetIterator>(
+      std::make_unique<SimpleExampleIterator>(
+          std::vector<const char*>{"a", "bb", "ccc"}),
+      &opstats_logger, &query_recorder, &total_example_count_,
+      &total_example_size_bytes_, &example_iterator_status_,
+      selector.collection_uri(), /*collect_stats=*/true);
+
+  std::vector<std::string> elements;
+  EXPECT_OK(iterator->GetNextBatch(3, elements));
+  EXPECT_THAT(elements, ElementsAre("a", "bb", "ccc"));
+  // Elements read ahead aren't counted until the caller reports them.
+  EXPECT_EQ(total_example_count_, 0);
+  EXPECT_EQ(total_example_size_bytes_, 0);
+
+  iterator->OnElementsConsumed(2, 3);
+  EXPECT_EQ(total_example_count_, 2);
+  EXPECT_EQ(total_example_size_bytes_, 3);
+  EXPECT_EQ(query_recorder.FinishRecordingAndGet().example_count(), 2);
+
+  EXPECT_CALL(opstats_logger,
+              UpdateDatasetStats("app:/test_collection", 2, 3));
+  iterator.reset();
+}
+
+TEST_F(DatasetIteratorTest, CancelIsForwardedToExampleIterator) {
+  auto example_iterator = std::make_unique<BlockingExampleIterator>();
+  BlockingExampleIterator* blocking_iterator = example_iterator.get();
+  std::unique_ptr<DatasetIterator> iterator =
+      CreateDatasetIterator(std::move(example_iterator));
+
+  absl::StatusOr<std::string> element;
+  std::thread consumer([&iterator, &element]() {
+    element = iterator->GetNext();
+  });
+  blocking_iterator->WaitUntilBlocked();
+  // GetNext() holds the iterator lock while it is blocked, so this must not
+  // wait for it.
+  iterator->Cancel();
+  consumer.join();
+
+  EXPECT_THAT(element, IsCode(absl::StatusCode::kCancelled));
+  EXPECT_THAT(example_iterator_status_.GetStatus(),
+              IsCode(absl::StatusCode::kCancelled));
+}
+
+TEST_F(DatasetIteratorTest, DestroyingPrefetchingIteratorUnblocksProducer) {
+  BlockingExampleIterator* blocking_iterator = nullptr;
+  std::unique_ptr<ExternalDataset> dataset = WithPrefetching(
+      ExternalDataset::FromFunction([this, &blocking_iterator]() {
+        auto example_iterator = std::make_unique<BlockingExampleIterator>();
+        blocking_iterator = example_iterator.get();
+        return CreateDatasetIterator(std::move(example_iterator));
+      }),
+      {.buffer_size = 4});
+
+  std::unique_ptr<ExternalDatasetIterator> iterator = dataset->MakeIterator();
+  blocking_iterator->WaitUntilBlocked();
+  // The destructor waits for the producer thread, which only returns once the
+  // cancellation has reached the example iterator.
+  iterator.reset();
+}
+
+}  // namespace
+}  // namespace fcp::client::engine
@@ -54,13 +54,15 @@ SimplePlanEngine::SimplePlanEngine(
     std::function<bool()> should_abort, LogManager* log_manager,
     OpStatsLogger* opstats_logger,
     ExampleIteratorQueryRecorder* example_iterator_query_recorder,
-    const InterruptibleRunner::TimingConfig* timing_config)
+    const InterruptibleRunner::TimingConfig* timing_config,
+    const ExternalDatasetPrefetchOptions& prefetch_options)
     : example_iterator_factories_(example_iterator_factories),
       should_abort_(should_abort),
       log_manager_(log_manager),
       opstats_logger_(opstats_logger),
       example_iterator_query_recorder_(example_iterator_query_recorder),
-      timing_config_(timing_config) {}
+      timing_config_(timing_config),
+      prefetch_options_(prefetch_options) {}
 
 PlanResult SimplePlanEngine::RunPlan(
     const TensorflowSpec& tensorflow_spec, const std::string& graph,
@@ -140,7 +142,7 @@ SimplePlanEngine::RunPlanInternal(
       example_iterator_factories_, opstats_logger_,
       example_iterator_query_recorder_, inputs.get(),
       tensorflow_spec.dataset_token_tensor_name(), total_example_count,
-      total_example_size_bytes, example_iterator_status);
+      total_example_size_bytes, example_iterator_status, prefetch_options_);
 
   std::vector<std::string> target_names;
   for (const std::string& target_node_name :
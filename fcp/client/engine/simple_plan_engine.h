@@ -36,6 +36,7 @@
 #include "fcp/client/log_manager.h"
 #include "fcp/client/opstats/opstats_logger.h"
 #include "fcp/protos/plan.pb.h"
+#include "fcp/tensorflow/prefetching_external_dataset.h"
 #include "tensorflow/core/framework/tensor.h"
 
 namespace fcp {
@@ -49,13 +50,15 @@ class SimplePlanEngine {
   // For each example query issued by the plan at runtime, the given
   // `example_iterator_factories` parameter will be iterated and the first
   // iterator factory that can handle the given query will be used to create the
-  // example iterator for that query.
+  // example iterator for that query. Examples are read ahead of the plan if
+  // enabled by `prefetch_options`.
   SimplePlanEngine(
       std::vector<ExampleIteratorFactory*> example_iterator_factories,
       std::function<bool()> should_abort, LogManager* log_manager,
       ::fcp::client::opstats::OpStatsLogger* opstats_logger,
       ExampleIteratorQueryRecorder* example_iterator_query_recorder,
-      const InterruptibleRunner::TimingConfig* timing_config);
+      const InterruptibleRunner::TimingConfig* timing_config,
+      const ExternalDatasetPrefetchOptions& prefetch_options = {});
 
   PlanResult RunPlan(
       const google::internal::federated::plan::TensorflowSpec& tensorflow_spec,
@@ -96,6 +99,7 @@ class SimplePlanEngine {
   ::fcp::client::opstats::OpStatsLogger* opstats_logger_;
   ExampleIteratorQueryRecorder* example_iterator_query_recorder_;
   const InterruptibleRunner::TimingConfig* timing_config_;
+  const ExternalDatasetPrefetchOptions prefetch_options_;
 };
 
 }  // namespace engine
@@ -110,7 +110,8 @@ PlanResult TfLitePlanEngine::RunPlan(
       example_iterator_factories_, opstats_logger_,
       example_iterator_query_recorder_, inputs.get(),
       tensorflow_spec.dataset_token_tensor_name(), &total_example_count,
-      &total_example_size_bytes, &example_iterator_status);
+      &total_example_size_bytes, &example_iterator_status,
+      GetExampleDatasetPrefetchOptions(flags_));
   // If the constant inputs are provided and the flag is enabled, add these to
   // the map of TFLite inputs.
   if (!tensorflow_spec.constant_inputs().empty()) {
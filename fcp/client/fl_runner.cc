@@ -431,7 +431,8 @@ engine::PlanResult RunEligibilityEvalPlanWithTensorflowSpec(
   // Run plan and get a set of output tensors back.
   engine::SimplePlanEngine plan_engine(
       example_iterator_factories, should_abort, log_manager, opstats_logger,
-      /*example_iterator_query_recorder=*/nullptr, &timing_config);
+      /*example_iterator_query_recorder=*/nullptr, &timing_config,
+      engine::GetExampleDatasetPrefetchOptions(*flags));
   return plan_engine.RunPlan(
       client_plan.phase().tensorflow_spec(), client_plan.graph(),
       client_plan.tensorflow_config_proto(), std::move(inputs), output_names);
@@ -601,7 +602,8 @@ PlanResultAndCheckpointFile RunPlanWithTensorflowSpec(
       checkpoint_output_filename);
   engine::SimplePlanEngine plan_engine(
       example_iterator_factories, should_abort, log_manager, opstats_logger,
-      example_iterator_query_recorder, &timing_config);
+      example_iterator_query_recorder, &timing_config,
+      engine::GetExampleDatasetPrefetchOptions(*flags));
   engine::PlanResult plan_result = plan_engine.RunPlan(
       client_plan.phase().tensorflow_spec(), client_plan.graph(),
       client_plan.tensorflow_config_proto(), std::move(inputs), *output_names);
@@ -1252,14 +1254,12 @@ absl::StatusOr<CheckinResult> CreateCheckinResultFromTaskAssignment(
   std::string computation_id;
   if (flags->enable_lightweight_computation_id()) {
     if (plan.phase().has_example_query_spec()) {
-      std::string merged_criteria;
+      Sha256Hasher hasher;
       for (const auto& example_query :
            plan.phase().example_query_spec().example_queries()) {
-        absl::StrAppend(
-            &merged_criteria,
-            example_query.example_selector().criteria().SerializeAsString());
+        hasher.Update(example_query.example_selector().criteria());
       }
-      computation_id = ComputeSHA256(merged_criteria);
+      computation_id = hasher.Finalize();
     }
   } else if (flags->enable_computation_id()) {
     if (std::holds_alternative<std::string>(plan_bytes)) {
@@ -1981,7 +1981,8 @@ absl::StatusOr<FLRunnerResult> RunFederatedComputation(
     absl::StatusOr<std::unique_ptr<cache::ResourceCache>>
         resource_cache_internal = cache::FileBackedResourceCache::Create(
             env_deps->GetBaseDir(), env_deps->GetCacheDir(), log_manager, clock,
-            flags->max_resource_cache_size_bytes());
+            flags->max_resource_cache_size_bytes(),
+            flags->enable_resource_cache_deduplication());
     if (!resource_cache_internal.ok()) {
       auto resource_init_failed_status = absl::Status(
           resource_cache_internal.status().code(),
@@ -166,6 +166,12 @@ class Flags {
     return false;
   }
 
+  // If true, resources downloaded via HTTP URIs are stored in the resource
+  // cache by the digest of their content, so that identical resources are only
+  // stored once, and a resource whose digest is provided by the server can be
+  // served from the cache even if it was cached under a different id.
+  virtual bool enable_resource_cache_deduplication() const { return false; }
+
   // The number of threads that TFLite interpreter will use.
   virtual int32_t num_threads_for_tflite() const { return 2; }
 
@@ -209,6 +215,23 @@ class Flags {
   // determine a number of returned examples.
   virtual bool use_example_query_result_for_data_avail() const { return false; }
 
+  // The number of threads used to evaluate native eligibility policies which
+  // don't depend on each other concurrently. Data availability policies using
+  // the same example store are still evaluated one after another. If this is 1
+  // or less, all policies are evaluated one after another.
+  virtual int32_t eligibility_policy_evaluation_threads() const { return 1; }
+
+  // The number of examples read ahead of a TensorFlow plan, on a background
+  // thread, for each dataset the plan iterates over. If this is 0 or less,
+  // examples are read on the TensorFlow thread when the plan requests them.
+  virtual int32_t example_prefetch_buffer_size() const { return 0; }
+
+  // The maximum number of example queries of an ExampleQuerySpec-based plan
+  // that are run concurrently. Queries served by the same
+  // ExampleIteratorFactory always run one after another. If this is 1 or less,
+  // all queries are run one after another.
+  virtual int32_t example_query_parallelism() const { return 1; }
+
   // If true, federated compute tasks using confidential aggregation will set
   // the correct aggregation type in the selector context.
   virtual bool confidential_agg_in_selector_context() const { return false; }
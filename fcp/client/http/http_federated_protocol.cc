@@ -297,7 +297,8 @@ absl::StatusOr<UriOrInlineData> ConvertResourceToUriOrInlineData(
       }
       return UriOrInlineData::CreateUri(
           resource.uri(), resource.client_cache_id(),
-          TimeUtil::ConvertProtoToAbslDuration(resource.max_age()));
+          TimeUtil::ConvertProtoToAbslDuration(resource.max_age()),
+          resource.sha256_digest());
     case Resource::ResourceCase::kInlineResource: {
       CompressionFormat compression_format = CompressionFormat::kUncompressed;
       if (resource.inline_resource().has_compression_format()) {
@@ -37,6 +37,7 @@
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "fcp/base/compression.h"
+#include "fcp/base/digest.h"
 #include "fcp/base/monitoring.h"
 #include "fcp/client/cache/resource_cache.h"
 #include "fcp/client/http/http_client.h"
@@ -50,28 +51,35 @@ namespace http {
 namespace {
 
 // Returns the resource from the cache, or NOT_FOUND if it was not in the cache.
-// If the resource was compressed, it will be decompressed.
+// If the resource isn't cached under `client_cache_id` but `sha256_digest` is
+// set, then a cached resource with the same content is returned instead. If the
+// resource was compressed, it will be decompressed.
 absl::StatusOr<absl::Cord> TryGetResourceFromCache(
-    absl::string_view client_cache_id,
-    const std::optional<absl::Duration>& max_age,
-    cache::ResourceCache& resource_cache) {
-  FCP_ASSIGN_OR_RETURN(
-      cache::ResourceCache::ResourceAndMetadata cached_resource_and_metadata,
-      resource_cache.Get(client_cache_id, max_age));
+    absl::string_view client_cache_id, absl::string_view sha256_digest,
+    absl::Duration max_age, cache::ResourceCache& resource_cache) {
+  absl::StatusOr<cache::ResourceCache::ResourceAndMetadata>
+      cached_resource_and_metadata =
+          resource_cache.Get(client_cache_id, max_age);
+  if (absl::IsNotFound(cached_resource_and_metadata.status()) &&
+      !sha256_digest.empty()) {
+    cached_resource_and_metadata =
+        resource_cache.GetByDigest(sha256_digest, client_cache_id, max_age);
+  }
+  FCP_RETURN_IF_ERROR(cached_resource_and_metadata);
   HttpResourceMetadata metadata;
-  if (!cached_resource_and_metadata.metadata.UnpackTo(&metadata)) {
+  if (!cached_resource_and_metadata->metadata.UnpackTo(&metadata)) {
     return absl::InternalError("Failed to unpack metadata!");
   }
-  absl::Cord cached_resource = cached_resource_and_metadata.resource;
+  absl::Cord cached_resource = cached_resource_and_metadata->resource;
   if (metadata.compression_format() ==
       ResourceCompressionFormat::RESOURCE_COMPRESSION_FORMAT_GZIP) {
-    FCP_ASSIGN_OR_RETURN(cached_resource,
-                         UncompressWithGzip(std::string(cached_resource)));
+    FCP_ASSIGN_OR_RETURN(cached_resource, UncompressWithGzip(cached_resource));
   }
   return cached_resource;
 }
 
 absl::Status TryPutResourceInCache(absl::string_view client_cache_id,
+                                   absl::string_view sha256_digest,
                                    const absl::Cord& response_body,
                                    bool response_encoded_with_gzip,
                                    absl::Duration max_age,
@@ -88,8 +96,21 @@ absl::Status TryPutResourceInCache(absl::string_view client_cache_id,
   }
   google::protobuf::Any metadata_wrapper;
   metadata_wrapper.PackFrom(metadata);
-  return resource_cache.Put(client_cache_id, response_body, metadata_wrapper,
-                            max_age);
+  if (!resource_cache.SupportsContentAddressedStorage()) {
+    // Don't spend a pass over the resource on a digest that would be ignored.
+    return resource_cache.Put(client_cache_id, response_body, metadata_wrapper,
+                              max_age);
+  }
+  // Store the resource along with the digest of its content, so that it can be
+  // shared with other resources that have the same content. If the server
+  // provided a digest that doesn't match the content, don't trust either.
+  std::string content_digest = ComputeSHA256(response_body);
+  if (!sha256_digest.empty() && sha256_digest != content_digest) {
+    return resource_cache.Put(client_cache_id, response_body, metadata_wrapper,
+                              max_age);
+  }
+  return resource_cache.PutWithDigest(client_cache_id, content_digest,
+                                      response_body, metadata_wrapper, max_age);
 }
 
 }  // namespace
@@ -187,6 +208,16 @@ absl::Status InMemoryHttpRequestCallback::OnResponseStarted(
   }
 
   content_type_ = FindHeader(response.headers(), kContentTypeHdr).value_or("");
+  if (decode_gzip_body_ &&
+      absl::EndsWithIgnoreCase(content_type_, kClientDecodedGzipSuffix)) {
+    absl::StatusOr<std::unique_ptr<GzipDecompressor>> decompressor =
+        GzipDecompressor::Create();
+    if (!decompressor.ok()) {
+      status_ = decompressor.status();
+      return status_;
+    }
+    decompressor_ = *std::move(decompressor);
+  }
 
   // Similarly, we should under no circumstances receive a non-identity
   // Transfer-Encoding header, since the `HttpClient` is unconditionally
@@ -249,12 +280,22 @@ absl::Status InMemoryHttpRequestCallback::OnResponseBody(
 
   // Ensure we're not receiving more data than expected.
   if (expected_content_length_.has_value() &&
-      response_buffer_.size() + data.size() > *expected_content_length_) {
+      received_body_bytes_ + data.size() > *expected_content_length_) {
     status_ = absl::OutOfRangeError(absl::StrCat(
-        "Too much response body data received (rcvd: ", response_buffer_.size(),
+        "Too much response body data received (rcvd: ", received_body_bytes_,
         ", new: ", data.size(), ", max: ", *expected_content_length_, ")"));
     return status_;
   }
+  received_body_bytes_ += data.size();
+
+  if (decompressor_ != nullptr) {
+    // A body which fails to decode only fails this response, once it has been
+    // received, rather than the request, so the rest of it is just dropped.
+    if (decode_status_.ok()) {
+      decode_status_ = decompressor_->Append(data, &response_buffer_);
+    }
+    return absl::OkStatus();
+  }
 
   // Copy the data into the target buffer. Note that this means we'll always
   // store the response body as a number of memory fragments (rather than a
@@ -284,15 +325,22 @@ void InMemoryHttpRequestCallback::OnResponseCompleted(
   // Note: the case when too *much* response data is unexpectedly received is
   // handled in OnResponseBody (while this handles the case of too little data).
   if (expected_content_length_.has_value() &&
-      response_buffer_.size() != *expected_content_length_) {
+      received_body_bytes_ != *expected_content_length_) {
     status_ = absl::InvalidArgumentError(
         absl::StrCat("Too little response body data received (rcvd: ",
-                     response_buffer_.size(),
+                     received_body_bytes_,
                      ", expected: ", *expected_content_length_, ")"));
     return;
   }
 
   status_ = ConvertHttpCodeToStatus(*response_code_);
+  if (status_.ok() && decompressor_ != nullptr) {
+    if (decode_status_.ok()) {
+      decode_status_ = decompressor_->Finish();
+    }
+    status_ = decode_status_;
+    decompressor_.reset();
+  }
 }
 
 absl::StatusOr<InMemoryHttpResponse> InMemoryHttpRequestCallback::Response()
@@ -322,11 +370,17 @@ absl::StatusOr<InMemoryHttpResponse> PerformRequestInMemory(
   return std::move(result[0]);
 }
 
+namespace {
+
+// Performs the given requests, delivering the response of each request to the
+// callback at the same index in `callbacks`.
 absl::StatusOr<std::vector<absl::StatusOr<InMemoryHttpResponse>>>
-PerformMultipleRequestsInMemory(
+PerformMultipleRequestsWithCallbacks(
     HttpClient& http_client, InterruptibleRunner& interruptible_runner,
     std::vector<std::unique_ptr<http::HttpRequest>> requests,
+    std::vector<std::unique_ptr<InMemoryHttpRequestCallback>> callbacks,
     int64_t* bytes_received_acc, int64_t* bytes_sent_acc) {
+  FCP_CHECK(requests.size() == callbacks.size());
   // A vector that will own the request handles and callbacks (and will
   // determine their lifetimes).
   std::vector<std::pair<std::unique_ptr<HttpRequestHandle>,
@@ -340,15 +394,15 @@ PerformMultipleRequestsInMemory(
       handles_and_callbacks_ptrs;
   handles_and_callbacks_ptrs.reserve(requests.size());
 
-  // Enqueue each request, and create a simple callback for each request which
-  // will simply buffer the response body in-memory and allow us to consume that
-  // buffer once all requests have finished.
-  for (std::unique_ptr<HttpRequest>& request : requests) {
+  // Enqueue each request, and pair it with its callback, which will buffer the
+  // response body in-memory and allow us to consume that buffer once all
+  // requests have finished.
+  for (size_t i = 0; i < requests.size(); ++i) {
     std::unique_ptr<HttpRequestHandle> handle =
-        http_client.EnqueueRequest(std::move(request));
-    auto callback = std::make_unique<InMemoryHttpRequestCallback>();
-    handles_and_callbacks_ptrs.push_back({handle.get(), callback.get()});
-    handles_and_callbacks.push_back({std::move(handle), std::move(callback)});
+        http_client.EnqueueRequest(std::move(requests[i]));
+    handles_and_callbacks_ptrs.push_back({handle.get(), callbacks[i].get()});
+    handles_and_callbacks.push_back(
+        {std::move(handle), std::move(callbacks[i])});
   }
 
   // Issue the requests in one call (allowing the HttpClient to issue them
@@ -390,6 +444,23 @@ PerformMultipleRequestsInMemory(
   return results;
 }
 
+}  // namespace
+
+absl::StatusOr<std::vector<absl::StatusOr<InMemoryHttpResponse>>>
+PerformMultipleRequestsInMemory(
+    HttpClient& http_client, InterruptibleRunner& interruptible_runner,
+    std::vector<std::unique_ptr<http::HttpRequest>> requests,
+    int64_t* bytes_received_acc, int64_t* bytes_sent_acc) {
+  std::vector<std::unique_ptr<InMemoryHttpRequestCallback>> callbacks;
+  callbacks.reserve(requests.size());
+  for (size_t i = 0; i < requests.size(); ++i) {
+    callbacks.push_back(std::make_unique<InMemoryHttpRequestCallback>());
+  }
+  return PerformMultipleRequestsWithCallbacks(
+      http_client, interruptible_runner, std::move(requests),
+      std::move(callbacks), bytes_received_acc, bytes_sent_acc);
+}
+
 absl::StatusOr<std::vector<absl::StatusOr<InMemoryHttpResponse>>>
 FetchResourcesInMemory(HttpClient& http_client,
                        InterruptibleRunner& interruptible_runner,
@@ -409,6 +480,9 @@ FetchResourcesInMemory(HttpClient& http_client,
     std::function<absl::StatusOr<InMemoryHttpResponse>()> accessor;
     std::string client_cache_id;
     absl::Duration max_age;
+    std::string sha256_digest;
+    // Whether a gzip-encoded body was already decoded as it was received.
+    bool body_decoded = false;
   };
   std::vector<AccessorAndCacheMetadata> response_accessors;
 
@@ -416,6 +490,7 @@ FetchResourcesInMemory(HttpClient& http_client,
   // fetched, then we'll fire them off all at once, and then we'll gather their
   // responses once all requests have finished.
   std::vector<std::unique_ptr<http::HttpRequest>> http_requests;
+  std::vector<std::unique_ptr<InMemoryHttpRequestCallback>> http_callbacks;
   std::vector<absl::StatusOr<InMemoryHttpResponse>> http_responses;
   bool caching_enabled = resource_cache != nullptr;
 
@@ -425,8 +500,9 @@ FetchResourcesInMemory(HttpClient& http_client,
       // condition happens outside the happy path, fetch the resource normally.
       if (caching_enabled && !resource.uri().client_cache_id.empty()) {
         absl::StatusOr<absl::Cord> cached_resource =
-            TryGetResourceFromCache(resource.uri().client_cache_id,
-                                    resource.uri().max_age, *resource_cache);
+            TryGetResourceFromCache(
+                resource.uri().client_cache_id, resource.uri().sha256_digest,
+                resource.uri().max_age, *resource_cache);
         if (cached_resource.ok()) {
           // Resource was successfully fetched from the cache, so we do not set
           // the client_cache_id or the max_age.
@@ -454,15 +530,24 @@ FetchResourcesInMemory(HttpClient& http_client,
       auto response_accessing_fn = [&http_responses, response_index]() {
         return std::move(http_responses.at(response_index));
       };
-      if (caching_enabled) {
+      if (caching_enabled && !resource.uri().client_cache_id.empty()) {
         // We didn't load the resource from the cache, so set the
-        // client_cache_id and max_age in the response_accessor.
+        // client_cache_id and max_age in the response_accessor. The encoded
+        // body is what gets cached, so it is only decoded once received.
+        http_callbacks.push_back(
+            std::make_unique<InMemoryHttpRequestCallback>());
         response_accessors.push_back(
             {.accessor = response_accessing_fn,
              .client_cache_id = std::string(resource.uri().client_cache_id),
-             .max_age = resource.uri().max_age});
+             .max_age = resource.uri().max_age,
+             .sha256_digest = resource.uri().sha256_digest});
       } else {
-        response_accessors.push_back({.accessor = response_accessing_fn});
+        // Otherwise the body is decoded as it is received, so the encoded
+        // body is never held in memory as a whole.
+        http_callbacks.push_back(std::make_unique<InMemoryHttpRequestCallback>(
+            /*decode_gzip_body=*/true));
+        response_accessors.push_back(
+            {.accessor = response_accessing_fn, .body_decoded = true});
       }
     } else {
       // The data is available inline. Make the accessor just return a "fake"
@@ -486,9 +571,9 @@ FetchResourcesInMemory(HttpClient& http_client,
   }
 
   // Perform the requests.
-  auto resource_fetch_result = PerformMultipleRequestsInMemory(
+  auto resource_fetch_result = PerformMultipleRequestsWithCallbacks(
       http_client, interruptible_runner, std::move(http_requests),
-      bytes_received_acc, bytes_sent_acc);
+      std::move(http_callbacks), bytes_received_acc, bytes_sent_acc);
   // Check whether issuing the requests failed as a whole (generally indicating
   // a programming error).
   FCP_RETURN_IF_ERROR(resource_fetch_result);
@@ -507,18 +592,19 @@ FetchResourcesInMemory(HttpClient& http_client,
       bool encoded_with_gzip = absl::EndsWithIgnoreCase(
           response->content_type, kClientDecodedGzipSuffix);
       if (!response_accessor.client_cache_id.empty()) {
-        TryPutResourceInCache(response_accessor.client_cache_id, response->body,
+        TryPutResourceInCache(response_accessor.client_cache_id,
+                              response_accessor.sha256_digest, response->body,
                               encoded_with_gzip, response_accessor.max_age,
                               *resource_cache)
             .IgnoreError();
       }
-      if (encoded_with_gzip) {
-        std::string response_body_temp(response->body);
-        // We're going to overwrite the response body with the decoded
-        // contents shortly, no need to keep an extra copy of it in memory.
+      if (encoded_with_gzip && !response_accessor.body_decoded) {
+        // The encoded body is decoded chunk by chunk, rather than first being
+        // flattened into a copy, and is released once it has been decoded.
+        absl::Cord encoded_response_body = std::move(response->body);
         response->body.Clear();
         absl::StatusOr<absl::Cord> decoded_response_body =
-            UncompressWithGzip(response_body_temp);
+            UncompressWithGzip(encoded_response_body);
         if (!decoded_response_body.ok()) {
           response = decoded_response_body.status();
         } else {
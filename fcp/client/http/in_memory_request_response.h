@@ -30,6 +30,7 @@
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
+#include "fcp/base/compression.h"
 #include "fcp/client/cache/resource_cache.h"
 #include "fcp/client/http/http_client.h"
 #include "fcp/client/interruptible_runner.h"
@@ -101,7 +102,12 @@ struct InMemoryHttpResponse {
 // body in an `InMemoryHttpResponse` object for later consumption.
 class InMemoryHttpRequestCallback : public HttpRequestCallback {
  public:
-  InMemoryHttpRequestCallback() = default;
+  // If `decode_gzip_body` is true and the response's Content-Type header ends
+  // with "+gzip", the body is decompressed as it is received, so that the
+  // compressed body is never held in memory as a whole. The Content-Type of
+  // the resulting `InMemoryHttpResponse` is left as is.
+  explicit InMemoryHttpRequestCallback(bool decode_gzip_body = false)
+      : decode_gzip_body_(decode_gzip_body) {}
 
   absl::Status OnResponseStarted(const HttpRequest& request,
                                  const HttpResponse& response) override;
@@ -124,7 +130,14 @@ class InMemoryHttpRequestCallback : public HttpRequestCallback {
   std::string content_encoding_ ABSL_GUARDED_BY(mutex_);
   std::string content_type_ ABSL_GUARDED_BY(mutex_);
   std::optional<int64_t> expected_content_length_ ABSL_GUARDED_BY(mutex_);
+  // The number of body bytes received, before any decoding.
+  int64_t received_body_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
   absl::Cord response_buffer_ ABSL_GUARDED_BY(mutex_);
+  const bool decode_gzip_body_;
+  // Set if the body is being decoded as it is received.
+  std::unique_ptr<GzipDecompressor> decompressor_ ABSL_GUARDED_BY(mutex_);
+  // The first error encountered while decoding the body, if any.
+  absl::Status decode_status_ ABSL_GUARDED_BY(mutex_);
   mutable absl::Mutex mutex_;
   std::string client_cache_id_;
 };
@@ -175,17 +188,23 @@ class UriOrInlineData {
     std::string uri;
     std::string client_cache_id;
     absl::Duration max_age;
+    // The raw SHA-256 digest of the data served at `uri`, if known.
+    std::string sha256_digest;
   };
 
   // Creates an instance representing a URI from which data has to be fetched.
   // If the resource represented by the uri should be cached, both
   // `client_cache_id` and `max_age` must be set, otherwise they may be
-  // empty/zero.
+  // empty/zero. If `sha256_digest` is set, a cached resource with the same
+  // content may be used even if it was cached under a different
+  // `client_cache_id`.
   static UriOrInlineData CreateUri(std::string uri, std::string client_cache_id,
-                                   absl::Duration max_age) {
+                                   absl::Duration max_age,
+                                   std::string sha256_digest = "") {
     return UriOrInlineData({.uri = std::move(uri),
                             .client_cache_id = std::move(client_cache_id),
-                            .max_age = max_age},
+                            .max_age = max_age,
+                            .sha256_digest = std::move(sha256_digest)},
                            {});
   }
   // Creates an instance representing a resource's already-available (or empty)
@@ -35,6 +35,7 @@
 #include "absl/synchronization/notification.h"
 #include "absl/time/time.h"
 #include "fcp/base/compression.h"
+#include "fcp/base/digest.h"
 #include "fcp/base/monitoring.h"
 #include "fcp/base/simulated_clock.h"
 #include "fcp/client/cache/file_backed_resource_cache.h"
@@ -552,6 +553,62 @@ TEST(InMemoryHttpRequestCallbackTest, OkResponseChunkedBody) {
   EXPECT_THAT(actual_response->body, StrEq("12345678"));
 }
 
+TEST(InMemoryHttpRequestCallbackTest, GzipBodyDecodedWhileReceived) {
+  absl::StatusOr<std::unique_ptr<HttpRequest>> request =
+      InMemoryHttpRequest::Create("https://valid.com",
+                                  HttpRequest::Method::kGet, {}, "",
+                                  /*use_compression=*/false);
+  ASSERT_OK(request);
+
+  const std::string expected_body(10000, 'x');
+  absl::StatusOr<std::string> compressed_body = CompressWithGzip(expected_body);
+  ASSERT_OK(compressed_body);
+  // The Content-Length is that of the encoded body.
+  auto fake_response = FakeHttpResponse(
+      kHttpOk,
+      {{kContentTypeHdr, "bytes+gzip"},
+       {kContentLengthHdr, std::to_string(compressed_body->size())}});
+
+  InMemoryHttpRequestCallback callback(/*decode_gzip_body=*/true);
+  ASSERT_OK(callback.OnResponseStarted(**request, fake_response));
+  absl::string_view remaining_body = *compressed_body;
+  while (!remaining_body.empty()) {
+    absl::string_view chunk = remaining_body.substr(0, 7);
+    remaining_body.remove_prefix(chunk.size());
+    ASSERT_OK(callback.OnResponseBody(**request, fake_response, chunk));
+  }
+  callback.OnResponseCompleted(**request, fake_response);
+
+  absl::StatusOr<InMemoryHttpResponse> actual_response = callback.Response();
+  ASSERT_OK(actual_response);
+  EXPECT_THAT(*actual_response, FieldsAre(kHttpOk, IsEmpty(), "bytes+gzip",
+                                          StrEq(expected_body)));
+}
+
+TEST(InMemoryHttpRequestCallbackTest, TruncatedGzipBodyFailsToDecode) {
+  absl::StatusOr<std::unique_ptr<HttpRequest>> request =
+      InMemoryHttpRequest::Create("https://valid.com",
+                                  HttpRequest::Method::kGet, {}, "",
+                                  /*use_compression=*/false);
+  ASSERT_OK(request);
+
+  absl::StatusOr<std::string> compressed_body =
+      CompressWithGzip(std::string(10000, 'x'));
+  ASSERT_OK(compressed_body);
+  auto fake_response =
+      FakeHttpResponse(kHttpOk, {{kContentTypeHdr, "bytes+gzip"}});
+
+  InMemoryHttpRequestCallback callback(/*decode_gzip_body=*/true);
+  ASSERT_OK(callback.OnResponseStarted(**request, fake_response));
+  ASSERT_OK(callback.OnResponseBody(
+      **request, fake_response,
+      absl::string_view(*compressed_body)
+          .substr(0, compressed_body->size() - 4)));
+  callback.OnResponseCompleted(**request, fake_response);
+
+  EXPECT_THAT(callback.Response(), IsCode(INTERNAL));
+}
+
 TEST(InMemoryHttpRequestCallbackTest,
      TestOkResponseWithEmptyBodyWithoutContentLength) {
   absl::StatusOr<std::unique_ptr<HttpRequest>> request =
@@ -1319,6 +1376,42 @@ TEST_F(PerformRequestsTest, FetchResourcesInMemoryCachedResourceOk) {
   EXPECT_THAT(bytes_received, Eq(0));
 }
 
+TEST_F(PerformRequestsTest, FetchResourcesInMemoryCachedResourceFoundByDigest) {
+  const std::string uri = "https://valid.com/1";
+  const std::string cache_id = "(^˵◕ω◕˵^)";
+  const std::string other_cache_id = "(◕‿◕)";
+  absl::Cord cached_resource("(((*°▽°*)八(*°▽°*)))");
+  std::string digest = ComputeSHA256(cached_resource);
+  absl::Duration max_age = absl::Hours(1);
+  int expected_response_code = kHttpOk;
+  auto resource = UriOrInlineData::CreateUri(uri, cache_id, max_age, digest);
+  auto resource_cache = cache::FileBackedResourceCache::Create(
+      root_files_dir_, root_cache_dir_, &log_manager_, &clock_,
+      kMaxCacheSizeBytes, /*enable_content_addressed_storage=*/true);
+  ASSERT_OK(resource_cache);
+  // The same content was previously cached under a different id.
+  ASSERT_OK((*resource_cache)
+                ->PutWithDigest(other_cache_id, digest, cached_resource,
+                                MetadataForUncompressedResource(), max_age));
+
+  int64_t bytes_received = 0;
+  int64_t bytes_sent = 0;
+  EXPECT_CALL(log_manager_, LogDiag(DebugDiagCode::RESOURCE_CACHE_MISS));
+  EXPECT_CALL(log_manager_, LogDiag(DebugDiagCode::RESOURCE_CACHE_DIGEST_HIT));
+  auto result = FetchResourcesInMemory(
+      mock_http_client_, interruptible_runner_, {resource}, &bytes_received,
+      &bytes_sent, resource_cache->get());
+  ASSERT_OK(result);
+
+  ASSERT_OK((*result)[0]);
+  EXPECT_THAT(*(*result)[0], FieldsAre(expected_response_code, IsEmpty(),
+                                       kOctetStream, StrEq(cached_resource)));
+
+  // Fully from the cache!
+  EXPECT_THAT(bytes_sent, Eq(0));
+  EXPECT_THAT(bytes_received, Eq(0));
+}
+
 TEST_F(PerformRequestsTest,
        FetchResourcesInMemoryCachedResourceOkAndCompressed) {
   const std::string uri = "https://valid.com/1";
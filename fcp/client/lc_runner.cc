@@ -261,7 +261,8 @@ absl::Status RunPlanWithTensorflowSpec(
   }
   engine::SimplePlanEngine plan_engine(
       example_iterator_factories, should_abort, log_manager, opstats_logger,
-      /*example_iterator_query_recorder=*/nullptr, &timing_config);
+      /*example_iterator_query_recorder=*/nullptr, &timing_config,
+      engine::GetExampleDatasetPrefetchOptions(*flags));
   engine::PlanResult plan_result = plan_engine.RunPlan(
       client_plan.phase().tensorflow_spec(), client_plan.graph(),
       client_plan.tensorflow_config_proto(), std::move(*inputs),
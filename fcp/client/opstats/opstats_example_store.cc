@@ -46,136 +46,208 @@ using ::google::protobuf::util::TimeUtil;
 
 namespace {
 
-tensorflow::Feature CreateFeatureFromString(const std::string& str) {
-  tensorflow::Feature feature;
-  feature.mutable_bytes_list()->add_value(str);
-  return feature;
-}
+// Builds serialized tf.Example protos from OperationalStats. The feature map
+// entries are created once and only their values are replaced for each entry,
+// so that iterating over many entries doesn't rebuild the map every time.
+class ExampleBuilder {
+ public:
+  explicit ExampleBuilder(int64_t earliest_trustworthy_time) {
+    auto* feature_map = example_.mutable_features()->mutable_feature();
+    population_name_ = (*feature_map)[kPopulationName].mutable_bytes_list();
+    session_name_ = (*feature_map)[kSessionName].mutable_bytes_list();
+    task_name_ = (*feature_map)[kTaskName].mutable_bytes_list();
+    event_types_ = (*feature_map)[kEventsEventType].mutable_int64_list();
+    event_time_millis_ =
+        (*feature_map)[kEventsTimestampMillis].mutable_int64_list();
+    dataset_uris_ = (*feature_map)[kDatasetStatsUri].mutable_bytes_list();
+    num_examples_read_ =
+        (*feature_map)[kDatasetStatsNumExamplesRead].mutable_int64_list();
+    num_bytes_read_ =
+        (*feature_map)[kDatasetStatsNumBytesRead].mutable_int64_list();
+    error_message_ = (*feature_map)[kErrorMessage].mutable_bytes_list();
+    retry_window_delay_min_ =
+        (*feature_map)[kRetryWindowDelayMinMillis].mutable_int64_list();
+    retry_window_delay_max_ =
+        (*feature_map)[kRetryWindowDelayMaxMillis].mutable_int64_list();
+    bytes_downloaded_ =
+        (*feature_map)[kChunkingLayerBytesDownloaded].mutable_int64_list();
+    bytes_uploaded_ =
+        (*feature_map)[kChunkingLayerBytesUploaded].mutable_int64_list();
+    network_duration_ = (*feature_map)[kNetworkDuration].mutable_int64_list();
+    (*feature_map)[kEarliestTrustWorthyTimeMillis]
+        .mutable_int64_list()
+        ->add_value(earliest_trustworthy_time);
+    (*feature_map)[kSupportsNeetContext].mutable_int64_list()->add_value(1);
+  }
 
-tensorflow::Feature CreateFeatureFromInt(int64_t value) {
-  tensorflow::Feature feature;
-  feature.mutable_int64_list()->add_value(value);
-  return feature;
-}
+  // Fills in the features for the given OperationalStats and serializes the
+  // resulting example into `output`.
+  void Build(const OperationalStats& op_stats, std::string& output) {
+    SetString(population_name_, op_stats.population_name());
+    SetString(session_name_, op_stats.session_name());
+    SetString(task_name_, op_stats.task_name());
 
-tensorflow::Feature CreateFeatureFromStringVector(
-    const std::vector<std::string>& values) {
-  tensorflow::Feature feature;
-  auto* bytes_list = feature.mutable_bytes_list();
-  for (const auto& value : values) {
-    bytes_list->add_value(value);
-  }
-  return feature;
-}
+    // Create events related features.
+    event_types_->Clear();
+    event_time_millis_->Clear();
+    for (const auto& event : op_stats.events()) {
+      event_types_->add_value(event.event_type());
+      event_time_millis_->add_value(
+          TimeUtil::TimestampToMilliseconds(event.timestamp()));
+    }
 
-tensorflow::Feature CreateFeatureFromIntVector(
-    const std::vector<int64_t>& values) {
-  tensorflow::Feature feature;
-  auto* int64_list = feature.mutable_int64_list();
-  for (const auto& value : values) {
-    int64_list->add_value(value);
+    // Create external dataset stats related features.
+    dataset_uris_->Clear();
+    num_examples_read_->Clear();
+    num_bytes_read_->Clear();
+    for (const auto& [uri, stats] : op_stats.dataset_stats()) {
+      dataset_uris_->add_value(uri);
+      num_examples_read_->add_value(stats.num_examples_read());
+      num_bytes_read_->add_value(stats.num_bytes_read());
+    }
+
+    SetString(error_message_, op_stats.error_message());
+
+    // Create RetryWindow related features.
+    SetInt(retry_window_delay_min_, TimeUtil::DurationToMilliseconds(
+                                        op_stats.retry_window().delay_min()));
+    SetInt(retry_window_delay_max_, TimeUtil::DurationToMilliseconds(
+                                        op_stats.retry_window().delay_max()));
+
+    SetInt(bytes_downloaded_, op_stats.chunking_layer_bytes_downloaded());
+    SetInt(bytes_uploaded_, op_stats.chunking_layer_bytes_uploaded());
+    SetInt(network_duration_,
+           TimeUtil::DurationToMilliseconds(op_stats.network_duration()));
+
+    example_.SerializeToString(&output);
   }
-  return feature;
-}
 
-std::string CreateExample(const OperationalStats& op_stats,
-                          int64_t earliest_trustworthy_time) {
-  tensorflow::Example example;
-  auto* feature_map = example.mutable_features()->mutable_feature();
-  (*feature_map)[kPopulationName] =
-      CreateFeatureFromString(op_stats.population_name());
-  (*feature_map)[kSessionName] =
-      CreateFeatureFromString(op_stats.session_name());
-  (*feature_map)[kTaskName] = CreateFeatureFromString(op_stats.task_name());
-
-  // Create events related features.
-  std::vector<int64_t> event_types;
-  std::vector<int64_t> event_time_millis;
-  for (const auto& event : op_stats.events()) {
-    event_types.push_back(event.event_type());
-    event_time_millis.push_back(
-        TimeUtil::TimestampToMilliseconds(event.timestamp()));
+ private:
+  static void SetString(tensorflow::BytesList* list, const std::string& str) {
+    list->Clear();
+    list->add_value(str);
   }
-  (*feature_map)[kEventsEventType] = CreateFeatureFromIntVector(event_types);
-  (*feature_map)[kEventsTimestampMillis] =
-      CreateFeatureFromIntVector(event_time_millis);
-
-  // Create external dataset stats related features.
-  std::vector<std::string> uris;
-  std::vector<int64_t> num_examples_read;
-  std::vector<int64_t> num_bytes_read;
-  std::vector<int64_t> first_access_time_millis;
-  for (const auto& stats : op_stats.dataset_stats()) {
-    uris.push_back(stats.first);
-    num_examples_read.push_back(stats.second.num_examples_read());
-    num_bytes_read.push_back(stats.second.num_bytes_read());
-    first_access_time_millis.push_back(TimeUtil::TimestampToMilliseconds(
-        stats.second.first_access_timestamp()));
+
+  static void SetInt(tensorflow::Int64List* list, int64_t value) {
+    list->Clear();
+    list->add_value(value);
   }
-  (*feature_map)[kDatasetStatsUri] = CreateFeatureFromStringVector(uris);
-  (*feature_map)[kDatasetStatsNumExamplesRead] =
-      CreateFeatureFromIntVector(num_examples_read);
-  (*feature_map)[kDatasetStatsNumBytesRead] =
-      CreateFeatureFromIntVector(num_bytes_read);
-
-  (*feature_map)[kErrorMessage] =
-      CreateFeatureFromString(op_stats.error_message());
-
-  // Create RetryWindow related features.
-  (*feature_map)[kRetryWindowDelayMinMillis] = CreateFeatureFromInt(
-      TimeUtil::DurationToMilliseconds(op_stats.retry_window().delay_min()));
-  (*feature_map)[kRetryWindowDelayMaxMillis] = CreateFeatureFromInt(
-      TimeUtil::DurationToMilliseconds(op_stats.retry_window().delay_max()));
-
-  (*feature_map)[kChunkingLayerBytesDownloaded] =
-      CreateFeatureFromInt(op_stats.chunking_layer_bytes_downloaded());
-  (*feature_map)[kChunkingLayerBytesUploaded] =
-      CreateFeatureFromInt(op_stats.chunking_layer_bytes_uploaded());
-    (*feature_map)[kNetworkDuration] = CreateFeatureFromInt(
-        TimeUtil::DurationToMilliseconds(op_stats.network_duration()));
-
-  (*feature_map)[kEarliestTrustWorthyTimeMillis] =
-      CreateFeatureFromInt(earliest_trustworthy_time);
-
-  (*feature_map)[kSupportsNeetContext] = CreateFeatureFromInt(1);
-
-  return example.SerializeAsString();
-}
 
+  tensorflow::Example example_;
+  // Pointers into the feature map of example_. Map values are never erased, so
+  // these remain valid for the lifetime of the builder.
+  tensorflow::BytesList* population_name_;
+  tensorflow::BytesList* session_name_;
+  tensorflow::BytesList* task_name_;
+  tensorflow::Int64List* event_types_;
+  tensorflow::Int64List* event_time_millis_;
+  tensorflow::BytesList* dataset_uris_;
+  tensorflow::Int64List* num_examples_read_;
+  tensorflow::Int64List* num_bytes_read_;
+  tensorflow::BytesList* error_message_;
+  tensorflow::Int64List* retry_window_delay_min_;
+  tensorflow::Int64List* retry_window_delay_max_;
+  tensorflow::Int64List* bytes_downloaded_;
+  tensorflow::Int64List* bytes_uploaded_;
+  tensorflow::Int64List* network_duration_;
+};
+
+// Walks the entries of an OpStatsSequence from the most recent to the oldest
+// one, returning an example for each task whose last update time falls within
+// the given time range. Entries are only converted and serialized once they
+// are reached, and entries which can't match the time range are skipped
+// without being converted at all.
 class OpStatsExampleIterator : public fcp::client::ExampleIterator {
  public:
-  explicit OpStatsExampleIterator(std::vector<OperationalStats> op_stats,
-                                  int64_t earliest_trustworthy_time)
-      : next_(0),
-        data_(std::move(op_stats)),
-        earliest_trustworthy_time_millis_(earliest_trustworthy_time) {}
+  OpStatsExampleIterator(OpStatsSequence data, absl::Time lower_bound_time,
+                         absl::Time upper_bound_time)
+      : data_(std::move(data)),
+        next_entry_(data_.opstats_size() - 1),
+        lower_bound_time_(lower_bound_time),
+        upper_bound_time_(upper_bound_time),
+        example_builder_(TimeUtil::TimestampToMilliseconds(
+            data_.earliest_trustworthy_time())) {}
+
   absl::StatusOr<std::string> Next() override {
-    if (data_.empty() && next_ == 0) {
+    std::string example;
+    OperationalStats legacy_op_stats;
+    if (NextInTimeRange(legacy_op_stats)) {
+      example_builder_.Build(legacy_op_stats, example);
+      returned_any_ = true;
+      return example;
+    }
+
+    if (!returned_any_) {
       // If there's no data, we still need to return an opstats example
       // containing baseline info like the earliest trustworthy time, and
-      // NEET custom policy support. We'll increment next so we never hit this
-      // case again.
-      next_++;
-      return CreateExample(OperationalStats(),
-                           earliest_trustworthy_time_millis_);
+      // NEET custom policy support. We'll mark the iterator as having returned
+      // an example so we never hit this case again.
+      returned_any_ = true;
+      example_builder_.Build(OperationalStats(), example);
+      return example;
     }
+    return absl::OutOfRangeError("The iterator is out of range.");
+  }
 
-    if (next_ < 0 || next_ >= data_.size()) {
-      return absl::OutOfRangeError("The iterator is out of range.");
+  // Skips examples without building and serializing them.
+  absl::StatusOr<int64_t> Skip(int64_t max_examples) override {
+    int64_t num_skipped = 0;
+    OperationalStats legacy_op_stats;
+    while (num_skipped < max_examples && NextInTimeRange(legacy_op_stats)) {
+      returned_any_ = true;
+      num_skipped++;
+    }
+    if (num_skipped < max_examples && !returned_any_) {
+      // Account for the baseline example Next() returns if there's no data.
+      returned_any_ = true;
+      num_skipped++;
     }
-    return CreateExample(data_[next_++], earliest_trustworthy_time_millis_);
+    return num_skipped;
   }
 
   void Close() override {
-    next_ = 0;
-    data_.clear();
+    next_entry_ = -1;
+    pending_.clear();
+    data_.Clear();
   }
 
  private:
-  // The index for the next OperationalStats to be used.
-  int next_;
-  std::vector<OperationalStats> data_;
-  const int64_t earliest_trustworthy_time_millis_;
+  // Moves the next legacy OperationalStats within the time range into
+  // `legacy_op_stats`. Returns false once all entries have been visited.
+  bool NextInTimeRange(OperationalStats& legacy_op_stats) {
+    while (true) {
+      while (!pending_.empty()) {
+        legacy_op_stats = std::move(pending_.back());
+        pending_.pop_back();
+        absl::Time last_update_time =
+            GetLastUpdatedTimeFromLegacyOpStats(legacy_op_stats);
+        if (last_update_time >= lower_bound_time_ &&
+            last_update_time <= upper_bound_time_) {
+          return true;
+        }
+      }
+      if (next_entry_ < 0) {
+        return false;
+      }
+      const OperationalStats& entry = data_.opstats(next_entry_--);
+      if (MayContainOperationalStatsInTimeRange(entry, lower_bound_time_,
+                                                upper_bound_time_)) {
+        pending_ = ConvertToLegacyOperationalStats(entry);
+      }
+    }
+  }
+
+  OpStatsSequence data_;
+  // The index of the next entry in data_ to be converted, or -1 if all entries
+  // have been visited.
+  int next_entry_;
+  // The legacy OperationalStats of the most recently visited entry which have
+  // yet to be returned, in time order.
+  std::vector<OperationalStats> pending_;
+  const absl::Time lower_bound_time_;
+  const absl::Time upper_bound_time_;
+  ExampleBuilder example_builder_;
+  bool returned_any_ = false;
 };
 
 }  // anonymous namespace
@@ -223,23 +295,21 @@ OpStatsExampleIteratorFactory::CreateExampleIterator(
 
   FCP_ASSIGN_OR_RETURN(OpStatsSequence data,
                        op_stats_logger_->GetOpStatsDb()->Read());
-  std::vector<OperationalStats> selected_data;
   if (last_successful_contribution) {
     // Selector specified last_successful_contribution, create a
-    // last_successful_contribution iterator.
+    // last_successful_contribution iterator over just that entry.
     std::optional<OperationalStats> last_successful_contribution_entry =
         GetLastSuccessfulContribution(data,
                                       op_stats_logger_->GetCurrentTaskName());
+    data.clear_opstats();
     if (last_successful_contribution_entry.has_value()) {
-      selected_data.push_back(*last_successful_contribution_entry);
+      *data.add_opstats() = std::move(*last_successful_contribution_entry);
     }
-  } else {
-    selected_data = GetOperationalStatsForTimeRange(data, lower_bound_time,
-                                                    upper_bound_time);
+    lower_bound_time = absl::InfinitePast();
+    upper_bound_time = absl::InfiniteFuture();
   }
   return std::make_unique<OpStatsExampleIterator>(
-      std::move(selected_data),
-      TimeUtil::TimestampToMilliseconds(data.earliest_trustworthy_time()));
+      std::move(data), lower_bound_time, upper_bound_time);
 }
 
 }  // namespace opstats
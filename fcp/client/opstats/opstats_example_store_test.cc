@@ -32,6 +32,7 @@
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
 #include "fcp/client/diag_codes.pb.h"
+#include "fcp/client/selector_context.pb.h"
 #include "fcp/client/simple_task_environment.h"
 #include "fcp/client/test_helpers.h"
 #include "fcp/protos/federated_api.pb.h"
@@ -329,6 +330,63 @@ TEST_F(OpStatsExampleStoreTest, DataIsFilteredBySelectionCriteria) {
   EXPECT_THAT(example_or.status(), IsCode(absl::StatusCode::kOutOfRange));
 }
 
+TEST_F(OpStatsExampleStoreTest, SkipCountsExamplesInTimeRange) {
+  OpStatsSequence opstats_sequence;
+  for (int64_t finish_time_ms : {700L, 1000L, 1500L, 2001L}) {
+    OperationalStats* stats = opstats_sequence.add_opstats();
+    stats->mutable_events()->Add(CreateEvent(
+        OperationalStats::Event::EVENT_KIND_COMPUTATION_STARTED, 500L));
+    stats->mutable_events()->Add(CreateEvent(
+        OperationalStats::Event::EVENT_KIND_COMPUTATION_FINISHED,
+        finish_time_ms));
+  }
+  EXPECT_CALL(mock_db_, Read()).WillRepeatedly(Return(opstats_sequence));
+
+  ExampleSelector selector;
+  selector.set_collection_uri(kOpStatsCollectionUri);
+  OpStatsSelectionCriteria criteria;
+  *criteria.mutable_start_time() = TimeUtil::MillisecondsToTimestamp(1000L);
+  *criteria.mutable_end_time() = TimeUtil::MillisecondsToTimestamp(2000L);
+  selector.mutable_criteria()->PackFrom(criteria);
+  absl::StatusOr<std::unique_ptr<ExampleIterator>> iterator =
+      iterator_factory_.CreateExampleIterator(selector);
+  ASSERT_OK(iterator);
+  absl::StatusOr<int64_t> num_skipped = (*iterator)->Skip(1);
+  ASSERT_OK(num_skipped);
+  EXPECT_EQ(*num_skipped, 1);
+  num_skipped = (*iterator)->Skip(10);
+  ASSERT_OK(num_skipped);
+  EXPECT_EQ(*num_skipped, 1);
+  EXPECT_THAT((*iterator)->Next().status(),
+              IsCode(absl::StatusCode::kOutOfRange));
+
+  // Counting stops at `max_count`.
+  absl::StatusOr<int64_t> count = iterator_factory_.CountExamples(
+      selector, SelectorContext::default_instance(), /*max_count=*/10);
+  ASSERT_OK(count);
+  EXPECT_EQ(*count, 2);
+  count = iterator_factory_.CountExamples(
+      selector, SelectorContext::default_instance(), /*max_count=*/1);
+  ASSERT_OK(count);
+  EXPECT_EQ(*count, 1);
+}
+
+TEST_F(OpStatsExampleStoreTest, SkipCountsBaselineExampleForEmptyData) {
+  EXPECT_CALL(mock_db_, Read())
+      .WillOnce(Return(OpStatsSequence::default_instance()));
+
+  ExampleSelector selector;
+  selector.set_collection_uri(kOpStatsCollectionUri);
+  absl::StatusOr<std::unique_ptr<ExampleIterator>> iterator =
+      iterator_factory_.CreateExampleIterator(selector);
+  ASSERT_OK(iterator);
+  absl::StatusOr<int64_t> num_skipped = (*iterator)->Skip(10);
+  ASSERT_OK(num_skipped);
+  EXPECT_EQ(*num_skipped, 1);
+  EXPECT_THAT((*iterator)->Next().status(),
+              IsCode(absl::StatusCode::kOutOfRange));
+}
+
 TEST_F(OpStatsExampleStoreTest, SelectionCriteriaOnlyContainsBeginTime) {
   OperationalStats included;
   included.mutable_events()->Add(CreateEvent(
@@ -170,28 +170,6 @@ OperationalStats CreateLegacyOperationalStats(
   return legacy_stats;
 }
 
-// Convert an OperationalStats to a list of legacy OperationalStats (without
-// PhaseStats).  If the input OperationalStats is already a legacy
-// OperationalStats, it will return a list of single element which is the input
-// OperationalStats. When the input OperationalStats has PhaseStats, it
-// potentially will be split into several legacy OperationalStats. Each legacy
-// OperationalStats contains all the metrics for a single task.
-std::vector<OperationalStats> ConvertToLegacyOperationalStats(
-    const OperationalStats& op_stats) {
-  std::vector<OperationalStats> legacy_op_stats;
-  if (op_stats.phase_stats().empty()) {
-    legacy_op_stats.push_back(op_stats);
-  } else {
-    std::vector<PerTaskStats> task_stats_list = GeneratePerTaskStats(op_stats);
-    for (const auto& task_stats : task_stats_list) {
-      legacy_op_stats.push_back(CreateLegacyOperationalStats(
-          op_stats.population_name(), op_stats.session_name(),
-          op_stats.retry_window(), task_stats));
-    }
-  }
-  return legacy_op_stats;
-}
-
 // Convert all of the OperationalStats inside a OpStatsSequence into legacy
 // OperationalStats (represent single task, no PhaseStats).
 std::vector<OperationalStats> ConvertToLegacyOperationalStats(
@@ -199,7 +177,7 @@ std::vector<OperationalStats> ConvertToLegacyOperationalStats(
   std::vector<OperationalStats> legacy_op_stats;
   for (const auto& op_stats : data.opstats()) {
     std::vector<OperationalStats> converted_op_stats =
-        ConvertToLegacyOperationalStats(op_stats);
+        opstats::ConvertToLegacyOperationalStats(op_stats);
     for (const auto& stats : converted_op_stats) {
       legacy_op_stats.push_back(stats);
     }
@@ -269,6 +247,24 @@ GetCollectionFirstAccessTimeFromLegacyOpstats(const OperationalStats& entry) {
   return collection_first_access_times;
 }
 
+}  // anonymous namespace
+
+std::vector<OperationalStats> ConvertToLegacyOperationalStats(
+    const OperationalStats& op_stats) {
+  std::vector<OperationalStats> legacy_op_stats;
+  if (op_stats.phase_stats().empty()) {
+    legacy_op_stats.push_back(op_stats);
+  } else {
+    std::vector<PerTaskStats> task_stats_list = GeneratePerTaskStats(op_stats);
+    for (const auto& task_stats : task_stats_list) {
+      legacy_op_stats.push_back(CreateLegacyOperationalStats(
+          op_stats.population_name(), op_stats.session_name(),
+          op_stats.retry_window(), task_stats));
+    }
+  }
+  return legacy_op_stats;
+}
+
 absl::Time GetLastUpdatedTimeFromLegacyOpStats(
     const OperationalStats& op_stats) {
   if (op_stats.events().empty()) {
@@ -279,7 +275,41 @@ absl::Time GetLastUpdatedTimeFromLegacyOpStats(
   }
 }
 
-}  // anonymous namespace
+bool MayContainOperationalStatsInTimeRange(const OperationalStats& op_stats,
+                                           absl::Time lower_bound_time,
+                                           absl::Time upper_bound_time) {
+  // Every legacy OperationalStats derived from op_stats takes its last updated
+  // time from one of the events in op_stats, or is absl::InfinitePast() if it
+  // has none. It is therefore enough to check whether the span of event
+  // timestamps overlaps with the requested range.
+  absl::Time earliest = absl::InfiniteFuture();
+  absl::Time latest = absl::InfinitePast();
+  bool has_event_less_stats = op_stats.events().empty();
+  auto update_span = [&earliest, &latest](const OperationalStats::Event& e) {
+    absl::Time event_time =
+        absl::FromUnixMillis(TimeUtil::TimestampToMilliseconds(e.timestamp()));
+    earliest = std::min(earliest, event_time);
+    latest = std::max(latest, event_time);
+  };
+  for (const auto& event : op_stats.events()) {
+    update_span(event);
+  }
+  if (!op_stats.phase_stats().empty()) {
+    has_event_less_stats = false;
+    for (const auto& phase_stats : op_stats.phase_stats()) {
+      if (phase_stats.events().empty()) {
+        has_event_less_stats = true;
+      }
+      for (const auto& event : phase_stats.events()) {
+        update_span(event);
+      }
+    }
+  }
+  if (has_event_less_stats && lower_bound_time == absl::InfinitePast()) {
+    return true;
+  }
+  return latest >= lower_bound_time && earliest <= upper_bound_time;
+}
 
 std::optional<OperationalStats> GetLastSuccessfulContribution(
     const OpStatsSequence& data, absl::string_view task_name) {
@@ -339,13 +369,21 @@ std::vector<OperationalStats> GetOperationalStatsForTimeRange(
     const OpStatsSequence& data, absl::Time lower_bound_time,
     absl::Time upper_bound_time) {
   std::vector<OperationalStats> selected_data;
-  std::vector<OperationalStats> legacy_op_stats =
-      ConvertToLegacyOperationalStats(data);
-  for (auto it = legacy_op_stats.rbegin(); it != legacy_op_stats.rend(); ++it) {
-    absl::Time last_update_time = GetLastUpdatedTimeFromLegacyOpStats(*it);
-    if (last_update_time >= lower_bound_time &&
-        last_update_time <= upper_bound_time) {
-      selected_data.push_back(*it);
+  for (auto entry = data.opstats().rbegin(); entry != data.opstats().rend();
+       ++entry) {
+    if (!MayContainOperationalStatsInTimeRange(*entry, lower_bound_time,
+                                               upper_bound_time)) {
+      continue;
+    }
+    std::vector<OperationalStats> legacy_op_stats =
+        ConvertToLegacyOperationalStats(*entry);
+    for (auto it = legacy_op_stats.rbegin(); it != legacy_op_stats.rend();
+         ++it) {
+      absl::Time last_update_time = GetLastUpdatedTimeFromLegacyOpStats(*it);
+      if (last_update_time >= lower_bound_time &&
+          last_update_time <= upper_bound_time) {
+        selected_data.push_back(std::move(*it));
+      }
     }
   }
   return selected_data;
@@ -66,6 +66,24 @@ GetLastSuccessfulContributionTimeForPattern(const OpStatsSequence& data,
 std::optional<int64_t> GetLastSuccessfulContributionMinSepPolicyIndex(
     const OpStatsSequence& data, absl::string_view task_name);
 
+// Converts an OperationalStats into a list of legacy OperationalStats (without
+// PhaseStats), one per task that ran as part of it. A legacy OperationalStats
+// is returned as-is in a single element list.
+std::vector<OperationalStats> ConvertToLegacyOperationalStats(
+    const OperationalStats& op_stats);
+
+// Returns the time of the last event recorded in a legacy OperationalStats, or
+// absl::InfinitePast() if it has no events.
+absl::Time GetLastUpdatedTimeFromLegacyOpStats(const OperationalStats& op_stats);
+
+// Returns false if none of the legacy OperationalStats derived from op_stats
+// can have a last updated time within [lower_bound_time, upper_bound_time].
+// This only inspects event timestamps and does not perform the conversion, so
+// it can be used to cheaply skip entries before converting them.
+bool MayContainOperationalStatsInTimeRange(const OperationalStats& op_stats,
+                                           absl::Time lower_bound_time,
+                                           absl::Time upper_bound_time);
+
 // Returns a list of OperationalStats for the tasks that ran in the given time
 // range in reverse time order.
 std::vector<OperationalStats> GetOperationalStatsForTimeRange(
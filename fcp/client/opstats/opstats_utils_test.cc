@@ -20,6 +20,7 @@
 #include <optional>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "google/protobuf/timestamp.pb.h"
 #include "gmock/gmock.h"
@@ -579,6 +580,81 @@ TEST(OpStatsUtils,
                                                               kTaskName)
                    .has_value());
 }
+
+TEST(OpStatsUtils, MayContainOperationalStatsInTimeRangeLegacyOpStats) {
+  OperationalStats stats;
+  *stats.add_events() =
+      CreateEvent(OperationalStats::Event::EVENT_KIND_CHECKIN_STARTED, 1000);
+  *stats.add_events() = CreateEvent(kUploadStartedEvent, 2000);
+
+  EXPECT_TRUE(MayContainOperationalStatsInTimeRange(
+      stats, absl::FromUnixSeconds(1500), absl::FromUnixSeconds(2500)));
+  EXPECT_TRUE(MayContainOperationalStatsInTimeRange(
+      stats, absl::FromUnixSeconds(500), absl::FromUnixSeconds(1000)));
+  EXPECT_FALSE(MayContainOperationalStatsInTimeRange(
+      stats, absl::FromUnixSeconds(2001), absl::InfiniteFuture()));
+  EXPECT_FALSE(MayContainOperationalStatsInTimeRange(
+      stats, absl::InfinitePast(), absl::FromUnixSeconds(999)));
+}
+
+TEST(OpStatsUtils, MayContainOperationalStatsInTimeRangePhaseStats) {
+  OperationalStats stats;
+  OperationalStats::PhaseStats computation;
+  computation.set_phase(OperationalStats::PhaseStats::COMPUTATION);
+  *computation.add_events() =
+      CreateEvent(OperationalStats::Event::EVENT_KIND_COMPUTATION_STARTED, 1000);
+  *stats.add_phase_stats() = computation;
+  OperationalStats::PhaseStats upload;
+  upload.set_phase(OperationalStats::PhaseStats::UPLOAD);
+  *upload.add_events() = CreateEvent(kUploadStartedEvent, 3000);
+  *stats.add_phase_stats() = upload;
+
+  EXPECT_TRUE(MayContainOperationalStatsInTimeRange(
+      stats, absl::FromUnixSeconds(2000), absl::FromUnixSeconds(4000)));
+  EXPECT_FALSE(MayContainOperationalStatsInTimeRange(
+      stats, absl::FromUnixSeconds(3001), absl::InfiniteFuture()));
+}
+
+TEST(OpStatsUtils, MayContainOperationalStatsInTimeRangeNoEvents) {
+  OperationalStats stats;
+  stats.set_task_name(kTaskName);
+
+  EXPECT_TRUE(MayContainOperationalStatsInTimeRange(
+      stats, absl::InfinitePast(), absl::InfiniteFuture()));
+  EXPECT_FALSE(MayContainOperationalStatsInTimeRange(
+      stats, absl::FromUnixSeconds(0), absl::InfiniteFuture()));
+}
+
+TEST(OpStatsUtils, GetOperationalStatsForTimeRangeSkipsEntriesOutOfRange) {
+  OperationalStats early;
+  early.set_task_name("early");
+  *early.add_events() = CreateEvent(kUploadStartedEvent, 1000);
+  OperationalStats in_range;
+  OperationalStats::PhaseStats computation;
+  computation.set_phase(OperationalStats::PhaseStats::COMPUTATION);
+  computation.set_task_name("in_range_1");
+  *computation.add_events() =
+      CreateEvent(OperationalStats::Event::EVENT_KIND_COMPUTATION_STARTED, 2000);
+  *in_range.add_phase_stats() = computation;
+  computation.set_task_name("in_range_2");
+  computation.clear_events();
+  *computation.add_events() =
+      CreateEvent(OperationalStats::Event::EVENT_KIND_COMPUTATION_STARTED, 2500);
+  *in_range.add_phase_stats() = computation;
+  OperationalStats late;
+  late.set_task_name("late");
+  *late.add_events() = CreateEvent(kUploadStartedEvent, 5000);
+  OpStatsSequence data;
+  *data.add_opstats() = early;
+  *data.add_opstats() = in_range;
+  *data.add_opstats() = late;
+
+  std::vector<OperationalStats> selected = GetOperationalStatsForTimeRange(
+      data, absl::FromUnixSeconds(1500), absl::FromUnixSeconds(3000));
+  ASSERT_EQ(selected.size(), 2);
+  EXPECT_EQ(selected[0].task_name(), "in_range_2");
+  EXPECT_EQ(selected[1].task_name(), "in_range_1");
+}
 }  // namespace
 }  // namespace opstats
 }  // namespace client
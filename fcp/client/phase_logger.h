@@ -107,6 +107,10 @@ class PhaseLogger {
   // client execution is allowed to continue.
   virtual void LogEligibilityEvalComputationErrorNonfatal(
       absl::Status error_status) = 0;
+  // Called after a single native eligibility policy was evaluated, with the
+  // time it took to evaluate it.
+  virtual void LogEligibilityEvalPolicyLatency(
+      absl::Duration policy_latency) = 0;
   // Called when the eligibility eval computation is completed.
   virtual void LogEligibilityEvalComputationCompleted(
       const ExampleStats& example_stats, absl::Time run_plan_start_time,
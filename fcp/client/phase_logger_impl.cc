@@ -302,6 +302,13 @@ void PhaseLoggerImpl::LogEligibilityEvalComputationErrorNonfatal(
       error_message);
 }
 
+void PhaseLoggerImpl::LogEligibilityEvalPolicyLatency(
+    absl::Duration policy_latency) {
+  log_manager_->LogToLongHistogram(
+      HistogramCounters::TRAINING_ELIGIBILITY_POLICY_LATENCY,
+      absl::ToInt64Milliseconds(policy_latency));
+}
+
 void PhaseLoggerImpl::LogEligibilityEvalComputationCompleted(
     const ExampleStats& example_stats, absl::Time run_plan_start_time,
     absl::Time reference_time) {
@@ -103,6 +103,7 @@ class PhaseLoggerImpl : public PhaseLogger {
       absl::Time reference_time) override;
   void LogEligibilityEvalComputationErrorNonfatal(
       absl::Status error_status) override;
+  void LogEligibilityEvalPolicyLatency(absl::Duration policy_latency) override;
 
   // Multiple task assignments phase.
   void LogMultipleTaskAssignmentsStarted() override;
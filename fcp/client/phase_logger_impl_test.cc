@@ -1249,6 +1249,13 @@ TEST_P(PhaseLoggerImplTest, LogEligibilityEvalComputationErrorNonfatal) {
   phase_logger_->LogEligibilityEvalComputationErrorNonfatal(error);
 }
 
+TEST_P(PhaseLoggerImplTest, LogEligibilityEvalPolicyLatency) {
+  VerifyCounterLogged(HistogramCounters::TRAINING_ELIGIBILITY_POLICY_LATENCY,
+                      Eq(1500));
+
+  phase_logger_->LogEligibilityEvalPolicyLatency(absl::Milliseconds(1500));
+}
+
 }  // namespace
 }  // namespace client
 }  // namespace fcp
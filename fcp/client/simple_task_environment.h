@@ -16,9 +16,12 @@
 #ifndef FCP_CLIENT_SIMPLE_TASK_ENVIRONMENT_H_
 #define FCP_CLIENT_SIMPLE_TASK_ENVIRONMENT_H_
 
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/time/time.h"
 #include "fcp/client/attestation/attestation_verifier.h"
@@ -31,7 +34,7 @@ namespace fcp {
 namespace client {
 
 // An interface used by the plan engine to query for serialized examples. Not
-// required to be thread-safe.
+// required to be thread-safe, except for Cancel().
 class ExampleIterator {
  public:
   virtual ~ExampleIterator() = default;
@@ -42,6 +45,58 @@ class ExampleIterator {
   //  - OUT_OF_RANGE if the end of the iterator was reached.
   virtual absl::StatusOr<std::string> Next() = 0;
 
+  // Appends up to `max_examples` serialized examples to `examples`, which the
+  // caller may clear and reuse across calls. Returns OK if `max_examples`
+  // examples were appended. Otherwise returns the status that ended the batch
+  // (with the same codes as Next()), in which case the examples appended
+  // before it are still valid and should be consumed before the error.
+  //
+  // The default implementation calls Next() repeatedly; implementations that
+  // can produce several examples more cheaply than one at a time should
+  // override it.
+  virtual absl::Status NextBatch(int max_examples,
+                                 std::vector<std::string>& examples) {
+    for (int i = 0; i < max_examples; ++i) {
+      absl::StatusOr<std::string> example = Next();
+      if (!example.ok()) {
+        return example.status();
+      }
+      examples.push_back(*std::move(example));
+    }
+    return absl::OkStatus();
+  }
+
+  // Advances past up to `max_examples` examples without returning them, and
+  // returns the number of examples skipped. This is less than `max_examples`
+  // only if the end of the iterator was reached. On error, returns the same
+  // codes as Next(), except OUT_OF_RANGE.
+  //
+  // The default implementation calls Next() repeatedly, and so reads every
+  // skipped example. Implementations backed by a store which can count or skip
+  // examples without reading their payloads should override it.
+  virtual absl::StatusOr<int64_t> Skip(int64_t max_examples) {
+    int64_t num_skipped = 0;
+    while (num_skipped < max_examples) {
+      absl::StatusOr<std::string> example = Next();
+      if (absl::IsOutOfRange(example.status())) {
+        break;
+      }
+      if (!example.ok()) {
+        return example.status();
+      }
+      num_skipped++;
+    }
+    return num_skipped;
+  }
+
+  // Interrupts a Next() or NextBatch() call which is blocked, e.g. waiting for
+  // an example store, so that it returns CANCELLED promptly. Unlike the other
+  // methods, this may be called from another thread, concurrently with them.
+  //
+  // The default implementation does nothing, in which case a pending call
+  // only returns once it would have anyway.
+  virtual void Cancel() {}
+
   // Close the iterator to release associated resources.
   virtual void Close() = 0;
 };
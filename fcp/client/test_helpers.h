@@ -679,6 +679,8 @@ class MockFlags : public Flags {
               (const, override));
   MOCK_METHOD(bool, use_example_query_result_for_data_avail, (),
               (const, override));
+  MOCK_METHOD(int32_t, eligibility_policy_evaluation_threads, (),
+              (const, override));
   MOCK_METHOD(bool, confidential_agg_in_selector_context, (),
               (const, override));
 };
@@ -775,6 +777,8 @@ class MockPhaseLogger : public PhaseLogger {
               (override));
   MOCK_METHOD(void, LogEligibilityEvalComputationErrorNonfatal,
               (absl::Status error_status), (override));
+  MOCK_METHOD(void, LogEligibilityEvalPolicyLatency,
+              (absl::Duration policy_latency), (override));
   MOCK_METHOD(void, LogEligibilityEvalComputationCompleted,
               (const ExampleStats& example_stats,
                absl::Time run_plan_start_time, absl::Time reference_time),
@@ -29,15 +29,19 @@
 #ifndef FCP_CONFIDENTIALCOMPUTE_CRYPTO_H_
 #define FCP_CONFIDENTIALCOMPUTE_CRYPTO_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "google/protobuf/struct.pb.h"
 #include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "fcp/base/scheduler.h"
 #include "fcp/protos/confidentialcompute/confidential_transform.pb.h"
 #include "openssl/base.h"
 #include "openssl/ec_key.h"  // // IWYU pragma: keep, needed for bssl::UniquePtr<EC_KEY>
@@ -117,6 +121,20 @@ class MessageEncryptor {
   const EVP_AEAD* aead_;
 };
 
+// A message to be decrypted by `MessageDecryptor::DecryptBatch`. The fields
+// other than `plaintext` are the arguments of `MessageDecryptor::Decrypt`.
+// None of the referenced data is owned, and it must outlive the call.
+struct DecryptRequest {
+  absl::string_view ciphertext;
+  absl::string_view ciphertext_associated_data;
+  absl::string_view encrypted_symmetric_key;
+  absl::string_view encrypted_symmetric_key_associated_data;
+  absl::string_view encapped_key;
+  // The buffer to write the plaintext to. The plaintext is never longer than
+  // the ciphertext, so a buffer of `ciphertext.size()` bytes always suffices.
+  absl::Span<char> plaintext;
+};
+
 // Decrypts messages intended for this recipient.
 //
 // This class is thread-safe.
@@ -166,7 +184,34 @@ class MessageDecryptor {
       absl::string_view encrypted_symmetric_key_associated_data,
       absl::string_view encapped_key) const;
 
+  // Decrypts each of `requests` as `Decrypt` would, but writes the plaintext to
+  // the request's buffer rather than to a newly allocated string.
+  //
+  // If `scheduler` is set, the requests are spread over its threads as well as
+  // the calling thread, and the call returns once all requests are decrypted.
+  // Consecutive requests with the same encrypted symmetric key, associated
+  // data and encapped key share a single HPKE unwrapping and AEAD context.
+  //
+  // Returns, for each request, the length of its plaintext, or the error that
+  // `Decrypt` would have returned for it. A request whose plaintext buffer is
+  // too small fails with an INVALID_ARGUMENT error.
+  std::vector<absl::StatusOr<size_t>> DecryptBatch(
+      absl::Span<const DecryptRequest> requests,
+      fcp::Scheduler* scheduler = nullptr) const;
+
  private:
+  // Unwraps the symmetric key, and initializes `aead_ctx`, which must be
+  // zeroed or cleaned up, to decrypt with it.
+  absl::Status InitAeadContext(
+      absl::string_view encrypted_symmetric_key,
+      absl::string_view encrypted_symmetric_key_associated_data,
+      absl::string_view encapped_key, EVP_AEAD_CTX* aead_ctx) const;
+
+  // Decrypts requests [begin, end) and stores their results in `results`,
+  // which is indexed like `requests`.
+  void DecryptRange(absl::Span<const DecryptRequest> requests, size_t begin,
+                    size_t end, absl::StatusOr<size_t>* results) const;
+
   const google::protobuf::Struct config_properties_;
   const EVP_HPKE_KEM* hpke_kem_;
   const EVP_HPKE_KDF* hpke_kdf_;
@@ -0,0 +1,133 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "fcp/base/monitoring.h"
+#include "fcp/base/scheduler.h"
+#include "fcp/confidentialcompute/crypto.h"
+
+// Open-source version of benchmarking library
+#include "benchmark//benchmark.h"
+
+namespace fcp {
+namespace confidential_compute {
+namespace {
+
+constexpr absl::string_view kAssociatedData = "associated data";
+constexpr int kNumMessages = 1024;
+
+// Messages encrypted for a decryptor, along with the requests to decrypt them
+// into preallocated buffers.
+struct EncryptedMessages {
+  std::vector<EncryptMessageResult> encrypt_results;
+  std::vector<std::string> plaintexts;
+  std::vector<DecryptRequest> requests;
+};
+
+// Encrypts kNumMessages messages of `message_size` bytes for `decryptor`.
+EncryptedMessages EncryptMessages(const MessageDecryptor& decryptor,
+                                  int64_t message_size) {
+  absl::StatusOr<std::string> public_key =
+      decryptor.GetPublicKey([](absl::string_view) { return ""; }, 0);
+  FCP_CHECK_STATUS(public_key.status());
+  MessageEncryptor encryptor;
+  EncryptedMessages messages;
+  messages.encrypt_results.reserve(kNumMessages);
+  messages.plaintexts.reserve(kNumMessages);
+  for (int i = 0; i < kNumMessages; ++i) {
+    absl::StatusOr<EncryptMessageResult> encrypt_result =
+        encryptor.Encrypt(std::string(message_size, static_cast<char>(i)),
+                          *public_key, kAssociatedData);
+    FCP_CHECK_STATUS(encrypt_result.status());
+    messages.encrypt_results.push_back(*std::move(encrypt_result));
+  }
+  for (const EncryptMessageResult& encrypt_result : messages.encrypt_results) {
+    messages.plaintexts.emplace_back(encrypt_result.ciphertext.size(), '\0');
+    messages.requests.push_back(DecryptRequest{
+        .ciphertext = encrypt_result.ciphertext,
+        .ciphertext_associated_data = kAssociatedData,
+        .encrypted_symmetric_key = encrypt_result.encrypted_symmetric_key,
+        .encrypted_symmetric_key_associated_data = kAssociatedData,
+        .encapped_key = encrypt_result.encapped_key,
+        .plaintext = absl::MakeSpan(messages.plaintexts.back()),
+    });
+  }
+  return messages;
+}
+
+// Decrypts the messages one at a time with MessageDecryptor::Decrypt.
+void BM_Decrypt(benchmark::State& state) {
+  const int64_t message_size = state.range(0);
+  MessageDecryptor decryptor;
+  EncryptedMessages messages = EncryptMessages(decryptor, message_size);
+
+  for (auto s : state) {
+    for (const DecryptRequest& request : messages.requests) {
+      absl::StatusOr<std::string> plaintext = decryptor.Decrypt(
+          request.ciphertext, request.ciphertext_associated_data,
+          request.encrypted_symmetric_key,
+          request.encrypted_symmetric_key_associated_data,
+          request.encapped_key);
+      FCP_CHECK_STATUS(plaintext.status());
+      benchmark::DoNotOptimize(plaintext);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kNumMessages);
+  state.SetBytesProcessed(state.iterations() * kNumMessages * message_size);
+}
+
+BENCHMARK(BM_Decrypt)->Arg(64)->Arg(4096)->Arg(65536);
+
+// Decrypts the messages with MessageDecryptor::DecryptBatch, using a thread
+// pool of `state.range(1)` threads, or only the calling thread if it is 0.
+void BM_DecryptBatch(benchmark::State& state) {
+  const int64_t message_size = state.range(0);
+  const int64_t num_threads = state.range(1);
+  MessageDecryptor decryptor;
+  EncryptedMessages messages = EncryptMessages(decryptor, message_size);
+  std::unique_ptr<Scheduler> scheduler;
+  if (num_threads > 0) {
+    scheduler = CreateThreadPoolScheduler(num_threads);
+  }
+
+  for (auto s : state) {
+    std::vector<absl::StatusOr<size_t>> results =
+        decryptor.DecryptBatch(messages.requests, scheduler.get());
+    for (const absl::StatusOr<size_t>& result : results) {
+      FCP_CHECK_STATUS(result.status());
+    }
+    benchmark::DoNotOptimize(messages.plaintexts.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kNumMessages);
+  state.SetBytesProcessed(state.iterations() * kNumMessages * message_size);
+  if (scheduler != nullptr) {
+    scheduler->WaitUntilIdle();
+  }
+}
+
+BENCHMARK(BM_DecryptBatch)
+    ->ArgsProduct({{64, 4096, 65536}, {0, 4, 16}})
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace confidential_compute
+}  // namespace fcp
@@ -18,8 +18,10 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <memory>
 #include <optional>
 #include <string>
+#include <vector>
 
 #include "google/protobuf/struct.pb.h"
 #include "gmock/gmock.h"
@@ -30,7 +32,9 @@
 #include "absl/strings/escaping.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "fcp/base/monitoring.h"
+#include "fcp/base/scheduler.h"
 #include "fcp/confidentialcompute/cose.h"
 #include "fcp/protos/confidentialcompute/confidential_transform.pb.h"
 #include "fcp/testing/testing.h"
@@ -63,6 +67,41 @@ void GenerateKeyPair(const EVP_HPKE_KEM& kem, std::string& public_key,
   public_key.resize(public_key_len);
 }
 
+// Encrypts `num_messages` distinct messages for `decryptor`, and returns the
+// encryption results along with the messages.
+void EncryptMessages(const MessageDecryptor& decryptor, int num_messages,
+                     absl::string_view associated_data,
+                     std::vector<std::string>& messages,
+                     std::vector<EncryptMessageResult>& encrypt_results) {
+  absl::StatusOr<std::string> recipient_public_key =
+      decryptor.GetPublicKey([](absl::string_view) { return ""; }, 0);
+  CHECK_OK(recipient_public_key);
+  MessageEncryptor encryptor;
+  for (int i = 0; i < num_messages; ++i) {
+    messages.push_back(absl::StrCat("plaintext message ", i));
+    absl::StatusOr<EncryptMessageResult> encrypt_result = encryptor.Encrypt(
+        messages.back(), *recipient_public_key, associated_data);
+    CHECK_OK(encrypt_result);
+    encrypt_results.push_back(*std::move(encrypt_result));
+  }
+}
+
+// Returns a request to decrypt `encrypt_result` into `plaintext`, which is
+// resized to fit.
+DecryptRequest CreateDecryptRequest(const EncryptMessageResult& encrypt_result,
+                                    absl::string_view associated_data,
+                                    std::string& plaintext) {
+  plaintext.resize(encrypt_result.ciphertext.size());
+  return DecryptRequest{
+      .ciphertext = encrypt_result.ciphertext,
+      .ciphertext_associated_data = associated_data,
+      .encrypted_symmetric_key = encrypt_result.encrypted_symmetric_key,
+      .encrypted_symmetric_key_associated_data = associated_data,
+      .encapped_key = encrypt_result.encapped_key,
+      .plaintext = absl::MakeSpan(plaintext),
+  };
+}
+
 TEST(CryptoTest, GetNextBlobNonceSucceedsAndIncrementsCounter) {
   std::string session_nonce = "session_nonce";
   NonceGenerator nonce_generator(session_nonce);
@@ -721,6 +760,120 @@ TEST(CryptoTest, DecryptWithInvalidAlgorithmFails) {
   EXPECT_THAT(decrypt_result, fcp::IsCode(INVALID_ARGUMENT));
 }
 
+TEST(CryptoTest, DecryptBatchWithoutScheduler) {
+  std::string associated_data = "plaintext associated data";
+  MessageDecryptor decryptor;
+  std::vector<std::string> messages;
+  std::vector<EncryptMessageResult> encrypt_results;
+  EncryptMessages(decryptor, 40, associated_data, messages, encrypt_results);
+
+  std::vector<std::string> plaintexts(messages.size());
+  std::vector<DecryptRequest> requests;
+  for (size_t i = 0; i < messages.size(); ++i) {
+    requests.push_back(CreateDecryptRequest(encrypt_results[i],
+                                            associated_data, plaintexts[i]));
+  }
+  std::vector<absl::StatusOr<size_t>> results =
+      decryptor.DecryptBatch(requests);
+
+  ASSERT_EQ(results.size(), messages.size());
+  for (size_t i = 0; i < messages.size(); ++i) {
+    ASSERT_OK(results[i]);
+    EXPECT_EQ(plaintexts[i].substr(0, *results[i]), messages[i]);
+  }
+}
+
+TEST(CryptoTest, DecryptBatchWithSchedulerMatchesDecrypt) {
+  std::string associated_data = "plaintext associated data";
+  MessageDecryptor decryptor;
+  std::vector<std::string> messages;
+  std::vector<EncryptMessageResult> encrypt_results;
+  EncryptMessages(decryptor, 200, associated_data, messages, encrypt_results);
+  // Corrupt some of the messages.
+  encrypt_results[17].ciphertext[0] ^= 1;
+  encrypt_results[100].encapped_key[0] ^= 1;
+
+  std::vector<std::string> plaintexts(messages.size());
+  std::vector<DecryptRequest> requests;
+  for (size_t i = 0; i < messages.size(); ++i) {
+    requests.push_back(CreateDecryptRequest(encrypt_results[i],
+                                            associated_data, plaintexts[i]));
+  }
+  std::unique_ptr<Scheduler> scheduler = CreateThreadPoolScheduler(4);
+  std::vector<absl::StatusOr<size_t>> results =
+      decryptor.DecryptBatch(requests, scheduler.get());
+
+  ASSERT_EQ(results.size(), messages.size());
+  for (size_t i = 0; i < messages.size(); ++i) {
+    absl::StatusOr<std::string> decrypt_result = decryptor.Decrypt(
+        encrypt_results[i].ciphertext, associated_data,
+        encrypt_results[i].encrypted_symmetric_key, associated_data,
+        encrypt_results[i].encapped_key);
+    if (i == 17 || i == 100) {
+      EXPECT_THAT(results[i], fcp::IsCode(INVALID_ARGUMENT));
+      EXPECT_THAT(decrypt_result, fcp::IsCode(INVALID_ARGUMENT));
+      continue;
+    }
+    ASSERT_OK(results[i]);
+    ASSERT_OK(decrypt_result);
+    EXPECT_EQ(plaintexts[i].substr(0, *results[i]), *decrypt_result);
+    EXPECT_EQ(*decrypt_result, messages[i]);
+  }
+  scheduler->WaitUntilIdle();
+}
+
+TEST(CryptoTest, DecryptBatchWithSharedSymmetricKey) {
+  std::string associated_data = "plaintext associated data";
+  MessageDecryptor decryptor;
+  std::vector<std::string> messages;
+  std::vector<EncryptMessageResult> encrypt_results;
+  EncryptMessages(decryptor, 2, associated_data, messages, encrypt_results);
+
+  // Runs of requests with the same wrapped key, one of which has the wrong
+  // ciphertext associated data.
+  std::vector<std::string> plaintexts(10);
+  std::vector<DecryptRequest> requests;
+  for (size_t i = 0; i < plaintexts.size(); ++i) {
+    requests.push_back(CreateDecryptRequest(encrypt_results[i < 6 ? 0 : 1],
+                                            associated_data, plaintexts[i]));
+  }
+  requests[3].ciphertext_associated_data = "wrong associated data";
+  std::vector<absl::StatusOr<size_t>> results =
+      decryptor.DecryptBatch(requests);
+
+  for (size_t i = 0; i < plaintexts.size(); ++i) {
+    if (i == 3) {
+      EXPECT_THAT(results[i], fcp::IsCode(INVALID_ARGUMENT));
+      continue;
+    }
+    ASSERT_OK(results[i]);
+    EXPECT_EQ(plaintexts[i].substr(0, *results[i]), messages[i < 6 ? 0 : 1]);
+  }
+}
+
+TEST(CryptoTest, DecryptBatchWithTooSmallBufferFails) {
+  std::string associated_data = "plaintext associated data";
+  MessageDecryptor decryptor;
+  std::vector<std::string> messages;
+  std::vector<EncryptMessageResult> encrypt_results;
+  EncryptMessages(decryptor, 1, associated_data, messages, encrypt_results);
+
+  std::string plaintext;
+  DecryptRequest request =
+      CreateDecryptRequest(encrypt_results[0], associated_data, plaintext);
+  request.plaintext = request.plaintext.subspan(0, messages[0].size() - 1);
+  std::vector<absl::StatusOr<size_t>> results =
+      decryptor.DecryptBatch(absl::MakeConstSpan(&request, 1));
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_THAT(results[0], fcp::IsCode(INVALID_ARGUMENT));
+}
+
+TEST(CryptoTest, DecryptBatchWithNoRequests) {
+  MessageDecryptor decryptor;
+  std::unique_ptr<Scheduler> scheduler = CreateThreadPoolScheduler(2);
+  EXPECT_TRUE(decryptor.DecryptBatch({}, scheduler.get()).empty());
+}
+
 TEST(EcdsaP256R1SignatureVerifierTest, VerifierWithInvalidPublicKeyFails) {
   // Verify a real signature with a bogus public key, which should fail.
   absl::StatusOr<EcdsaP256R1SignatureVerifier> verifier =
@@ -16,6 +16,7 @@
 #include "fcp/dictionary/dictionary.h"
 
 #include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -24,39 +25,39 @@
 
 #include "fcp/base/monitoring.h"
 #include "fcp/dictionary/dictionary.pb.h"
-#include "absl/container/node_hash_map.h"
+#include "fcp/dictionary/packed_vocabulary.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 
 namespace fcp {
 namespace dictionary {
 
-// Bidirectional map defined as hash_map from strings to int32_t paired with
-// a vector of those keys for reverse lookup.
-typedef std::pair<absl::node_hash_map<std::string, int32_t>,
-                  std::vector<std::string>>
-    HashVectorBimap;
-
 namespace {
 
-// Map a string to an ID, using a bidirectional map (an std::pair containing
-// two data structures for string -> int and for int -> string lookups).
-int32_t MapLookup(const HashVectorBimap& bimap, const absl::string_view tag) {
-  auto map_idx = bimap.first.find(tag);
-  return map_idx == bimap.first.end() ? Dictionary::kNotFound : map_idx->second;
+// Map a string to an ID, using a bidirectional map stored as a single packed
+// buffer (see PackedVocabulary).
+int32_t MapLookup(const PackedVocabulary& bimap, const absl::string_view tag) {
+  int32_t id = bimap.Find(tag);
+  return id < 0 ? Dictionary::kNotFound : id;
+}
+// Map strings to IDs, as MapLookup. Missing tokens are found as -1, which is
+// kNotFound.
+void MapBatchLookup(const PackedVocabulary& bimap,
+                    absl::Span<const absl::string_view> tags,
+                    absl::Span<int32_t> ids) {
+  static_assert(Dictionary::kNotFound == -1);
+  bimap.FindBatch(tags, ids);
 }
 // Lookup a token given its ID.
-std::string MapReverseLookup(const HashVectorBimap& bimap, int32_t id) {
-  if (id < 0 || id >= bimap.second.size()) {
-    return "";
-  }
-  return bimap.second[id];
+absl::string_view MapReverseLookup(const PackedVocabulary& bimap, int32_t id) {
+  return bimap.Token(id);
 }
 
-// Return the size of an stl-like data structure.
-int32_t GetSize(const HashVectorBimap& bimap) {
-  return static_cast<int32_t>(bimap.first.size());
+// Return the number of distinct tokens in the map.
+int32_t GetSize(const PackedVocabulary& bimap) {
+  return bimap.num_unique_tokens();
 }
 
 int32_t GetMaxSpecialId(const DictionaryDescription::SpecialIds& special_ids) {
@@ -107,8 +108,25 @@ class DictionaryImpl : public Dictionary {
     }
   }
 
+  void TokensToIds(absl::Span<const absl::string_view> tags,
+                   absl::Span<int32_t> ids) const override {
+    FCP_CHECK(tags.size() == ids.size());
+    MapBatchLookup(*bimap_, tags, ids);
+    for (int32_t& id : ids) {
+      id = id == kNotFound ? special_ids_.unk() : id + max_special_id_ + 1;
+    }
+  }
+
   std::string IdToToken(int32_t id) const override {
-    return MapReverseLookup(*bimap_, id - (max_special_id_ + 1));
+    return std::string(MapReverseLookup(*bimap_, id - (max_special_id_ + 1)));
+  }
+
+  void IdsToTokens(absl::Span<const int32_t> ids,
+                   absl::Span<absl::string_view> tokens) const override {
+    FCP_CHECK(ids.size() == tokens.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+      tokens[i] = MapReverseLookup(*bimap_, ids[i] - (max_special_id_ + 1));
+    }
   }
 
   bool IsSpecialId(int32_t token_id) const override {
@@ -130,6 +148,24 @@ class DictionaryImpl : public Dictionary {
   std::vector<int32_t> output_blocklist_ids_;
 };
 
+absl::StatusOr<PackedVocabulary> BuildPackedVocabulary(
+    const DictionaryDescription::Vocabulary::TokenIndex& index) {
+  std::vector<absl::string_view> tokens;
+  tokens.reserve(index.token_size());
+  for (absl::string_view token : index.token()) {
+    FCP_CHECK(!token.empty());
+    tokens.push_back(token);
+  }
+  return PackedVocabulary::Build(tokens);
+}
+
+absl::StatusOr<std::unique_ptr<Dictionary>> CreateWithPackedVocabulary(
+    PackedVocabulary vocabulary, const DictionaryDescription& description) {
+  return std::unique_ptr<Dictionary>(new DictionaryImpl<PackedVocabulary>(
+      std::make_unique<PackedVocabulary>(std::move(vocabulary)),
+      description.special_ids(), description.output_blocklist_ids()));
+}
+
 absl::Status IsOutputBlocklistIdsSortedAndUnique(
     const DictionaryDescription& description) {
   // All blocklist ids must be greater than max_special_id.
@@ -164,21 +200,40 @@ absl::StatusOr<std::unique_ptr<Dictionary>> Dictionary::Create(
   FCP_RETURN_IF_ERROR(IsOutputBlocklistIdsSortedAndUnique(description));
 
   if (description.vocabulary().has_index()) {
-    auto bimap = std::make_unique<HashVectorBimap>();
-    int i = 0;
-    bimap->second.reserve(description.vocabulary().index().token_size());
-    for (absl::string_view token : description.vocabulary().index().token()) {
-      FCP_CHECK(!token.empty());
-      bimap->first[token] = i++;
-      bimap->second.emplace_back(token);
-    }
-    return std::unique_ptr<Dictionary>(new DictionaryImpl<HashVectorBimap>(
-        std::move(bimap), description.special_ids(),
-    description.output_blocklist_ids()));
+    FCP_ASSIGN_OR_RETURN(
+        PackedVocabulary vocabulary,
+        BuildPackedVocabulary(description.vocabulary().index()));
+    return CreateWithPackedVocabulary(std::move(vocabulary), description);
   } else {
     return absl::InvalidArgumentError(
         "Invalid DictionaryDescription: no vocabulary specified.");
   }
 }
+
+absl::StatusOr<std::string> Dictionary::PackVocabulary(
+    const DictionaryDescription& description) {
+  if (!description.vocabulary().has_index()) {
+    return absl::InvalidArgumentError(
+        "Invalid DictionaryDescription: no vocabulary specified.");
+  }
+  FCP_ASSIGN_OR_RETURN(
+      PackedVocabulary vocabulary,
+      BuildPackedVocabulary(description.vocabulary().index()));
+  return std::string(vocabulary.data());
+}
+
+absl::StatusOr<std::unique_ptr<Dictionary>> Dictionary::Create(
+    const DictionaryDescription& description,
+    absl::string_view packed_vocabulary) {
+  if (description.has_vocabulary()) {
+    return absl::InvalidArgumentError(
+        "Cannot create a dictionary from both a packed vocabulary and a "
+        "vocabulary in its description");
+  }
+  FCP_RETURN_IF_ERROR(IsOutputBlocklistIdsSortedAndUnique(description));
+  FCP_ASSIGN_OR_RETURN(PackedVocabulary vocabulary,
+                       PackedVocabulary::FromBuffer(packed_vocabulary));
+  return CreateWithPackedVocabulary(std::move(vocabulary), description);
+}
 }  // namespace dictionary
 }  // namespace fcp
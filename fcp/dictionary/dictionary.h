@@ -23,6 +23,7 @@
 
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "fcp/dictionary/dictionary.pb.h"
 
 namespace fcp {
@@ -43,6 +44,17 @@ class Dictionary {
   // Returns "" on error.
   virtual std::string IdToToken(int32_t id) const = 0;
 
+  // Batch version of TokenToId: sets ids[i] to the id of tokens[i]. `ids` must
+  // have the same size as `tokens`.
+  virtual void TokensToIds(absl::Span<const absl::string_view> tokens,
+                           absl::Span<int32_t> ids) const = 0;
+
+  // Batch version of IdToToken: sets tokens[i] to the token for ids[i], or ""
+  // if it is not a valid id. The tokens point into the dictionary, and remain
+  // valid as long as it does. `tokens` must have the same size as `ids`.
+  virtual void IdsToTokens(absl::Span<const int32_t> ids,
+                           absl::Span<absl::string_view> tokens) const = 0;
+
   // Returns true if the given id is set via DictionaryDescription.SpecialIds.
   virtual bool IsSpecialId(int32_t id) const = 0;
 
@@ -64,6 +76,19 @@ class Dictionary {
   // Creates a dictionary from a self-describing DictionaryDescription proto.
   static absl::StatusOr<std::unique_ptr<Dictionary>> Create(
       const DictionaryDescription& description);
+
+  // Creates a dictionary from a DictionaryDescription without a vocabulary,
+  // using a vocabulary serialized by PackVocabulary() in place. This allows
+  // the vocabulary to be memory-mapped rather than parsed. `packed_vocabulary`
+  // must outlive the returned dictionary.
+  static absl::StatusOr<std::unique_ptr<Dictionary>> Create(
+      const DictionaryDescription& description,
+      absl::string_view packed_vocabulary);
+
+  // Serializes the vocabulary of `description` into the form accepted by the
+  // Create() overload above.
+  static absl::StatusOr<std::string> PackVocabulary(
+      const DictionaryDescription& description);
 };
 
 }  // namespace dictionary
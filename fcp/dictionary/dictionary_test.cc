@@ -15,6 +15,7 @@
  */
 #include "fcp/dictionary/dictionary.h"
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -25,7 +26,9 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 
 namespace fcp {
 namespace dictionary {
@@ -111,5 +114,71 @@ TEST_F(DictionaryTest, TestMapDictionaryReverseLookupWithSpecialTokenHoles) {
   EXPECT_EQ(dictionary->IdToToken(0xDEADBEEF), "");
   EXPECT_EQ(dictionary->IdToToken(1337), "");
 }
+
+TEST_F(DictionaryTest, TestMapDictionaryBatchLookup) {
+  std::unique_ptr<Dictionary> dictionary = *Dictionary::Create(
+      PARSE_TEXT_PROTO("special_ids: < unk: 1 bos: 4 > "
+                       "vocabulary: < index: <"
+                       "  token: 'a' token: 'b' token: 'c' > >"));
+  std::vector<absl::string_view> tokens;
+  for (int i = 0; i < 20; ++i) {
+    tokens.push_back(i % 2 == 0 ? "c" : "d");
+  }
+  tokens.push_back("a");
+  std::vector<int32_t> ids(tokens.size());
+  dictionary->TokensToIds(tokens, absl::MakeSpan(ids));
+  for (int i = 0; i < tokens.size(); ++i) {
+    EXPECT_EQ(ids[i], dictionary->TokenToId(tokens[i]));
+  }
+
+  std::vector<absl::string_view> reversed(ids.size());
+  dictionary->IdsToTokens(ids, absl::MakeSpan(reversed));
+  for (int i = 0; i < ids.size(); ++i) {
+    EXPECT_EQ(reversed[i], dictionary->IdToToken(ids[i]));
+  }
+  EXPECT_EQ(reversed[0], "c");
+  EXPECT_EQ(reversed[1], "");
+  EXPECT_EQ(reversed[20], "a");
+}
+
+TEST_F(DictionaryTest, TestMapDictionaryWithRepeatedToken) {
+  std::unique_ptr<Dictionary> dictionary = *Dictionary::Create(PARSE_TEXT_PROTO(
+      "vocabulary: < index: < token: 'a' token: 'b' token: 'a' > >"));
+  EXPECT_EQ(2, dictionary->Size());
+  EXPECT_EQ(2, dictionary->TokenToId("a"));
+  EXPECT_EQ(dictionary->IdToToken(0), "a");
+  EXPECT_EQ(dictionary->IdToToken(2), "a");
+}
+
+TEST_F(DictionaryTest, TestPackedVocabulary) {
+  absl::StatusOr<std::string> packed_vocabulary =
+      Dictionary::PackVocabulary(PARSE_TEXT_PROTO(
+          "vocabulary: < index: < token: 'a' token: 'b' token: 'c' > >"));
+  ASSERT_TRUE(packed_vocabulary.ok());
+  std::unique_ptr<Dictionary> dictionary = *Dictionary::Create(
+      PARSE_TEXT_PROTO("special_ids: < unk: 1 bos: 4 >"), *packed_vocabulary);
+
+  EXPECT_EQ(8, dictionary->Size());
+  EXPECT_EQ(5, dictionary->TokenToId("a"));
+  EXPECT_EQ(7, dictionary->TokenToId("c"));
+  EXPECT_EQ(1, dictionary->TokenToId("d"));
+  EXPECT_EQ(dictionary->IdToToken(6), "b");
+  EXPECT_EQ(dictionary->IdToToken(1337), "");
+}
+
+TEST_F(DictionaryTest, TestPackedVocabularyErrors) {
+  EXPECT_EQ(Dictionary::PackVocabulary(DictionaryDescription()).status().code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(Dictionary::Create(DictionaryDescription(), "not a vocabulary")
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+
+  DictionaryDescription description = PARSE_TEXT_PROTO(
+      "vocabulary: < index: < token: 'a' > >");
+  std::string packed_vocabulary = *Dictionary::PackVocabulary(description);
+  EXPECT_EQ(Dictionary::Create(description, packed_vocabulary).status().code(),
+            absl::StatusCode::kInvalidArgument);
+}
 }  // namespace dictionary
 }  // namespace fcp
@@ -0,0 +1,274 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fcp/dictionary/packed_vocabulary.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/config.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "fcp/base/monitoring.h"
+
+namespace fcp {
+namespace dictionary {
+
+namespace {
+
+constexpr uint32_t kPackedVocabularyMagic = 0x56504346;  // "FCPV"
+constexpr uint32_t kPackedVocabularyVersion = 1;
+// Marks an empty hash bucket. Buckets hold a (hash, index) pair, so that most
+// mismatches are rejected without touching the token arena.
+constexpr uint32_t kEmptyBucket = std::numeric_limits<uint32_t>::max();
+constexpr size_t kBucketSize = 2;
+// The number of tokens whose buckets FindBatch() prefetches at a time.
+constexpr size_t kFindBatchGroupSize = 16;
+
+// Returns the smallest power of two which keeps the hash table at most half
+// full.
+uint32_t NumBuckets(size_t num_tokens) {
+  uint32_t num_buckets = 1;
+  while (num_buckets < 2 * num_tokens) {
+    num_buckets *= 2;
+  }
+  return num_buckets;
+}
+
+void Store(std::string& buffer, size_t index, uint32_t value) {
+  std::memcpy(buffer.data() + index * sizeof(uint32_t), &value, sizeof(value));
+}
+
+}  // namespace
+
+uint32_t PackedVocabulary::Hash(absl::string_view token) {
+  // The hash is part of the serialized form, so it must be stable across
+  // processes (unlike absl::Hash). Tokens are consumed eight bytes at a time,
+  // each folded in with a multiply, and all loads have a fixed size so that
+  // they compile to plain moves.
+  constexpr uint64_t kMultiplier = 0x9e3779b97f4a7c15u;
+  auto mix = [](uint64_t hash, uint64_t word) {
+    hash = (hash ^ word) * kMultiplier;
+    return hash ^ (hash >> 29);
+  };
+  const char* data = token.data();
+  size_t remaining = token.size();
+  uint64_t hash = remaining * kMultiplier;
+  for (; remaining >= 8; data += 8, remaining -= 8) {
+    uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    hash = mix(hash, word);
+  }
+  // The remaining bytes are read with two possibly overlapping loads. Since
+  // the length is part of the hash, this loses no information.
+  if (remaining >= 4) {
+    uint32_t low, high;
+    std::memcpy(&low, data, sizeof(low));
+    std::memcpy(&high, data + remaining - 4, sizeof(high));
+    hash = mix(hash, (static_cast<uint64_t>(high) << 32) | low);
+  } else if (remaining > 0) {
+    hash = mix(hash, (static_cast<uint64_t>(static_cast<uint8_t>(data[0]))
+                      << 16) |
+                         (static_cast<uint64_t>(
+                              static_cast<uint8_t>(data[remaining / 2]))
+                          << 8) |
+                         static_cast<uint8_t>(data[remaining - 1]));
+  }
+  return static_cast<uint32_t>((hash * kMultiplier) >> 32);
+}
+
+absl::StatusOr<PackedVocabulary> PackedVocabulary::Build(
+    absl::Span<const absl::string_view> tokens) {
+  size_t arena_size = 0;
+  for (absl::string_view token : tokens) {
+    arena_size += token.size();
+  }
+  if (arena_size > std::numeric_limits<uint32_t>::max() ||
+      tokens.size() >= std::numeric_limits<int32_t>::max() / 2) {
+    return absl::InvalidArgumentError("Vocabulary too large to be packed");
+  }
+  const uint32_t num_buckets = NumBuckets(tokens.size());
+  const size_t offsets_start = kHeaderSize;
+  const size_t buckets_start = offsets_start + tokens.size() + 1;
+  const size_t arena_start =
+      (buckets_start + kBucketSize * num_buckets) * sizeof(uint32_t);
+
+  auto buffer = std::make_shared<std::string>(arena_start + arena_size, '\0');
+  Store(*buffer, kMagic, kPackedVocabularyMagic);
+  Store(*buffer, kVersion, kPackedVocabularyVersion);
+  Store(*buffer, kNumTokens, tokens.size());
+  Store(*buffer, kNumBuckets, num_buckets);
+  Store(*buffer, kArenaSize, arena_size);
+  for (uint32_t i = 0; i < num_buckets; ++i) {
+    Store(*buffer, buckets_start + kBucketSize * i + 1, kEmptyBucket);
+  }
+
+  uint32_t offset = 0;
+  for (size_t i = 0; i < tokens.size(); ++i) {
+    Store(*buffer, offsets_start + i, offset);
+    std::memcpy(buffer->data() + arena_start + offset, tokens[i].data(),
+                tokens[i].size());
+    offset += tokens[i].size();
+  }
+  Store(*buffer, offsets_start + tokens.size(), offset);
+
+  // Insert the tokens via a view of the partially written buffer, so that
+  // probing is shared with Find().
+  PackedVocabulary vocabulary(buffer, *buffer);
+  vocabulary.InitLayout();
+  uint32_t num_unique_tokens = 0;
+  for (size_t i = 0; i < tokens.size(); ++i) {
+    const uint32_t hash = Hash(tokens[i]);
+    uint32_t bucket = hash & (num_buckets - 1);
+    while (true) {
+      const size_t bucket_start = buckets_start + kBucketSize * bucket;
+      const uint32_t index = vocabulary.Load(bucket_start + 1);
+      if (index == kEmptyBucket) {
+        Store(*buffer, bucket_start, hash);
+        ++num_unique_tokens;
+      } else if (vocabulary.Load(bucket_start) != hash ||
+                 vocabulary.TokenUnchecked(index) != tokens[i]) {
+        bucket = (bucket + 1) & (num_buckets - 1);
+        continue;
+      }
+      Store(*buffer, bucket_start + 1, i);
+      break;
+    }
+  }
+  Store(*buffer, kNumUniqueTokens, num_unique_tokens);
+  return vocabulary;
+}
+
+absl::StatusOr<PackedVocabulary> PackedVocabulary::FromBuffer(
+    absl::string_view buffer) {
+  PackedVocabulary vocabulary(nullptr, buffer);
+  if (buffer.size() < kHeaderSize * sizeof(uint32_t) ||
+      vocabulary.Header(kMagic) != kPackedVocabularyMagic) {
+    return absl::InvalidArgumentError("Not a packed vocabulary");
+  }
+  if (vocabulary.Header(kVersion) != kPackedVocabularyVersion) {
+    return absl::InvalidArgumentError("Unsupported packed vocabulary version");
+  }
+  const uint64_t num_tokens = vocabulary.Header(kNumTokens);
+  const uint64_t num_buckets = vocabulary.Header(kNumBuckets);
+  const uint64_t arena_size = vocabulary.Header(kArenaSize);
+  if (num_tokens >= std::numeric_limits<int32_t>::max() / 2 ||
+      num_buckets != NumBuckets(num_tokens) ||
+      vocabulary.Header(kNumUniqueTokens) > num_tokens) {
+    return absl::InvalidArgumentError("Malformed packed vocabulary header");
+  }
+  const uint64_t arena_start =
+      (kHeaderSize + num_tokens + 1 + kBucketSize * num_buckets) *
+      sizeof(uint32_t);
+  if (buffer.size() != arena_start + arena_size) {
+    return absl::InvalidArgumentError("Packed vocabulary has the wrong size");
+  }
+  vocabulary.InitLayout();
+
+  // Validate everything which is later used to index into the buffer, so that
+  // lookups don't need any bounds checks.
+  uint32_t previous_offset = 0;
+  for (uint64_t i = 0; i <= num_tokens; ++i) {
+    const uint32_t offset = vocabulary.Load(vocabulary.OffsetsStart() + i);
+    if (offset < previous_offset || offset > arena_size ||
+        (i == 0 && offset != 0)) {
+      return absl::InvalidArgumentError("Malformed packed vocabulary offsets");
+    }
+    previous_offset = offset;
+  }
+  bool has_empty_bucket = false;
+  for (uint64_t i = 0; i < num_buckets; ++i) {
+    const uint32_t index =
+        vocabulary.Load(vocabulary.BucketsStart() + kBucketSize * i + 1);
+    if (index == kEmptyBucket) {
+      has_empty_bucket = true;
+    } else if (index >= num_tokens) {
+      return absl::InvalidArgumentError("Malformed packed vocabulary buckets");
+    }
+  }
+  // Probing for a missing token only terminates at an empty bucket.
+  if (!has_empty_bucket) {
+    return absl::InvalidArgumentError("Malformed packed vocabulary buckets");
+  }
+  return vocabulary;
+}
+
+void PackedVocabulary::InitLayout() {
+  const uint32_t num_buckets = Header(kNumBuckets);
+  buckets_ = data_.data() + BucketsStart() * sizeof(uint32_t);
+  arena_ = buckets_ + kBucketSize * num_buckets * sizeof(uint32_t);
+  bucket_mask_ = num_buckets - 1;
+}
+
+int32_t PackedVocabulary::FindWithHash(absl::string_view token,
+                                       uint32_t hash) const {
+  for (uint32_t bucket = hash & bucket_mask_;;
+       bucket = (bucket + 1) & bucket_mask_) {
+    uint32_t entry[kBucketSize];
+    std::memcpy(entry, buckets_ + bucket * sizeof(entry), sizeof(entry));
+    if (entry[1] == kEmptyBucket) {
+      return -1;
+    }
+    if (entry[0] == hash && TokenUnchecked(entry[1]) == token) {
+      return static_cast<int32_t>(entry[1]);
+    }
+  }
+}
+
+void PackedVocabulary::FindBatch(absl::Span<const absl::string_view> tokens,
+                                 absl::Span<int32_t> indices) const {
+  FCP_CHECK(tokens.size() == indices.size());
+  uint32_t hashes[kFindBatchGroupSize];
+  for (size_t start = 0; start < tokens.size(); start += kFindBatchGroupSize) {
+    const size_t group_size =
+        std::min(kFindBatchGroupSize, tokens.size() - start);
+    for (size_t i = 0; i < group_size; ++i) {
+      hashes[i] = Hash(tokens[start + i]);
+#if ABSL_HAVE_BUILTIN(__builtin_prefetch) || defined(__GNUC__)
+      __builtin_prefetch(buckets_ + (hashes[i] & bucket_mask_) * kBucketSize *
+                                        sizeof(uint32_t));
+#endif
+    }
+    for (size_t i = 0; i < group_size; ++i) {
+      indices[start + i] = FindWithHash(tokens[start + i], hashes[i]);
+    }
+  }
+}
+
+absl::string_view PackedVocabulary::Token(int32_t index) const {
+  if (index < 0 || index >= num_tokens()) {
+    return "";
+  }
+  return TokenUnchecked(index);
+}
+
+absl::string_view PackedVocabulary::TokenUnchecked(uint32_t index) const {
+  uint32_t offsets[2];
+  std::memcpy(offsets,
+              data_.data() + (OffsetsStart() + index) * sizeof(uint32_t),
+              sizeof(offsets));
+  return absl::string_view(arena_ + offsets[0], offsets[1] - offsets[0]);
+}
+
+}  // namespace dictionary
+}  // namespace fcp
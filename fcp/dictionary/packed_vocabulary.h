@@ -0,0 +1,130 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef FCP_DICTIONARY_PACKED_VOCABULARY_H_
+#define FCP_DICTIONARY_PACKED_VOCABULARY_H_
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+
+namespace fcp {
+namespace dictionary {
+
+// A read-only token <-> index map stored in a single contiguous buffer.
+//
+// The buffer holds all tokens back-to-back in one string arena, an offset per
+// token into that arena, and an open-addressing hash table of token indices.
+// Compared to a node-based hash map plus a vector of strings, this stores each
+// token once, needs no per-token allocations, and keeps lookups to two or three
+// cache lines.
+//
+// The buffer is also the serialized form: it can be written out via `data()`
+// and later used in place via `FromBuffer`, e.g. from a memory-mapped file.
+// All integers are stored in host byte order.
+class PackedVocabulary {
+ public:
+  // Builds a vocabulary where `tokens[i]` has index `i`. As with a hash map
+  // assigned in order, a token that appears more than once maps to its last
+  // index, while each occurrence keeps its own reverse mapping. Returns
+  // INVALID_ARGUMENT if the tokens don't fit the 32-bit offsets.
+  static absl::StatusOr<PackedVocabulary> Build(
+      absl::Span<const absl::string_view> tokens);
+
+  // Returns a vocabulary which uses the serialized form in `buffer` in place.
+  // `buffer` must remain valid as long as the returned value (or any copy of
+  // it) is used. Returns INVALID_ARGUMENT if `buffer` is malformed.
+  static absl::StatusOr<PackedVocabulary> FromBuffer(absl::string_view buffer);
+
+  // Returns the index of `token`, or -1 if it isn't in the vocabulary.
+  int32_t Find(absl::string_view token) const {
+    return FindWithHash(token, Hash(token));
+  }
+
+  // Sets `indices[i]` to `Find(tokens[i])`. The hash buckets of several tokens
+  // are prefetched at a time, so that their cache misses overlap.
+  // `indices` must have the same size as `tokens`.
+  void FindBatch(absl::Span<const absl::string_view> tokens,
+                 absl::Span<int32_t> indices) const;
+
+  // Returns the token at `index`, or "" if `index` is out of range. The result
+  // points into the buffer.
+  absl::string_view Token(int32_t index) const;
+
+  // Returns the number of distinct tokens.
+  int32_t num_unique_tokens() const { return Header(kNumUniqueTokens); }
+
+  // Returns the number of indices, including those of repeated tokens.
+  int32_t num_tokens() const { return Header(kNumTokens); }
+
+  // Returns the serialized form of the vocabulary.
+  absl::string_view data() const { return data_; }
+
+ private:
+  // Positions of the header fields, in units of uint32_t.
+  enum HeaderField {
+    kMagic,
+    kVersion,
+    kNumTokens,
+    kNumUniqueTokens,
+    kNumBuckets,
+    kArenaSize,
+    kHeaderSize
+  };
+
+  PackedVocabulary(std::shared_ptr<const std::string> owned,
+                   absl::string_view data)
+      : owned_(std::move(owned)), data_(data) {}
+
+  // Caches the positions derived from the header, which must be valid.
+  void InitLayout();
+
+  // Loads the uint32_t at `index` (in units of uint32_t) from the buffer. The
+  // buffer may not be suitably aligned, e.g. when it is part of a larger file.
+  uint32_t Load(size_t index) const {
+    uint32_t value;
+    std::memcpy(&value, data_.data() + index * sizeof(uint32_t),
+                sizeof(value));
+    return value;
+  }
+  uint32_t Header(HeaderField field) const { return Load(field); }
+  // Offset (in units of uint32_t) of the token offsets and the hash buckets.
+  size_t OffsetsStart() const { return kHeaderSize; }
+  size_t BucketsStart() const { return OffsetsStart() + num_tokens() + 1; }
+
+  static uint32_t Hash(absl::string_view token);
+  int32_t FindWithHash(absl::string_view token, uint32_t hash) const;
+  // Like Token(), but without the bounds check.
+  absl::string_view TokenUnchecked(uint32_t index) const;
+
+  // Holds the buffer if it was built rather than loaded; shared by copies.
+  std::shared_ptr<const std::string> owned_;
+  absl::string_view data_;
+  // Set by InitLayout(), so that lookups needn't re-read the header.
+  const char* buckets_ = nullptr;
+  const char* arena_ = nullptr;
+  uint32_t bucket_mask_ = 0;
+};
+
+}  // namespace dictionary
+}  // namespace fcp
+
+#endif  // FCP_DICTIONARY_PACKED_VOCABULARY_H_
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/node_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "fcp/base/monitoring.h"
+#include "fcp/dictionary/packed_vocabulary.h"
+
+// Open-source version of benchmarking library
+#include "benchmark//benchmark.h"
+
+namespace fcp {
+namespace dictionary {
+namespace {
+
+// The number of tokens looked up per iteration.
+constexpr int kNumLookups = 4096;
+
+struct Vocabulary {
+  std::vector<std::string> tokens;
+  // Tokens to look up: mostly known tokens, and some unknown ones.
+  std::vector<std::string> lookups;
+};
+
+// Returns a vocabulary of state.range(0) tokens.
+Vocabulary MakeVocabulary(const benchmark::State& state) {
+  Vocabulary vocabulary;
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    vocabulary.tokens.push_back(absl::StrCat("token_", i * 7919));
+  }
+  // Spread the lookups over the vocabulary, and make one in eight of them miss.
+  for (int64_t i = 0; i < kNumLookups; ++i) {
+    const int64_t index = (i * 104729) % state.range(0);
+    vocabulary.lookups.push_back(i % 8 == 0
+                                     ? absl::StrCat("unknown_", index)
+                                     : vocabulary.tokens[index]);
+  }
+  return vocabulary;
+}
+
+PackedVocabulary BuildPacked(const Vocabulary& vocabulary) {
+  std::vector<absl::string_view> views(vocabulary.tokens.begin(),
+                                       vocabulary.tokens.end());
+  absl::StatusOr<PackedVocabulary> packed = PackedVocabulary::Build(views);
+  FCP_CHECK(packed.ok());
+  return *std::move(packed);
+}
+
+// The representation PackedVocabulary replaced, for comparison.
+static void BM_NodeHashMapFind(benchmark::State& state) {
+  Vocabulary vocabulary = MakeVocabulary(state);
+  absl::node_hash_map<std::string, int32_t> map;
+  for (int32_t i = 0; i < vocabulary.tokens.size(); ++i) {
+    map[vocabulary.tokens[i]] = i;
+  }
+  for (auto s : state) {
+    for (const std::string& token : vocabulary.lookups) {
+      auto it = map.find(token);
+      benchmark::DoNotOptimize(it == map.end() ? -1 : it->second);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kNumLookups);
+}
+
+static void BM_PackedVocabularyFind(benchmark::State& state) {
+  Vocabulary vocabulary = MakeVocabulary(state);
+  PackedVocabulary packed = BuildPacked(vocabulary);
+  for (auto s : state) {
+    for (const std::string& token : vocabulary.lookups) {
+      benchmark::DoNotOptimize(packed.Find(token));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kNumLookups);
+}
+
+static void BM_PackedVocabularyFindBatch(benchmark::State& state) {
+  Vocabulary vocabulary = MakeVocabulary(state);
+  PackedVocabulary packed = BuildPacked(vocabulary);
+  std::vector<absl::string_view> lookups(vocabulary.lookups.begin(),
+                                         vocabulary.lookups.end());
+  std::vector<int32_t> indices(kNumLookups);
+  for (auto s : state) {
+    packed.FindBatch(lookups, absl::MakeSpan(indices));
+    benchmark::DoNotOptimize(indices.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kNumLookups);
+}
+
+static void BM_PackedVocabularyBuild(benchmark::State& state) {
+  Vocabulary vocabulary = MakeVocabulary(state);
+  for (auto s : state) {
+    benchmark::DoNotOptimize(BuildPacked(vocabulary).data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Vocabularies from 1K to 1M tokens.
+BENCHMARK(BM_NodeHashMapFind)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_PackedVocabularyFind)
+    ->RangeMultiplier(32)
+    ->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_PackedVocabularyFindBatch)
+    ->RangeMultiplier(32)
+    ->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_PackedVocabularyBuild)
+    ->RangeMultiplier(32)
+    ->Range(1 << 10, 1 << 20);
+
+}  // namespace
+}  // namespace dictionary
+}  // namespace fcp
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fcp/dictionary/packed_vocabulary.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "fcp/testing/testing.h"
+
+namespace fcp {
+namespace dictionary {
+namespace {
+
+using ::testing::Eq;
+
+TEST(PackedVocabularyTest, FindAndToken) {
+  std::vector<absl::string_view> tokens = {"a", "bb", "", "ccc"};
+  absl::StatusOr<PackedVocabulary> vocabulary = PackedVocabulary::Build(tokens);
+  ASSERT_OK(vocabulary);
+
+  EXPECT_THAT(vocabulary->num_tokens(), Eq(4));
+  EXPECT_THAT(vocabulary->num_unique_tokens(), Eq(4));
+  for (int32_t i = 0; i < tokens.size(); ++i) {
+    EXPECT_THAT(vocabulary->Find(tokens[i]), Eq(i));
+    EXPECT_THAT(vocabulary->Token(i), Eq(tokens[i]));
+  }
+  EXPECT_THAT(vocabulary->Find("b"), Eq(-1));
+  EXPECT_THAT(vocabulary->Find("cccc"), Eq(-1));
+  EXPECT_THAT(vocabulary->Token(-1), Eq(""));
+  EXPECT_THAT(vocabulary->Token(4), Eq(""));
+}
+
+TEST(PackedVocabularyTest, RepeatedTokenMapsToLastIndex) {
+  std::vector<absl::string_view> tokens = {"a", "b", "a"};
+  absl::StatusOr<PackedVocabulary> vocabulary = PackedVocabulary::Build(tokens);
+  ASSERT_OK(vocabulary);
+
+  EXPECT_THAT(vocabulary->num_tokens(), Eq(3));
+  EXPECT_THAT(vocabulary->num_unique_tokens(), Eq(2));
+  EXPECT_THAT(vocabulary->Find("a"), Eq(2));
+  EXPECT_THAT(vocabulary->Token(0), Eq("a"));
+  EXPECT_THAT(vocabulary->Token(2), Eq("a"));
+}
+
+TEST(PackedVocabularyTest, Empty) {
+  absl::StatusOr<PackedVocabulary> vocabulary = PackedVocabulary::Build({});
+  ASSERT_OK(vocabulary);
+
+  EXPECT_THAT(vocabulary->num_tokens(), Eq(0));
+  EXPECT_THAT(vocabulary->Find("a"), Eq(-1));
+  EXPECT_THAT(vocabulary->Token(0), Eq(""));
+}
+
+TEST(PackedVocabularyTest, ManyTokens) {
+  std::vector<std::string> strings;
+  for (int i = 0; i < 10000; ++i) {
+    strings.push_back(absl::StrCat("token", i));
+  }
+  std::vector<absl::string_view> tokens(strings.begin(), strings.end());
+  absl::StatusOr<PackedVocabulary> vocabulary = PackedVocabulary::Build(tokens);
+  ASSERT_OK(vocabulary);
+
+  for (int32_t i = 0; i < tokens.size(); ++i) {
+    ASSERT_THAT(vocabulary->Find(tokens[i]), Eq(i));
+    ASSERT_THAT(vocabulary->Token(i), Eq(tokens[i]));
+  }
+  EXPECT_THAT(vocabulary->Find("token10000"), Eq(-1));
+}
+
+TEST(PackedVocabularyTest, FindBatch) {
+  std::vector<std::string> strings;
+  for (int i = 0; i < 100; ++i) {
+    strings.push_back(absl::StrCat("token", i));
+  }
+  std::vector<absl::string_view> tokens(strings.begin(), strings.end());
+  absl::StatusOr<PackedVocabulary> vocabulary = PackedVocabulary::Build(tokens);
+  ASSERT_OK(vocabulary);
+
+  std::vector<absl::string_view> queries;
+  for (int i = 0; i < 200; i += 3) {
+    queries.push_back(i < 100 ? tokens[i] : "missing");
+  }
+  std::vector<int32_t> indices(queries.size());
+  vocabulary->FindBatch(queries, absl::MakeSpan(indices));
+  for (int i = 0; i < queries.size(); ++i) {
+    EXPECT_THAT(indices[i], Eq(vocabulary->Find(queries[i])));
+  }
+  EXPECT_THAT(indices[1], Eq(3));
+  EXPECT_THAT(indices.back(), Eq(-1));
+}
+
+TEST(PackedVocabularyTest, FromBufferRoundTrip) {
+  std::vector<absl::string_view> tokens = {"x", "yy", "zzz"};
+  absl::StatusOr<PackedVocabulary> built = PackedVocabulary::Build(tokens);
+  ASSERT_OK(built);
+  // Copy into a buffer at an odd address, as can happen when the vocabulary is
+  // part of a larger memory-mapped file.
+  std::string storage = absl::StrCat("_", built->data());
+  absl::string_view buffer = absl::string_view(storage).substr(1);
+
+  absl::StatusOr<PackedVocabulary> loaded =
+      PackedVocabulary::FromBuffer(buffer);
+  ASSERT_OK(loaded);
+  EXPECT_THAT(loaded->data().data(), Eq(buffer.data()));
+  for (int32_t i = 0; i < tokens.size(); ++i) {
+    EXPECT_THAT(loaded->Find(tokens[i]), Eq(i));
+    EXPECT_THAT(loaded->Token(i), Eq(tokens[i]));
+  }
+}
+
+TEST(PackedVocabularyTest, CopiesShareBuffer) {
+  std::vector<absl::string_view> tokens = {"a", "b"};
+  absl::StatusOr<PackedVocabulary> built = PackedVocabulary::Build(tokens);
+  ASSERT_OK(built);
+  PackedVocabulary copy = *built;
+  built = absl::InternalError("");
+
+  EXPECT_THAT(copy.Find("b"), Eq(1));
+  EXPECT_THAT(copy.Token(0), Eq("a"));
+}
+
+TEST(PackedVocabularyTest, FromBufferRejectsMalformedBuffers) {
+  std::vector<absl::string_view> tokens = {"a", "b", "c"};
+  absl::StatusOr<PackedVocabulary> built = PackedVocabulary::Build(tokens);
+  ASSERT_OK(built);
+  std::string data(built->data());
+
+  EXPECT_THAT(PackedVocabulary::FromBuffer(""),
+              IsCode(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(PackedVocabulary::FromBuffer(absl::string_view(data).substr(1)),
+              IsCode(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(PackedVocabulary::FromBuffer(data + "x"),
+              IsCode(absl::StatusCode::kInvalidArgument));
+
+  std::string wrong_version = data;
+  wrong_version[4] ^= 1;
+  EXPECT_THAT(PackedVocabulary::FromBuffer(wrong_version),
+              IsCode(absl::StatusCode::kInvalidArgument));
+
+  // The offset of the last token points past the end of the arena.
+  std::string bad_offset = data;
+  bad_offset[(6 + 3) * sizeof(uint32_t)] = 100;
+  EXPECT_THAT(PackedVocabulary::FromBuffer(bad_offset),
+              IsCode(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace dictionary
+}  // namespace fcp
@@ -27,6 +27,7 @@
 
 #include "absl/container/node_hash_map.h"
 #include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
 #include "fcp/base/monitoring.h"
 #include "fcp/secagg/server/experiments_names.h"
 #include "fcp/secagg/server/secagg_scheduler.h"
@@ -133,10 +134,15 @@ Status AesSecAggServerProtocolImpl::HandleMaskedInputCollectionResponse(
     // task to process the queue that we just initiated, which will happen
     // eventually.
     size_t is_queue_empty;
+    size_t queue_size;
     {
       absl::MutexLock lock(&mutex_);
       is_queue_empty = masked_input_queue_.empty();
       masked_input_queue_.emplace_back(std::move(checked_masked_vectors));
+      queue_size = masked_input_queue_.size();
+    }
+    if (metrics()) {
+      metrics()->MaskedInputQueueSizes(queue_size);
     }
     if (is_queue_empty) {
       // TODO(team): Abort should handle the situation where `this` has
@@ -223,5 +229,70 @@ AsyncToken AesSecAggServerProtocolImpl::StartPrng(
   });
   return accumulator;
 }
+
+void AesSecAggServerProtocolImpl::WriteSnapshot(
+    SecAggServerSnapshot* snapshot) const {
+  SecAggServerProtocolImpl::WriteSnapshot(snapshot);
+  if (snapshot->state() != SecAggServerStateKind::R3_UNMASKING &&
+      snapshot->state() != SecAggServerStateKind::PRNG_RUNNING) {
+    return;
+  }
+  FCP_CHECK(masked_input_);
+  auto& snapshot_masked_input = *snapshot->mutable_masked_input();
+  for (const auto& [name, vector] : *masked_input_) {
+    // The packed representation is several times smaller than the unpacked
+    // one for typical moduli.
+    SecAggVector packed(vector, vector.modulus());
+    SecAggServerSnapshot::MaskedInputVector& snapshot_vector =
+        snapshot_masked_input[name];
+    snapshot_vector.set_modulus(packed.modulus());
+    snapshot_vector.set_num_elements(packed.num_elements());
+    snapshot_vector.set_packed_bytes(std::move(packed).TakePackedBytes());
+  }
+}
+
+Status AesSecAggServerProtocolImpl::RestoreSnapshot(
+    const SecAggServerSnapshot& snapshot) {
+  FCP_RETURN_IF_ERROR(SecAggServerProtocolImpl::RestoreSnapshot(snapshot));
+  if (snapshot.state() != SecAggServerStateKind::R3_UNMASKING &&
+      snapshot.state() != SecAggServerStateKind::PRNG_RUNNING) {
+    return ::absl::OkStatus();
+  }
+  if (snapshot.masked_input().size() != input_vector_specs().size()) {
+    return ::absl::InvalidArgumentError(
+        "The snapshot doesn't have the expected number of masked input "
+        "vectors.");
+  }
+  auto masked_input = std::make_unique<SecAggUnpackedVectorMap>();
+  for (const InputVectorSpecification& vector_spec : input_vector_specs()) {
+    auto it = snapshot.masked_input().find(vector_spec.name());
+    if (it == snapshot.masked_input().end()) {
+      return ::absl::InvalidArgumentError(
+          absl::StrCat("The snapshot is missing the masked input vector ",
+                       vector_spec.name(), "."));
+    }
+    const SecAggServerSnapshot::MaskedInputVector& snapshot_vector =
+        it->second;
+    if (snapshot_vector.modulus() != vector_spec.modulus() ||
+        snapshot_vector.num_elements() != vector_spec.length() ||
+        snapshot_vector.packed_bytes().size() !=
+            DivideRoundUp(
+                vector_spec.length() *
+                    SecAggVector::GetBitWidth(vector_spec.modulus()),
+                8)) {
+      return ::absl::InvalidArgumentError(
+          absl::StrCat("The masked input vector ", vector_spec.name(),
+                       " in the snapshot doesn't match its specification."));
+    }
+    masked_input->emplace(
+        vector_spec.name(),
+        SecAggUnpackedVector(SecAggVector(snapshot_vector.packed_bytes(),
+                                          vector_spec.modulus(),
+                                          vector_spec.length())));
+  }
+  masked_input_ = std::move(masked_input);
+  return ::absl::OkStatus();
+}
+
 }  // namespace secagg
 }  // namespace fcp
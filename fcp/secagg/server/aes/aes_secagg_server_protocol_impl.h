@@ -93,6 +93,12 @@ class AesSecAggServerProtocolImpl
   AsyncToken StartPrng(const PrngWorkItems& work_items,
                        std::function<void(Status)> done_callback) override;
 
+  // In addition to the base class data, the snapshots of rounds 3 and later
+  // include the sum of the masked inputs received in round 2.
+  void WriteSnapshot(SecAggServerSnapshot* snapshot) const override;
+
+  Status RestoreSnapshot(const SecAggServerSnapshot& snapshot) override;
+
  private:
   std::unique_ptr<SecAggUnpackedVectorMap> masked_input_;
   // Protects masked_input_queue_.
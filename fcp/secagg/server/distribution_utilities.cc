@@ -16,6 +16,7 @@
 
 #include "fcp/secagg/server/distribution_utilities.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <memory>
@@ -136,5 +137,74 @@ double HypergeometricDistribution::FindQuantileImpl(double quantile,
   return result;
 }
 
+StatusOr<std::unique_ptr<IncrementalHypergeometricQuantile>>
+IncrementalHypergeometricQuantile::Create(int total, int marked, int sampled,
+                                          double quantile) {
+  // Validates the other parameters.
+  FCP_RETURN_IF_ERROR(
+      HypergeometricDistribution::Create(total, marked, sampled));
+  if (!(quantile > 0 && quantile <= 0.5)) {
+    return FCP_STATUS(FAILED_PRECONDITION)
+           << "The quantile should be in (0, 0.5]. Value provided = "
+           << quantile;
+  }
+  auto result =
+      std::unique_ptr<IncrementalHypergeometricQuantile>(
+          new IncrementalHypergeometricQuantile(total, marked, sampled,
+                                                quantile));
+  result->Reset();
+  return result;
+}
+
+void IncrementalHypergeometricQuantile::Reset() {
+  auto distribution =
+      HypergeometricDistribution::Create(total_, marked_, sampled_).value();
+  x_ = distribution->FindQuantile(quantile_) + 1;
+  cdf_ = distribution->CDF(x_);
+  pmf_ = distribution->PMF(x_);
+}
+
+void IncrementalHypergeometricQuantile::IncrementSampled() {
+  FCP_CHECK(sampled_ < total_)
+      << "The sample size can't exceed the total population " << total_;
+  if (pmf_ > 0) {
+    cdf_ -= pmf_ * (marked_ - x_) / (total_ - sampled_);
+    pmf_ *= total_ - marked_ - sampled_ + x_;
+    pmf_ /= total_ - sampled_;
+    pmf_ *= sampled_ + 1;
+    pmf_ /= sampled_ + 1 - x_;
+    ++sampled_;
+    if (x_ <= std::max(0, sampled_ - (total_ - marked_))) {
+      // x_ is the smallest value in the support, so its cdf is its probability
+      // mass. Setting it so discards the rounding errors accumulated in cdf_.
+      cdf_ = pmf_;
+    }
+  } else {
+    // x_ is outside of the support, so the cdf is either 0 or 1, and the
+    // recurrence can't be continued.
+    ++sampled_;
+    Reset();
+    return;
+  }
+  WalkUp();
+}
+
+void IncrementalHypergeometricQuantile::WalkUp() {
+  while (cdf_ < quantile_ && x_ < sampled_) {
+    if (pmf_ > 0) {
+      pmf_ *= marked_ - x_;
+      pmf_ *= sampled_ - x_;
+      pmf_ /= x_ + 1;
+      pmf_ /= total_ - marked_ - sampled_ + x_ + 1;
+    } else {
+      pmf_ = HypergeometricDistribution::Create(total_, marked_, sampled_)
+                 .value()
+                 ->PMF(x_ + 1);
+    }
+    cdf_ += pmf_;
+    ++x_;
+  }
+}
+
 }  // namespace secagg
 }  // namespace fcp
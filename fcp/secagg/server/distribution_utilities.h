@@ -57,6 +57,59 @@ class HypergeometricDistribution {
   double FindQuantileImpl(double quantile, int counted);
 };
 
+// Tracks a lower quantile of a Hypergeometric distribution as its sample size
+// grows one by one. Rather than recomputing the cdf from scratch for every
+// sample size, as HypergeometricDistribution::FindQuantile would, it is updated
+// using
+//   P[X_{s+1} <= x] = P[X_s <= x] - P[X_s = x] * (marked - x) / (total - s)
+// where X_s is the number of marked items among s sampled ones. As the
+// quantile can only increase with the sample size, it is then found by
+// walking up from the previous one.
+class IncrementalHypergeometricQuantile {
+ public:
+  // Starts tracking the quantile'th quantile (for quantile in (0, 0.5]) of the
+  // Hypergeometric distribution with the given parameters.
+  static StatusOr<std::unique_ptr<IncrementalHypergeometricQuantile>> Create(
+      int total, int marked, int sampled, double quantile);
+
+  // Increases the sample size by one. The sample size must be less than the
+  // total population.
+  void IncrementSampled();
+
+  int sampled() const { return sampled_; }
+
+  // Returns the quantile for the current sample size, with the same meaning
+  // as HypergeometricDistribution::FindQuantile(quantile).
+  double Quantile() const { return x_ - 1; }
+
+  // Returns the cumulative distribution function at Quantile().
+  double CDFAtQuantile() const { return cdf_ - pmf_; }
+
+ private:
+  const int total_;
+  const int marked_;
+  const double quantile_;
+  int sampled_;
+  // The smallest value whose cdf is at least quantile_, along with its cdf and
+  // probability mass for the current sample size.
+  double x_;
+  double cdf_;
+  double pmf_;
+
+  IncrementalHypergeometricQuantile(int total, int marked, int sampled,
+                                    double quantile)
+      : total_(total),
+        marked_(marked),
+        quantile_(quantile),
+        sampled_(sampled) {}
+
+  // Sets x_, cdf_ and pmf_ from scratch for the current sample size.
+  void Reset();
+
+  // Walks x_ up until its cdf is at least quantile_.
+  void WalkUp();
+};
+
 }  // namespace secagg
 }  // namespace fcp
 #endif  // FCP_SECAGG_SERVER_DISTRIBUTION_UTILITIES_H_
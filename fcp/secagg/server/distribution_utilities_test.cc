@@ -161,6 +161,66 @@ INSTANTIATE_TEST_SUITE_P(HypergeometricQuantileTests, HypergeometricQuantile,
                               {1e-18, 1000000, 200000, 500000, 98248,
                                101751}}));
 
+TEST(IncrementalHypergeometricQuantileCreate, RejectsInvalidInputs) {
+  ASSERT_FALSE(IncrementalHypergeometricQuantile::Create(10, 11, 5, 0.1).ok());
+  ASSERT_FALSE(IncrementalHypergeometricQuantile::Create(10, 5, 11, 0.1).ok());
+  ASSERT_FALSE(IncrementalHypergeometricQuantile::Create(10, 5, 5, 0).ok());
+  ASSERT_FALSE(IncrementalHypergeometricQuantile::Create(10, 5, 5, 0.6).ok());
+}
+
+struct IncrementalHypergeometricQuantileInstance {
+  const double probability;
+  const int total;
+  const int marked;
+  const int initial_sampled;
+};
+
+class IncrementalHypergeometricQuantileTest
+    : public ::testing::TestWithParam<
+          IncrementalHypergeometricQuantileInstance> {};
+
+TEST_P(IncrementalHypergeometricQuantileTest, ReturnsQuantileForEachSize) {
+  const IncrementalHypergeometricQuantileInstance& test_params = GetParam();
+  auto quantile = IncrementalHypergeometricQuantile::Create(
+      test_params.total, test_params.marked, test_params.initial_sampled,
+      test_params.probability);
+  ASSERT_THAT(quantile, IsOk());
+  for (int sampled = test_params.initial_sampled; sampled <= test_params.total;
+       ++sampled) {
+    ASSERT_EQ(quantile.value()->sampled(), sampled);
+    auto p = HypergeometricDistribution::Create(
+        test_params.total, test_params.marked, sampled);
+    ASSERT_THAT(p, IsOk());
+    // The result is the largest value whose cdf is less than the probability.
+    double result = quantile.value()->Quantile();
+    double cdf = p.value()->CDF(result);
+    ASSERT_LT(cdf, test_params.probability) << "for sample size " << sampled;
+    ASSERT_GE(p.value()->CDF(result + 1), test_params.probability)
+        << "for sample size " << sampled;
+    // The cdf is only ever compared to the probability, so it needs to be
+    // accurate relative to that.
+    EXPECT_NEAR(quantile.value()->CDFAtQuantile(), cdf,
+                1e-9 * (cdf + test_params.probability))
+        << "for sample size " << sampled;
+    if (sampled < test_params.total) {
+      quantile.value()->IncrementSampled();
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    IncrementalHypergeometricQuantileTests,
+    IncrementalHypergeometricQuantileTest,
+    ::testing::ValuesIn<IncrementalHypergeometricQuantileInstance>(
+        {{0.5, 10, 0, 0},
+         {0.2, 10, 10, 0},
+         {0.3, 15, 6, 2},
+         {0.0001, 98, 63, 0},
+         {1e-05, 187, 105, 10},
+         {3e-08, 980, 392, 20},
+         {1.1e-09, 1489, 312, 370},
+         {1e-18, 20000, 4000, 100}}));
+
 }  // namespace
 }  // namespace secagg
 }  // namespace fcp
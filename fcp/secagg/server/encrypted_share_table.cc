@@ -0,0 +1,78 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fcp/secagg/server/encrypted_share_table.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+
+namespace fcp {
+namespace secagg {
+
+EncryptedShareTable::EncryptedShareTable(size_t num_recipients,
+                                         size_t num_shares_per_recipient)
+    : num_shares_per_recipient_(num_shares_per_recipient),
+      entries_(num_recipients * num_shares_per_recipient) {}
+
+void EncryptedShareTable::Set(uint32_t recipient, size_t index,
+                              absl::string_view share) {
+  Entry& entry = entries_[recipient * num_shares_per_recipient_ + index];
+  if (share.empty()) {
+    entry = Entry();
+    return;
+  }
+  char* data = Allocate(share.size());
+  std::memcpy(data, share.data(), share.size());
+  entry.data = data;
+  entry.size = share.size();
+}
+
+void EncryptedShareTable::Erase(uint32_t recipient, size_t index) {
+  entries_[recipient * num_shares_per_recipient_ + index] = Entry();
+}
+
+void EncryptedShareTable::Clear() {
+  // Swap rather than clear, so that the memory is actually released.
+  std::vector<Entry>().swap(entries_);
+  std::vector<std::unique_ptr<char[]>>().swap(blocks_);
+  block_free_ = nullptr;
+  block_remaining_ = 0;
+  next_block_size_ = kMinBlockSize;
+}
+
+char* EncryptedShareTable::Allocate(size_t size) {
+  if (size > block_remaining_) {
+    size_t block_size = std::max(next_block_size_, size);
+    next_block_size_ = std::min(kMaxBlockSize, 2 * next_block_size_);
+    // Not value-initialized, since every byte is written before it's read.
+    blocks_.emplace_back(new char[block_size]);
+    block_free_ = blocks_.back().get();
+    block_remaining_ = block_size;
+  }
+  char* data = block_free_;
+  block_free_ += size;
+  block_remaining_ -= size;
+  return data;
+}
+
+}  // namespace secagg
+}  // namespace fcp
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FCP_SECAGG_SERVER_ENCRYPTED_SHARE_TABLE_H_
+#define FCP_SECAGG_SERVER_ENCRYPTED_SHARE_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+
+namespace fcp {
+namespace secagg {
+
+// Holds the encrypted pairs of key shares which the server collects in round 1
+// and forwards in round 2. Entry (i, j) is the share to be sent to client i,
+// received from client i's j-th neighbor.
+//
+// Rather than keeping every share in its own string, the share bytes are
+// copied into large blocks, and the table itself is a flat array of
+// references into those blocks, laid out by recipient. Shares are never moved
+// once stored, so references returned by Get() stay valid until Clear() is
+// called or the table is destroyed.
+//
+// Thread safety: concurrent calls to Get() are safe, as long as no other
+// method is called at the same time.
+class EncryptedShareTable {
+ public:
+  EncryptedShareTable(size_t num_recipients, size_t num_shares_per_recipient);
+
+  EncryptedShareTable(EncryptedShareTable&&) = default;
+  EncryptedShareTable& operator=(EncryptedShareTable&&) = default;
+  EncryptedShareTable(const EncryptedShareTable&) = delete;
+  EncryptedShareTable& operator=(const EncryptedShareTable&) = delete;
+
+  // Stores a copy of `share` as entry (recipient, index), replacing any
+  // previous entry.
+  void Set(uint32_t recipient, size_t index, absl::string_view share);
+
+  // Returns entry (recipient, index), or an empty string if it isn't set.
+  absl::string_view Get(uint32_t recipient, size_t index) const {
+    const Entry& entry =
+        entries_[recipient * num_shares_per_recipient_ + index];
+    return absl::string_view(entry.data, entry.size);
+  }
+
+  // Empties entry (recipient, index). Its bytes are only released by Clear().
+  void Erase(uint32_t recipient, size_t index);
+
+  // Empties all entries and releases all memory held by the table.
+  void Clear();
+
+ private:
+  struct Entry {
+    const char* data = nullptr;
+    size_t size = 0;
+  };
+
+  // Returns `size` bytes of storage which won't move for the table's lifetime.
+  char* Allocate(size_t size);
+
+  // Blocks start small, so that small cohorts don't pay for a large block,
+  // and double in size up to a limit, so that large cohorts need few
+  // allocations.
+  static constexpr size_t kMinBlockSize = 4096;
+  static constexpr size_t kMaxBlockSize = 1 << 20;
+
+  size_t num_shares_per_recipient_;
+  std::vector<Entry> entries_;
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  // The unused part of the last block.
+  char* block_free_ = nullptr;
+  size_t block_remaining_ = 0;
+  size_t next_block_size_ = kMinBlockSize;
+};
+
+}  // namespace secagg
+}  // namespace fcp
+
+#endif  // FCP_SECAGG_SERVER_ENCRYPTED_SHARE_TABLE_H_
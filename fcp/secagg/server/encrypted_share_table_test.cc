@@ -0,0 +1,110 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fcp/secagg/server/encrypted_share_table.h"
+
+#include <string>
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+
+namespace fcp {
+namespace secagg {
+namespace {
+
+TEST(EncryptedShareTableTest, EntriesStartEmpty) {
+  EncryptedShareTable table(3, 2);
+  for (uint32_t i = 0; i < 3; ++i) {
+    for (size_t j = 0; j < 2; ++j) {
+      EXPECT_TRUE(table.Get(i, j).empty());
+    }
+  }
+}
+
+TEST(EncryptedShareTableTest, SetStoresCopies) {
+  EncryptedShareTable table(3, 2);
+  std::string share = "share";
+  table.Set(1, 0, share);
+  share = "other";
+  table.Set(2, 1, share);
+
+  EXPECT_EQ(table.Get(1, 0), "share");
+  EXPECT_EQ(table.Get(2, 1), "other");
+  EXPECT_TRUE(table.Get(1, 1).empty());
+  EXPECT_TRUE(table.Get(2, 0).empty());
+}
+
+TEST(EncryptedShareTableTest, SetReplacesEntry) {
+  EncryptedShareTable table(1, 1);
+  table.Set(0, 0, "first");
+  table.Set(0, 0, "second");
+  EXPECT_EQ(table.Get(0, 0), "second");
+  table.Set(0, 0, "");
+  EXPECT_TRUE(table.Get(0, 0).empty());
+}
+
+TEST(EncryptedShareTableTest, EraseEmptiesOnlyThatEntry) {
+  EncryptedShareTable table(2, 2);
+  table.Set(0, 1, "a");
+  table.Set(1, 0, "b");
+  table.Erase(0, 1);
+  EXPECT_TRUE(table.Get(0, 1).empty());
+  EXPECT_EQ(table.Get(1, 0), "b");
+}
+
+TEST(EncryptedShareTableTest, EntriesDontMoveAsTableGrows) {
+  constexpr int kNumRecipients = 100;
+  constexpr int kNumShares = 50;
+  EncryptedShareTable table(kNumRecipients, kNumShares);
+  table.Set(0, 0, "first");
+  absl::string_view first = table.Get(0, 0);
+
+  // Enough shares of varying sizes to need several blocks, including some
+  // larger than a block.
+  for (uint32_t i = 0; i < kNumRecipients; ++i) {
+    for (size_t j = 0; j < kNumShares; ++j) {
+      if (i == 0 && j == 0) continue;
+      table.Set(i, j, std::string(((i * kNumShares + j) % 7) * 40,
+                                  static_cast<char>('a' + j % 26)));
+    }
+  }
+  table.Set(kNumRecipients - 1, 0, std::string(1 << 21, 'z'));
+
+  EXPECT_EQ(first.data(), table.Get(0, 0).data());
+  EXPECT_EQ(first, "first");
+  for (uint32_t i = 0; i < kNumRecipients - 1; ++i) {
+    for (size_t j = 0; j < kNumShares; ++j) {
+      if (i == 0 && j == 0) continue;
+      EXPECT_EQ(table.Get(i, j),
+                std::string(((i * kNumShares + j) % 7) * 40,
+                            static_cast<char>('a' + j % 26)));
+    }
+  }
+  EXPECT_EQ(table.Get(kNumRecipients - 1, 0), std::string(1 << 21, 'z'));
+}
+
+TEST(EncryptedShareTableTest, MoveKeepsEntries) {
+  EncryptedShareTable table(2, 1);
+  table.Set(1, 0, absl::StrCat("share", 1));
+  EncryptedShareTable moved = std::move(table);
+  EXPECT_EQ(moved.Get(1, 0), "share1");
+}
+
+}  // namespace
+}  // namespace secagg
+}  // namespace fcp
@@ -20,7 +20,12 @@
 #include <cmath>
 #include <memory>
 #include <optional>
+#include <tuple>
 
+#include "absl/base/attributes.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
 #include "fcp/base/monitoring.h"
 #include "fcp/secagg/server/distribution_utilities.h"
 #include "fcp/secagg/server/secagg_server_enums.pb.h"
@@ -100,14 +105,45 @@ class HararyGraphParameterFinder {
   // participants and a fraction of [adversarial_rate_] (resp. [dropout_rate_])
   // adversarial clients (resp. dropouts).
   StatusOr<HararyGraphParameters> ComputeDegreeAndThreshold() {
-    for (int number_of_neighbors = 2;
-         number_of_neighbors < number_of_clients_ - 1;
-         number_of_neighbors += 2) {
-      auto threshold = CheckNumberOfNeighbors(number_of_neighbors);
-      if (threshold.has_value()) {
-        HararyGraphParameters params = {number_of_clients_, number_of_neighbors,
-                                        threshold.value()};
-        return params;
+    int number_of_neighbors = MinNumberOfNeighborsForConnectivity();
+    if (number_of_neighbors < number_of_clients_ - 1) {
+      // The number of adversarial (resp. surviving) neighbors of a client
+      // follows a Hypergeometric distribution whose sample size is the degree.
+      // Its quantiles are updated incrementally as the degree increases.
+      int upper_bound_adversarial_clients = static_cast<int>(
+          std::floor((adversarial_rate_ + kSmall) * number_of_clients_));
+      int lower_bound_surviving_clients = static_cast<int>(
+          std::ceil((1 - dropout_rate_ - kSmall) * number_of_clients_));
+      // The upper quantile of the number of adversarial neighbors is tracked
+      // as a lower quantile of the number of non-adversarial neighbors.
+      FCP_ASSIGN_OR_RETURN(
+          auto num_non_adversarial_neighbors_quantile,
+          IncrementalHypergeometricQuantile::Create(
+              number_of_clients_,
+              number_of_clients_ - upper_bound_adversarial_clients,
+              number_of_neighbors, SecurityQuantile()));
+      FCP_ASSIGN_OR_RETURN(auto num_surviving_neighbors_quantile,
+                           IncrementalHypergeometricQuantile::Create(
+                               number_of_clients_,
+                               lower_bound_surviving_clients,
+                               number_of_neighbors, CorrectnessQuantile()));
+      while (true) {
+        auto threshold = CheckNumberOfNeighbors(
+            number_of_neighbors, *num_non_adversarial_neighbors_quantile,
+            *num_surviving_neighbors_quantile);
+        if (threshold.has_value()) {
+          HararyGraphParameters params = {
+              number_of_clients_, number_of_neighbors, threshold.value()};
+          return params;
+        }
+        number_of_neighbors += 2;
+        if (number_of_neighbors >= number_of_clients_ - 1) {
+          break;
+        }
+        for (int i = 0; i < 2; ++i) {
+          num_non_adversarial_neighbors_quantile->IncrementSampled();
+          num_surviving_neighbors_quantile->IncrementSampled();
+        }
       }
     }
     return FCP_STATUS(FAILED_PRECONDITION)
@@ -128,6 +164,8 @@ class HararyGraphParameterFinder {
   // Statistical correctness parameter. Parameters found by
   // HararyGraphParameterFinder guarantee a failure probability < 2^{-20}
   static constexpr double kCorrectnessParameter = 20;
+  // We split the security parameter evenly across the two bad events
+  static constexpr double kSecurityParameterPerEvent = kSecurityParameter + 1;
 
   // Adding kSmall stops the floating point rounding error being magnified in
   // an insecure direction by the rounding. Being small it is unlikely to
@@ -171,17 +209,64 @@ class HararyGraphParameterFinder {
     return ret;
   }
 
+  // Returns whether the graph of honest surviving nodes of a random harary
+  // graph with degree number_of_neighbors is connected with large enough
+  // probability.
+  bool IsConnectedWithHighProbability(int number_of_neighbors) {
+    return LogProbOfDisconnectedRandomHarary(number_of_neighbors) <
+           -kSecurityParameterPerEvent * std::log(2);
+  }
+
+  // Returns the smallest even number_of_neighbors >= 2 for which
+  // IsConnectedWithHighProbability holds, or the first even number >=
+  // number_of_clients_ - 1 if there is none.
+  //
+  // The bound computed by LogProbOfDisconnectedRandomHarary decreases as
+  // number_of_neighbors increases: both log(number_of_clients_ -
+  // number_of_neighbors - 1) and log((number_of_clients_ -
+  // number_of_neighbors)! / (max_bad_clients - number_of_neighbors)!), a sum
+  // of the logarithms of a window of number_of_clients_ - max_bad_clients
+  // consecutive integers which moves down, do. This allows a binary search,
+  // which skips evaluating the more expensive threshold conditions for all
+  // the smaller degrees which can't be secure anyway.
+  int MinNumberOfNeighborsForConnectivity() {
+    // Searches for the smallest index i with degree 2 * i + 2 in [low, high).
+    int low = 0;
+    int high = std::max(0, (number_of_clients_ - 2) / 2);
+    while (low < high) {
+      int mid = low + (high - low) / 2;
+      if (IsConnectedWithHighProbability(2 * mid + 2)) {
+        high = mid;
+      } else {
+        low = mid + 1;
+      }
+    }
+    return 2 * low + 2;
+  }
+
+  // Pr[# of adversarial neighbors of a client > t1] must not exceed this.
+  double SecurityQuantile() const {
+    return std::pow(2, -kSecurityParameterPerEvent) / number_of_clients_;
+  }
+
+  // Pr[# of surviving neighbors of a client <= t2] must not exceed this.
+  double CorrectnessQuantile() const {
+    return std::pow(2, -kCorrectnessParameter) / number_of_clients_;
+  }
+
   // Checks if degree number_of_neighbors_ results in a secure and correct
-  // protocol, and returns an appropriate threshold if so.
-  std::optional<int> CheckNumberOfNeighbors(int number_of_neighbors) {
-    // We split the security parameter evenly across the two bad events
-    constexpr double kSecurityParameterPerEvent = kSecurityParameter + 1;
-    const double kLogProbSecurityParameterPerEvent =
-        -kSecurityParameterPerEvent * std::log(2);
+  // protocol, and returns an appropriate threshold if so. The quantiles must
+  // have been created by ComputeDegreeAndThreshold and have sample size
+  // number_of_neighbors.
+  std::optional<int> CheckNumberOfNeighbors(
+      int number_of_neighbors,
+      const IncrementalHypergeometricQuantile&
+          num_non_adversarial_neighbors_quantile,
+      const IncrementalHypergeometricQuantile&
+          num_surviving_neighbors_quantile) {
     // We first check that the graph of honest surviving nodes is connected with
     // large enough probability
-    if (LogProbOfDisconnectedRandomHarary(number_of_neighbors) >=
-        kLogProbSecurityParameterPerEvent) {
+    if (!IsConnectedWithHighProbability(number_of_neighbors)) {
       // The probability of the graph getting disconnected is not small enough
       return std::nullopt;
     }
@@ -190,17 +275,10 @@ class HararyGraphParameterFinder {
     // number of adversarial neighbors of i is greater than t-1 with small
     // enough probability, and (b) that the number of surviving nodes of a
     // client is greater than t-1 with large enough probability.
-    int upper_bound_adversarial_clients = static_cast<int>(
-        std::floor((adversarial_rate_ + kSmall) * number_of_clients_));
-    int lower_bound_surviving_clients = static_cast<int>(
-        std::ceil((1 - dropout_rate_ - kSmall) * number_of_clients_));
-    // Distribution of the number of adversarial neighbors of a client
-    auto num_adversarial_neighbors = HypergeometricDistribution::Create(
-        number_of_clients_, upper_bound_adversarial_clients,
-        number_of_neighbors);
-    // Distribution of the number of dropout neighbors of a client
-    auto num_surviving_neighbors = HypergeometricDistribution::Create(
-        number_of_clients_, lower_bound_surviving_clients, number_of_neighbors);
+    FCP_CHECK(num_non_adversarial_neighbors_quantile.sampled() ==
+              number_of_neighbors);
+    FCP_CHECK(num_surviving_neighbors_quantile.sampled() ==
+              number_of_neighbors);
 
     // t1 is such that Pr[# of adversarial neighbors of a client > t1] <=
     // 2^{-security_parameter_per_event} / number_of_clients_
@@ -210,12 +288,11 @@ class HararyGraphParameterFinder {
 
     // The result of the below quantile functions is an integer result rounded
     // outwards i.e. away from the median of the distribution.
-    auto t1 = num_adversarial_neighbors.value()->FindQuantile(
-        std::pow(2, -kSecurityParameterPerEvent) / number_of_clients_, true);
-    auto t2 = num_surviving_neighbors.value()->FindQuantile(
-        std::pow(2, -kCorrectnessParameter) / number_of_clients_);
-    if (num_surviving_neighbors.value()->CDF(t2) <
-        std::pow(2, -kCorrectnessParameter) / number_of_clients_) {
+    double t1 = number_of_neighbors -
+                num_non_adversarial_neighbors_quantile.Quantile() - 1;
+    double t2 = num_surviving_neighbors_quantile.Quantile();
+    if (num_surviving_neighbors_quantile.CDFAtQuantile() <
+        CorrectnessQuantile()) {
       t2++;
     }
 
@@ -248,6 +325,24 @@ class HararyGraphParameterFinder {
         adversary_class_(adversary_class) {}
 };
 
+namespace {
+
+// The number of clients, adversarial rate, dropout rate and adversary class
+// that HararyGraphParameters are computed for.
+using ParameterCacheKey = std::tuple<int, double, double, AdversaryClass>;
+
+// The parameters are a pure function of the key, and the same few cohort
+// sizes and threat models are usually used over and over, so the results of
+// the search are cached. The cache is cleared when it reaches this size.
+constexpr int kMaxCachedParameters = 256;
+
+ABSL_CONST_INIT absl::Mutex parameter_cache_mutex(absl::kConstInit);
+// Leaked on purpose, to avoid running its destructor at exit.
+absl::flat_hash_map<ParameterCacheKey, StatusOr<HararyGraphParameters>>*
+    parameter_cache ABSL_GUARDED_BY(parameter_cache_mutex) = nullptr;
+
+}  // namespace
+
 StatusOr<HararyGraphParameters> ComputeHararyGraphParameters(
     int number_of_clients, SecureAggregationRequirements threat_model) {
   FCP_ASSIGN_OR_RETURN(
@@ -255,7 +350,31 @@ StatusOr<HararyGraphParameters> ComputeHararyGraphParameters(
                    number_of_clients, threat_model.adversarial_client_rate(),
                    threat_model.estimated_dropout_rate(),
                    threat_model.adversary_class()));
-  return pf->ComputeDegreeAndThreshold();
+  ParameterCacheKey key(number_of_clients,
+                        threat_model.adversarial_client_rate(),
+                        threat_model.estimated_dropout_rate(),
+                        threat_model.adversary_class());
+  {
+    absl::MutexLock lock(&parameter_cache_mutex);
+    if (parameter_cache != nullptr) {
+      auto it = parameter_cache->find(key);
+      if (it != parameter_cache->end()) {
+        return it->second;
+      }
+    }
+  }
+  // The search runs without holding the lock, so that concurrent searches for
+  // different keys don't wait for each other.
+  StatusOr<HararyGraphParameters> params = pf->ComputeDegreeAndThreshold();
+  absl::MutexLock lock(&parameter_cache_mutex);
+  if (parameter_cache == nullptr) {
+    parameter_cache = new absl::flat_hash_map<
+        ParameterCacheKey, StatusOr<HararyGraphParameters>>();
+  } else if (parameter_cache->size() >= kMaxCachedParameters) {
+    parameter_cache->clear();
+  }
+  parameter_cache->insert_or_assign(key, params);
+  return params;
 }
 
 Status CheckFullGraphParameters(int number_of_clients, int threshold,
@@ -20,10 +20,14 @@
 #include "fcp/secagg/server/graph_parameter_finder.h"
 
 #include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <optional>
 #include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
+#include "fcp/secagg/server/distribution_utilities.h"
 #include "fcp/secagg/server/secagg_server_enums.pb.h"
 #include "fcp/secagg/server/secagg_server_messages.pb.h"
 #include "fcp/testing/testing.h"
@@ -540,6 +544,30 @@ INSTANTIATE_TEST_SUITE_P(
       return info.param.test_name;
     });
 
+TEST(HararyGraphParameterFinderTest, RepeatedCallsReturnSameParameters) {
+  // Results are memoized, so this checks that the cache is keyed by the whole
+  // threat model and keeps errors as well.
+  SecureAggregationRequirements threat_model;
+  threat_model.set_adversarial_client_rate(.05);
+  threat_model.set_estimated_dropout_rate(.1);
+  threat_model.set_adversary_class(AdversaryClass::CURIOUS_SERVER);
+  auto first_params = ComputeHararyGraphParameters(1000, threat_model);
+  ASSERT_TRUE(first_params.ok());
+  auto second_params = ComputeHararyGraphParameters(1000, threat_model);
+  ASSERT_TRUE(second_params.ok());
+  EXPECT_EQ(second_params->degree, first_params->degree);
+  EXPECT_EQ(second_params->threshold, first_params->threshold);
+
+  threat_model.set_estimated_dropout_rate(.3);
+  auto higher_dropout_params = ComputeHararyGraphParameters(1000, threat_model);
+  ASSERT_TRUE(higher_dropout_params.ok());
+  EXPECT_GT(higher_dropout_params->degree, first_params->degree);
+
+  threat_model.set_estimated_dropout_rate(1.);
+  EXPECT_FALSE(ComputeHararyGraphParameters(1000, threat_model).ok());
+  EXPECT_FALSE(ComputeHararyGraphParameters(1000, threat_model).ok());
+}
+
 TEST(FullGraphCeckParamsTest, ReturnsTrueOnValidThresholds) {
   SecureAggregationRequirements threat_model;
   threat_model.set_adversarial_client_rate(.05);
@@ -565,6 +593,100 @@ TEST(FullGraphCeckParamsTest, ReturnsFalseOnInvalidThresholds) {
   }
 }
 
+// The exhaustive search ComputeHararyGraphParameters used to do, which
+// evaluates each even degree from scratch with HypergeometricDistribution. It
+// is kept as a reference for the incremental search, and assumes a feasible
+// threat model.
+std::optional<HararyGraphParameters> ReferenceHararyGraphParameters(
+    int number_of_clients, double adversarial_rate, double dropout_rate,
+    AdversaryClass adversary_class) {
+  constexpr double kSecurityParameterPerEvent = 41;
+  constexpr double kCorrectnessParameter = 20;
+  constexpr double kSmall = 1e-14;
+  const double log_prob_security_parameter_per_event =
+      -kSecurityParameterPerEvent * std::log(2);
+  int max_adversarial_clients = static_cast<int>(
+      std::floor((adversarial_rate + kSmall) * number_of_clients));
+  int max_dropout_clients = static_cast<int>(
+      std::floor((dropout_rate + kSmall) * number_of_clients));
+  int max_bad_clients = max_adversarial_clients + max_dropout_clients;
+  int lower_bound_surviving_clients = static_cast<int>(
+      std::ceil((1 - dropout_rate - kSmall) * number_of_clients));
+  for (int degree = 2; degree < number_of_clients - 1; degree += 2) {
+    if (degree <= max_bad_clients) {
+      double log_prob_disconnected =
+          std::log(number_of_clients) +
+          std::log(number_of_clients - degree - 1) - std::log(2) +
+          std::lgamma(max_bad_clients + 1) +
+          std::lgamma(number_of_clients - degree + 1) -
+          std::lgamma(number_of_clients + 1) -
+          std::lgamma(max_bad_clients - degree + 1);
+      if (log_prob_disconnected >= log_prob_security_parameter_per_event) {
+        continue;
+      }
+    }
+    auto num_adversarial_neighbors = HypergeometricDistribution::Create(
+        number_of_clients, max_adversarial_clients, degree);
+    auto num_surviving_neighbors = HypergeometricDistribution::Create(
+        number_of_clients, lower_bound_surviving_clients, degree);
+    double t1 = num_adversarial_neighbors.value()->FindQuantile(
+        std::pow(2, -kSecurityParameterPerEvent) / number_of_clients, true);
+    double t2 = num_surviving_neighbors.value()->FindQuantile(
+        std::pow(2, -kCorrectnessParameter) / number_of_clients);
+    if (num_surviving_neighbors.value()->CDF(t2) <
+        std::pow(2, -kCorrectnessParameter) / number_of_clients) {
+      t2++;
+    }
+    if (adversary_class == AdversaryClass::SEMI_MALICIOUS_SERVER) {
+      t1 = std::ceil((t1 + degree - 1.25) / 2);
+    }
+    if (t2 > t1) {
+      return HararyGraphParameters{number_of_clients, degree,
+                                   static_cast<int>(std::max(t1 + 1, 2.))};
+    }
+  }
+  return std::nullopt;
+}
+
+TEST(HararyGraphParameterFinderTest, MatchesExhaustiveSearchForLargeCohorts) {
+  struct Rates {
+    double adversarial_rate;
+    double dropout_rate;
+  };
+  const std::vector<Rates> rates = {{0, .05}, {.05, .1}, {.1, .3}, {.3, .3}};
+  for (int number_of_clients : {100000, 500000, 1000000}) {
+    for (AdversaryClass adversary_class :
+         {AdversaryClass::CURIOUS_SERVER,
+          AdversaryClass::SEMI_MALICIOUS_SERVER}) {
+      for (const Rates& rate : rates) {
+        if (adversary_class == AdversaryClass::SEMI_MALICIOUS_SERVER &&
+            rate.adversarial_rate + 2 * rate.dropout_rate > .9) {
+          continue;
+        }
+        SCOPED_TRACE(testing::Message()
+                     << "clients = " << number_of_clients
+                     << ", adversary class = " << adversary_class
+                     << ", adversarial rate = " << rate.adversarial_rate
+                     << ", dropout rate = " << rate.dropout_rate);
+        SecureAggregationRequirements threat_model;
+        threat_model.set_adversarial_client_rate(rate.adversarial_rate);
+        threat_model.set_estimated_dropout_rate(rate.dropout_rate);
+        threat_model.set_adversary_class(adversary_class);
+        auto params =
+            ComputeHararyGraphParameters(number_of_clients, threat_model);
+        std::optional<HararyGraphParameters> expected_params =
+            ReferenceHararyGraphParameters(
+                number_of_clients, rate.adversarial_rate, rate.dropout_rate,
+                adversary_class);
+        ASSERT_TRUE(expected_params.has_value());
+        ASSERT_TRUE(params.ok()) << params.status();
+        EXPECT_EQ(params->degree, expected_params->degree);
+        EXPECT_EQ(params->threshold, expected_params->threshold);
+      }
+    }
+  }
+}
+
 }  // namespace
 }  // namespace secagg
 }  // namespace fcp
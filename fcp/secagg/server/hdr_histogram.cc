@@ -0,0 +1,124 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fcp/secagg/server/hdr_histogram.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "absl/numeric/bits.h"
+#include "absl/strings/str_cat.h"
+#include "fcp/secagg/server/secagg_server_messages.pb.h"
+
+namespace fcp {
+namespace secagg {
+
+void HdrHistogram::Record(uint64_t value) {
+  buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  uint64_t min = min_.load(std::memory_order_relaxed);
+  while (value < min &&
+         !min_.compare_exchange_weak(min, value, std::memory_order_relaxed)) {
+  }
+  uint64_t max = max_.load(std::memory_order_relaxed);
+  while (value > max &&
+         !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+  }
+}
+
+uint64_t HdrHistogram::min() const {
+  return count() == 0 ? 0 : min_.load(std::memory_order_relaxed);
+}
+
+uint64_t HdrHistogram::ValueAtPercentile(double percentile) const {
+  uint64_t total = count();
+  if (total == 0) {
+    return 0;
+  }
+  percentile = std::clamp(percentile, 0.0, 100.0);
+  uint64_t rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(percentile / 100 * total)));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      return std::min(BucketUpperBound(i), max());
+    }
+  }
+  // Only reachable if values were recorded while the buckets were read.
+  return max();
+}
+
+std::string HdrHistogram::ToString() const {
+  uint64_t total = count();
+  return absl::StrCat(
+      "count=", total, " min=", min(), " p50=", ValueAtPercentile(50),
+      " p90=", ValueAtPercentile(90), " p99=", ValueAtPercentile(99),
+      " p99.9=", ValueAtPercentile(99.9), " max=", max(),
+      " mean=", total == 0 ? 0.0 : static_cast<double>(sum()) / total);
+}
+
+void HdrHistogram::ToProto(HdrHistogramProto* proto) const {
+  proto->set_count(count());
+  proto->set_sum(sum());
+  proto->set_min(min());
+  proto->set_max(max());
+  proto->clear_buckets();
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    uint64_t bucket_count = buckets_[i].load(std::memory_order_relaxed);
+    if (bucket_count == 0) {
+      continue;
+    }
+    HdrHistogramProto::Bucket* bucket = proto->add_buckets();
+    bucket->set_lower_bound(BucketLowerBound(i));
+    bucket->set_upper_bound(BucketUpperBound(i));
+    bucket->set_count(bucket_count);
+  }
+}
+
+size_t HdrHistogram::BucketIndex(uint64_t value) {
+  if (value < kSubBucketCount) {
+    return value;
+  }
+  // Shift the value so that it falls in [kSubBucketHalfCount, kSubBucketCount),
+  // i.e. so that only its kSubBucketBits most significant bits are kept.
+  int shift = absl::bit_width(value) - kSubBucketBits;
+  return shift * kSubBucketHalfCount + (value >> shift);
+}
+
+uint64_t HdrHistogram::BucketLowerBound(size_t index) {
+  if (index < kSubBucketCount) {
+    return index;
+  }
+  int shift = index / kSubBucketHalfCount - 1;
+  return (index % kSubBucketHalfCount + kSubBucketHalfCount) << shift;
+}
+
+uint64_t HdrHistogram::BucketUpperBound(size_t index) {
+  if (index < kSubBucketCount) {
+    return index;
+  }
+  int shift = index / kSubBucketHalfCount - 1;
+  return BucketLowerBound(index) + ((uint64_t{1} << shift) - 1);
+}
+
+}  // namespace secagg
+}  // namespace fcp
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FCP_SECAGG_SERVER_HDR_HISTOGRAM_H_
+#define FCP_SECAGG_SERVER_HDR_HISTOGRAM_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "fcp/secagg/server/secagg_server_messages.pb.h"
+
+namespace fcp {
+namespace secagg {
+
+// A high dynamic range histogram of non-negative integer values, such as
+// latencies or queue sizes.
+//
+// Values are counted in log-linear buckets: values below 128 each have their
+// own bucket, and every larger power-of-two range is split into 64 equal
+// buckets, so that any recorded value is known to within 1/64 of itself. This
+// covers the whole uint64_t range in a fixed number of buckets.
+//
+// Thread safety: Record() is lock-free and may be called concurrently with any
+// other method. Readers see each bucket atomically, but not the histogram as a
+// whole, so a read that races with Record() may be off by the values being
+// recorded at the time.
+class HdrHistogram {
+ public:
+  HdrHistogram() = default;
+
+  // HdrHistogram is neither copyable nor movable.
+  HdrHistogram(const HdrHistogram&) = delete;
+  HdrHistogram& operator=(const HdrHistogram&) = delete;
+
+  void Record(uint64_t value);
+
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+  uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+  // Returns 0 if no values were recorded.
+  uint64_t min() const;
+  uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+  // Returns an upper bound of the value below which the given percentage
+  // (between 0 and 100) of the recorded values fall, or 0 if no values were
+  // recorded. The bound is within 1/64 of the actual value.
+  uint64_t ValueAtPercentile(double percentile) const;
+
+  // Returns a one line summary, e.g. "count=3 min=1 p50=2 ... max=5".
+  std::string ToString() const;
+
+  // Writes the summary values and all non-empty buckets to `proto`.
+  void ToProto(HdrHistogramProto* proto) const;
+
+ private:
+  static constexpr int kSubBucketBits = 7;
+  static constexpr uint64_t kSubBucketCount = uint64_t{1} << kSubBucketBits;
+  static constexpr uint64_t kSubBucketHalfCount = kSubBucketCount / 2;
+  // Values below kSubBucketCount take the first kSubBucketCount buckets, and
+  // each of the remaining power-of-two ranges up to 2^64 takes another
+  // kSubBucketHalfCount.
+  static constexpr size_t kNumBuckets =
+      kSubBucketCount + (64 - kSubBucketBits) * kSubBucketHalfCount;
+
+  static size_t BucketIndex(uint64_t value);
+  // Returns the smallest and largest value counted in the bucket at `index`.
+  static uint64_t BucketLowerBound(size_t index);
+  static uint64_t BucketUpperBound(size_t index);
+
+  std::array<std::atomic<uint64_t>, kNumBuckets> buckets_{};
+  std::atomic<uint64_t> count_ = 0;
+  std::atomic<uint64_t> sum_ = 0;
+  std::atomic<uint64_t> min_ = UINT64_MAX;
+  std::atomic<uint64_t> max_ = 0;
+};
+
+}  // namespace secagg
+}  // namespace fcp
+
+#endif  // FCP_SECAGG_SERVER_HDR_HISTOGRAM_H_
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fcp/secagg/server/hdr_histogram.h"
+
+#include <cstdint>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "fcp/secagg/server/secagg_server_messages.pb.h"
+
+namespace fcp {
+namespace secagg {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ge;
+using ::testing::Le;
+
+TEST(HdrHistogramTest, EmptyHistogram) {
+  HdrHistogram histogram;
+  EXPECT_THAT(histogram.count(), Eq(0));
+  EXPECT_THAT(histogram.sum(), Eq(0));
+  EXPECT_THAT(histogram.min(), Eq(0));
+  EXPECT_THAT(histogram.max(), Eq(0));
+  EXPECT_THAT(histogram.ValueAtPercentile(50), Eq(0));
+  HdrHistogramProto proto;
+  histogram.ToProto(&proto);
+  EXPECT_THAT(proto.buckets_size(), Eq(0));
+}
+
+TEST(HdrHistogramTest, SmallValuesAreExact) {
+  HdrHistogram histogram;
+  for (uint64_t i = 1; i <= 100; ++i) {
+    histogram.Record(i);
+  }
+  EXPECT_THAT(histogram.count(), Eq(100));
+  EXPECT_THAT(histogram.sum(), Eq(5050));
+  EXPECT_THAT(histogram.min(), Eq(1));
+  EXPECT_THAT(histogram.max(), Eq(100));
+  EXPECT_THAT(histogram.ValueAtPercentile(0), Eq(1));
+  EXPECT_THAT(histogram.ValueAtPercentile(50), Eq(50));
+  EXPECT_THAT(histogram.ValueAtPercentile(99), Eq(99));
+  EXPECT_THAT(histogram.ValueAtPercentile(100), Eq(100));
+}
+
+TEST(HdrHistogramTest, LargeValuesAreWithinRelativeError) {
+  for (uint64_t value : {uint64_t{128}, uint64_t{1000}, uint64_t{123456789},
+                         uint64_t{1} << 40, UINT64_MAX / 3}) {
+    HdrHistogram histogram;
+    histogram.Record(value);
+    histogram.Record(value + value / 1000);
+    uint64_t p50 = histogram.ValueAtPercentile(50);
+    EXPECT_THAT(p50, Ge(value));
+    EXPECT_THAT(p50 - value, Le(value / 64));
+  }
+}
+
+TEST(HdrHistogramTest, PercentileIsClampedToMax) {
+  HdrHistogram histogram;
+  histogram.Record(1000);
+  EXPECT_THAT(histogram.ValueAtPercentile(100), Eq(1000));
+}
+
+TEST(HdrHistogramTest, ExtremeValues) {
+  HdrHistogram histogram;
+  histogram.Record(0);
+  histogram.Record(UINT64_MAX);
+  EXPECT_THAT(histogram.min(), Eq(0));
+  EXPECT_THAT(histogram.max(), Eq(UINT64_MAX));
+  EXPECT_THAT(histogram.ValueAtPercentile(50), Eq(0));
+  EXPECT_THAT(histogram.ValueAtPercentile(100), Eq(UINT64_MAX));
+}
+
+TEST(HdrHistogramTest, ToProtoHasNonEmptyBuckets) {
+  HdrHistogram histogram;
+  histogram.Record(5);
+  histogram.Record(5);
+  histogram.Record(1000);
+  HdrHistogramProto proto;
+  histogram.ToProto(&proto);
+
+  EXPECT_THAT(proto.count(), Eq(3));
+  EXPECT_THAT(proto.sum(), Eq(1010));
+  EXPECT_THAT(proto.min(), Eq(5));
+  EXPECT_THAT(proto.max(), Eq(1000));
+  ASSERT_THAT(proto.buckets_size(), Eq(2));
+  EXPECT_THAT(proto.buckets(0).lower_bound(), Eq(5));
+  EXPECT_THAT(proto.buckets(0).upper_bound(), Eq(5));
+  EXPECT_THAT(proto.buckets(0).count(), Eq(2));
+  EXPECT_THAT(proto.buckets(1).lower_bound(), Le(1000));
+  EXPECT_THAT(proto.buckets(1).upper_bound(), Ge(1000));
+  EXPECT_THAT(proto.buckets(1).count(), Eq(1));
+}
+
+TEST(HdrHistogramTest, ToString) {
+  HdrHistogram histogram;
+  histogram.Record(2);
+  histogram.Record(4);
+  EXPECT_THAT(histogram.ToString(),
+              Eq("count=2 min=2 p50=2 p90=4 p99=4 p99.9=4 max=4 mean=3"));
+}
+
+TEST(HdrHistogramTest, ConcurrentRecords) {
+  constexpr int kNumThreads = 8;
+  constexpr int kRecordsPerThread = 10000;
+  HdrHistogram histogram;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&histogram, t] {
+      for (int i = 0; i < kRecordsPerThread; ++i) {
+        histogram.Record(t * kRecordsPerThread + i);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  constexpr uint64_t kCount = kNumThreads * kRecordsPerThread;
+  EXPECT_THAT(histogram.count(), Eq(kCount));
+  EXPECT_THAT(histogram.sum(), Eq(kCount * (kCount - 1) / 2));
+  EXPECT_THAT(histogram.min(), Eq(0));
+  EXPECT_THAT(histogram.max(), Eq(kCount - 1));
+}
+
+}  // namespace
+}  // namespace secagg
+}  // namespace fcp
@@ -0,0 +1,270 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fcp/secagg/server/histogram_metrics_listener.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "fcp/secagg/server/hdr_histogram.h"
+#include "fcp/secagg/server/secagg_server_enums.pb.h"
+#include "fcp/secagg/server/secagg_server_messages.pb.h"
+#include "fcp/secagg/server/secagg_server_metrics_listener.h"
+#include "fcp/secagg/shared/secagg_messages.pb.h"
+#include "google/protobuf/descriptor.h"
+
+namespace fcp {
+namespace secagg {
+
+SecAggServerHistograms::SecAggServerHistograms(int num_parallel_threads)
+    : num_parallel_threads_(num_parallel_threads) {
+  const google::protobuf::Descriptor* descriptor =
+      ClientToServerWrapperMessage::descriptor();
+  for (int i = 0; i < kNumMessageTypes; ++i) {
+    const google::protobuf::FieldDescriptor* field =
+        descriptor->FindFieldByNumber(i);
+    if (field == nullptr) {
+      continue;
+    }
+    named_histograms_.emplace_back(
+        absl::StrCat("message_handling_micros/", field->name()),
+        &message_handling_micros_[i]);
+    named_histograms_.emplace_back(
+        absl::StrCat("client_response_millis/", field->name()),
+        &client_response_millis_[i]);
+  }
+  for (int i = 0; i < kNumStates; ++i) {
+    if (!SecAggServerStateKind_IsValid(i)) {
+      continue;
+    }
+    std::string state = absl::AsciiStrToLower(
+        SecAggServerStateKind_Name(static_cast<SecAggServerStateKind>(i)));
+    named_histograms_.emplace_back(absl::StrCat("round_millis/", state),
+                                   &round_millis_[i]);
+    named_histograms_.emplace_back(
+        absl::StrCat("worker_busy_permille/", state),
+        &worker_busy_permille_[i]);
+  }
+  named_histograms_.emplace_back("prng_expansion_millis",
+                                 &prng_expansion_millis_);
+  named_histograms_.emplace_back("shamir_reconstruction_millis",
+                                 &shamir_reconstruction_millis_);
+  named_histograms_.emplace_back("masked_input_queue_size",
+                                 &masked_input_queue_size_);
+  named_histograms_.emplace_back("async_task_wait_micros",
+                                 &async_task_wait_micros_);
+  named_histograms_.emplace_back("async_task_run_micros",
+                                 &async_task_run_micros_);
+}
+
+const HdrHistogram* SecAggServerHistograms::Get(absl::string_view name) const {
+  for (const auto& [histogram_name, histogram] : named_histograms_) {
+    if (histogram_name == name) {
+      return histogram;
+    }
+  }
+  return nullptr;
+}
+
+std::string SecAggServerHistograms::ToString() const {
+  std::string result;
+  for (const auto& [name, histogram] : named_histograms_) {
+    if (histogram->count() > 0) {
+      absl::StrAppend(&result, name, " ", histogram->ToString(), "\n");
+    }
+  }
+  return result;
+}
+
+SecAggServerMetricsDump SecAggServerHistograms::ToProto() const {
+  SecAggServerMetricsDump dump;
+  for (const auto& [name, histogram] : named_histograms_) {
+    if (histogram->count() > 0) {
+      histogram->ToProto(&(*dump.mutable_histograms())[name]);
+    }
+  }
+  return dump;
+}
+
+HdrHistogram* SecAggServerHistograms::MessageHistogram(
+    std::array<HdrHistogram, kNumMessageTypes>& histograms,
+    ClientToServerWrapperMessage::MessageContentCase message_type) {
+  int index = static_cast<int>(message_type);
+  if (index <= 0 || index >= kNumMessageTypes) {
+    return nullptr;
+  }
+  return &histograms[index];
+}
+
+HdrHistogram* SecAggServerHistograms::StateHistogram(
+    std::array<HdrHistogram, kNumStates>& histograms,
+    SecAggServerStateKind state) {
+  int index = static_cast<int>(state);
+  if (index <= 0 || index >= kNumStates) {
+    return nullptr;
+  }
+  return &histograms[index];
+}
+
+void SecAggServerHistograms::AddBusyTime(uint64_t run_micros) {
+  busy_micros_.fetch_add(run_micros, std::memory_order_relaxed);
+}
+
+void SecAggServerHistograms::RecordBusyFraction(SecAggServerStateKind state,
+                                                uint64_t elapsed_millis) {
+  uint64_t busy_micros = busy_micros_.exchange(0, std::memory_order_relaxed);
+  HdrHistogram* histogram = StateHistogram(worker_busy_permille_, state);
+  if (histogram == nullptr || num_parallel_threads_ <= 0 ||
+      elapsed_millis == 0) {
+    return;
+  }
+  // Microseconds per millisecond make for the factor of 1000.
+  histogram->Record(busy_micros / (elapsed_millis * num_parallel_threads_));
+}
+
+HistogramMetricsListener::HistogramMetricsListener(
+    std::shared_ptr<SecAggServerHistograms> histograms,
+    std::unique_ptr<SecAggServerMetricsListener> delegate)
+    : histograms_(std::move(histograms)), delegate_(std::move(delegate)) {}
+
+void HistogramMetricsListener::ProtocolStarts(ServerVariant server_variant) {
+  if (delegate_) {
+    delegate_->ProtocolStarts(server_variant);
+  }
+}
+
+void HistogramMetricsListener::IndividualMessageSizes(
+    ServerToClientWrapperMessage::MessageContentCase message_type,
+    uint64_t size) {
+  if (delegate_) {
+    delegate_->IndividualMessageSizes(message_type, size);
+  }
+}
+
+void HistogramMetricsListener::MessageReceivedSizes(
+    ClientToServerWrapperMessage::MessageContentCase message_type,
+    bool message_expected, uint64_t size) {
+  if (delegate_) {
+    delegate_->MessageReceivedSizes(message_type, message_expected, size);
+  }
+}
+
+void HistogramMetricsListener::ClientResponseTimes(
+    ClientToServerWrapperMessage::MessageContentCase message_type,
+    uint64_t elapsed_millis) {
+  if (HdrHistogram* histogram = histograms_->MessageHistogram(
+          histograms_->client_response_millis_, message_type)) {
+    histogram->Record(elapsed_millis);
+  }
+  if (delegate_) {
+    delegate_->ClientResponseTimes(message_type, elapsed_millis);
+  }
+}
+
+void HistogramMetricsListener::RoundTimes(SecAggServerStateKind target_state,
+                                          bool successful,
+                                          uint64_t elapsed_millis) {
+  if (HdrHistogram* histogram = histograms_->StateHistogram(
+          histograms_->round_millis_, target_state)) {
+    histogram->Record(elapsed_millis);
+  }
+  histograms_->RecordBusyFraction(target_state, elapsed_millis);
+  if (delegate_) {
+    delegate_->RoundTimes(target_state, successful, elapsed_millis);
+  }
+}
+
+void HistogramMetricsListener::PrngExpansionTimes(uint64_t elapsed_millis) {
+  histograms_->prng_expansion_millis_.Record(elapsed_millis);
+  if (delegate_) {
+    delegate_->PrngExpansionTimes(elapsed_millis);
+  }
+}
+
+void HistogramMetricsListener::RoundSurvivingClients(
+    SecAggServerStateKind target_state, uint64_t number_of_clients) {
+  if (delegate_) {
+    delegate_->RoundSurvivingClients(target_state, number_of_clients);
+  }
+}
+
+void HistogramMetricsListener::RoundCompletionFractions(
+    SecAggServerStateKind target_state, ClientStatus client_state,
+    double fraction) {
+  if (delegate_) {
+    delegate_->RoundCompletionFractions(target_state, client_state, fraction);
+  }
+}
+
+void HistogramMetricsListener::ProtocolOutcomes(SecAggServerOutcome outcome) {
+  if (delegate_) {
+    delegate_->ProtocolOutcomes(outcome);
+  }
+}
+
+void HistogramMetricsListener::ClientsDropped(ClientStatus abort_state,
+                                              ClientDropReason error_code) {
+  if (delegate_) {
+    delegate_->ClientsDropped(abort_state, error_code);
+  }
+}
+
+void HistogramMetricsListener::ShamirReconstructionTimes(
+    uint64_t elapsed_millis) {
+  histograms_->shamir_reconstruction_millis_.Record(elapsed_millis);
+  if (delegate_) {
+    delegate_->ShamirReconstructionTimes(elapsed_millis);
+  }
+}
+
+void HistogramMetricsListener::MessageHandlingTimes(
+    ClientToServerWrapperMessage::MessageContentCase message_type,
+    uint64_t elapsed_micros) {
+  if (HdrHistogram* histogram = histograms_->MessageHistogram(
+          histograms_->message_handling_micros_, message_type)) {
+    histogram->Record(elapsed_micros);
+  }
+  if (delegate_) {
+    delegate_->MessageHandlingTimes(message_type, elapsed_micros);
+  }
+}
+
+void HistogramMetricsListener::MaskedInputQueueSizes(uint64_t queue_size) {
+  histograms_->masked_input_queue_size_.Record(queue_size);
+  if (delegate_) {
+    delegate_->MaskedInputQueueSizes(queue_size);
+  }
+}
+
+void HistogramMetricsListener::AsyncTaskTimes(uint64_t wait_micros,
+                                              uint64_t run_micros) {
+  histograms_->async_task_wait_micros_.Record(wait_micros);
+  histograms_->async_task_run_micros_.Record(run_micros);
+  histograms_->AddBusyTime(run_micros);
+  if (delegate_) {
+    delegate_->AsyncTaskTimes(wait_micros, run_micros);
+  }
+}
+
+}  // namespace secagg
+}  // namespace fcp
@@ -0,0 +1,167 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FCP_SECAGG_SERVER_HISTOGRAM_METRICS_LISTENER_H_
+#define FCP_SECAGG_SERVER_HISTOGRAM_METRICS_LISTENER_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "fcp/secagg/server/hdr_histogram.h"
+#include "fcp/secagg/server/secagg_server_enums.pb.h"
+#include "fcp/secagg/server/secagg_server_messages.pb.h"
+#include "fcp/secagg/server/secagg_server_metrics_listener.h"
+#include "fcp/secagg/shared/secagg_messages.pb.h"
+
+namespace fcp {
+namespace secagg {
+
+// Histograms of the timing and queueing metrics of a SecAggServer, recorded by
+// a HistogramMetricsListener. They are kept apart from the listener, which is
+// owned by the server, so that they can be dumped while the protocol runs as
+// well as after the server is gone.
+//
+// The histograms are named as follows, where <message> is the name of a
+// ClientToServerWrapperMessage field, e.g. "masked_input_response", and
+// <state> is the lower case name of a SecAggServerStateKind, e.g.
+// "r2_masked_input_collection":
+//   message_handling_micros/<message>
+//   client_response_millis/<message>
+//   round_millis/<state>
+//   worker_busy_permille/<state>: the time the parallel scheduler's threads
+//       spent running tasks during the round, in thousandths of the time they
+//       could have spent. Only recorded if the number of threads is known.
+//   prng_expansion_millis
+//   shamir_reconstruction_millis
+//   masked_input_queue_size
+//   async_task_wait_micros
+//   async_task_run_micros
+//
+// Thread safety: all methods may be called concurrently.
+class SecAggServerHistograms {
+ public:
+  // num_parallel_threads is the number of threads of the parallel scheduler
+  // given to the SecAggServer, or 0 if it isn't known.
+  explicit SecAggServerHistograms(int num_parallel_threads = 0);
+
+  // SecAggServerHistograms is neither copyable nor movable.
+  SecAggServerHistograms(const SecAggServerHistograms&) = delete;
+  SecAggServerHistograms& operator=(const SecAggServerHistograms&) = delete;
+
+  // Returns the histogram with the given name, or nullptr if there is none.
+  const HdrHistogram* Get(absl::string_view name) const;
+
+  // Returns a line per non-empty histogram, with its name and summary.
+  std::string ToString() const;
+
+  // Returns all non-empty histograms.
+  SecAggServerMetricsDump ToProto() const;
+
+ private:
+  friend class HistogramMetricsListener;
+
+  // Indexed by ClientToServerWrapperMessage::MessageContentCase.
+  static constexpr int kNumMessageTypes =
+      ClientToServerWrapperMessage::kUnmaskingResponseFieldNumber + 1;
+  // Indexed by SecAggServerStateKind.
+  static constexpr int kNumStates = SecAggServerStateKind_ARRAYSIZE;
+
+  // Return nullptr for values without a histogram, so that recording never
+  // needs to allocate.
+  HdrHistogram* MessageHistogram(
+      std::array<HdrHistogram, kNumMessageTypes>& histograms,
+      ClientToServerWrapperMessage::MessageContentCase message_type);
+  HdrHistogram* StateHistogram(std::array<HdrHistogram, kNumStates>& histograms,
+                               SecAggServerStateKind state);
+
+  // Adds the time spent by tasks of the parallel scheduler.
+  void AddBusyTime(uint64_t run_micros);
+  // Records the busy fraction of the parallel scheduler over a round, and
+  // starts counting anew for the next one.
+  void RecordBusyFraction(SecAggServerStateKind state, uint64_t elapsed_millis);
+
+  const int num_parallel_threads_;
+  std::array<HdrHistogram, kNumMessageTypes> message_handling_micros_;
+  std::array<HdrHistogram, kNumMessageTypes> client_response_millis_;
+  std::array<HdrHistogram, kNumStates> round_millis_;
+  std::array<HdrHistogram, kNumStates> worker_busy_permille_;
+  HdrHistogram prng_expansion_millis_;
+  HdrHistogram shamir_reconstruction_millis_;
+  HdrHistogram masked_input_queue_size_;
+  HdrHistogram async_task_wait_micros_;
+  HdrHistogram async_task_run_micros_;
+  // Time spent running tasks since the last round ended.
+  std::atomic<uint64_t> busy_micros_ = 0;
+
+  // All of the above histograms with their names, in the order they're dumped.
+  std::vector<std::pair<std::string, const HdrHistogram*>> named_histograms_;
+};
+
+// A SecAggServerMetricsListener which records timing and queueing metrics in
+// SecAggServerHistograms, and forwards all metrics to another listener.
+// Recording a metric is lock-free, so this can be used in production to find
+// where a server spends its time, or contends for threads.
+class HistogramMetricsListener : public SecAggServerMetricsListener {
+ public:
+  // delegate may be null, in which case metrics are only recorded in
+  // histograms.
+  explicit HistogramMetricsListener(
+      std::shared_ptr<SecAggServerHistograms> histograms,
+      std::unique_ptr<SecAggServerMetricsListener> delegate = nullptr);
+
+  void ProtocolStarts(ServerVariant server_variant) override;
+  void IndividualMessageSizes(
+      ServerToClientWrapperMessage::MessageContentCase message_type,
+      uint64_t size) override;
+  void MessageReceivedSizes(
+      ClientToServerWrapperMessage::MessageContentCase message_type,
+      bool message_expected, uint64_t size) override;
+  void ClientResponseTimes(
+      ClientToServerWrapperMessage::MessageContentCase message_type,
+      uint64_t elapsed_millis) override;
+  void RoundTimes(SecAggServerStateKind target_state, bool successful,
+                  uint64_t elapsed_millis) override;
+  void PrngExpansionTimes(uint64_t elapsed_millis) override;
+  void RoundSurvivingClients(SecAggServerStateKind target_state,
+                             uint64_t number_of_clients) override;
+  void RoundCompletionFractions(SecAggServerStateKind target_state,
+                                ClientStatus client_state,
+                                double fraction) override;
+  void ProtocolOutcomes(SecAggServerOutcome outcome) override;
+  void ClientsDropped(ClientStatus abort_state,
+                      ClientDropReason error_code) override;
+  void ShamirReconstructionTimes(uint64_t elapsed_millis) override;
+  void MessageHandlingTimes(
+      ClientToServerWrapperMessage::MessageContentCase message_type,
+      uint64_t elapsed_micros) override;
+  void MaskedInputQueueSizes(uint64_t queue_size) override;
+  void AsyncTaskTimes(uint64_t wait_micros, uint64_t run_micros) override;
+
+ private:
+  std::shared_ptr<SecAggServerHistograms> histograms_;
+  std::unique_ptr<SecAggServerMetricsListener> delegate_;
+};
+
+}  // namespace secagg
+}  // namespace fcp
+
+#endif  // FCP_SECAGG_SERVER_HISTOGRAM_METRICS_LISTENER_H_
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fcp/secagg/server/histogram_metrics_listener.h"
+
+#include <memory>
+#include <utility>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "fcp/secagg/server/hdr_histogram.h"
+#include "fcp/secagg/server/secagg_server_enums.pb.h"
+#include "fcp/secagg/server/secagg_server_messages.pb.h"
+#include "fcp/secagg/shared/secagg_messages.pb.h"
+#include "fcp/secagg/testing/server/mock_secagg_server_metrics_listener.h"
+
+namespace fcp {
+namespace secagg {
+namespace {
+
+using ::testing::Eq;
+using ::testing::IsNull;
+using ::testing::NotNull;
+using ::testing::StrictMock;
+
+TEST(HistogramMetricsListenerTest, RecordsMessageHandlingTimesByType) {
+  auto histograms = std::make_shared<SecAggServerHistograms>();
+  HistogramMetricsListener listener(histograms);
+  listener.MessageHandlingTimes(
+      ClientToServerWrapperMessage::kMaskedInputResponse, 100);
+  listener.MessageHandlingTimes(
+      ClientToServerWrapperMessage::kMaskedInputResponse, 300);
+  listener.MessageHandlingTimes(ClientToServerWrapperMessage::kAdvertiseKeys,
+                                7);
+  // Not a message type, so not recorded.
+  listener.MessageHandlingTimes(
+      ClientToServerWrapperMessage::MESSAGE_CONTENT_NOT_SET, 1);
+
+  const HdrHistogram* masked_input =
+      histograms->Get("message_handling_micros/masked_input_response");
+  ASSERT_THAT(masked_input, NotNull());
+  EXPECT_THAT(masked_input->count(), Eq(2));
+  EXPECT_THAT(masked_input->sum(), Eq(400));
+  const HdrHistogram* advertise_keys =
+      histograms->Get("message_handling_micros/advertise_keys");
+  ASSERT_THAT(advertise_keys, NotNull());
+  EXPECT_THAT(advertise_keys->count(), Eq(1));
+  EXPECT_THAT(histograms->Get("message_handling_micros/unknown"), IsNull());
+}
+
+TEST(HistogramMetricsListenerTest, RecordsQueueSizesAndTaskTimes) {
+  auto histograms = std::make_shared<SecAggServerHistograms>();
+  HistogramMetricsListener listener(histograms);
+  listener.MaskedInputQueueSizes(1);
+  listener.MaskedInputQueueSizes(5);
+  listener.AsyncTaskTimes(10, 2000);
+  listener.PrngExpansionTimes(30);
+  listener.ShamirReconstructionTimes(40);
+
+  EXPECT_THAT(histograms->Get("masked_input_queue_size")->max(), Eq(5));
+  EXPECT_THAT(histograms->Get("async_task_wait_micros")->sum(), Eq(10));
+  EXPECT_THAT(histograms->Get("async_task_run_micros")->sum(), Eq(2000));
+  EXPECT_THAT(histograms->Get("prng_expansion_millis")->sum(), Eq(30));
+  EXPECT_THAT(histograms->Get("shamir_reconstruction_millis")->sum(), Eq(40));
+}
+
+TEST(HistogramMetricsListenerTest, RecordsWorkerBusyFractionPerRound) {
+  auto histograms =
+      std::make_shared<SecAggServerHistograms>(/*num_parallel_threads=*/4);
+  HistogramMetricsListener listener(histograms);
+  // 2 of the 4 threads' 10 milliseconds.
+  listener.AsyncTaskTimes(0, 15000);
+  listener.AsyncTaskTimes(0, 5000);
+  listener.RoundTimes(SecAggServerStateKind::PRNG_RUNNING, true, 10);
+  // Busy time is counted anew for each round.
+  listener.RoundTimes(SecAggServerStateKind::R3_UNMASKING, true, 10);
+
+  const HdrHistogram* prng =
+      histograms->Get("worker_busy_permille/prng_running");
+  ASSERT_THAT(prng, NotNull());
+  EXPECT_THAT(prng->count(), Eq(1));
+  EXPECT_THAT(prng->max(), Eq(500));
+  const HdrHistogram* r3 =
+      histograms->Get("worker_busy_permille/r3_unmasking");
+  ASSERT_THAT(r3, NotNull());
+  EXPECT_THAT(r3->max(), Eq(0));
+  EXPECT_THAT(histograms->Get("round_millis/prng_running")->sum(), Eq(10));
+}
+
+TEST(HistogramMetricsListenerTest, NoBusyFractionWithoutThreadCount) {
+  auto histograms = std::make_shared<SecAggServerHistograms>();
+  HistogramMetricsListener listener(histograms);
+  listener.AsyncTaskTimes(0, 15000);
+  listener.RoundTimes(SecAggServerStateKind::PRNG_RUNNING, true, 10);
+  EXPECT_THAT(histograms->Get("worker_busy_permille/prng_running")->count(),
+              Eq(0));
+}
+
+TEST(HistogramMetricsListenerTest, ForwardsToDelegate) {
+  auto delegate =
+      std::make_unique<StrictMock<MockSecAggServerMetricsListener>>();
+  EXPECT_CALL(*delegate, ProtocolStarts(ServerVariant::NATIVE_V1));
+  EXPECT_CALL(*delegate,
+              ClientResponseTimes(
+                  ClientToServerWrapperMessage::kShareKeysResponse, 12));
+  EXPECT_CALL(*delegate, ProtocolOutcomes(SecAggServerOutcome::SUCCESS));
+  auto histograms = std::make_shared<SecAggServerHistograms>();
+  HistogramMetricsListener listener(histograms, std::move(delegate));
+
+  listener.ProtocolStarts(ServerVariant::NATIVE_V1);
+  listener.ClientResponseTimes(ClientToServerWrapperMessage::kShareKeysResponse,
+                               12);
+  listener.ProtocolOutcomes(SecAggServerOutcome::SUCCESS);
+  EXPECT_THAT(
+      histograms->Get("client_response_millis/share_keys_response")->count(),
+      Eq(1));
+}
+
+TEST(HistogramMetricsListenerTest, DumpsOnlyNonEmptyHistograms) {
+  auto histograms = std::make_shared<SecAggServerHistograms>();
+  {
+    HistogramMetricsListener listener(histograms);
+    listener.MaskedInputQueueSizes(3);
+    listener.MessageHandlingTimes(
+        ClientToServerWrapperMessage::kUnmaskingResponse, 42);
+  }
+
+  // The histograms outlive the listener.
+  EXPECT_THAT(histograms->ToString(),
+              Eq("message_handling_micros/unmasking_response count=1 min=42 "
+                 "p50=42 p90=42 p99=42 p99.9=42 max=42 mean=42\n"
+                 "masked_input_queue_size count=1 min=3 p50=3 p90=3 p99=3 "
+                 "p99.9=3 max=3 mean=3\n"));
+  SecAggServerMetricsDump dump = histograms->ToProto();
+  EXPECT_THAT(dump.histograms_size(), Eq(2));
+  EXPECT_THAT(dump.histograms().at("masked_input_queue_size").max(), Eq(3));
+  EXPECT_THAT(dump.histograms()
+                  .at("message_handling_micros/unmasking_response")
+                  .buckets_size(),
+              Eq(1));
+}
+
+}  // namespace
+}  // namespace secagg
+}  // namespace fcp
@@ -16,11 +16,20 @@
 
 #include "fcp/secagg/server/secagg_scheduler.h"
 
+#include <cstddef>
 #include <functional>
+#include <utility>
 
 namespace fcp {
 namespace secagg {
 
+void SecAggScheduler::ParallelFor(size_t count,
+                                  std::function<void(size_t)> function) {
+  ParallelForOptions options;
+  options.task_times_observer = task_times_observer_;
+  fcp::ParallelFor(parallel_scheduler_, count, std::move(function), options);
+}
+
 void SecAggScheduler::WaitUntilIdle() {
   parallel_scheduler_->WaitUntilIdle();
   sequential_scheduler_->WaitUntilIdle();
@@ -18,6 +18,7 @@
 #define FCP_SECAGG_SERVER_SECAGG_SCHEDULER_H_
 
 #include <atomic>
+#include <cstddef>
 #include <functional>
 #include <memory>
 #include <utility>
@@ -66,6 +67,11 @@ class AsyncWorker {
 
 using AsyncToken = std::shared_ptr<AsyncWorker>;
 
+// Called with the time a task spent waiting for a thread of the parallel
+// scheduler, and the time it then spent running. Must be thread-safe.
+using TaskTimesObserver =
+    std::function<void(absl::Duration wait_time, absl::Duration run_time)>;
+
 template <typename T>
 class Accumulator : public AsyncWorker,
                     public std::enable_shared_from_this<Accumulator<T>> {
@@ -74,17 +80,21 @@ class Accumulator : public AsyncWorker,
       std::unique_ptr<T> initial_value,
       std::function<std::unique_ptr<T>(const T&, const T&)> accumulator_func,
       Scheduler* parallel_scheduler, Scheduler* sequential_scheduler,
-      Clock* clock)
+      Clock* clock, TaskTimesObserver task_times_observer = nullptr)
       : parallel_scheduler_(parallel_scheduler),
         sequential_scheduler_(sequential_scheduler),
         accumulated_value_(std::move(initial_value)),
         accumulator_func_(accumulator_func),
-        clock_(clock) {}
+        clock_(clock),
+        task_times_observer_(std::move(task_times_observer)) {}
 
+  // If the accumulator has a task times observer, scheduled_time is the time
+  // from which the returned function is considered to be waiting to run.
   inline static std::function<void()> GetParallelScheduleFunc(
       std::shared_ptr<Accumulator<T>> accumulator,
-      std::function<std::unique_ptr<T>()> generator) {
-    return [accumulator, generator] {
+      std::function<std::unique_ptr<T>()> generator,
+      absl::Time scheduled_time = absl::InfinitePast()) {
+    return [accumulator, generator, scheduled_time] {
       // Increment active count if the accumulator is not canceled, otherwise
       // return without scheduling the task. By active count we mean the total
       // number of scheduled tasks, both parallel and sequential. To cancel an
@@ -92,8 +102,15 @@ class Accumulator : public AsyncWorker,
       if (!accumulator->MaybeIncrementActiveCount()) {
         return;
       }
+      const TaskTimesObserver& observer = accumulator->task_times_observer_;
+      absl::Time start_time = observer ? absl::Now() : absl::InfinitePast();
       auto partial = generator();
       FCP_CHECK(partial);
+      // Reported while the task still counts as active, so that a
+      // cancellation waits for the observer too.
+      if (observer) {
+        observer(start_time - scheduled_time, absl::Now() - start_time);
+      }
       // Decrement the count for the parallel task that was just run as
       // generator().
       accumulator->DecrementActiveCount();
@@ -140,8 +157,9 @@ class Accumulator : public AsyncWorker,
     clock_->WakeupWithDeadline(
         clock_->Now() + delay,
         std::make_shared<CallbackWaiter>([shared_this, generator] {
-          shared_this->RunParallel(
-              Accumulator<T>::GetParallelScheduleFunc(shared_this, generator));
+          // The task only starts waiting for a thread once the delay is over.
+          shared_this->RunParallel(Accumulator<T>::GetParallelScheduleFunc(
+              shared_this, generator, shared_this->ScheduledTime()));
         }));
   }
 
@@ -153,8 +171,9 @@ class Accumulator : public AsyncWorker,
     // to a starting batch of unobserved work.
     auto shared_this = this->shared_from_this();
     shared_this->IncrementRemainingCount();
-    RunParallel([shared_this, generator] {
-      shared_this->GetParallelScheduleFunc(shared_this, generator)();
+    RunParallel([shared_this, generator, scheduled_time = ScheduledTime()] {
+      shared_this->GetParallelScheduleFunc(shared_this, generator,
+                                           scheduled_time)();
     });
   }
 
@@ -271,6 +290,12 @@ class Accumulator : public AsyncWorker,
   }
 
  private:
+  // Returns the current time if task times are observed. Otherwise, returns
+  // an arbitrary time, so that the clock isn't read needlessly.
+  absl::Time ScheduledTime() const {
+    return task_times_observer_ ? absl::Now() : absl::InfinitePast();
+  }
+
   // Scheduler for sequential and parallel tasks, received from the
   // SecAggScheduler instatiating this class
   Scheduler* parallel_scheduler_;
@@ -286,6 +311,8 @@ class Accumulator : public AsyncWorker,
   std::function<std::unique_ptr<T>(const T&, const T&)> accumulator_func_;
   // Clock used for scheduling delays in parallel tasks
   Clock* clock_;
+  // Optional observer of the times of the parallel tasks.
+  TaskTimesObserver task_times_observer_;
   // Remaining number of sequential tasks to be executed - accessed by
   // sequential tasks only.
   size_t remaining_sequential_tasks_count_ ABSL_GUARDED_BY(mutex_) = 0;
@@ -328,15 +355,28 @@ class SecAggScheduler {
     RunSequential(callback);
   }
 
+  // Sets an observer to which the times of the tasks run on the parallel
+  // scheduler are reported, both for accumulators and ParallelFor. Only
+  // affects accumulators created after this call, and must not be called
+  // during a ParallelFor.
+  void set_task_times_observer(TaskTimesObserver task_times_observer) {
+    task_times_observer_ = std::move(task_times_observer);
+  }
+
   template <typename T>
   std::shared_ptr<Accumulator<T>> CreateAccumulator(
       std::unique_ptr<T> initial_value,
       std::function<std::unique_ptr<T>(const T&, const T&)> accumulator_func) {
     return std::make_shared<Accumulator<T>>(
         std::move(initial_value), accumulator_func, parallel_scheduler_,
-        sequential_scheduler_, clock_);
+        sequential_scheduler_, clock_, task_times_observer_);
   }
 
+  // Calls function(i) for each i in [0, count) and returns once all calls have
+  // completed, spreading them over the parallel scheduler. See
+  // fcp::ParallelFor.
+  void ParallelFor(size_t count, std::function<void(size_t)> function);
+
   void WaitUntilIdle();
 
  protected:
@@ -347,6 +387,7 @@ class SecAggScheduler {
   Scheduler* parallel_scheduler_;
   Scheduler* sequential_scheduler_;
   Clock* clock_;
+  TaskTimesObserver task_times_observer_;
 };
 
 }  // namespace secagg
@@ -17,9 +17,11 @@
 #include "fcp/secagg/server/secagg_scheduler.h"
 
 #include <atomic>
+#include <cstddef>
 #include <functional>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -36,6 +38,7 @@ namespace {
 
 using ::testing::_;
 using ::testing::Eq;
+using ::testing::Ge;
 using ::testing::IsFalse;
 using ::testing::Lt;
 using ::testing::StrictMock;
@@ -282,6 +285,115 @@ TEST(SecAggSchedulerTest, ThreeCallbackCalls) {
   EXPECT_THAT(result.value, Eq(216));  // 6^3 = 216
 }
 
+TEST(SecAggSchedulerTest, ParallelForRunsEachIndexOnce) {
+  auto parallel_scheduler = fcp::CreateThreadPoolScheduler(4);
+  auto sequential_scheduler = fcp::CreateThreadPoolScheduler(1);
+  SecAggScheduler runner(parallel_scheduler.get(), sequential_scheduler.get());
+
+  std::vector<std::atomic<int>> calls(1000);
+  runner.ParallelFor(calls.size(), [&calls](size_t i) { calls[i]++; });
+  for (const auto& count : calls) {
+    EXPECT_THAT(count.load(), Eq(1));
+  }
+  runner.WaitUntilIdle();
+}
+
+TEST(SecAggSchedulerTest, ParallelForWithDeferredParallelScheduler) {
+  // The parallel scheduler only runs its tasks after ParallelFor returns, so
+  // all the work has to be done by the calling thread.
+  StrictMock<MockScheduler> parallel_scheduler;
+  StrictMock<MockScheduler> sequential_scheduler;
+  std::vector<std::function<void()>> deferred_tasks;
+  EXPECT_CALL(parallel_scheduler, Schedule(_))
+      .Times(9)
+      .WillRepeatedly([&deferred_tasks](std::function<void()> task) {
+        deferred_tasks.push_back(std::move(task));
+      });
+  SecAggScheduler runner(&parallel_scheduler, &sequential_scheduler);
+
+  int sum = 0;
+  runner.ParallelFor(10, [&sum](size_t i) { sum += i; });
+  EXPECT_THAT(sum, Eq(45));
+  // The deferred tasks find no work left.
+  for (const auto& task : deferred_tasks) {
+    task();
+  }
+  EXPECT_THAT(sum, Eq(45));
+}
+
+TEST(SecAggSchedulerTest, ParallelForWithoutParallelScheduler) {
+  SecAggScheduler runner(nullptr, nullptr);
+  int sum = 0;
+  runner.ParallelFor(10, [&sum](size_t i) { sum += i; });
+  EXPECT_THAT(sum, Eq(45));
+  runner.ParallelFor(0, [](size_t) { FCP_CHECK(false); });
+}
+
+TEST(SecAggSchedulerTest, AccumulatorReportsTaskTimes) {
+  StrictMock<MockScheduler> parallel_scheduler;
+  StrictMock<MockScheduler> sequential_scheduler;
+  std::vector<std::function<void()>> deferred_tasks;
+  EXPECT_CALL(parallel_scheduler, Schedule(_))
+      .Times(3)
+      .WillRepeatedly([&deferred_tasks](std::function<void()> task) {
+        deferred_tasks.push_back(std::move(task));
+      });
+  EXPECT_CALL(sequential_scheduler, Schedule(_))
+      .Times(3)
+      .WillRepeatedly(call_fn);
+  SecAggScheduler runner(&parallel_scheduler, &sequential_scheduler);
+  std::vector<std::pair<absl::Duration, absl::Duration>> task_times;
+  runner.set_task_times_observer(
+      [&task_times](absl::Duration wait_time, absl::Duration run_time) {
+        task_times.emplace_back(wait_time, run_time);
+      });
+
+  auto accumulator = runner.CreateAccumulator<Integer>(
+      std::make_unique<Integer>(1), multiply_accumulator);
+  for (int i = 0; i < 3; ++i) {
+    accumulator->Schedule([]() {
+      absl::SleepFor(absl::Milliseconds(5));
+      return std::make_unique<Integer>(2);
+    });
+  }
+  absl::SleepFor(absl::Milliseconds(10));
+  for (const auto& task : deferred_tasks) {
+    task();
+  }
+
+  ASSERT_THAT(task_times.size(), Eq(3));
+  for (const auto& [wait_time, run_time] : task_times) {
+    EXPECT_THAT(wait_time, Ge(absl::Milliseconds(10)));
+    EXPECT_THAT(run_time, Ge(absl::Milliseconds(5)));
+  }
+  EXPECT_THAT(accumulator->GetResultAndCancel()->value, Eq(8));
+}
+
+TEST(SecAggSchedulerTest, ParallelForReportsTaskTimesOfTasksThatRan) {
+  StrictMock<MockScheduler> parallel_scheduler;
+  StrictMock<MockScheduler> sequential_scheduler;
+  // The first scheduled task runs right away and takes all the indices, so
+  // the other tasks and the calling thread find no work left.
+  EXPECT_CALL(parallel_scheduler, Schedule(_))
+      .Times(9)
+      .WillRepeatedly(call_fn);
+  SecAggScheduler runner(&parallel_scheduler, &sequential_scheduler);
+  std::vector<absl::Duration> run_times;
+  runner.set_task_times_observer(
+      [&run_times](absl::Duration wait_time, absl::Duration run_time) {
+        run_times.push_back(run_time);
+      });
+
+  int sum = 0;
+  runner.ParallelFor(10, [&sum](size_t i) {
+    absl::SleepFor(absl::Milliseconds(1));
+    sum += i;
+  });
+  EXPECT_THAT(sum, Eq(45));
+  ASSERT_THAT(run_times.size(), Eq(1));
+  EXPECT_THAT(run_times[0], Ge(absl::Milliseconds(10)));
+}
+
 }  // namespace
 }  // namespace secagg
 }  // namespace fcp
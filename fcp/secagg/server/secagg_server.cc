@@ -18,14 +18,19 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_set.h"
 #include "absl/container/node_hash_set.h"
+#include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "fcp/base/monitoring.h"
 #include "fcp/secagg/server/aes/aes_secagg_server_protocol_impl.h"
 #include "fcp/secagg/server/experiments_names.h"
@@ -35,7 +40,11 @@
 #include "fcp/secagg/server/secagg_server_enums.pb.h"
 #include "fcp/secagg/server/secagg_server_messages.pb.h"
 #include "fcp/secagg/server/secagg_server_metrics_listener.h"
+#include "fcp/secagg/server/secagg_server_prng_running_state.h"
 #include "fcp/secagg/server/secagg_server_r0_advertise_keys_state.h"
+#include "fcp/secagg/server/secagg_server_r1_share_keys_state.h"
+#include "fcp/secagg/server/secagg_server_r2_masked_input_coll_state.h"
+#include "fcp/secagg/server/secagg_server_r3_unmasking_state.h"
 #include "fcp/secagg/server/secagg_server_state.h"
 #include "fcp/secagg/server/secagg_trace_utility.h"
 #include "fcp/secagg/server/secret_sharing_graph.h"
@@ -43,6 +52,7 @@
 #include "fcp/secagg/server/send_to_clients_interface.h"
 #include "fcp/secagg/server/tracing_schema.h"
 #include "fcp/secagg/shared/aes_ctr_prng_factory.h"
+#include "fcp/secagg/shared/aes_key.h"
 #include "fcp/secagg/shared/aes_prng_factory.h"
 #include "fcp/secagg/shared/input_vector_specification.h"
 #include "fcp/secagg/shared/secagg_messages.pb.h"
@@ -51,8 +61,84 @@
 namespace fcp {
 namespace secagg {
 
-SecAggServer::SecAggServer(std::unique_ptr<SecAggServerProtocolImpl> impl) {
-  state_ = std::make_unique<SecAggServerR0AdvertiseKeysState>(std::move(impl));
+namespace {
+
+// Returns the secret sharing graph described by a snapshot.
+StatusOr<std::unique_ptr<SecretSharingGraph>> CreateGraphFromSnapshot(
+    const SecAggServerSnapshot& snapshot) {
+  const int num_nodes = snapshot.number_of_clients();
+  const int degree = snapshot.degree();
+  const int threshold = snapshot.threshold();
+  if (num_nodes < 1 || threshold < 1 || threshold > degree ||
+      degree > num_nodes) {
+    return ::absl::InvalidArgumentError(
+        "The snapshot has invalid graph parameters.");
+  }
+  std::unique_ptr<SecretSharingGraph> secret_sharing_graph;
+  switch (snapshot.server_variant()) {
+    case ServerVariant::NATIVE_V1:
+      if (degree != num_nodes || !snapshot.graph_permutation().empty() ||
+          !snapshot.graph_permutation_seed().empty()) {
+        return ::absl::InvalidArgumentError(
+            "The snapshot has invalid graph parameters.");
+      }
+      secret_sharing_graph =
+          SecretSharingGraphFactory::CreateCompleteGraph(num_nodes, threshold);
+      break;
+    case ServerVariant::NATIVE_SUBGRAPH: {
+      if (degree % 2 != 1) {
+        return ::absl::InvalidArgumentError(
+            "The snapshot has invalid graph parameters.");
+      }
+      if (!snapshot.graph_permutation_seed().empty()) {
+        const std::string& seed = snapshot.graph_permutation_seed();
+        if (seed.size() != AesKey::kSize ||
+            !snapshot.graph_permutation().empty()) {
+          return ::absl::InvalidArgumentError(
+              "The snapshot has an invalid graph permutation seed.");
+        }
+        secret_sharing_graph =
+            SecretSharingGraphFactory::CreateHararyGraphWithPermutationSeed(
+                num_nodes, degree, threshold,
+                AesKey(reinterpret_cast<const uint8_t*>(seed.data())));
+        break;
+      }
+      if (snapshot.graph_permutation_size() != num_nodes) {
+        return ::absl::InvalidArgumentError(
+            "The snapshot has invalid graph parameters.");
+      }
+      std::vector<bool> seen(num_nodes);
+      for (int node : snapshot.graph_permutation()) {
+        if (node < 0 || node >= num_nodes || seen[node]) {
+          return ::absl::InvalidArgumentError(
+              "The graph permutation in the snapshot isn't a permutation.");
+        }
+        seen[node] = true;
+      }
+      secret_sharing_graph =
+          SecretSharingGraphFactory::CreateHararyGraphWithPermutation(
+              degree, threshold,
+              std::vector<int>(snapshot.graph_permutation().begin(),
+                               snapshot.graph_permutation().end()));
+      break;
+    }
+    default:
+      return ::absl::InvalidArgumentError(
+          absl::StrCat("The snapshot has unsupported server variant ",
+                       ServerVariant_Name(snapshot.server_variant()), "."));
+  }
+  return std::move(secret_sharing_graph);
+}
+
+}  // namespace
+
+SecAggServer::SecAggServer(std::unique_ptr<SecAggServerProtocolImpl> impl)
+    : SecAggServer(
+          std::make_unique<SecAggServerR0AdvertiseKeysState>(std::move(impl))) {
+}
+
+SecAggServer::SecAggServer(std::unique_ptr<SecAggServerState> state) {
+  state_ = std::move(state);
 
   // Start the span for the current state. The rest of the state span
   // transitioning is done in TransitionState.
@@ -174,6 +260,82 @@ StatusOr<std::unique_ptr<SecAggServer>> SecAggServer::Create(
           server_variant, std::move(experiments))));
 }
 
+StatusOr<std::unique_ptr<SecAggServer>> SecAggServer::Resume(
+    const SecAggServerSnapshot& snapshot,
+    const std::vector<InputVectorSpecification>& input_vector_specs,
+    SendToClientsInterface* sender,
+    std::unique_ptr<SecAggServerMetricsListener> metrics,
+    std::unique_ptr<SecAggScheduler> prng_runner,
+    std::unique_ptr<ExperimentsInterface> experiments) {
+  switch (snapshot.state()) {
+    case SecAggServerStateKind::R1_SHARE_KEYS:
+    case SecAggServerStateKind::R2_MASKED_INPUT_COLLECTION:
+    case SecAggServerStateKind::R3_UNMASKING:
+    case SecAggServerStateKind::PRNG_RUNNING:
+      break;
+    default:
+      return ::absl::InvalidArgumentError(
+          absl::StrCat("The protocol can't be resumed in state ",
+                       SecAggServerStateKind_Name(snapshot.state()), "."));
+  }
+  // The session id is computed at the end of round 0.
+  if (snapshot.session_id().empty()) {
+    return ::absl::InvalidArgumentError("The snapshot has no session id.");
+  }
+  if (snapshot.minimum_number_of_clients_to_proceed() < 1 ||
+      snapshot.minimum_number_of_clients_to_proceed() >
+          snapshot.number_of_clients()) {
+    return ::absl::InvalidArgumentError(
+        "The snapshot has an invalid minimum number of clients to proceed.");
+  }
+  FCP_ASSIGN_OR_RETURN(std::unique_ptr<SecretSharingGraph> secret_sharing_graph,
+                       CreateGraphFromSnapshot(snapshot));
+
+  auto impl = std::make_unique<AesSecAggServerProtocolImpl>(
+      std::move(secret_sharing_graph),
+      snapshot.minimum_number_of_clients_to_proceed(), input_vector_specs,
+      std::move(metrics), std::make_unique<AesCtrPrngFactory>(), sender,
+      std::move(prng_runner),
+      std::vector<ClientStatus>(snapshot.number_of_clients(),
+                                ClientStatus::READY_TO_START),
+      snapshot.server_variant(), std::move(experiments));
+  FCP_RETURN_IF_ERROR(impl->RestoreSnapshot(snapshot));
+
+  const int failed_after_sending_masked_input =
+      snapshot.number_of_clients_failed_after_sending_masked_input();
+  const int failed_before_sending_masked_input =
+      snapshot.number_of_clients_failed_before_sending_masked_input();
+  const int terminated_without_unmasking =
+      snapshot.number_of_clients_terminated_without_unmasking();
+  std::unique_ptr<SecAggServerState> state;
+  switch (snapshot.state()) {
+    case SecAggServerStateKind::R1_SHARE_KEYS:
+      state = std::make_unique<SecAggServerR1ShareKeysState>(
+          std::move(impl), failed_after_sending_masked_input,
+          failed_before_sending_masked_input, terminated_without_unmasking);
+      break;
+    case SecAggServerStateKind::R2_MASKED_INPUT_COLLECTION:
+      state = std::make_unique<SecAggServerR2MaskedInputCollState>(
+          std::move(impl), failed_after_sending_masked_input,
+          failed_before_sending_masked_input, terminated_without_unmasking);
+      break;
+    case SecAggServerStateKind::R3_UNMASKING:
+      state = std::make_unique<SecAggServerR3UnmaskingState>(
+          std::move(impl), failed_after_sending_masked_input,
+          failed_before_sending_masked_input, terminated_without_unmasking);
+      break;
+    default:
+      state = std::make_unique<SecAggServerPrngRunningState>(
+          std::move(impl), failed_after_sending_masked_input,
+          failed_before_sending_masked_input, terminated_without_unmasking);
+      break;
+  }
+
+  auto server = absl::WrapUnique(new SecAggServer(std::move(state)));
+  server->state_->EnterState();
+  return std::move(server);
+}
+
 Status SecAggServer::Abort() {
   const std::string reason = "Abort upon external request.";
   TracingSpan<AbortSecAggServer> span(state_span_->Ref(), reason);
@@ -246,7 +408,11 @@ StatusOr<bool> SecAggServer::ReceiveMessage(
   TracingSpan<ReceiveSecAggMessage> span(state_span_->Ref(), client_id);
   FCP_RETURN_IF_ERROR(ErrorIfAbortedOrCompleted());
   FCP_RETURN_IF_ERROR(ValidateClientId(client_id));
-  FCP_RETURN_IF_ERROR(state_->HandleMessage(client_id, std::move(message)));
+  absl::Time start_time = absl::Now();
+  auto message_type = message->message_content_case();
+  Status status = state_->HandleMessage(client_id, std::move(message));
+  state_->MessageHandled(message_type, absl::Now() - start_time);
+  FCP_RETURN_IF_ERROR(status);
   return ReadyForNextRound();
 }
 
@@ -254,6 +420,11 @@ bool SecAggServer::SetAsyncCallback(std::function<void()> async_callback) {
   return state_->SetAsyncCallback(async_callback);
 }
 
+void SecAggServer::SetSnapshotCallback(
+    std::function<void(const SecAggServerSnapshot&)> snapshot_callback) {
+  snapshot_callback_ = std::move(snapshot_callback);
+}
+
 void SecAggServer::TransitionState(
     std::unique_ptr<SecAggServerState> new_state) {
   // Reset state_span_ before creating a new unscoped span for the next state
@@ -262,6 +433,23 @@ void SecAggServer::TransitionState(
   state_ = std::move(new_state);
   state_span_ = std::make_unique<UnscopedTracingSpan<SecureAggServerState>>(
       span_.Ref(), TracingState(state_->State()));
+  if (snapshot_callback_) {
+    switch (state_->State()) {
+      case SecAggServerStateKind::R1_SHARE_KEYS:
+      case SecAggServerStateKind::R2_MASKED_INPUT_COLLECTION:
+      case SecAggServerStateKind::R3_UNMASKING:
+      case SecAggServerStateKind::PRNG_RUNNING: {
+        // The snapshot must be written before EnterState, which starts the
+        // PRNG computation, consuming the sum of the masked inputs.
+        SecAggServerSnapshot snapshot;
+        state_->WriteSnapshot(&snapshot);
+        snapshot_callback_(snapshot);
+        break;
+      }
+      default:
+        break;
+    }
+  }
   state_->EnterState();
 }
 
@@ -117,6 +117,30 @@ class SecAggServer {
       std::unique_ptr<ExperimentsInterface> experiments,
       const SecureAggregationRequirements& threat_model);
 
+  // Constructs a server which resumes the protocol from a snapshot passed to
+  // a snapshot callback (see SetSnapshotCallback) by a previous server, e.g.
+  // one which was lost together with the process running it.
+  //
+  // The resumed server is in the state in which the snapshot was taken, at
+  // the start of its round: the messages which the previous server sent to
+  // clients on proceeding to that round aren't sent again, and any client
+  // responses which the previous server received during the round must be
+  // passed to ReceiveMessage again. A server resumed in the PRNG_RUNNING state
+  // starts the PRNG computation right away.
+  //
+  // input_vector_specs must be the same as for the previous server. The other
+  // arguments are as for Create.
+  //
+  // Returns an INVALID_ARGUMENT status if the snapshot is malformed or
+  // inconsistent with input_vector_specs.
+  static StatusOr<std::unique_ptr<SecAggServer>> Resume(
+      const SecAggServerSnapshot& snapshot,
+      const std::vector<InputVectorSpecification>& input_vector_specs,
+      SendToClientsInterface* sender,
+      std::unique_ptr<SecAggServerMetricsListener> metrics,
+      std::unique_ptr<SecAggScheduler> prng_runner,
+      std::unique_ptr<ExperimentsInterface> experiments);
+
   ////////////////////////////// PROTOCOL METHODS //////////////////////////////
 
   // Makes the server abort the protocol, sending a message to all still-alive
@@ -193,6 +217,26 @@ class SecAggServer {
   // is ignored in that case.
   bool SetAsyncCallback(std::function<void()> async_callback);
 
+  // Sets up a callback to be invoked with a snapshot of the server each time
+  // it proceeds to round 1, 2 or 3, or to the PRNG computation. The snapshot
+  // is a protocol buffer, so it can be serialized and persisted by the
+  // callback; the protocol can then be resumed from the start of the last
+  // round reached, using Resume.
+  //
+  // The callback is invoked synchronously from ProceedToNextRound, after the
+  // messages for the new round have been sent to clients.
+  //
+  // From round 3 on, a snapshot holds the sum of the masked inputs received
+  // in round 2. A snapshot taken on proceeding to the PRNG computation also
+  // holds the Shamir shares collected in round 3: shares of the pairwise mask
+  // keys of the clients which didn't send a masked input, and of the self mask
+  // keys of the clients which did. These are the secrets the server holds in
+  // memory to unmask the sum, so a snapshot must be stored and transferred
+  // with the same confidentiality guarantees as the memory of the server
+  // itself, and deleted once the protocol has completed.
+  void SetSnapshotCallback(
+      std::function<void(const SecAggServerSnapshot&)> snapshot_callback);
+
   /////////////////////////////// STATUS METHODS ///////////////////////////////
 
   // Returns the set of clients that aborted the protocol. Can be used by the
@@ -315,6 +359,10 @@ class SecAggServer {
   // Constructs a new instance of the Secure Aggregation server.
   explicit SecAggServer(std::unique_ptr<SecAggServerProtocolImpl> impl);
 
+  // Constructs an instance of the Secure Aggregation server in the given
+  // state.
+  explicit SecAggServer(std::unique_ptr<SecAggServerState> state);
+
   // This causes the server to transition into a new state, and call the
   // callback if one is provided.
   void TransitionState(std::unique_ptr<SecAggServerState> new_state);
@@ -337,6 +385,8 @@ class SecAggServer {
   // Holds pointer to a tracing span corresponding to the current active
   // SecAggServerState.
   std::unique_ptr<UnscopedTracingSpan<SecureAggServerState>> state_span_;
+
+  std::function<void(const SecAggServerSnapshot&)> snapshot_callback_;
 };
 
 }  // namespace secagg
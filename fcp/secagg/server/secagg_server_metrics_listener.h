@@ -89,6 +89,28 @@ class SecAggServerMetricsListener {
   // Shamir secret shares.
   // This includes all reconstruction operations for all shares, taken together.
   virtual void ShamirReconstructionTimes(uint64_t elapsed_millis) = 0;
+
+  // The following metrics are finer grained, and meant for finding contention
+  // in the server. They are not needed by most listeners, so they default to
+  // doing nothing.
+
+  // Time (in microseconds) taken by the server to handle a message received
+  // from a client, measured over the SecAggServer::ReceiveMessage call.
+  virtual void MessageHandlingTimes(
+      ClientToServerWrapperMessage::MessageContentCase message_type,
+      uint64_t elapsed_micros) {}
+
+  // Number of masked input vectors waiting to be added to the sum, including
+  // the one just received, sampled each time a round 2 message is queued. Only
+  // reported when round 2 messages are aggregated asynchronously.
+  virtual void MaskedInputQueueSizes(uint64_t queue_size) {}
+
+  // Times (in microseconds) that an asynchronous task waited for a thread of
+  // the parallel scheduler, from being scheduled to starting to run, and then
+  // spent running. Such tasks are PRNG expansion batches, asynchronous round 2
+  // aggregation, and the parts of per-client work that the server spreads over
+  // the parallel scheduler.
+  virtual void AsyncTaskTimes(uint64_t wait_micros, uint64_t run_micros) {}
 };
 
 }  // namespace secagg
@@ -16,13 +16,21 @@
 
 #include "fcp/secagg/server/secagg_server_protocol_impl.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/container/node_hash_map.h"
 #include "absl/status/status.h"
+#include "absl/strings/string_view.h"
 #include "absl/time/time.h"
 #include "fcp/base/monitoring.h"
+#include "fcp/secagg/server/secret_sharing_harary_graph.h"
 #include "fcp/secagg/server/tracing_schema.h"
 #include "fcp/secagg/shared/compute_session_id.h"
 #include "fcp/tracing/tracing_span.h"
@@ -62,8 +70,18 @@ SecAggServerProtocolImpl::SecAggServerProtocolImpl(
                                      new EmptyExperiment())),
       pairwise_public_keys_(total_number_of_clients()),
       pairs_of_public_keys_(total_number_of_clients()),
-      encrypted_shares_(total_number_of_clients(),
-                        std::vector<std::string>(number_of_neighbors())) {}
+      encrypted_shares_(total_number_of_clients(), number_of_neighbors()) {
+  if (scheduler_ && metrics_) {
+    scheduler_->set_task_times_observer(
+        [metrics = metrics_.get()](absl::Duration wait_time,
+                                   absl::Duration run_time) {
+          // absl::Now() isn't monotonic, so the times may be negative.
+          metrics->AsyncTaskTimes(
+              std::max<int64_t>(0, absl::ToInt64Microseconds(wait_time)),
+              std::max<int64_t>(0, absl::ToInt64Microseconds(run_time)));
+        });
+  }
+}
 
 void SecAggServerProtocolImpl::SetResult(
     std::unique_ptr<SecAggVectorMap> result) {
@@ -178,8 +196,8 @@ Status SecAggServerProtocolImpl::HandleShareKeysResponse(
     // neighbor_id and client_id are neighbors, and thus index_in_neighbors is
     // in [0, number_neighbors()-1]
     int index_in_neighbor = GetNeighborIndexOrDie(neighbor_id, client_id);
-    encrypted_shares_[neighbor_id][index_in_neighbor] =
-        share_keys_response.encrypted_key_shares(i);
+    encrypted_shares_.Set(neighbor_id, index_in_neighbor,
+                          share_keys_response.encrypted_key_shares(i));
   }
 
   return ::absl::OkStatus();
@@ -189,19 +207,21 @@ void SecAggServerProtocolImpl::EraseShareKeysForClient(uint32_t client_id) {
   for (int i = 0; i < number_of_neighbors(); ++i) {
     int neighbor_id = GetNeighbor(client_id, i);
     int index_in_neighbor = GetNeighborIndexOrDie(neighbor_id, client_id);
-    encrypted_shares_[neighbor_id][index_in_neighbor].clear();
+    encrypted_shares_.Erase(neighbor_id, index_in_neighbor);
   }
 }
 
 void SecAggServerProtocolImpl::PrepareMaskedInputCollectionRequestForClient(
     uint32_t client_id, MaskedInputCollectionRequest* request) const {
   request->clear_encrypted_key_shares();
+  request->mutable_encrypted_key_shares()->Reserve(number_of_neighbors());
   for (int j = 0; j < number_of_neighbors(); ++j) {
-    request->add_encrypted_key_shares(encrypted_shares_[client_id][j]);
+    absl::string_view share = encrypted_shares_.Get(client_id, j);
+    request->add_encrypted_key_shares(share.data(), share.size());
   }
 }
 
-void SecAggServerProtocolImpl::ClearShareKeys() { encrypted_shares_.clear(); }
+void SecAggServerProtocolImpl::ClearShareKeys() { encrypted_shares_.Clear(); }
 
 // -----------------------------------------------------------------------------
 // Round 3 methods
@@ -236,29 +256,36 @@ inline ClientMask ClientMaskType(const ClientStatus& client_status) {
 }
 
 void SecAggServerProtocolImpl::SetUpShamirSharesTables() {
-  pairwise_shamir_share_table_ = std::make_unique<
-      absl::flat_hash_map<uint32_t, std::vector<ShamirShare>>>();
-  self_shamir_share_table_ = std::make_unique<
-      absl::flat_hash_map<uint32_t, std::vector<ShamirShare>>>();
+  pairwise_shamir_share_table_ =
+      std::make_unique<ShamirShareTable>(total_number_of_clients());
+  self_shamir_share_table_ =
+      std::make_unique<ShamirShareTable>(total_number_of_clients());
+  unmasking_responses_.clear();
 
   // Prepare the share tables with rows for clients we expect to have shares for
   for (uint32_t i = 0; i < total_number_of_clients(); ++i) {
     auto mask_type = ClientMaskType(client_status(i));
     if (mask_type == ClientMask::kPairwiseMask) {
-      pairwise_shamir_share_table_->emplace(i, number_of_neighbors());
+      (*pairwise_shamir_share_table_)[i].resize(number_of_neighbors());
     } else if (mask_type == ClientMask::kSelfMask) {
-      self_shamir_share_table_->emplace(i, number_of_neighbors());
+      (*self_shamir_share_table_)[i].resize(number_of_neighbors());
     }
   }
 }
 
 Status SecAggServerProtocolImpl::HandleUnmaskingResponse(
-    uint32_t client_id, const UnmaskingResponse& unmasking_response) {
+    uint32_t client_id, UnmaskingResponse unmasking_response) {
   FCP_CHECK(pairwise_shamir_share_table_ != nullptr &&
             self_shamir_share_table_ != nullptr)
       << "Shamir Shares Tables haven't been initialized";
 
   // Verify the client sent all the right types of shares.
+  if (unmasking_response.noise_or_prf_key_shares().size() !=
+      number_of_neighbors()) {
+    return ::absl::InvalidArgumentError(
+        "The UnmaskingResponse does not contain the expected number of key "
+        "shares.");
+  }
   for (uint32_t i = 0; i < number_of_neighbors(); ++i) {
     int ith_neighbor = GetNeighbor(client_id, i);
     switch (ClientMaskType(client_status(ith_neighbor))) {
@@ -285,64 +312,143 @@ Status SecAggServerProtocolImpl::HandleUnmaskingResponse(
         }
     }
   }
-  // Prepare the received key shares for reconstruction by inserting them into
-  // the tables.
-  for (int i = 0; i < number_of_neighbors(); ++i) {
-    // Find the index of client_id in the list of neighbors of the ith
-    // neighbor of client_id
-    int ith_neighbor = GetNeighbor(client_id, i);
-    int index = GetNeighborIndexOrDie(ith_neighbor, client_id);
-    if (unmasking_response.noise_or_prf_key_shares(i).oneof_shares_case() ==
-        NoiseOrPrfKeyShare::OneofSharesCase::kNoiseSkShare) {
-      (*pairwise_shamir_share_table_)[ith_neighbor][index].data =
-          unmasking_response.noise_or_prf_key_shares(i).noise_sk_share();
-    } else if (unmasking_response.noise_or_prf_key_shares(i)
-                   .oneof_shares_case() ==
-               NoiseOrPrfKeyShare::OneofSharesCase::kPrfSkShare) {
-      (*self_shamir_share_table_)[ith_neighbor][index].data =
-          unmasking_response.noise_or_prf_key_shares(i).prf_sk_share();
+  // The shares are added to the tables at the end of the round, when all the
+  // responses can be processed in parallel.
+  unmasking_responses_.emplace_back(client_id, std::move(unmasking_response));
+  return ::absl::OkStatus();
+}
+
+void SecAggServerProtocolImpl::FinalizeUnmaskingResponses() {
+  FCP_CHECK(pairwise_shamir_share_table_ != nullptr &&
+            self_shamir_share_table_ != nullptr)
+      << "Shamir Shares Tables haven't been initialized";
+  // Each client provides at most one share for each of its neighbors' keys,
+  // so no two responses write to the same table entry.
+  ParallelFor(unmasking_responses_.size(), [this](size_t response_index) {
+    auto& [client_id, unmasking_response] =
+        unmasking_responses_[response_index];
+    for (int i = 0; i < number_of_neighbors(); ++i) {
+      // Find the index of client_id in the list of neighbors of the ith
+      // neighbor of client_id
+      int ith_neighbor = GetNeighbor(client_id, i);
+      int index = GetNeighborIndexOrDie(ith_neighbor, client_id);
+      NoiseOrPrfKeyShare* share =
+          unmasking_response.mutable_noise_or_prf_key_shares(i);
+      if (share->oneof_shares_case() ==
+          NoiseOrPrfKeyShare::OneofSharesCase::kNoiseSkShare) {
+        (*pairwise_shamir_share_table_)[ith_neighbor][index].data =
+            std::move(*share->mutable_noise_sk_share());
+      } else if (share->oneof_shares_case() ==
+                 NoiseOrPrfKeyShare::OneofSharesCase::kPrfSkShare) {
+        (*self_shamir_share_table_)[ith_neighbor][index].data =
+            std::move(*share->mutable_prf_sk_share());
+      }
     }
+  });
+  std::vector<std::pair<uint32_t, UnmaskingResponse>>().swap(
+      unmasking_responses_);
+}
+
+void SecAggServerProtocolImpl::set_pairwise_shamir_share_table(
+    std::unique_ptr<absl::flat_hash_map<uint32_t, std::vector<ShamirShare>>>
+        pairwise_shamir_share_table) {
+  pairwise_shamir_share_table_ =
+      ToShamirShareTable(*pairwise_shamir_share_table);
+}
+
+void SecAggServerProtocolImpl::set_self_shamir_share_table(
+    std::unique_ptr<absl::flat_hash_map<uint32_t, std::vector<ShamirShare>>>
+        self_shamir_share_table) {
+  self_shamir_share_table_ = ToShamirShareTable(*self_shamir_share_table);
+}
+
+std::unique_ptr<SecAggServerProtocolImpl::ShamirShareTable>
+SecAggServerProtocolImpl::ToShamirShareTable(
+    const absl::flat_hash_map<uint32_t, std::vector<ShamirShare>>& table)
+    const {
+  auto result = std::make_unique<ShamirShareTable>(total_number_of_clients());
+  for (const auto& [client_id, shares] : table) {
+    FCP_CHECK(client_id < total_number_of_clients());
+    (*result)[client_id] = shares;
   }
-  return ::absl::OkStatus();
+  return result;
 }
 
 // -----------------------------------------------------------------------------
 // PRNG computation methods
 // -----------------------------------------------------------------------------
 
+// Number of keys reconstructed by each parallel task. Each task has its own
+// ShamirSecretSharing, whose cached coefficients are reused across the keys of
+// the batch.
+static constexpr size_t kShamirReconstructionBatchSize = 32;
+
 StatusOr<SecAggServerProtocolImpl::ShamirReconstructionResult>
 SecAggServerProtocolImpl::HandleShamirReconstruction() {
   FCP_CHECK(pairwise_shamir_share_table_ != nullptr &&
             self_shamir_share_table_ != nullptr)
       << "Shamir Shares Tables haven't been initialized";
 
-  ShamirReconstructionResult result;
-  ShamirSecretSharing reconstructor;
-
-  for (const auto& item : *pairwise_shamir_share_table_) {
-    FCP_ASSIGN_OR_RETURN(std::string reconstructed_key,
-                         reconstructor.Reconstruct(
-                             minimum_surviving_neighbors_for_reconstruction(),
-                             item.second, EcdhPrivateKey::kSize));
-    auto key_agreement = EcdhKeyAgreement::CreateFromPrivateKey(EcdhPrivateKey(
-        reinterpret_cast<const uint8_t*>(reconstructed_key.c_str())));
-    if (!key_agreement.ok()) {
-      // The server was unable to reconstruct the private key, probably
-      // because some client(s) sent invalid key shares. The only way out is
-      // to abort.
-      return ::absl::InvalidArgumentError(
-          "Unable to reconstruct aborted client's private key from shares");
+  const size_t num_clients = total_number_of_clients();
+  // A client's key is reconstructed from at most one of the tables, so the
+  // results can be indexed by client id.
+  std::vector<std::unique_ptr<EcdhKeyAgreement>> key_agreements(num_clients);
+  std::vector<AesKey> self_keys(num_clients);
+  std::vector<Status> statuses(num_clients);
+  const size_t num_batches =
+      (num_clients + kShamirReconstructionBatchSize - 1) /
+      kShamirReconstructionBatchSize;
+  ParallelFor(num_batches, [&](size_t batch) {
+    ShamirSecretSharing reconstructor;
+    const size_t end = std::min(
+        num_clients, (batch + 1) * kShamirReconstructionBatchSize);
+    for (size_t i = batch * kShamirReconstructionBatchSize; i < end; ++i) {
+      const std::vector<ShamirShare>& pairwise_shares =
+          (*pairwise_shamir_share_table_)[i];
+      const std::vector<ShamirShare>& self_shares =
+          (*self_shamir_share_table_)[i];
+      if (!pairwise_shares.empty()) {
+        auto reconstructed_key = reconstructor.Reconstruct(
+            minimum_surviving_neighbors_for_reconstruction(), pairwise_shares,
+            EcdhPrivateKey::kSize);
+        if (!reconstructed_key.ok()) {
+          statuses[i] = reconstructed_key.status();
+          continue;
+        }
+        auto key_agreement =
+            EcdhKeyAgreement::CreateFromPrivateKey(EcdhPrivateKey(
+                reinterpret_cast<const uint8_t*>(reconstructed_key->c_str())));
+        if (!key_agreement.ok()) {
+          // The server was unable to reconstruct the private key, probably
+          // because some client(s) sent invalid key shares. The only way out
+          // is to abort.
+          statuses[i] = ::absl::InvalidArgumentError(
+              "Unable to reconstruct aborted client's private key from "
+              "shares");
+          continue;
+        }
+        key_agreements[i] = std::move(key_agreement).value();
+      } else if (!self_shares.empty()) {
+        auto reconstructed = AesKey::CreateFromShares(
+            self_shares, minimum_surviving_neighbors_for_reconstruction());
+        if (!reconstructed.ok()) {
+          statuses[i] = reconstructed.status();
+          continue;
+        }
+        self_keys[i] = std::move(reconstructed).value();
+      }
     }
-    result.aborted_client_key_agreements.try_emplace(
-        item.first, std::move(*(key_agreement.value())));
-  }
+  });
 
-  for (const auto& item : *self_shamir_share_table_) {
-    FCP_ASSIGN_OR_RETURN(
-        AesKey reconstructed,
-        AesKey::CreateFromShares(
-            item.second, minimum_surviving_neighbors_for_reconstruction()));
-    result.self_keys.try_emplace(item.first, reconstructed);
+  ShamirReconstructionResult result;
+  for (uint32_t i = 0; i < num_clients; ++i) {
+    FCP_RETURN_IF_ERROR(statuses[i]);
+    if (key_agreements[i] != nullptr) {
+      result.aborted_client_key_agreements.try_emplace(
+          i, std::move(*key_agreements[i]));
+    } else if (!(*self_shamir_share_table_)[i].empty()) {
+      result.self_keys.try_emplace(i, self_keys[i]);
+    }
   }
 
   return std::move(result);
@@ -399,5 +505,138 @@ SecAggServerProtocolImpl::InitializePrng(
   return std::move(work_items);
 }
 
+// -----------------------------------------------------------------------------
+// Snapshot methods
+// -----------------------------------------------------------------------------
+
+void SecAggServerProtocolImpl::WriteSnapshot(
+    SecAggServerSnapshot* snapshot) const {
+  snapshot->set_server_variant(server_variant());
+  snapshot->set_minimum_number_of_clients_to_proceed(
+      minimum_number_of_clients_to_proceed());
+  snapshot->set_number_of_clients(total_number_of_clients());
+  snapshot->set_degree(number_of_neighbors());
+  snapshot->set_threshold(minimum_surviving_neighbors_for_reconstruction());
+  if (server_variant() == ServerVariant::NATIVE_SUBGRAPH) {
+    // The subgraph variant always uses a Harary graph, whose randomly permuted
+    // node ids must be kept for the resumed protocol to use the same graph.
+    const auto* graph =
+        static_cast<const SecretSharingHararyGraph*>(secret_sharing_graph());
+    if (graph->permutation_seed().has_value()) {
+      snapshot->set_graph_permutation_seed(
+          graph->permutation_seed()->AsString());
+    } else {
+      snapshot->mutable_graph_permutation()->Add(graph->permutation().begin(),
+                                                 graph->permutation().end());
+    }
+  }
+
+  for (ClientStatus status : client_statuses_) {
+    snapshot->add_client_statuses(status);
+  }
+  for (const EcdhPublicKey& key : pairwise_public_keys_) {
+    snapshot->add_pairwise_public_keys(key.AsString());
+  }
+  if (session_id_ != nullptr) {
+    snapshot->set_session_id(session_id_->data);
+  }
+
+  auto write_table = [](const ShamirShareTable& table,
+                        ::google::protobuf::RepeatedPtrField<
+                            SecAggServerSnapshot::ShamirShareRow>* rows) {
+    for (uint32_t client_id = 0; client_id < table.size(); ++client_id) {
+      if (table[client_id].empty()) {
+        continue;
+      }
+      SecAggServerSnapshot::ShamirShareRow* row = rows->Add();
+      row->set_client_id(client_id);
+      for (const ShamirShare& share : table[client_id]) {
+        row->add_shares(share.data);
+      }
+    }
+  };
+  // The shares are only complete once round 3 is over.
+  if (snapshot->state() == SecAggServerStateKind::PRNG_RUNNING) {
+    FCP_CHECK(pairwise_shamir_share_table_ != nullptr &&
+              self_shamir_share_table_ != nullptr)
+        << "Shamir Shares Tables haven't been initialized";
+    write_table(*pairwise_shamir_share_table_,
+                snapshot->mutable_pairwise_shamir_shares());
+    write_table(*self_shamir_share_table_,
+                snapshot->mutable_self_shamir_shares());
+  }
+}
+
+Status SecAggServerProtocolImpl::RestoreSnapshot(
+    const SecAggServerSnapshot& snapshot) {
+  if (snapshot.client_statuses_size() != total_number_of_clients() ||
+      snapshot.pairwise_public_keys_size() != total_number_of_clients()) {
+    return ::absl::InvalidArgumentError(
+        "The snapshot doesn't have an entry for every client.");
+  }
+  for (uint32_t i = 0; i < total_number_of_clients(); ++i) {
+    client_statuses_[i] = snapshot.client_statuses(i);
+    const std::string& key = snapshot.pairwise_public_keys(i);
+    if (key.empty()) {
+      pairwise_public_keys_[i] = EcdhPublicKey();
+    } else if (key.size() == EcdhPublicKey::kSize) {
+      pairwise_public_keys_[i] =
+          EcdhPublicKey(reinterpret_cast<const uint8_t*>(key.data()));
+    } else if (key.size() == EcdhPublicKey::kUncompressedSize) {
+      pairwise_public_keys_[i] =
+          EcdhPublicKey(reinterpret_cast<const uint8_t*>(key.data()),
+                        EcdhPublicKey::kUncompressed);
+    } else {
+      return ::absl::InvalidArgumentError(
+          "A public key in the snapshot is not the correct size.");
+    }
+  }
+  if (!snapshot.session_id().empty()) {
+    set_session_id(
+        std::make_unique<SessionId>(SessionId{snapshot.session_id()}));
+  }
+
+  if (snapshot.state() == SecAggServerStateKind::PRNG_RUNNING) {
+    FCP_ASSIGN_OR_RETURN(
+        pairwise_shamir_share_table_,
+        ShamirShareTableFromSnapshot(snapshot.pairwise_shamir_shares()));
+    FCP_ASSIGN_OR_RETURN(
+        self_shamir_share_table_,
+        ShamirShareTableFromSnapshot(snapshot.self_shamir_shares()));
+  }
+  return ::absl::OkStatus();
+}
+
+StatusOr<std::unique_ptr<SecAggServerProtocolImpl::ShamirShareTable>>
+SecAggServerProtocolImpl::ShamirShareTableFromSnapshot(
+    const ::google::protobuf::RepeatedPtrField<
+        SecAggServerSnapshot::ShamirShareRow>& rows) const {
+  auto table = std::make_unique<ShamirShareTable>(total_number_of_clients());
+  for (const SecAggServerSnapshot::ShamirShareRow& row : rows) {
+    if (row.client_id() >= total_number_of_clients() ||
+        row.shares_size() != number_of_neighbors()) {
+      return ::absl::InvalidArgumentError(
+          "A row of Shamir shares in the snapshot is invalid.");
+    }
+    std::vector<ShamirShare>& shares = (*table)[row.client_id()];
+    shares.reserve(row.shares_size());
+    for (const std::string& share : row.shares()) {
+      shares.push_back({share});
+    }
+  }
+  return std::move(table);
+}
+
+void SecAggServerProtocolImpl::ParallelFor(
+    size_t count, std::function<void(size_t)> function) {
+  if (scheduler() != nullptr) {
+    scheduler()->ParallelFor(count, std::move(function));
+  } else {
+    for (size_t i = 0; i < count; ++i) {
+      function(i);
+    }
+  }
+}
+
 }  // namespace secagg
 }  // namespace fcp
@@ -24,9 +24,12 @@
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "google/protobuf/repeated_ptr_field.h"
+#include "fcp/secagg/server/encrypted_share_table.h"
 #include "fcp/secagg/server/experiments_interface.h"
 #include "fcp/secagg/server/secagg_scheduler.h"
 #include "fcp/secagg/server/secagg_server_enums.pb.h"
+#include "fcp/secagg/server/secagg_server_messages.pb.h"
 #include "fcp/secagg/server/secagg_server_metrics_listener.h"
 #include "fcp/secagg/server/secret_sharing_graph.h"
 #include "fcp/secagg/server/send_to_clients_interface.h"
@@ -205,17 +208,15 @@ class SecAggServerProtocolImpl {
   // TODO(team): Review whether getters and setters below are needed.
   // Most of these fields are needed only for testing.
 
+  // The Shamir shares tables are set from maps keyed by client id; rows for
+  // clients which aren't in a map are left empty.
   void set_pairwise_shamir_share_table(
       std::unique_ptr<absl::flat_hash_map<uint32_t, std::vector<ShamirShare>>>
-          pairwise_shamir_share_table) {
-    pairwise_shamir_share_table_ = std::move(pairwise_shamir_share_table);
-  }
+          pairwise_shamir_share_table);
 
   void set_self_shamir_share_table(
       std::unique_ptr<absl::flat_hash_map<uint32_t, std::vector<ShamirShare>>>
-          self_shamir_share_table) {
-    self_shamir_share_table_ = std::move(self_shamir_share_table);
-  }
+          self_shamir_share_table);
 
   // ---------------------------------------------------------------------------
   // Round 0 methods
@@ -297,10 +298,16 @@ class SecAggServerProtocolImpl {
   // tables based on client states at the beginning of the round.
   void SetUpShamirSharesTables();
 
-  // Populates Shamir shares tables with the data from UnmaskingResponse.
+  // Checks an UnmaskingResponse, and if it is valid, queues its shares to be
+  // added to the Shamir shares tables by FinalizeUnmaskingResponses().
   // Returning an error status means that the unmasking response was invalid.
   Status HandleUnmaskingResponse(uint32_t client_id,
-                                 const UnmaskingResponse& unmasking_response);
+                                 UnmaskingResponse unmasking_response);
+
+  // Moves the shares of all queued unmasking responses into the Shamir shares
+  // tables. Responses are processed in parallel; this must be called at the
+  // end of round 3, before HandleShamirReconstruction().
+  void FinalizeUnmaskingResponses();
 
   // ---------------------------------------------------------------------------
   // PRNG computation methods
@@ -314,7 +321,7 @@ class SecAggServerProtocolImpl {
   };
 
   // Performs reconstruction secret sharing keys reconstruction step of
-  // the PRNG stage of the protocol.
+  // the PRNG stage of the protocol. Keys are reconstructed in parallel.
   StatusOr<ShamirReconstructionResult> HandleShamirReconstruction();
 
   struct PrngWorkItems {
@@ -333,7 +340,41 @@ class SecAggServerProtocolImpl {
   virtual AsyncToken StartPrng(const PrngWorkItems& work_items,
                                std::function<void(Status)> done_callback) = 0;
 
+  // ---------------------------------------------------------------------------
+  // Snapshot methods
+  // ---------------------------------------------------------------------------
+
+  // Writes the data needed to resume the protocol from the start of the
+  // current round to `snapshot`, whose state must already be set. This must be
+  // called at the start of a round, before any messages of the round have been
+  // handled, and, in the PRNG_RUNNING state, before StartPrng().
+  virtual void WriteSnapshot(SecAggServerSnapshot* snapshot) const;
+
+  // Restores the data written by WriteSnapshot() into a new instance, which
+  // must have been constructed with the graph and parameters in `snapshot`.
+  // Returns an error if the snapshot is inconsistent with those parameters.
+  virtual Status RestoreSnapshot(const SecAggServerSnapshot& snapshot);
+
  private:
+  // Shamir shares indexed by the client whose key they are shares of, and then
+  // by the index among that client's neighbors of the client who provided the
+  // share. Rows for clients whose key isn't being reconstructed are empty.
+  using ShamirShareTable = std::vector<std::vector<ShamirShare>>;
+
+  // Converts a test-provided table keyed by client id to a ShamirShareTable.
+  std::unique_ptr<ShamirShareTable> ToShamirShareTable(
+      const absl::flat_hash_map<uint32_t, std::vector<ShamirShare>>& table)
+      const;
+
+  // Converts the rows of a snapshot to a ShamirShareTable.
+  StatusOr<std::unique_ptr<ShamirShareTable>> ShamirShareTableFromSnapshot(
+      const ::google::protobuf::RepeatedPtrField<
+          SecAggServerSnapshot::ShamirShareRow>& rows) const;
+
+  // Calls `function` for each index in [0, count), in parallel if there is a
+  // scheduler.
+  void ParallelFor(size_t count, std::function<void(size_t)> function);
+
   std::unique_ptr<SecretSharingGraph> secret_sharing_graph_;
   int minimum_number_of_clients_to_proceed_;
 
@@ -360,19 +401,20 @@ class SecAggServerProtocolImpl {
   std::unique_ptr<SessionId> session_id_;
 
   // Track the encrypted shares received from clients in preparation for sending
-  // them. encrypted_shares_table_[i][j] is an encryption of the pair of shares
-  // to be sent to client i, received from client j.
-  std::vector<std::vector<std::string>> encrypted_shares_;
+  // them. Entry (i, j) is an encryption of the pair of shares to be sent to
+  // client i, received from client i's j-th neighbor.
+  EncryptedShareTable encrypted_shares_;
 
   // Shamir shares tables.
-  // These store shares that have been collected from clients, and will be built
-  // up over the course of round 3. For both tables, the map key represents
-  // the client whose key these are shares of; the index in the vector
-  // represents the client who provided that key share.
-  std::unique_ptr<absl::flat_hash_map<uint32_t, std::vector<ShamirShare>>>
-      pairwise_shamir_share_table_;
-  std::unique_ptr<absl::flat_hash_map<uint32_t, std::vector<ShamirShare>>>
-      self_shamir_share_table_;
+  // These store shares that have been collected from clients in round 3. They
+  // are allocated in full at the start of the round, so that shares can be
+  // moved into them from several threads at once.
+  std::unique_ptr<ShamirShareTable> pairwise_shamir_share_table_;
+  std::unique_ptr<ShamirShareTable> self_shamir_share_table_;
+
+  // Valid unmasking responses which haven't been added to the Shamir shares
+  // tables yet, with the ids of the clients which sent them.
+  std::vector<std::pair<uint32_t, UnmaskingResponse>> unmasking_responses_;
 };
 
 }  // namespace secagg
@@ -17,9 +17,12 @@
 #include "fcp/secagg/server/secagg_server_r0_advertise_keys_state.h"
 
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "fcp/base/monitoring.h"
 #include "fcp/secagg/server/secagg_server_r1_share_keys_state.h"
@@ -147,15 +150,21 @@ SecAggServerR0AdvertiseKeysState::ProceedToNextRound() {
   FCP_RETURN_IF_ERROR(impl()->InitializeShareKeysRequest(
       message_to_client.mutable_share_keys_request()));
 
+  std::vector<uint32_t> recipient_ids;
   for (int i = 0; i < total_number_of_clients(); ++i) {
-    //  Reuse the common parts of the ShareKeysRequest message and update the
-    //  client-specific parts.
     if (!IsClientDead(i)) {
-      impl()->PrepareShareKeysRequestForClient(
-          i, message_to_client.mutable_share_keys_request());
-      Send(i, message_to_client);
+      recipient_ids.push_back(i);
     }
   }
+  // Reuse the common parts of the ShareKeysRequest message and update the
+  // client-specific parts.
+  SendToClients(recipient_ids, [this, &recipient_ids, &message_to_client](
+                                   size_t i,
+                                   ServerToClientWrapperMessage* message) {
+    *message = message_to_client;
+    impl()->PrepareShareKeysRequestForClient(
+        recipient_ids[i], message->mutable_share_keys_request());
+  });
 
   // Pairs of public keys are no longer needed beyond this point as the server
   // has already forwarded them to the clients.
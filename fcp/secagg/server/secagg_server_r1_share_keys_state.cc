@@ -17,9 +17,12 @@
 #include "fcp/secagg/server/secagg_server_r1_share_keys_state.h"
 
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "fcp/base/monitoring.h"
 #include "fcp/secagg/server/secagg_server_r2_masked_input_coll_state.h"
@@ -128,6 +131,7 @@ SecAggServerR1ShareKeysState::ProceedToNextRound() {
 
   // Abort all clients that haven't yet sent a message, and send a message to
   // all clients that are still alive.
+  std::vector<uint32_t> recipient_ids;
   for (int i = 0; i < total_number_of_clients(); ++i) {
     if (!IsClientDead(i) &&
         client_status(i) != ClientStatus::SHARE_KEYS_RECEIVED) {
@@ -135,12 +139,15 @@ SecAggServerR1ShareKeysState::ProceedToNextRound() {
           i, "Client did not send ShareKeysResponse before round transition.",
           ClientDropReason::NO_SHARE_KEYS);
     } else if (client_status(i) == ClientStatus::SHARE_KEYS_RECEIVED) {
-      ServerToClientWrapperMessage message;
-      impl()->PrepareMaskedInputCollectionRequestForClient(
-          i, message.mutable_masked_input_request());
-      Send(i, message);
+      recipient_ids.push_back(i);
     }
   }
+  SendToClients(recipient_ids, [this, &recipient_ids](
+                                   size_t i,
+                                   ServerToClientWrapperMessage* message) {
+    impl()->PrepareMaskedInputCollectionRequestForClient(
+        recipient_ids[i], message->mutable_masked_input_request());
+  });
 
   // Encrypted shares are no longer needed beyond this point as the server has
   // already forwarded them to the clients.
@@ -43,8 +43,14 @@ SecAggServerR3UnmaskingState::~SecAggServerR3UnmaskingState() {}
 
 Status SecAggServerR3UnmaskingState::HandleMessage(
     uint32_t client_id, const ClientToServerWrapperMessage& message) {
-  if (message.has_abort()) {
-    MessageReceived(message, false);
+  return HandleMessage(
+      client_id, std::make_unique<ClientToServerWrapperMessage>(message));
+}
+
+Status SecAggServerR3UnmaskingState::HandleMessage(
+    uint32_t client_id, std::unique_ptr<ClientToServerWrapperMessage> message) {
+  if (message->has_abort()) {
+    MessageReceived(*message, false);
     AbortClient(client_id, "Client sent abort message.",
                 ClientDropReason::SENT_ABORT_MESSAGE,
                 /*notify=*/false);
@@ -53,7 +59,7 @@ Status SecAggServerR3UnmaskingState::HandleMessage(
   // If the client has aborted already, ignore its messages.
   if (client_status(client_id) !=
       ClientStatus::MASKED_INPUT_RESPONSE_RECEIVED) {
-    MessageReceived(message, false);
+    MessageReceived(*message, false);
     AbortClient(
         client_id,
         "Not expecting an UnmaskingResponse from this client - either the "
@@ -61,17 +67,17 @@ Status SecAggServerR3UnmaskingState::HandleMessage(
         ClientDropReason::UNMASKING_RESPONSE_UNEXPECTED);
     return FCP_STATUS(OK);
   }
-  if (!message.has_unmasking_response()) {
-    MessageReceived(message, false);
+  if (!message->has_unmasking_response()) {
+    MessageReceived(*message, false);
     AbortClient(client_id,
                 "Message type received is different from what was expected.",
                 ClientDropReason::UNEXPECTED_MESSAGE_TYPE);
     return FCP_STATUS(OK);
   }
-  MessageReceived(message, true);
+  MessageReceived(*message, true);
 
-  Status status =
-      impl()->HandleUnmaskingResponse(client_id, message.unmasking_response());
+  Status status = impl()->HandleUnmaskingResponse(
+      client_id, std::move(*message->mutable_unmasking_response()));
   if (!status.ok()) {
     AbortClient(client_id, std::string(status.message()),
                 ClientDropReason::INVALID_UNMASKING_RESPONSE);
@@ -156,6 +162,7 @@ SecAggServerR3UnmaskingState::ProceedToNextRound() {
     }
   }
 
+  impl()->FinalizeUnmaskingResponses();
   return {std::make_unique<SecAggServerPrngRunningState>(
       ExitState(StateTransition::kSuccess),
       number_of_clients_failed_after_sending_masked_input_,
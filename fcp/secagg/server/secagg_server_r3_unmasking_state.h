@@ -46,6 +46,11 @@ class SecAggServerR3UnmaskingState : public SecAggServerState {
   // Handles an unmasking response or abort message from a client.
   Status HandleMessage(uint32_t client_id,
                        const ClientToServerWrapperMessage& message) override;
+  // Analog of the above method, which moves the key shares out of the message
+  // rather than copying them.
+  Status HandleMessage(
+      uint32_t client_id,
+      std::unique_ptr<ClientToServerWrapperMessage> message) override;
 
   bool IsNumberOfIncludedInputsCommitted() const override;
 
@@ -840,6 +840,34 @@ TEST(SecaggServerR3UnmaskingStateTest,
   state.ProceedToNextRound().IgnoreError();  // causes server abort
 }
 
+TEST(SecaggServerR3UnmaskingStateTest, ResponseWithTooFewSharesAbortsClient) {
+  MockSecAggServerMetricsListener* metrics =
+      new MockSecAggServerMetricsListener();
+  auto sender = std::make_unique<MockSendToClientsInterface>();
+  SecAggServerR3UnmaskingState state(
+      CreateSecAggServerProtocolImpl(3, 4, sender.get(), metrics),
+      0,   // number_of_clients_failed_after_sending_masked_input
+      0,   // number_of_clients_failed_before_sending_masked_input
+      0);  // number_of_clients_terminated_without_unmasking
+
+  ClientToServerWrapperMessage short_message;
+  for (int j = 0; j < 3; ++j) {
+    NoiseOrPrfKeyShare* share = short_message.mutable_unmasking_response()
+                                    ->add_noise_or_prf_key_shares();
+    share->set_prf_sk_share(
+        absl::StrCat("Test key share for client ", j, " from client 1"));
+  }
+
+  EXPECT_CALL(*metrics,
+              ClientsDropped(
+                  Eq(ClientStatus::DEAD_AFTER_MASKED_INPUT_RESPONSE_RECEIVED),
+                  Eq(ClientDropReason::INVALID_UNMASKING_RESPONSE)));
+  EXPECT_CALL(*sender, Send(Eq(1), _));
+  EXPECT_THAT(state.HandleMessage(1, short_message), IsOk());
+  EXPECT_THAT(state.AbortedClientIds().contains(1), Eq(true));
+  EXPECT_THAT(state.NumberOfMessagesReceivedInThisRound(), Eq(0));
+}
+
 TEST(SecaggServerR3UnmaskingStateTest, MetricsAreRecorded) {
   // In this test, no clients abort or aborted at any point, but
   // ProceedToNextRound is called after only 3 clients have submitted masked
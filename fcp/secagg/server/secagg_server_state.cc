@@ -16,19 +16,25 @@
 
 #include "fcp/secagg/server/secagg_server_state.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/container/node_hash_set.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "fcp/base/monitoring.h"
 #include "fcp/secagg/server/secagg_server_aborted_state.h"
 #include "fcp/secagg/server/secagg_server_enums.pb.h"
+#include "fcp/secagg/server/secagg_server_messages.pb.h"
 #include "fcp/secagg/server/secagg_trace_utility.h"
 #include "fcp/secagg/server/tracing_schema.h"
 #include "fcp/secagg/shared/secagg_messages.pb.h"
@@ -37,6 +43,15 @@
 namespace fcp {
 namespace secagg {
 
+namespace {
+
+// The number of client-specific messages which SendToClients prepares before
+// sending them. This bounds the memory held by prepared but unsent messages,
+// while giving each parallel task several messages to prepare.
+constexpr size_t kSendToClientsBatchSize = 256;
+
+}  // namespace
+
 SecAggServerState::SecAggServerState(
     int number_of_clients_failed_after_sending_masked_input,
     int number_of_clients_failed_before_sending_masked_input,
@@ -228,6 +243,17 @@ int SecAggServerState::NumberOfClientsTerminatedWithoutUnmasking() const {
 
 bool SecAggServerState::NeedsToAbort() const { return needs_to_abort_; }
 
+void SecAggServerState::WriteSnapshot(SecAggServerSnapshot* snapshot) const {
+  snapshot->set_state(state_kind_);
+  snapshot->set_number_of_clients_failed_after_sending_masked_input(
+      number_of_clients_failed_after_sending_masked_input_);
+  snapshot->set_number_of_clients_failed_before_sending_masked_input(
+      number_of_clients_failed_before_sending_masked_input_);
+  snapshot->set_number_of_clients_terminated_without_unmasking(
+      number_of_clients_terminated_without_unmasking_);
+  impl_->WriteSnapshot(snapshot);
+}
+
 absl::flat_hash_set<uint32_t> SecAggServerState::AbortedClientIds() const {
   auto aborted_client_ids_ = absl::flat_hash_set<uint32_t>();
   for (int i = 0; i < total_number_of_clients(); ++i) {
@@ -288,6 +314,17 @@ void SecAggServerState::MessageReceived(
                                elapsed_millis);
 }
 
+void SecAggServerState::MessageHandled(
+    ClientToServerWrapperMessage::MessageContentCase message_type,
+    absl::Duration elapsed_time) {
+  if (metrics()) {
+    // absl::Now() isn't monotonic, so elapsed_time may be negative.
+    metrics()->MessageHandlingTimes(
+        message_type,
+        std::max<int64_t>(0, absl::ToInt64Microseconds(elapsed_time)));
+  }
+}
+
 void SecAggServerState::BroadcastMessage(
     const ServerToClientWrapperMessage& message) {
   FCP_CHECK(message.message_content_case() !=
@@ -320,5 +357,49 @@ void SecAggServerState::Send(uint32_t recipient_id,
                                message.ByteSizeLong());
 }
 
+void SecAggServerState::SendToClients(
+    absl::Span<const uint32_t> recipient_ids,
+    const std::function<void(size_t, ServerToClientWrapperMessage*)>&
+        prepare_message) {
+  std::vector<ServerToClientWrapperMessage> messages;
+  std::vector<size_t> message_sizes;
+  for (size_t begin = 0; begin < recipient_ids.size();
+       begin += kSendToClientsBatchSize) {
+    size_t batch_size =
+        std::min(kSendToClientsBatchSize, recipient_ids.size() - begin);
+    messages.clear();
+    messages.resize(batch_size);
+    message_sizes.resize(batch_size);
+    auto prepare = [&](size_t i) {
+      prepare_message(begin + i, &messages[i]);
+      message_sizes[i] = messages[i].ByteSizeLong();
+    };
+    if (impl()->scheduler() != nullptr) {
+      impl()->scheduler()->ParallelFor(batch_size, prepare);
+    } else {
+      for (size_t i = 0; i < batch_size; ++i) {
+        prepare(i);
+      }
+    }
+
+    absl::Span<const uint32_t> batch_recipient_ids =
+        recipient_ids.subspan(begin, batch_size);
+    for (size_t i = 0; i < batch_size; ++i) {
+      FCP_CHECK(messages[i].message_content_case() !=
+                ServerToClientWrapperMessage::MESSAGE_CONTENT_NOT_SET);
+      if (metrics()) {
+        metrics()->IndividualMessageSizes(messages[i].message_content_case(),
+                                          message_sizes[i]);
+      }
+    }
+    sender()->SendBatch(batch_recipient_ids, messages);
+    for (size_t i = 0; i < batch_size; ++i) {
+      Trace<IndividualMessageSent>(batch_recipient_ids[i],
+                                   GetServerToClientMessageType(messages[i]),
+                                   message_sizes[i]);
+    }
+  }
+}
+
 }  // namespace secagg
 }  // namespace fcp
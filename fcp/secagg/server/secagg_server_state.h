@@ -17,13 +17,17 @@
 #ifndef FCP_SECAGG_SERVER_SECAGG_SERVER_STATE_H_
 #define FCP_SECAGG_SERVER_SECAGG_SERVER_STATE_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
 
 #include "absl/container/flat_hash_set.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "fcp/secagg/server/secagg_server_enums.pb.h"
+#include "fcp/secagg/server/secagg_server_messages.pb.h"
 #include "fcp/secagg/server/secagg_server_protocol_impl.h"
 #include "fcp/secagg/server/tracing_schema.h"
 #include "fcp/secagg/shared/secagg_messages.pb.h"
@@ -82,6 +86,12 @@ class SecAggServerState {
       uint32_t client_id,
       std::unique_ptr<ClientToServerWrapperMessage> message);
 
+  // Records the time taken by the caller to handle a message of the given
+  // type, including the HandleMessage call.
+  void MessageHandled(
+      ClientToServerWrapperMessage::MessageContentCase message_type,
+      absl::Duration elapsed_time);
+
   // Proceeds to the next round, doing all necessary computation and sending
   // messages to clients as appropriate. If the server is not yet ready to
   // proceed, returns an UNAVAILABLE status.
@@ -210,6 +220,11 @@ class SecAggServerState {
   // incoming messages from those clients for performance reasons.
   absl::flat_hash_set<uint32_t> AbortedClientIds() const;
 
+  // Writes a snapshot of the server, from which the protocol can be resumed
+  // at the start of this state. Only valid just after transitioning to the
+  // state, before EnterState is called.
+  void WriteSnapshot(SecAggServerSnapshot* snapshot) const;
+
   // Returns true if the server has determined that it needs to abort itself,
   // If the server is in a terminal state, returns false.
   bool NeedsToAbort() const;
@@ -269,6 +284,16 @@ class SecAggServerState {
   // Sends the message to the given client and records metrics.
   void Send(uint32_t recipient_id, const ServerToClientWrapperMessage& message);
 
+  // Sends a message to each of the given clients and records metrics, where
+  // prepare_message(i, message) fills in the message for recipient_ids[i].
+  // Messages are prepared in parallel on the scheduler, a batch at a time, and
+  // each batch is passed to SendToClientsInterface::SendBatch. Therefore
+  // prepare_message may be called concurrently, and must not modify state.
+  void SendToClients(
+      absl::Span<const uint32_t> recipient_ids,
+      const std::function<void(size_t, ServerToClientWrapperMessage*)>&
+          prepare_message);
+
   // Returns an aborted version of the current state, storing the specified
   // reason. Calling this method makes the current state unusable. The caller is
   // responsible for sending any failure messages that need to be sent, and for
@@ -17,6 +17,7 @@
 #include "fcp/secagg/server/secagg_server.h"
 
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <set>
 #include <string>
@@ -26,13 +27,19 @@
 #include "fcp/testing/parse_text_proto.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
 #include "fcp/base/monitoring.h"
+#include "fcp/secagg/server/experiments_names.h"
 #include "fcp/secagg/server/secagg_server_enums.pb.h"
+#include "fcp/secagg/server/secagg_server_messages.pb.h"
 #include "fcp/secagg/server/secagg_server_state.h"
+#include "fcp/secagg/server/secret_sharing_graph_factory.h"
 #include "fcp/secagg/server/tracing_schema.h"
 #include "fcp/secagg/shared/aes_ctr_prng_factory.h"
+#include "fcp/secagg/shared/aes_key.h"
 #include "fcp/secagg/shared/input_vector_specification.h"
 #include "fcp/secagg/shared/secagg_messages.pb.h"
+#include "fcp/secagg/shared/secagg_vector.h"
 #include "fcp/secagg/testing/ecdh_pregenerated_test_keys.h"
 #include "fcp/secagg/testing/server/mock_secagg_server_metrics_listener.h"
 #include "fcp/secagg/testing/server/mock_send_to_clients_interface.h"
@@ -45,7 +52,10 @@ namespace secagg {
 namespace {
 
 using ::testing::_;
+using ::testing::Each;
+using ::testing::ElementsAreArray;
 using ::testing::Eq;
+using ::testing::IsEmpty;
 
 std::unique_ptr<SecAggServer> CreateServer(
     SendToClientsInterface* sender,
@@ -406,6 +416,247 @@ TEST(SecaggServerTest, VerifyErrorsInAbortedState) {
   EXPECT_THAT(server->ReadyForNextRound(), IsCode(FAILED_PRECONDITION));
 }
 
+
+// A cohort small enough to be run through several rounds, using a subgraph
+// with 5 neighbors per client.
+constexpr int kSmallCohortSize = 10;
+constexpr int kSmallCohortVectorLength = 4;
+constexpr uint64_t kSmallCohortModulus = 32;
+
+std::vector<InputVectorSpecification> SmallCohortInputVectorSpecs() {
+  return {InputVectorSpecification("foobar", kSmallCohortVectorLength,
+                                   kSmallCohortModulus)};
+}
+
+std::unique_ptr<SecAggServer> CreateSmallCohortServer(
+    SendToClientsInterface* sender) {
+  SecureAggregationRequirements threat_model;
+  threat_model.set_adversary_class(AdversaryClass::CURIOUS_SERVER);
+  threat_model.set_adversarial_client_rate(.3);
+  threat_model.set_estimated_dropout_rate(.3);
+  auto status_or_server = SecAggServer::Create(
+      7,  // minimum_number_of_clients_to_proceed
+      kSmallCohortSize, SmallCohortInputVectorSpecs(), sender,
+      std::make_unique<MockSecAggServerMetricsListener>(),
+      /*prng_runner=*/nullptr,
+      std::make_unique<TestSecAggExperiment>(kForceSubgraphSecAggExperiment),
+      threat_model);
+  EXPECT_THAT(status_or_server.ok(), true) << status_or_server.status();
+  return std::move(status_or_server.value());
+}
+
+StatusOr<std::unique_ptr<SecAggServer>> ResumeSmallCohortServer(
+    const SecAggServerSnapshot& snapshot, SendToClientsInterface* sender) {
+  // Go through the serialized form, as a persisted snapshot would.
+  SecAggServerSnapshot parsed_snapshot;
+  EXPECT_TRUE(parsed_snapshot.ParseFromString(snapshot.SerializeAsString()));
+  return SecAggServer::Resume(
+      parsed_snapshot, SmallCohortInputVectorSpecs(), sender,
+      std::make_unique<MockSecAggServerMetricsListener>(),
+      /*prng_runner=*/nullptr, std::make_unique<TestSecAggExperiment>());
+}
+
+// Sends an AdvertiseKeys message from every client, and proceeds to round 1.
+void RunAdvertiseKeysRound(SecAggServer* server) {
+  EcdhPregeneratedTestKeys ecdh_keys;
+  for (uint32_t i = 0; i < kSmallCohortSize; ++i) {
+    auto message = std::make_unique<ClientToServerWrapperMessage>();
+    PairOfPublicKeys* keys =
+        message->mutable_advertise_keys()->mutable_pair_of_public_keys();
+    keys->set_enc_pk(ecdh_keys.GetPublicKeyString(i % 4));
+    keys->set_noise_pk(ecdh_keys.GetPublicKeyString(i % 4 + 4));
+    ASSERT_THAT(server->ReceiveMessage(i, std::move(message)), IsOk());
+  }
+  ASSERT_THAT(server->ProceedToNextRound(), IsOk());
+}
+
+// Sends a ShareKeysResponse from every client, and proceeds to round 2. The
+// graph is recreated from a snapshot of the server to find the clients'
+// neighbors.
+void RunShareKeysRound(SecAggServer* server,
+                       const SecAggServerSnapshot& snapshot) {
+  auto graph = SecretSharingGraphFactory::CreateHararyGraphWithPermutationSeed(
+      snapshot.number_of_clients(), snapshot.degree(), snapshot.threshold(),
+      AesKey(reinterpret_cast<const uint8_t*>(
+          snapshot.graph_permutation_seed().data())));
+  for (int i = 0; i < kSmallCohortSize; ++i) {
+    auto message = std::make_unique<ClientToServerWrapperMessage>();
+    ShareKeysResponse* response = message->mutable_share_keys_response();
+    for (int j = 0; j < graph->GetDegree(); ++j) {
+      response->add_encrypted_key_shares(
+          graph->GetNeighbor(i, j) == i ? "" : absl::StrCat("share", i, j));
+    }
+    ASSERT_THAT(server->ReceiveMessage(i, std::move(message)), IsOk());
+  }
+  ASSERT_THAT(server->ProceedToNextRound(), IsOk());
+}
+
+// Sends a masked input vector filled with i from every client i, and proceeds
+// to round 3.
+void RunMaskedInputCollectionRound(SecAggServer* server) {
+  for (uint32_t i = 0; i < kSmallCohortSize; ++i) {
+    auto message = std::make_unique<ClientToServerWrapperMessage>();
+    (*message->mutable_masked_input_response()->mutable_vectors())["foobar"]
+        .set_encoded_vector(
+            SecAggVector(std::vector<uint64_t>(kSmallCohortVectorLength, i),
+                         kSmallCohortModulus)
+                .GetAsPackedBytes());
+    ASSERT_THAT(server->ReceiveMessage(i, std::move(message)), IsOk());
+  }
+  ASSERT_THAT(server->ProceedToNextRound(), IsOk());
+}
+
+// The sum of the masked inputs sent by RunMaskedInputCollectionRound.
+std::vector<uint64_t> SmallCohortMaskedInputSum() {
+  return std::vector<uint64_t>(
+      kSmallCohortVectorLength,
+      (kSmallCohortSize * (kSmallCohortSize - 1) / 2) % kSmallCohortModulus);
+}
+
+std::vector<uint64_t> MaskedInputFromSnapshot(
+    const SecAggServerSnapshot& snapshot) {
+  const SecAggServerSnapshot::MaskedInputVector& vector =
+      snapshot.masked_input().at("foobar");
+  return SecAggVector(vector.packed_bytes(), vector.modulus(),
+                      vector.num_elements())
+      .GetAsUint64Vector();
+}
+
+TEST(SecaggServerTest, SnapshotIsTakenOnEachRoundTransition) {
+  auto sender = std::make_unique<MockSendToClientsInterface>();
+  auto server = CreateSmallCohortServer(sender.get());
+  std::vector<SecAggServerSnapshot> snapshots;
+  server->SetSnapshotCallback(
+      [&snapshots](const SecAggServerSnapshot& snapshot) {
+        snapshots.push_back(snapshot);
+      });
+
+  RunAdvertiseKeysRound(server.get());
+  ASSERT_THAT(snapshots.size(), Eq(1));
+  RunShareKeysRound(server.get(), snapshots[0]);
+  ASSERT_THAT(snapshots.size(), Eq(2));
+  RunMaskedInputCollectionRound(server.get());
+  ASSERT_THAT(snapshots.size(), Eq(3));
+
+  EXPECT_THAT(snapshots[0].state(), Eq(SecAggServerStateKind::R1_SHARE_KEYS));
+  EXPECT_THAT(snapshots[1].state(),
+              Eq(SecAggServerStateKind::R2_MASKED_INPUT_COLLECTION));
+  EXPECT_THAT(snapshots[2].state(), Eq(SecAggServerStateKind::R3_UNMASKING));
+  EcdhPregeneratedTestKeys ecdh_keys;
+  for (const SecAggServerSnapshot& snapshot : snapshots) {
+    EXPECT_THAT(snapshot.server_variant(), Eq(ServerVariant::NATIVE_SUBGRAPH));
+    EXPECT_THAT(snapshot.number_of_clients(), Eq(kSmallCohortSize));
+    EXPECT_THAT(snapshot.degree(), Eq(server->NumberOfNeighbors()));
+    EXPECT_THAT(snapshot.threshold(),
+                Eq(server->MinimumSurvivingNeighborsForReconstruction()));
+    EXPECT_THAT(snapshot.graph_permutation_seed(),
+                Eq(snapshots[0].graph_permutation_seed()));
+    EXPECT_THAT(snapshot.graph_permutation(), IsEmpty());
+    EXPECT_THAT(snapshot.session_id(), Eq(snapshots[0].session_id()));
+    ASSERT_THAT(snapshot.pairwise_public_keys_size(), Eq(kSmallCohortSize));
+    for (int i = 0; i < kSmallCohortSize; ++i) {
+      EXPECT_THAT(snapshot.pairwise_public_keys(i),
+                  Eq(ecdh_keys.GetPublicKeyString(i % 4 + 4)));
+    }
+  }
+  EXPECT_THAT(snapshots[0].session_id().empty(), Eq(false));
+  EXPECT_THAT(snapshots[0].graph_permutation_seed().size(),
+              Eq(AesKey::kSize));
+  EXPECT_THAT(snapshots[0].client_statuses(),
+              Each(Eq(ClientStatus::ADVERTISE_KEYS_RECEIVED)));
+  EXPECT_THAT(snapshots[1].client_statuses(),
+              Each(Eq(ClientStatus::SHARE_KEYS_RECEIVED)));
+  EXPECT_THAT(snapshots[2].client_statuses(),
+              Each(Eq(ClientStatus::MASKED_INPUT_RESPONSE_RECEIVED)));
+  EXPECT_THAT(snapshots[1].masked_input(), IsEmpty());
+  EXPECT_THAT(MaskedInputFromSnapshot(snapshots[2]),
+              ElementsAreArray(SmallCohortMaskedInputSum()));
+}
+
+TEST(SecaggServerTest, ResumedServerContinuesFromSnapshot) {
+  auto sender = std::make_unique<MockSendToClientsInterface>();
+  auto server = CreateSmallCohortServer(sender.get());
+  std::vector<SecAggServerSnapshot> snapshots;
+  auto snapshot_callback = [&snapshots](const SecAggServerSnapshot& snapshot) {
+    snapshots.push_back(snapshot);
+  };
+  server->SetSnapshotCallback(snapshot_callback);
+  RunAdvertiseKeysRound(server.get());
+  ASSERT_THAT(snapshots.size(), Eq(1));
+  server.reset();
+
+  // Resume in round 1, and run round 1 and 2 on the resumed server.
+  auto resumed_sender = std::make_unique<MockSendToClientsInterface>();
+  auto resumed_server =
+      ResumeSmallCohortServer(snapshots[0], resumed_sender.get());
+  ASSERT_THAT(resumed_server, IsOk());
+  EXPECT_THAT((*resumed_server)->State(),
+              Eq(SecAggServerStateKind::R1_SHARE_KEYS));
+  EXPECT_THAT((*resumed_server)->NumberOfAliveClients(), Eq(kSmallCohortSize));
+  EXPECT_THAT((*resumed_server)->NumberOfNeighbors(),
+              Eq(snapshots[0].degree()));
+  (*resumed_server)->SetSnapshotCallback(snapshot_callback);
+  RunShareKeysRound(resumed_server->get(), snapshots[0]);
+  RunMaskedInputCollectionRound(resumed_server->get());
+  ASSERT_THAT(snapshots.size(), Eq(3));
+  EXPECT_THAT(snapshots[2].state(), Eq(SecAggServerStateKind::R3_UNMASKING));
+  EXPECT_THAT(snapshots[2].graph_permutation_seed(),
+              Eq(snapshots[0].graph_permutation_seed()));
+  EXPECT_THAT(snapshots[2].session_id(), Eq(snapshots[0].session_id()));
+
+  // Resume in round 3; the sum of the masked inputs is kept.
+  auto sender_in_round_3 = std::make_unique<MockSendToClientsInterface>();
+  auto server_in_round_3 =
+      ResumeSmallCohortServer(snapshots[2], sender_in_round_3.get());
+  ASSERT_THAT(server_in_round_3, IsOk());
+  EXPECT_THAT((*server_in_round_3)->State(),
+              Eq(SecAggServerStateKind::R3_UNMASKING));
+  EXPECT_THAT((*server_in_round_3)->NumberOfIncludedInputs(),
+              Eq(kSmallCohortSize));
+}
+
+TEST(SecaggServerTest, ResumeFailsOnInvalidSnapshot) {
+  auto sender = std::make_unique<MockSendToClientsInterface>();
+  auto server = CreateSmallCohortServer(sender.get());
+  std::vector<SecAggServerSnapshot> snapshots;
+  server->SetSnapshotCallback(
+      [&snapshots](const SecAggServerSnapshot& snapshot) {
+        snapshots.push_back(snapshot);
+      });
+  RunAdvertiseKeysRound(server.get());
+  ASSERT_THAT(snapshots.size(), Eq(1));
+
+  SecAggServerSnapshot snapshot_in_round_0 = snapshots[0];
+  snapshot_in_round_0.set_state(SecAggServerStateKind::R0_ADVERTISE_KEYS);
+  EXPECT_THAT(ResumeSmallCohortServer(snapshot_in_round_0, sender.get()),
+              IsCode(INVALID_ARGUMENT));
+
+  SecAggServerSnapshot snapshot_with_bad_seed = snapshots[0];
+  snapshot_with_bad_seed.mutable_graph_permutation_seed()->pop_back();
+  EXPECT_THAT(ResumeSmallCohortServer(snapshot_with_bad_seed, sender.get()),
+              IsCode(INVALID_ARGUMENT));
+
+  SecAggServerSnapshot snapshot_with_bad_permutation = snapshots[0];
+  snapshot_with_bad_permutation.clear_graph_permutation_seed();
+  for (int i = 0; i < kSmallCohortSize; ++i) {
+    snapshot_with_bad_permutation.add_graph_permutation(i == 0 ? 1 : i);
+  }
+  EXPECT_THAT(
+      ResumeSmallCohortServer(snapshot_with_bad_permutation, sender.get()),
+      IsCode(INVALID_ARGUMENT));
+
+  SecAggServerSnapshot snapshot_with_missing_key = snapshots[0];
+  snapshot_with_missing_key.mutable_pairwise_public_keys()->RemoveLast();
+  EXPECT_THAT(ResumeSmallCohortServer(snapshot_with_missing_key, sender.get()),
+              IsCode(INVALID_ARGUMENT));
+
+  SecAggServerSnapshot snapshot_without_masked_input = snapshots[0];
+  snapshot_without_masked_input.set_state(SecAggServerStateKind::R3_UNMASKING);
+  EXPECT_THAT(
+      ResumeSmallCohortServer(snapshot_without_masked_input, sender.get()),
+      IsCode(INVALID_ARGUMENT));
+}
+
 }  // namespace
 }  // namespace secagg
 }  // namespace fcp
@@ -17,16 +17,17 @@
 #ifndef FCP_SECAGG_SERVER_SECRET_SHARING_GRAPH_FACTORY_H_
 #define FCP_SECAGG_SERVER_SECRET_SHARING_GRAPH_FACTORY_H_
 
-#include <algorithm>
 #include <cstddef>
 #include <memory>
+#include <optional>
 #include <utility>
+#include <vector>
 
 #include "fcp/base/monitoring.h"
 #include "fcp/secagg/server/secret_sharing_complete_graph.h"
 #include "fcp/secagg/server/secret_sharing_graph.h"
 #include "fcp/secagg/server/secret_sharing_harary_graph.h"
-#include "fcp/secagg/server/ssl_bit_gen.h"
+#include "fcp/secagg/shared/aes_key.h"
 
 namespace fcp {
 namespace secagg {
@@ -49,9 +50,61 @@ class SecretSharingGraphFactory {
         new SecretSharingCompleteGraph(num_nodes, threshold));
   }
 
-  // Creates a SecretSharingHararyGraph.
+  // Creates a SecretSharingHararyGraph. If is_random is true, the node ids are
+  // permuted by a permutation derived from a fresh random seed.
   static std::unique_ptr<SecretSharingHararyGraph> CreateHararyGraph(
       int num_nodes, int degree, int threshold, bool is_random = true) {
+    if (is_random) {
+      return CreateHararyGraphWithPermutationSeed(
+          num_nodes, degree, threshold,
+          SecretSharingHararyGraph::CreateRandomPermutationSeed());
+    }
+    CheckHararyGraphParameters(num_nodes, degree, threshold);
+    auto permutation = std::vector<int>(num_nodes);
+    for (int i = 0; i < num_nodes; ++i) {
+      permutation[i] = i;
+    }
+    return absl::WrapUnique(new SecretSharingHararyGraph(
+        degree, threshold, std::move(permutation), std::nullopt));
+  }
+
+  // Creates a SecretSharingHararyGraph whose node ids are permuted by the
+  // permutation derived from the given seed, e.g. one returned by
+  // SecretSharingHararyGraph::permutation_seed().
+  static std::unique_ptr<SecretSharingHararyGraph>
+  CreateHararyGraphWithPermutationSeed(int num_nodes, int degree,
+                                       int threshold, AesKey seed) {
+    CheckHararyGraphParameters(num_nodes, degree, threshold);
+    FCP_CHECK(seed.size() == AesKey::kSize)
+        << "seed must be " << AesKey::kSize << " bytes, given size was "
+        << seed.size();
+    std::vector<int> permutation =
+        SecretSharingHararyGraph::ExpandPermutationSeed(num_nodes, seed);
+    return absl::WrapUnique(new SecretSharingHararyGraph(
+        degree, threshold, std::move(permutation), std::move(seed)));
+  }
+
+  // Creates a SecretSharingHararyGraph whose node ids are permuted by the
+  // given permutation of 0..num_nodes-1, e.g. one returned by
+  // SecretSharingHararyGraph::permutation().
+  static std::unique_ptr<SecretSharingHararyGraph>
+  CreateHararyGraphWithPermutation(int degree, int threshold,
+                                   std::vector<int> permutation) {
+    const int num_nodes = static_cast<int>(permutation.size());
+    CheckHararyGraphParameters(num_nodes, degree, threshold);
+    std::vector<bool> seen(num_nodes);
+    for (int node : permutation) {
+      FCP_CHECK(node >= 0 && node < num_nodes && !seen[node])
+          << "permutation must be a permutation of 0.." << num_nodes - 1;
+      seen[node] = true;
+    }
+    return absl::WrapUnique(new SecretSharingHararyGraph(
+        degree, threshold, std::move(permutation), std::nullopt));
+  }
+
+ private:
+  static void CheckHararyGraphParameters(int num_nodes, int degree,
+                                         int threshold) {
     FCP_CHECK(num_nodes >= 1)
         << "num_nodes must be >= 1, given value was " << num_nodes;
     FCP_CHECK(degree <= num_nodes)
@@ -64,15 +117,6 @@ class SecretSharingGraphFactory {
     FCP_CHECK(threshold <= degree)
         << "threshold must be <= degree, given values were " << threshold
         << ", " << degree;
-    auto permutation = std::vector<int>(num_nodes);
-    for (int i = 0; i < num_nodes; ++i) {
-      permutation[i] = i;
-    }
-    if (is_random) {
-      std::shuffle(permutation.begin(), permutation.end(), SslBitGen());
-    }
-    return absl::WrapUnique(new SecretSharingHararyGraph(
-        degree, threshold, std::move(permutation)));
   }
 };
 
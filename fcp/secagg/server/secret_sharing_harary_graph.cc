@@ -17,27 +17,67 @@
 #include "fcp/secagg/server/secret_sharing_harary_graph.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <utility>
+#include <vector>
 
 #include "absl/strings/str_cat.h"
 #include "fcp/base/monitoring.h"
 #include "fcp/secagg/server/secret_sharing_graph.h"
+#include "fcp/secagg/shared/aes_ctr_prng_factory.h"
+#include "fcp/secagg/shared/aes_key.h"
+#include "fcp/secagg/shared/prng.h"
+#include "openssl/rand.h"
 
 namespace fcp {
 namespace secagg {
 
-SecretSharingHararyGraph::SecretSharingHararyGraph(int degree, int threshold,
-                                                   std::vector<int> permutation)
+SecretSharingHararyGraph::SecretSharingHararyGraph(
+    int degree, int threshold, std::vector<int> permutation,
+    std::optional<AesKey> permutation_seed)
     : number_of_nodes_(static_cast<int>(permutation.size())),
       degree_(degree),
       threshold_(threshold),
-      permutation_(std::move(permutation)) {
+      permutation_(std::move(permutation)),
+      permutation_seed_(std::move(permutation_seed)) {
   inverse_permutation_ = std::vector<int>(number_of_nodes_);
   for (int i = 0; i < number_of_nodes_; ++i) {
     inverse_permutation_[permutation_[i]] = i;
   }
 }
 
+AesKey SecretSharingHararyGraph::CreateRandomPermutationSeed() {
+  uint8_t seed[AesKey::kSize];
+  // RAND_bytes always returns 1 in BoringSSL
+  FCP_CHECK(RAND_bytes(seed, AesKey::kSize) == 1);
+  return AesKey(seed);
+}
+
+std::vector<int> SecretSharingHararyGraph::ExpandPermutationSeed(
+    int num_nodes, const AesKey& seed) {
+  std::unique_ptr<SecurePrng> prng = AesCtrPrngFactory().MakePrng(seed);
+  std::vector<int> permutation(num_nodes);
+  for (int i = 0; i < num_nodes; ++i) {
+    permutation[i] = i;
+  }
+  // A Fisher-Yates shuffle, in which j is drawn uniformly from 0..i by
+  // rejecting the lowest 2^64 mod (i + 1) values of Rand64() to avoid bias.
+  for (int i = num_nodes - 1; i > 0; --i) {
+    uint64_t bound = static_cast<uint64_t>(i) + 1;
+    uint64_t rejection_threshold =
+        (std::numeric_limits<uint64_t>::max() - bound + 1) % bound;
+    uint64_t random;
+    do {
+      random = prng->Rand64();
+    } while (random < rejection_threshold);
+    std::swap(permutation[i], permutation[random % bound]);
+  }
+  return permutation;
+}
+
 int SecretSharingHararyGraph::GetNeighbor(int curr_node,
                                           int neighbor_index) const {
   FCP_CHECK(IsValidNode(curr_node));
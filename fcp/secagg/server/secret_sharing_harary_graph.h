@@ -17,9 +17,11 @@
 #ifndef FCP_SECAGG_SERVER_SECRET_SHARING_HARARY_GRAPH_H_
 #define FCP_SECAGG_SERVER_SECRET_SHARING_HARARY_GRAPH_H_
 
+#include <optional>
 #include <vector>
 
 #include "fcp/secagg/server/secret_sharing_graph.h"
+#include "fcp/secagg/shared/aes_key.h"
 
 namespace fcp {
 namespace secagg {
@@ -82,6 +84,11 @@ namespace secagg {
 // 8, 9, 5, 6)) leads to a more space efficient implementation with constant
 // time cost for all class functions.
 
+// The random permutation is derived from a short random seed, by a
+// Fisher-Yates shuffle driven by AES-CTR output. This only takes a single call
+// to the secure random number generator, and the seed suffices to reconstruct
+// the graph, e.g. when resuming the protocol from a snapshot.
+
 // This class must be instantiated through SecretSharingGraphFactory.
 class SecretSharingHararyGraph : public SecretSharingGraph {
  public:
@@ -103,6 +110,18 @@ class SecretSharingHararyGraph : public SecretSharingGraph {
 
   bool IsOutgoingNeighbor(int node_1, int node_2) const override;
 
+  // Returns the permutation that was applied to the nodes in the construction.
+  // A graph with the same nodes and edges can be constructed from it with
+  // SecretSharingGraphFactory::CreateHararyGraphWithPermutation.
+  const std::vector<int>& permutation() const { return permutation_; }
+
+  // Returns the seed that the permutation was derived from, if it was. A graph
+  // with the same nodes and edges can be constructed from it with
+  // SecretSharingGraphFactory::CreateHararyGraphWithPermutationSeed.
+  const std::optional<AesKey>& permutation_seed() const {
+    return permutation_seed_;
+  }
+
   // Returns the permutation that was applied to the nodes in the construction.
   // This function is only used for testing purposes.
   std::vector<int> GetPermutationForTesting() const { return permutation_; }
@@ -116,10 +135,22 @@ class SecretSharingHararyGraph : public SecretSharingGraph {
   const std::vector<int> permutation_;
   // Inverse of the above permutation.
   std::vector<int> inverse_permutation_;
+  // The seed the permutation was derived from, if any.
+  const std::optional<AesKey> permutation_seed_;
   SecretSharingHararyGraph(int degree, int threshold,
-                           std::vector<int> permutation);
+                           std::vector<int> permutation,
+                           std::optional<AesKey> permutation_seed);
   friend class SecretSharingGraphFactory;
 
+  // Returns a seed of AesKey::kSize random bytes.
+  static AesKey CreateRandomPermutationSeed();
+
+  // Returns the pseudorandom permutation of 0..num_nodes-1 determined by the
+  // seed. The derivation is fixed, so that the same seed results in the same
+  // permutation on every platform.
+  static std::vector<int> ExpandPermutationSeed(int num_nodes,
+                                                const AesKey& seed);
+
   bool IsValidNode(int node) const {
     return 0 <= node && node < number_of_nodes_;
   }
@@ -15,12 +15,15 @@
  */
 
 #include <algorithm>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "absl/status/status.h"
 #include "fcp/secagg/server/secret_sharing_graph.h"
 #include "fcp/secagg/server/secret_sharing_graph_factory.h"
+#include "fcp/secagg/shared/aes_key.h"
 #include "fcp/testing/testing.h"
 
 namespace fcp {
@@ -85,6 +88,53 @@ TEST(SecretSharingHararyGraphTest,
   EXPECT_EQ(found, true);
 }
 
+TEST(SecretSharingHararyGraphTest, RandomHararyGraphCanBeRecreatedFromSeed) {
+  SecretSharingGraphFactory factory;
+  auto graph = factory.CreateHararyGraph(kNumNodes, kDegree, kThreshold);
+  ASSERT_TRUE(graph->permutation_seed().has_value());
+  auto recreated_graph = factory.CreateHararyGraphWithPermutationSeed(
+      kNumNodes, kDegree, kThreshold, *graph->permutation_seed());
+  EXPECT_EQ(recreated_graph->GetPermutationForTesting(),
+            graph->GetPermutationForTesting());
+  EXPECT_EQ(recreated_graph->permutation_seed()->AsString(),
+            graph->permutation_seed()->AsString());
+}
+
+TEST(SecretSharingHararyGraphTest,
+     DeterministicHararyGraphHasNoPermutationSeed) {
+  SecretSharingGraphFactory factory;
+  auto graph = factory.CreateHararyGraph(kNumNodes, kDegree, kThreshold, false);
+  EXPECT_FALSE(graph->permutation_seed().has_value());
+}
+
+TEST(SecretSharingHararyGraphTest, PermutationSeedExpandsToPermutation) {
+  SecretSharingGraphFactory factory;
+  int larger_num_nodes = 1000;
+  std::string seed(AesKey::kSize, 'a');
+  auto graph = factory.CreateHararyGraphWithPermutationSeed(
+      larger_num_nodes, kDegree, kThreshold,
+      AesKey(reinterpret_cast<const uint8_t*>(seed.data())));
+  std::vector<int> permutation = graph->GetPermutationForTesting();
+  ASSERT_EQ(permutation.size(), larger_num_nodes);
+  std::vector<int> counters(larger_num_nodes, 0);
+  int num_fixed_points = 0;
+  for (int i = 0; i < permutation.size(); ++i) {
+    counters[permutation[i]]++;
+    num_fixed_points += permutation[i] == i;
+  }
+  for (auto x : counters) {
+    EXPECT_EQ(x, 1);
+  }
+  // A random permutation has one fixed point in expectation.
+  EXPECT_LT(num_fixed_points, 10);
+
+  std::string other_seed(AesKey::kSize, 'b');
+  auto other_graph = factory.CreateHararyGraphWithPermutationSeed(
+      larger_num_nodes, kDegree, kThreshold,
+      AesKey(reinterpret_cast<const uint8_t*>(other_seed.data())));
+  EXPECT_NE(other_graph->GetPermutationForTesting(), permutation);
+}
+
 TEST(SecretSharingHararyGraphTest, AreNeighborsIsCorrectInRandomHararyGraph) {
   SecretSharingGraphFactory factory;
   auto graph = factory.CreateHararyGraph(kNumNodes, kDegree, kThreshold);
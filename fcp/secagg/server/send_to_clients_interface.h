@@ -17,6 +17,11 @@
 #ifndef FCP_SECAGG_SERVER_SEND_TO_CLIENTS_INTERFACE_H_
 #define FCP_SECAGG_SERVER_SEND_TO_CLIENTS_INTERFACE_H_
 
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/types/span.h"
+#include "fcp/base/monitoring.h"
 #include "fcp/secagg/shared/secagg_messages.pb.h"
 
 namespace fcp {
@@ -31,6 +36,19 @@ class SendToClientsInterface {
   virtual void Send(uint32_t recipient_id,
                     const ServerToClientWrapperMessage& message) = 0;
 
+  // Sends messages[i] to recipient_ids[i], for each i. Used when the server
+  // sends a different message to each of many clients, so that transports can
+  // override it to pipeline the sends. By default, calls Send for each message
+  // in turn.
+  virtual void SendBatch(
+      absl::Span<const uint32_t> recipient_ids,
+      absl::Span<const ServerToClientWrapperMessage> messages) {
+    FCP_CHECK(recipient_ids.size() == messages.size());
+    for (size_t i = 0; i < messages.size(); ++i) {
+      Send(recipient_ids[i], messages[i]);
+    }
+  }
+
   virtual ~SendToClientsInterface() = default;
 };
 
@@ -54,7 +54,7 @@ def append_slices(filename, tensor_names, shapes_and_slices, data, name=None):
       filename, tensor_names, shapes_and_slices, data, name=name)
 
 
-def merge_appended_slices(filename, name=None):
+def merge_appended_slices(filename, run_in_background=False, name=None):
   """Merges the appended file created by `append_slices` to a single checkpoint.
 
   The immediate file output of `append_slices` is not in checkpoint format. It
@@ -64,11 +64,18 @@ def merge_appended_slices(filename, name=None):
   that the `append_slices` calls have executed prior to the execution of
   `merge_appended_slices`.
 
+  Appends to and merges of the same `filename` are serialized against each
+  other, while those of different files may run concurrently.
+
   Args:
     filename: The name of a file appended to by calls to `append_slices`.
+    run_in_background: Whether to merge on a separate thread rather than on one
+      of the threads executing the graph. Either way the op only completes once
+      the merge has finished.
     name: A name for the operation (optional).
 
   Returns:
     The created `Operation`.
   """
-  return gen_append_slices_py.merge_appended_slices(filename, name)
+  return gen_append_slices_py.merge_appended_slices(
+      filename, run_in_background=run_in_background, name=name)
@@ -21,13 +21,15 @@
 #include <memory>
 #include <numeric>
 #include <queue>
-#include <set>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/base/const_init.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
@@ -344,24 +346,21 @@ class PartialRandomAccessFile : public tensorflow::RandomAccessFile {
   int64_t end_;
 };
 
-struct TableIteratorComparator {
-  // Returns whether `i1` should come after `i2` in the priority queue.
-  // That is, whether `i1` has *lower* priority than `i2`.
-  bool operator()(const std::unique_ptr<tensorflow::table::Iterator>& i1,
-                  const std::unique_ptr<tensorflow::table::Iterator>& i2) {
-    // Ensure that iterators which have no remaining elements go last in the
-    // list.
-    if (!i2->Valid()) {
-      return false;
-    }
-    if (!i1->Valid()) {
-      return true;
-    }
-    if ((i2->key() == kSavedTensorSlicesKey) &&
-        (i1->key() != kSavedTensorSlicesKey)) {
-      return true;
-    }
-    return i1->key() > i2->key();
+// A chunk of an appended file, opened as a table. The file and table are kept
+// alongside the iterator since they are referenced internally by it.
+struct Chunk {
+  std::unique_ptr<tensorflow::RandomAccessFile> file;
+  std::unique_ptr<tensorflow::table::Table> table;
+  std::unique_ptr<tensorflow::table::Iterator> iterator;
+};
+
+struct ChunkComparator {
+  // Returns whether `c1` should come after `c2` in the priority queue.
+  // That is, whether `c1` has *lower* priority than `c2`. Only chunks with a
+  // valid iterator are kept in the queue.
+  bool operator()(const std::unique_ptr<Chunk>& c1,
+                  const std::unique_ptr<Chunk>& c2) {
+    return c1->iterator->key() > c2->iterator->key();
   }
 };
 
@@ -411,20 +410,16 @@ absl::Status LoadAndMergeAppendedSlices(const std::string& filename) {
   // into the old file contents even after it is overwritten.
   TF_RETURN_IF_ERROR(tensorflow::Env::Default()->DeleteFile(filename));
 
-  // `chunk_files` and `chunk_tables` must be kept around since they are
-  // referenced internally by `chunk_iterators`.
-  std::vector<std::unique_ptr<tensorflow::RandomAccessFile>> chunk_files;
-  std::vector<std::unique_ptr<tensorflow::table::Table>> chunk_tables;
-  std::priority_queue<std::unique_ptr<tensorflow::table::Iterator>,
-                      std::vector<std::unique_ptr<tensorflow::table::Iterator>>,
-                      TableIteratorComparator>
-      chunk_iterators;
+  std::priority_queue<std::unique_ptr<Chunk>,
+                      std::vector<std::unique_ptr<Chunk>>, ChunkComparator>
+      chunks;
 
   tensorflow::SavedTensorSlices merged_sts;
   tensorflow::SavedTensorSliceMeta* merged_meta = merged_sts.mutable_meta();
-  std::set<std::string> slices_added;
+  absl::flat_hash_set<std::string> slices_added;
 
-  // Read all of the chunks into tables.
+  // Open all of the chunks as tables, reading only their metadata entries.
+  int num_chunks = 0;
   int64_t chunk_footer_end = file_size;
   bool version_was_set = false;
   while (chunk_footer_end > 0) {
@@ -437,22 +432,23 @@ absl::Status LoadAndMergeAppendedSlices(const std::string& filename) {
     int64_t chunk_start = Int64FromHostEndianBytes(chunk_footer.data());
     int64_t chunk_end = chunk_footer_end - sizeof(int64_t);
     int64_t chunk_len = chunk_end - chunk_start;
-    std::unique_ptr<tensorflow::RandomAccessFile> chunk_file =
-        std::make_unique<PartialRandomAccessFile>(file.get(), chunk_start,
-                                                  chunk_end);
+    auto chunk = std::make_unique<Chunk>();
+    chunk->file = std::make_unique<PartialRandomAccessFile>(
+        file.get(), chunk_start, chunk_end);
     tensorflow::table::Options options;
     tensorflow::table::Table* raw_table;
     TF_RETURN_WITH_CONTEXT_IF_ERROR(
-        tensorflow::table::Table::Open(options, chunk_file.get(), chunk_len,
+        tensorflow::table::Table::Open(options, chunk->file.get(), chunk_len,
                                        &raw_table),
         absl::StrCat("Error opening sub-table of file ", filename,
                      " starting at ", chunk_start, " and ending at ", chunk_end,
                      ". Total file size: ", file_size));
-    std::unique_ptr<tensorflow::table::Table> table(raw_table);
-    tensorflow::table::Iterator* raw_iterator = table->NewIterator();
-    std::unique_ptr<tensorflow::table::Iterator> iterator(raw_iterator);
+    chunk->table.reset(raw_table);
+    chunk->iterator.reset(chunk->table->NewIterator());
+    tensorflow::table::Iterator* iterator = chunk->iterator.get();
     iterator->SeekToFirst();
     if (!iterator->Valid()) {
+      TF_RETURN_IF_ERROR(iterator->status());
       return absl::Status(absl::StatusCode::kInternal,
                           "Unexpected immediately-invalid iterator. "
                           "Expected table to iterator to have at least a "
@@ -473,23 +469,27 @@ absl::Status LoadAndMergeAppendedSlices(const std::string& filename) {
       version_was_set = true;
       *merged_meta->mutable_versions() = sts.meta().versions();
     }
-    for (const tensorflow::SavedSliceMeta& slice_meta : sts.meta().tensor()) {
-      if (slices_added.find(slice_meta.name()) != slices_added.end()) {
+    for (tensorflow::SavedSliceMeta& slice_meta :
+         *sts.mutable_meta()->mutable_tensor()) {
+      if (!slices_added.insert(slice_meta.name()).second) {
         return absl::Status(
             absl::StatusCode::kInvalidArgument,
             absl::StrCat(
                 "Attempted to merge two checkpoint entries for slice name: `",
                 slice_meta.name(), "`. Only one entry per name is permitted."));
       }
-      slices_added.insert(slice_meta.name());
+      *merged_meta->add_tensor() = std::move(slice_meta);
+    }
+    ++num_chunks;
+    // Chunks holding only metadata don't take part in the merge below.
+    if (iterator->Valid()) {
+      chunks.push(std::move(chunk));
+    } else {
+      TF_RETURN_IF_ERROR(iterator->status());
     }
-    merged_meta->mutable_tensor()->MergeFrom(sts.meta().tensor());
-    chunk_iterators.push(std::move(iterator));
-    chunk_files.push_back(std::move(chunk_file));
-    chunk_tables.push_back(std::move(table));
     chunk_footer_end = chunk_start;
   }
-  VLOG(1) << "Merging " << chunk_files.size() << " checkpoint chunks from file "
+  VLOG(1) << "Merging " << num_chunks << " checkpoint chunks from file "
           << filename;
 
   tensorflow::checkpoint::TensorSliceWriter::Builder* raw_builder;
@@ -501,14 +501,20 @@ absl::Status LoadAndMergeAppendedSlices(const std::string& filename) {
   // First, we add the merged entry which holds a `SavedTensorSlices` proto.
   builder->Add(kSavedTensorSlicesKey, merged_sts.SerializeAsString());
 
-  // Then the remaining entries are concatenated alphabetically.
-  while (chunk_iterators.top()->Valid()) {
-    std::unique_ptr<tensorflow::table::Iterator> iter =
-        PopWithElement(chunk_iterators);
-    VLOG(2) << "Merging table entry for key " << iter->key();
-    builder->Add(iter->key(), iter->value());
-    iter->Next();
-    chunk_iterators.push(std::move(iter));
+  // Then the remaining entries are streamed to the builder alphabetically.
+  // Each chunk only holds its current block in memory, and is released as
+  // soon as all of its entries have been written.
+  while (!chunks.empty()) {
+    std::unique_ptr<Chunk> chunk = PopWithElement(chunks);
+    tensorflow::table::Iterator* iterator = chunk->iterator.get();
+    VLOG(2) << "Merging table entry for key " << iterator->key();
+    builder->Add(iterator->key(), iterator->value());
+    iterator->Next();
+    if (iterator->Valid()) {
+      chunks.push(std::move(chunk));
+    } else {
+      TF_RETURN_IF_ERROR(iterator->status());
+    }
   }
   int64_t resulting_file_size;
   TF_RETURN_WITH_CONTEXT_IF_ERROR(builder->Finish(&resulting_file_size),
@@ -516,7 +522,59 @@ absl::Status LoadAndMergeAppendedSlices(const std::string& filename) {
   return absl::OkStatus();
 }
 
-ABSL_CONST_INIT absl::Mutex append_mutex(absl::kConstInit);
+// Serializes the appends to and merges of a single file, while allowing
+// operations on different files to proceed concurrently.
+//
+// Files are identified by the filename passed to the op, so differently
+// spelled paths to the same file are not serialized against each other.
+class FileLock {
+ public:
+  explicit FileLock(const std::string& filename) : filename_(filename) {
+    {
+      absl::MutexLock registry_lock(&registry_mutex_);
+      std::unique_ptr<Entry>& entry = (*registry_)[filename_];
+      if (entry == nullptr) {
+        entry = std::make_unique<Entry>();
+      }
+      ++entry->users;
+      entry_ = entry.get();
+    }
+    entry_->mutex.Lock();
+  }
+
+  ~FileLock() {
+    entry_->mutex.Unlock();
+    absl::MutexLock registry_lock(&registry_mutex_);
+    if (--entry_->users == 0) {
+      registry_->erase(filename_);
+    }
+  }
+
+  FileLock(const FileLock&) = delete;
+  FileLock& operator=(const FileLock&) = delete;
+
+ private:
+  struct Entry {
+    absl::Mutex mutex;
+    // The number of `FileLock`s holding or waiting for `mutex`. Guarded by
+    // `registry_mutex_`.
+    int users = 0;
+  };
+
+  static absl::Mutex registry_mutex_;
+  // Entries are removed once unused, so that the registry doesn't grow with
+  // the number of distinct files ever written.
+  static absl::flat_hash_map<std::string, std::unique_ptr<Entry>>* registry_
+      ABSL_GUARDED_BY(registry_mutex_);
+
+  const std::string filename_;
+  Entry* entry_;
+};
+
+ABSL_CONST_INIT absl::Mutex FileLock::registry_mutex_(absl::kConstInit);
+absl::flat_hash_map<std::string, std::unique_ptr<FileLock::Entry>>*
+    FileLock::registry_ =
+        new absl::flat_hash_map<std::string, std::unique_ptr<Entry>>();
 
 }  // namespace
 
@@ -525,9 +583,9 @@ class AppendSlicesOp : public OpKernel {
   explicit AppendSlicesOp(OpKernelConstruction* context) : OpKernel(context) {}
 
   void Compute(OpKernelContext* context) override {
-    absl::MutexLock lock(&append_mutex);
     const tensorflow::Tensor& filename_t = context->input(0);
     tensorflow::tstring filename = filename_t.flat<tensorflow::tstring>()(0);
+    FileLock lock(filename);
     SaveTensors(
         context,
         [context](
@@ -557,19 +615,41 @@ class AppendSlicesOp : public OpKernel {
   }
 };
 
-class MergeAppendedSlicesOp : public OpKernel {
+// Merging rewrites the whole file, so with `run_in_background` it is done on a
+// separate thread rather than occupying one of the executor's threads. Either
+// way the op only completes once the merge has finished.
+class MergeAppendedSlicesOp : public tensorflow::AsyncOpKernel {
  public:
   explicit MergeAppendedSlicesOp(OpKernelConstruction* context)
-      : OpKernel(context) {}
+      : AsyncOpKernel(context) {
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("run_in_background", &run_in_background_));
+  }
 
-  void Compute(OpKernelContext* context) override {
-    absl::MutexLock lock(&append_mutex);
+  void ComputeAsync(OpKernelContext* context, DoneCallback done) override {
     const tensorflow::Tensor* filename_tensor;
-    OP_REQUIRES_OK(context, context->input("filename", &filename_tensor));
-    const tensorflow::tstring filename =
-        filename_tensor->scalar<tensorflow::tstring>()();
-    OP_REQUIRES_OK(context, LoadAndMergeAppendedSlices(filename));
+    OP_REQUIRES_OK_ASYNC(context, context->input("filename", &filename_tensor),
+                         done);
+    std::string filename(filename_tensor->scalar<tensorflow::tstring>()());
+    auto merge = [context, filename = std::move(filename),
+                  done = std::move(done)]() {
+      absl::Status status;
+      {
+        FileLock lock(filename);
+        status = LoadAndMergeAppendedSlices(filename);
+      }
+      OP_REQUIRES_OK_ASYNC(context, status, done);
+      done();
+    };
+    if (run_in_background_) {
+      context->env()->SchedClosure(std::move(merge));
+    } else {
+      merge();
+    }
   }
+
+ private:
+  bool run_in_background_;
 };
 
 // Note: `key` *must* come last so that the indices of the other arguments are
@@ -585,7 +665,10 @@ REGISTER_OP("AppendSlices")
 REGISTER_KERNEL_BUILDER(Name("AppendSlices").Device(tensorflow::DEVICE_CPU),
                         AppendSlicesOp);
 
-REGISTER_OP("MergeAppendedSlices").Input("filename: string").SetIsStateful();
+REGISTER_OP("MergeAppendedSlices")
+    .Input("filename: string")
+    .Attr("run_in_background: bool = false")
+    .SetIsStateful();
 
 REGISTER_KERNEL_BUILDER(
     Name("MergeAppendedSlices").Device(tensorflow::DEVICE_CPU),
@@ -178,6 +178,45 @@ class AppendSlicesTest(tf.test.TestCase):
       self.assertEqual(restored[0], 7)
       self.assertEqual(restored[1], 11)
 
+  def test_merges_in_background(self):
+    checkpoint_path = self.new_tempfile_path()
+    tensor_names = ['b', 'a']
+    tensor_values = [tf.constant(x, dtype=tf.int32) for x in (7, 11)]
+    for (tensor_name, tensor_value) in zip(tensor_names, tensor_values):
+      append_slices.append_slices(
+          filename=checkpoint_path,
+          tensor_names=[tensor_name],
+          data=[tensor_value],
+          shapes_and_slices=[''])
+    append_slices.merge_appended_slices(
+        checkpoint_path, run_in_background=True)
+    restored = tf.raw_ops.RestoreV2(
+        prefix=checkpoint_path,
+        tensor_names=tensor_names,
+        shape_and_slices=[''] * 2,
+        dtypes=[tf.int32] * 2)
+    self.assertEqual(restored[0], 7)
+    self.assertEqual(restored[1], 11)
+
+  def test_interleaved_appends_to_different_files(self):
+    checkpoint_paths = [self.new_tempfile_path() + str(i) for i in range(2)]
+    for i, tensor_name in enumerate(['a', 'b']):
+      for j, checkpoint_path in enumerate(checkpoint_paths):
+        append_slices.append_slices(
+            filename=checkpoint_path,
+            tensor_names=[tensor_name],
+            data=[tf.constant(10 * i + j, dtype=tf.int32)],
+            shapes_and_slices=[''])
+    for j, checkpoint_path in enumerate(checkpoint_paths):
+      append_slices.merge_appended_slices(checkpoint_path)
+      restored = tf.raw_ops.RestoreV2(
+          prefix=checkpoint_path,
+          tensor_names=['a', 'b'],
+          shape_and_slices=[''] * 2,
+          dtypes=[tf.int32] * 2)
+      self.assertEqual(restored[0], j)
+      self.assertEqual(restored[1], 10 + j)
+
 
 if __name__ == '__main__':
   tf.test.main()
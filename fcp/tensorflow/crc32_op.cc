@@ -53,8 +53,11 @@ class CRC32Op : public OpKernel {
     Tensor* output_tensor = nullptr;
     OP_REQUIRES_OK(context, context->allocate_output(0, {}, &output_tensor));
 
-    // Store CRC32 of input tensor in output.
-    output_tensor->scalar<uint32_t>()() = TensorToCRC32(context->input(0));
+    // Store CRC32 of input tensor in output. Large tensors are checksummed in
+    // parallel on the intra-op thread pool.
+    output_tensor->scalar<uint32_t>()() =
+        TensorToCRC32(context->input(0),
+                      *context->device()->tensorflow_cpu_worker_threads());
   }
 };
 
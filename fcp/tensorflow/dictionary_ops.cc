@@ -13,6 +13,7 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
 #include <cstdint>
 #include <functional>
 #include <memory>
@@ -22,6 +23,8 @@
 
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 #include "fcp/base/monitoring.h"
 #include "fcp/dictionary/dictionary.h"
 #include "fcp/dictionary/dictionary.pb.h"
@@ -31,6 +34,7 @@
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/public/version.h"
+#include "tensorflow/core/util/work_sharder.h"
 #include "tensorflow/tsl/platform/tstring.h"
 
 namespace tf = tensorflow;
@@ -43,6 +47,24 @@ using fcp::dictionary::DictionaryDescription;
 
 namespace {
 
+// The number of elements converted at a time by each shard of the lookup ops,
+// sized so that the intermediate spans fit on the stack.
+constexpr int64_t kLookupChunkSize = 256;
+// Rough costs (in cycles) per element of the lookup ops, used to decide how
+// finely to shard them.
+constexpr int64_t kLookupCostPerToken = 250;
+constexpr int64_t kReverseLookupCostPerId = 100;
+
+// Runs `work` on ranges of [0, total) on the intra-op thread pool.
+void ShardLookup(tf::OpKernelContext* context, int64_t total,
+                 int64_t cost_per_unit,
+                 std::function<void(int64_t, int64_t)> work) {
+  const tf::DeviceBase::CpuWorkerThreads* worker_threads =
+      context->device()->tensorflow_cpu_worker_threads();
+  tf::Shard(worker_threads->num_threads, worker_threads->workers, total,
+            cost_per_unit, std::move(work));
+}
+
 // Base class for ops that work with a Dictionary.
 //
 // Subclasses need to provide Compute and register appropriately using
@@ -170,18 +192,35 @@ class DictionaryLookup : public AbstractDictionaryOp {
     }
     const auto tokens_flat = token_tensor.flat<tf::tstring>();
     auto ids_flat = ids_tensor->flat<int64_t>();
-    const int64_t num_tokens = tokens_flat.size();
-    for (int i = 0; i < num_tokens; ++i) {
-      const absl::string_view token = tokens_flat(i);
-      if (token.data() == nullptr && !token.empty()) {
-        return absl::InternalError(
-            absl::StrCat("Encountered token with nullptr data(), type: ",
-                         tokens_flat(i).type(), ", size: ", token.size(),
-                         ", capacity: ", tokens_flat(i).capacity()));
-      }
-      ids_flat(i) = dictionary.TokenToId(token);
-    }
-    return absl::OkStatus();
+    absl::Mutex mu;
+    absl::Status shard_status;
+    ShardLookup(
+        context, tokens_flat.size(), kLookupCostPerToken,
+        [&](int64_t begin, int64_t end) {
+          absl::string_view tokens[kLookupChunkSize];
+          int32_t ids[kLookupChunkSize];
+          for (int64_t start = begin; start < end; start += kLookupChunkSize) {
+            const int64_t size = std::min(kLookupChunkSize, end - start);
+            for (int64_t i = 0; i < size; ++i) {
+              const absl::string_view token = tokens_flat(start + i);
+              if (token.data() == nullptr && !token.empty()) {
+                absl::MutexLock lock(&mu);
+                shard_status = absl::InternalError(absl::StrCat(
+                    "Encountered token with nullptr data(), type: ",
+                    tokens_flat(start + i).type(), ", size: ", token.size(),
+                    ", capacity: ", tokens_flat(start + i).capacity()));
+                return;
+              }
+              tokens[i] = token;
+            }
+            dictionary.TokensToIds(absl::MakeConstSpan(tokens, size),
+                                   absl::MakeSpan(ids, size));
+            for (int64_t i = 0; i < size; ++i) {
+              ids_flat(start + i) = ids[i];
+            }
+          }
+        });
+    return shard_status;
   }
 };
 
@@ -234,10 +273,27 @@ class DictionaryReverseLookup : public AbstractDictionaryOp {
 
     const auto ids_flat = ids_tensor.flat<int64_t>();
     auto tokens_flat = token_tensor->flat<tf::tstring>();
-    const int64_t num_tokens = ids_flat.size();
-    for (int i = 0; i < num_tokens; ++i) {
-      tokens_flat(i) = dictionary.IdToToken(ids_flat(i));
-    }
+    ShardLookup(
+        context, ids_flat.size(), kReverseLookupCostPerId,
+        [&](int64_t begin, int64_t end) {
+          int32_t ids[kLookupChunkSize];
+          absl::string_view tokens[kLookupChunkSize];
+          for (int64_t start = begin; start < end; start += kLookupChunkSize) {
+            const int64_t size = std::min(kLookupChunkSize, end - start);
+            for (int64_t i = 0; i < size; ++i) {
+              const int64_t id = ids_flat(start + i);
+              // Ids outside the int32_t range are never valid.
+              ids[i] = id == static_cast<int32_t>(id) ? static_cast<int32_t>(id)
+                                                      : Dictionary::kNotFound;
+            }
+            dictionary.IdsToTokens(absl::MakeConstSpan(ids, size),
+                                   absl::MakeSpan(tokens, size));
+            for (int64_t i = 0; i < size; ++i) {
+              tokens_flat(start + i).assign(tokens[i].data(),
+                                            tokens[i].size());
+            }
+          }
+        });
     return absl::OkStatus();
   }
 };
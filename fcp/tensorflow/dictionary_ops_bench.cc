@@ -0,0 +1,139 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks the DictionaryLookup and DictionaryReverseLookup ops end to end,
+// through a TensorFlow session, at vocabulary scale.
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "fcp/dictionary/dictionary.pb.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/tstring.h"
+#include "tensorflow/core/public/session.h"
+#include "tensorflow/core/public/session_options.h"
+
+// Open-source version of benchmarking library
+#include "benchmark//benchmark.h"
+
+namespace fcp {
+namespace tensorflow {
+namespace {
+
+using ::fcp::dictionary::DictionaryDescription;
+
+// The number of tokens or ids converted per op invocation.
+constexpr int kNumLookups = 1 << 16;
+
+// Returns the name of the token at `index` in the benchmark vocabulary.
+std::string TokenName(int64_t index) { return absl::StrCat("token_", index); }
+
+// Returns a serialized DictionaryDescription with `num_tokens` tokens and an
+// unknown token id, so that missing tokens map to a valid id.
+std::string MakeDictionaryDescription(int64_t num_tokens) {
+  DictionaryDescription description;
+  description.mutable_special_ids()->set_unk(0);
+  auto* tokens = description.mutable_vocabulary()->mutable_index();
+  for (int64_t i = 0; i < num_tokens; ++i) {
+    tokens->add_token(TokenName(i));
+  }
+  return description.SerializeAsString();
+}
+
+// Returns a session running `op` on the placeholder "input" as "output".
+std::unique_ptr<::tensorflow::Session> MakeSession(
+    const std::string& op, ::tensorflow::DataType input_type,
+    int64_t num_tokens) {
+  ::tensorflow::GraphDef graph;
+  ::tensorflow::NodeDef* input = graph.add_node();
+  input->set_name("input");
+  input->set_op("Placeholder");
+  (*input->mutable_attr())["dtype"].set_type(input_type);
+  ::tensorflow::NodeDef* output = graph.add_node();
+  output->set_name("output");
+  output->set_op(op);
+  output->add_input("input");
+  (*output->mutable_attr())["dictionary_description_proto"].set_s(
+      MakeDictionaryDescription(num_tokens));
+
+  ::tensorflow::Session* session = nullptr;
+  TF_CHECK_OK(
+      ::tensorflow::NewSession(::tensorflow::SessionOptions(), &session));
+  TF_CHECK_OK(session->Create(graph));
+  return std::unique_ptr<::tensorflow::Session>(session);
+}
+
+// Runs `session` once per iteration on `input`.
+void RunSession(benchmark::State& state, ::tensorflow::Session* session,
+                const ::tensorflow::Tensor& input) {
+  std::vector<::tensorflow::Tensor> outputs;
+  for (auto s : state) {
+    TF_CHECK_OK(session->Run({{"input", input}}, {"output"}, {}, &outputs));
+    benchmark::DoNotOptimize(outputs[0].data());
+  }
+  state.SetItemsProcessed(state.iterations() * kNumLookups);
+}
+
+static void BM_DictionaryLookup(benchmark::State& state) {
+  const int64_t num_tokens = state.range(0);
+  std::unique_ptr<::tensorflow::Session> session =
+      MakeSession("DictionaryLookup", ::tensorflow::DT_STRING, num_tokens);
+  // Spread the lookups over the vocabulary, and make one in eight of them miss.
+  ::tensorflow::Tensor tokens(::tensorflow::DT_STRING,
+                              ::tensorflow::TensorShape({kNumLookups}));
+  auto flat = tokens.flat<::tensorflow::tstring>();
+  for (int64_t i = 0; i < kNumLookups; ++i) {
+    const int64_t index = (i * 104729) % num_tokens;
+    flat(i) = i % 8 == 0 ? absl::StrCat("unknown_", index) : TokenName(index);
+  }
+  RunSession(state, session.get(), tokens);
+}
+
+static void BM_DictionaryReverseLookup(benchmark::State& state) {
+  const int64_t num_tokens = state.range(0);
+  std::unique_ptr<::tensorflow::Session> session = MakeSession(
+      "DictionaryReverseLookup", ::tensorflow::DT_INT64, num_tokens);
+  ::tensorflow::Tensor ids(::tensorflow::DT_INT64,
+                           ::tensorflow::TensorShape({kNumLookups}));
+  auto flat = ids.flat<int64_t>();
+  for (int64_t i = 0; i < kNumLookups; ++i) {
+    flat(i) = (i * 104729) % num_tokens;
+  }
+  RunSession(state, session.get(), ids);
+}
+
+// Vocabularies from 1K to 1M tokens.
+BENCHMARK(BM_DictionaryLookup)
+    ->RangeMultiplier(32)
+    ->Range(1 << 10, 1 << 20)
+    ->UseRealTime();
+BENCHMARK(BM_DictionaryReverseLookup)
+    ->RangeMultiplier(32)
+    ->Range(1 << 10, 1 << 20)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace tensorflow
+}  // namespace fcp
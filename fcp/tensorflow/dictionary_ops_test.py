@@ -105,6 +105,27 @@ class DictionaryOpsTest(tf.test.TestCase, parameterized.TestCase):
     ]
     self.assertListEqual(['10', '02', '01', '11', ''], rlookup)
 
+  def test_lookup_and_reverse_lookup_large_input(self):
+    tokens = [str(i) for i in range(1000)]
+    dictionary = dictionary_ops.Dictionary.from_tokens(tokens, unk_id=0)
+    # Large enough to be split across several shards.
+    values = [i % 1100 for i in range(100000)]
+    inputs = [str(v) for v in values]
+    expected_ids = [v + 1 if v < 1000 else 0 for v in values]
+    expected_tokens = [str(v) if v < 1000 else '' for v in values]
+
+    ids = dictionary_ops.dictionary_lookup(
+        inputs,
+        dictionary_description_proto=dictionary.dictionary_description_proto)
+    reversed_tokens = dictionary_ops.dictionary_reverse_lookup(
+        ids,
+        dictionary_description_proto=dictionary.dictionary_description_proto)
+    with tf.compat.v1.Session() as sess:
+      ids_result, reversed_result = sess.run([ids, reversed_tokens])
+    self.assertEqual(expected_ids, ids_result.tolist())
+    self.assertEqual(expected_tokens,
+                     [t.decode('utf-8') for t in reversed_result.tolist()])
+
   def test_literal_dictionary_in_python(self):
     dictionary_description = dictionary_pb2.DictionaryDescription()
     text_format.Merge(
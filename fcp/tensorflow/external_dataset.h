@@ -17,8 +17,11 @@
 #ifndef FCP_TENSORFLOW_EXTERNAL_DATASET_H_
 #define FCP_TENSORFLOW_EXTERNAL_DATASET_H_
 
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
@@ -44,6 +47,54 @@ class ExternalDatasetIterator {
    * Implementations must be thread-safe.
    */
   virtual absl::StatusOr<std::string> GetNext() = 0;
+
+  /**
+   * Appends up to 'max_elements' elements to 'elements'. Returns OK if
+   * 'max_elements' elements were appended; otherwise returns the status that
+   * ended the batch (OUT_OF_RANGE at end-of-stream). Elements appended before
+   * a non-OK status are still valid, and precede it in the stream.
+   *
+   * Unlike elements returned by GetNext(), these elements aren't considered
+   * consumed yet, since the caller may be reading ahead. It must report them
+   * with OnElementsConsumed() as it hands them on.
+   *
+   * The default implementation calls GetNext() repeatedly. Implementations
+   * that can amortize locking or I/O across elements should override it.
+   *
+   * Implementations must be thread-safe.
+   */
+  virtual absl::Status GetNextBatch(int max_elements,
+                                    std::vector<std::string>& elements) {
+    for (int i = 0; i < max_elements; ++i) {
+      absl::StatusOr<std::string> element = GetNext();
+      if (!element.ok()) {
+        return element.status();
+      }
+      elements.push_back(*std::move(element));
+    }
+    return absl::OkStatus();
+  }
+
+  /**
+   * Reports that the next 'num_elements' elements returned by GetNextBatch(),
+   * which are 'size_bytes' long in total, were handed to the consumer of the
+   * dataset. Iterators which keep statistics about the elements they return
+   * should count elements returned by GetNextBatch() here, so that elements
+   * which were read ahead but never used aren't counted. Those iterators must
+   * therefore override GetNextBatch() too.
+   *
+   * The default implementation does nothing. Implementations must be
+   * thread-safe.
+   */
+  virtual void OnElementsConsumed(int num_elements, int64_t size_bytes) {}
+
+  /**
+   * Requests that pending and future calls return promptly (with CANCELLED),
+   * e.g. because the TensorFlow step consuming this iterator was cancelled.
+   * Called by the ExternalDataset op from its cancellation callback, possibly
+   * concurrently with GetNext(). The default implementation does nothing.
+   */
+  virtual void Cancel() {}
 };
 
 namespace external_dataset_internal {
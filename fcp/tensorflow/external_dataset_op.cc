@@ -14,12 +14,14 @@
  * limitations under the License.
  */
 
+#include <functional>
 #include <memory>
 #include <optional>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_format.h"
@@ -27,6 +29,7 @@
 #include "absl/types/span.h"
 #include "fcp/base/random_token.h"
 #include "fcp/tensorflow/external_dataset.h"
+#include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/framework/common_shape_fns.h"
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/op.h"
@@ -162,34 +165,57 @@ class ExternalDatasetOp : public tensorflow::data::DatasetOpKernel {
                         std::unique_ptr<ExternalDatasetIterator> stub)
           : DatasetIterator<Dataset>(params), stub_(std::move(stub)) {}
 
+      ~Iterator() override {
+        if (deregister_cancellation_) {
+          deregister_cancellation_();
+        }
+      }
+
+      absl::Status Initialize(tensorflow::data::IteratorContext* ctx) override {
+        // Forward cancellation of the step (e.g. when the session is closed to
+        // interrupt it) to the stub, so that a GetNextInternal() call blocked
+        // on it can return.
+        return tensorflow::RegisterCancellationCallback(
+            ctx->cancellation_manager(), [this]() { stub_->Cancel(); },
+            &deregister_cancellation_);
+      }
+
       absl::Status GetNextInternal(tensorflow::data::IteratorContext* ctx,
                                    std::vector<tensorflow::Tensor>* out_tensors,
                                    bool* end_of_sequence) override {
-        absl::StatusOr<std::string> maybe_element;
+        std::string element;
         {
           absl::MutexLock _(&mu_);
-          maybe_element = stub_->GetNext();
-        }
-
-        if (maybe_element.ok()) {
-          std::string element = std::move(maybe_element).value();
-
-          // The {} at the end specifies a scalar tensor.
-          tensorflow::Tensor element_tensor(ctx->allocator({}),
-                                            tensorflow::DT_STRING, {});
-          element_tensor.scalar<tensorflow::tstring>()() = element;
-
-          *end_of_sequence = false;
-          out_tensors->push_back(std::move(element_tensor));
-          return absl::OkStatus();
-        } else {
-          *end_of_sequence = true;
-          if (maybe_element.status().code() == absl::StatusCode::kOutOfRange) {
-            return absl::OkStatus();
-          } else {
-            return maybe_element.status();
+          if (next_element_ == elements_.size() && batch_status_.ok()) {
+            // The previous batch has been consumed; fetch the next one with a
+            // single call into the stub.
+            elements_.clear();
+            next_element_ = 0;
+            batch_status_ = stub_->GetNextBatch(kBatchSize, elements_);
+          }
+          if (next_element_ == elements_.size()) {
+            *end_of_sequence = true;
+            if (batch_status_.code() == absl::StatusCode::kOutOfRange) {
+              return absl::OkStatus();
+            } else {
+              return batch_status_;
+            }
           }
+          element = std::move(elements_[next_element_++]);
         }
+        // Only elements handed to TensorFlow count as consumed, not the rest
+        // of the batch, which may never be requested.
+        stub_->OnElementsConsumed(1, element.size());
+
+        // The {} at the end specifies a scalar tensor. A tstring can't adopt
+        // the buffer of a std::string, so this copies the element.
+        tensorflow::Tensor element_tensor(ctx->allocator({}),
+                                          tensorflow::DT_STRING, {});
+        element_tensor.scalar<tensorflow::tstring>()() = element;
+
+        *end_of_sequence = false;
+        out_tensors->push_back(std::move(element_tensor));
+        return absl::OkStatus();
       }
 
      protected:
@@ -211,8 +237,18 @@ class ExternalDatasetOp : public tensorflow::data::DatasetOpKernel {
       }
 
      private:
+      // Maximum number of elements requested from the stub at once.
+      static constexpr int kBatchSize = 16;
+
       std::unique_ptr<ExternalDatasetIterator> stub_;
+      std::function<void()> deregister_cancellation_;
       absl::Mutex mu_;
+      // Elements fetched from the stub but not yet returned, starting at
+      // next_element_. Once they're consumed, batch_status_ is returned if it
+      // is an error (including OUT_OF_RANGE).
+      std::vector<std::string> elements_ ABSL_GUARDED_BY(mu_);
+      size_t next_element_ ABSL_GUARDED_BY(mu_) = 0;
+      absl::Status batch_status_ ABSL_GUARDED_BY(mu_);
     };
 
     // Private members of Dataset
@@ -29,6 +29,7 @@
 #include <fcntl.h>
 #include <stdint.h>
 
+#include <atomic>
 #include <limits>
 #include <memory>
 #include <string>
@@ -237,6 +238,92 @@ class FailingIteratorDatasetProvider
   }
 };
 
+// Counts the calls to a BatchingIterator and the elements it was told were
+// consumed.
+struct BatchingIteratorCounts {
+  std::atomic<int> calls = 0;
+  std::atomic<int> consumed = 0;
+};
+
+// Produces the examples 1..num_examples, in batches, and counts how often
+// GetNextBatch() is called. GetNext() is never expected to be called.
+class BatchingIterator : public ExternalDatasetIterator {
+ public:
+  BatchingIterator(int num_examples,
+                   std::shared_ptr<BatchingIteratorCounts> counts)
+      : num_examples_(num_examples), counts_(std::move(counts)) {}
+
+  absl::StatusOr<std::string> GetNext() final {
+    return absl::InternalError("GetNext() should not be called");
+  }
+
+  absl::Status GetNextBatch(int max_elements,
+                            std::vector<std::string>& elements) final {
+    ++counts_->calls;
+    for (int i = 0; i < max_elements; ++i) {
+      if (next_ > num_examples_) {
+        return absl::OutOfRangeError("");
+      }
+      elements.push_back(SerializeExample(next_++));
+    }
+    return absl::OkStatus();
+  }
+
+  void OnElementsConsumed(int num_elements, int64_t size_bytes) final {
+    counts_->consumed += num_elements;
+  }
+
+ private:
+  int num_examples_;
+  int next_ = 1;
+  std::shared_ptr<BatchingIteratorCounts> counts_;
+};
+
+class BatchingIteratorDatasetProvider
+    : public ExternalDatasetProvider::UsingProtoSelector<TestSelector> {
+ public:
+  BatchingIteratorDatasetProvider(
+      int num_examples, std::shared_ptr<BatchingIteratorCounts> counts)
+      : num_examples_(num_examples), counts_(std::move(counts)) {}
+
+  absl::StatusOr<std::unique_ptr<ExternalDataset>> MakeDataset(
+      TestSelector selector) final {
+    return ExternalDataset::FromFunction(
+        [num_examples = num_examples_, counts = counts_]() {
+          return std::make_unique<BatchingIterator>(num_examples, counts);
+        });
+  }
+
+ private:
+  int num_examples_;
+  std::shared_ptr<BatchingIteratorCounts> counts_;
+};
+
+// Returns a single example and then fails, using the default GetNextBatch().
+class FailAfterOneExampleIterator : public ExternalDatasetIterator {
+ public:
+  absl::StatusOr<std::string> GetNext() final {
+    if (returned_example_) {
+      return absl::NotFoundError("");
+    }
+    returned_example_ = true;
+    return SerializeExample(1);
+  }
+
+ private:
+  bool returned_example_ = false;
+};
+
+class FailAfterOneExampleDatasetProvider
+    : public ExternalDatasetProvider::UsingProtoSelector<TestSelector> {
+ public:
+  absl::StatusOr<std::unique_ptr<ExternalDataset>> MakeDataset(
+      TestSelector selector) final {
+    return ExternalDataset::FromFunction(
+        []() { return std::make_unique<FailAfterOneExampleIterator>(); });
+  }
+};
+
 //
 // Actual tests
 //
@@ -301,6 +388,39 @@ TEST(ExternalDatasetOpTest, FailingIterator) {
   EXPECT_THAT(status.code(), Eq(absl::StatusCode::kNotFound));
 }
 
+TEST(ExternalDatasetOpTest, RunExampleGraph_ElementsFetchedInBatches) {
+  auto counts = std::make_shared<BatchingIteratorCounts>();
+  auto stub = std::make_shared<BatchingIteratorDatasetProvider>(40, counts);
+  auto stub_reg = ExternalDatasetProviderRegistry::Register(stub);
+
+  TestSelector selector;
+  tensorflow::Tensor expected = tensorflow::test::AsTensor<int64_t>(
+      {40 * 41 / 2}, tensorflow::TensorShape({1}));
+
+  auto session = PrepareExampleGraphSession();
+  tensorflow::Tensor output =
+      RunSessionAndGetOutput(session.get(), stub_reg.token(), selector);
+
+  tensorflow::test::ExpectTensorEqual<int64_t>(output, expected);
+  // 40 elements are fetched in three batches, the last of which also signals
+  // the end of the sequence.
+  EXPECT_THAT(counts->calls.load(), Eq(3));
+  // Each element is reported as consumed as it is handed to TensorFlow.
+  EXPECT_THAT(counts->consumed.load(), Eq(40));
+}
+
+TEST(ExternalDatasetOpTest, FailingIteratorAfterPartialBatch) {
+  auto stub = std::make_shared<FailAfterOneExampleDatasetProvider>();
+  auto stub_reg = ExternalDatasetProviderRegistry::Register(stub);
+
+  TestSelector selector;
+
+  auto session = PrepareExampleGraphSession();
+  absl::Status status =
+      RunSession(session.get(), stub_reg.token(), selector, nullptr);
+  EXPECT_THAT(status.code(), Eq(absl::StatusCode::kNotFound));
+}
+
 TEST(ExternalDatasetOpTest, RunExampleGraph_InvalidSelector) {
   std::vector<int64_t> examples{123};
 
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fcp/tensorflow/prefetching_external_dataset.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "fcp/base/scheduler.h"
+#include "fcp/tensorflow/external_dataset.h"
+
+namespace fcp {
+
+PrefetchingExternalDatasetIterator::PrefetchingExternalDatasetIterator(
+    std::unique_ptr<ExternalDatasetIterator> iterator,
+    const ExternalDatasetPrefetchOptions& options)
+    : iterator_(std::move(iterator)),
+      buffer_size_(std::max(options.buffer_size, 1)),
+      max_elements_per_call_(
+          std::max(options.buffer_size / std::max(options.num_threads, 1), 1)),
+      producers_(CreateThreadPoolScheduler(std::max(options.num_threads, 1))) {
+  for (int i = 0; i < std::max(options.num_threads, 1); ++i) {
+    producers_->Schedule([this]() { Produce(); });
+  }
+}
+
+PrefetchingExternalDatasetIterator::~PrefetchingExternalDatasetIterator() {
+  Cancel();
+  producers_->WaitUntilIdle();
+}
+
+bool PrefetchingExternalDatasetIterator::CanConsume() const {
+  return cancelled_ || !elements_.empty() ||
+         (!end_status_.ok() && reserved_ == 0);
+}
+
+bool PrefetchingExternalDatasetIterator::CanProduce() const {
+  return !end_status_.ok() || elements_.size() + reserved_ < buffer_size_;
+}
+
+void PrefetchingExternalDatasetIterator::Produce() {
+  std::vector<std::string> batch;
+  while (true) {
+    int max_elements;
+    {
+      absl::MutexLock lock(&mu_);
+      mu_.Await(absl::Condition(
+          this, &PrefetchingExternalDatasetIterator::CanProduce));
+      if (!end_status_.ok()) {
+        return;
+      }
+      max_elements = static_cast<int>(
+          std::min(buffer_size_ - elements_.size() - reserved_,
+                   static_cast<size_t>(max_elements_per_call_)));
+      reserved_ += max_elements;
+    }
+
+    // The wrapped iterator is called without holding the lock, so that
+    // consumers can take buffered elements in the meantime.
+    batch.clear();
+    absl::Status status = iterator_->GetNextBatch(max_elements, batch);
+
+    absl::MutexLock lock(&mu_);
+    reserved_ -= max_elements;
+    if (!cancelled_) {
+      for (std::string& element : batch) {
+        elements_.push_back(std::move(element));
+      }
+    }
+    if (!status.ok() && end_status_.ok()) {
+      end_status_ = status;
+    }
+  }
+}
+
+absl::StatusOr<std::string> PrefetchingExternalDatasetIterator::GetNext() {
+  std::string element;
+  {
+    absl::MutexLock lock(&mu_);
+    mu_.Await(absl::Condition(
+        this, &PrefetchingExternalDatasetIterator::CanConsume));
+    if (elements_.empty()) {
+      return end_status_;
+    }
+    element = std::move(elements_.front());
+    elements_.pop_front();
+  }
+  // The element is consumed by returning it from GetNext().
+  iterator_->OnElementsConsumed(1, element.size());
+  return element;
+}
+
+absl::Status PrefetchingExternalDatasetIterator::GetNextBatch(
+    int max_elements, std::vector<std::string>& elements) {
+  absl::MutexLock lock(&mu_);
+  while (max_elements > 0) {
+    mu_.Await(absl::Condition(
+        this, &PrefetchingExternalDatasetIterator::CanConsume));
+    if (elements_.empty()) {
+      return end_status_;
+    }
+    while (max_elements > 0 && !elements_.empty()) {
+      elements.push_back(std::move(elements_.front()));
+      elements_.pop_front();
+      --max_elements;
+    }
+  }
+  return absl::OkStatus();
+}
+
+void PrefetchingExternalDatasetIterator::OnElementsConsumed(
+    int num_elements, int64_t size_bytes) {
+  iterator_->OnElementsConsumed(num_elements, size_bytes);
+}
+
+void PrefetchingExternalDatasetIterator::Cancel() {
+  {
+    absl::MutexLock lock(&mu_);
+    if (cancelled_) {
+      return;
+    }
+    cancelled_ = true;
+    elements_.clear();
+    end_status_ = absl::CancelledError("The dataset iterator was cancelled");
+  }
+  // Producers may be blocked in the wrapped iterator.
+  iterator_->Cancel();
+}
+
+namespace {
+
+class PrefetchingExternalDataset : public ExternalDataset {
+ public:
+  PrefetchingExternalDataset(std::unique_ptr<ExternalDataset> dataset,
+                             const ExternalDatasetPrefetchOptions& options)
+      : dataset_(std::move(dataset)), options_(options) {}
+
+  std::unique_ptr<ExternalDatasetIterator> MakeIterator() final {
+    return std::make_unique<PrefetchingExternalDatasetIterator>(
+        dataset_->MakeIterator(), options_);
+  }
+
+ private:
+  std::unique_ptr<ExternalDataset> dataset_;
+  const ExternalDatasetPrefetchOptions options_;
+};
+
+}  // namespace
+
+std::unique_ptr<ExternalDataset> WithPrefetching(
+    std::unique_ptr<ExternalDataset> dataset,
+    const ExternalDatasetPrefetchOptions& options) {
+  if (options.buffer_size <= 0) {
+    return dataset;
+  }
+  return std::make_unique<PrefetchingExternalDataset>(std::move(dataset),
+                                                      options);
+}
+
+}  // namespace fcp
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FCP_TENSORFLOW_PREFETCHING_EXTERNAL_DATASET_H_
+#define FCP_TENSORFLOW_PREFETCHING_EXTERNAL_DATASET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "fcp/base/scheduler.h"
+#include "fcp/tensorflow/external_dataset.h"
+
+namespace fcp {
+
+/**
+ * Options for reading an ExternalDatasetIterator ahead of its consumer.
+ */
+struct ExternalDatasetPrefetchOptions {
+  /**
+   * Maximum number of elements held by the prefetch buffer. Zero (or less)
+   * disables prefetching.
+   */
+  int buffer_size = 0;
+  /**
+   * Number of background threads calling the wrapped iterator. Since
+   * ExternalDatasetIterator implementations are thread-safe this is always
+   * allowed, but it only helps if the wrapped iterator serves concurrent calls
+   * in parallel, rather than serializing them. With more than one thread
+   * elements may be returned in a different order than the wrapped iterator
+   * produced them.
+   */
+  int num_threads = 1;
+};
+
+/**
+ * An ExternalDatasetIterator that reads elements from a wrapped iterator on
+ * background threads, into a bounded buffer.
+ *
+ * Once the wrapped iterator returns an error (including OUT_OF_RANGE), the
+ * elements already buffered are returned first, and the error is returned
+ * after that (repeatedly). Cancel() discards the buffer, makes all pending
+ * and future calls return CANCELLED, and forwards the cancellation to the
+ * wrapped iterator.
+ *
+ * The destructor cancels the iterator and blocks until the background threads
+ * have returned from the wrapped iterator.
+ */
+class PrefetchingExternalDatasetIterator : public ExternalDatasetIterator {
+ public:
+  PrefetchingExternalDatasetIterator(
+      std::unique_ptr<ExternalDatasetIterator> iterator,
+      const ExternalDatasetPrefetchOptions& options);
+  ~PrefetchingExternalDatasetIterator() override;
+
+  absl::StatusOr<std::string> GetNext() final ABSL_LOCKS_EXCLUDED(mu_);
+  absl::Status GetNextBatch(int max_elements,
+                            std::vector<std::string>& elements) final
+      ABSL_LOCKS_EXCLUDED(mu_);
+  // Forwarded to the wrapped iterator, whose GetNextBatch() the buffered
+  // elements came from.
+  void OnElementsConsumed(int num_elements, int64_t size_bytes) final;
+  void Cancel() final ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  // The loop run by each background thread.
+  void Produce() ABSL_LOCKS_EXCLUDED(mu_);
+  // Whether a producer can make progress: there's room in the buffer, or it
+  // should stop.
+  bool CanProduce() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Whether a consumer can make progress: an element is available, or no more
+  // elements will become available.
+  bool CanConsume() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  std::unique_ptr<ExternalDatasetIterator> iterator_;
+  const size_t buffer_size_;
+  // Maximum number of elements requested by a single producer call, so that
+  // multiple producers can have calls in flight at the same time.
+  const int max_elements_per_call_;
+
+  mutable absl::Mutex mu_;
+  std::deque<std::string> elements_ ABSL_GUARDED_BY(mu_);
+  // Buffer slots reserved by producer calls which haven't returned yet.
+  size_t reserved_ ABSL_GUARDED_BY(mu_) = 0;
+  // The first error returned by the wrapped iterator, or CANCELLED.
+  absl::Status end_status_ ABSL_GUARDED_BY(mu_);
+  bool cancelled_ ABSL_GUARDED_BY(mu_) = false;
+
+  std::unique_ptr<Scheduler> producers_;
+};
+
+/**
+ * Returns an ExternalDataset whose iterators are the iterators of 'dataset'
+ * wrapped in a PrefetchingExternalDatasetIterator. Returns 'dataset' itself if
+ * prefetching is disabled by 'options'.
+ */
+std::unique_ptr<ExternalDataset> WithPrefetching(
+    std::unique_ptr<ExternalDataset> dataset,
+    const ExternalDatasetPrefetchOptions& options);
+
+}  // namespace fcp
+
+#endif  // FCP_TENSORFLOW_PREFETCHING_EXTERNAL_DATASET_H_
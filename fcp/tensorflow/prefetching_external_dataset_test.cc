@@ -0,0 +1,251 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fcp/tensorflow/prefetching_external_dataset.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "fcp/testing/testing.h"
+
+namespace fcp {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::NotNull;
+using ::testing::UnorderedElementsAreArray;
+
+// Returns "0", "1", ... up to num_elements, and then end_status. Counts the
+// elements reported as consumed.
+class CountingIterator : public ExternalDatasetIterator {
+ public:
+  explicit CountingIterator(int num_elements,
+                            absl::Status end_status = absl::OutOfRangeError(""))
+      : num_elements_(num_elements), end_status_(end_status) {}
+
+  absl::StatusOr<std::string> GetNext() final {
+    absl::MutexLock lock(&mu_);
+    if (next_ >= num_elements_) {
+      return end_status_;
+    }
+    return absl::StrCat(next_++);
+  }
+
+  void OnElementsConsumed(int num_elements, int64_t size_bytes) final {
+    absl::MutexLock lock(&mu_);
+    num_consumed_ += num_elements;
+  }
+
+  int num_produced() {
+    absl::MutexLock lock(&mu_);
+    return next_;
+  }
+
+  int num_consumed() {
+    absl::MutexLock lock(&mu_);
+    return num_consumed_;
+  }
+
+ private:
+  const int num_elements_;
+  const absl::Status end_status_;
+  absl::Mutex mu_;
+  int next_ ABSL_GUARDED_BY(mu_) = 0;
+  int num_consumed_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
+// Blocks in GetNext() until cancelled.
+class BlockingIterator : public ExternalDatasetIterator {
+ public:
+  absl::StatusOr<std::string> GetNext() final {
+    cancelled_.WaitForNotification();
+    return absl::CancelledError("");
+  }
+
+  void Cancel() final {
+    if (!cancelled_.HasBeenNotified()) {
+      cancelled_.Notify();
+    }
+  }
+
+ private:
+  absl::Notification cancelled_;
+};
+
+std::vector<std::string> ReadAll(ExternalDatasetIterator& iterator,
+                                 absl::Status* end_status) {
+  std::vector<std::string> elements;
+  while (true) {
+    absl::StatusOr<std::string> element = iterator.GetNext();
+    if (!element.ok()) {
+      *end_status = element.status();
+      return elements;
+    }
+    elements.push_back(*std::move(element));
+  }
+}
+
+TEST(PrefetchingExternalDatasetTest, ReturnsElementsInOrder) {
+  PrefetchingExternalDatasetIterator iterator(
+      std::make_unique<CountingIterator>(5),
+      {.buffer_size = 2, .num_threads = 1});
+
+  absl::Status end_status;
+  EXPECT_THAT(ReadAll(iterator, &end_status),
+              ElementsAre("0", "1", "2", "3", "4"));
+  EXPECT_THAT(end_status, IsCode(absl::StatusCode::kOutOfRange));
+  // The end of the sequence is returned repeatedly.
+  EXPECT_THAT(iterator.GetNext(), IsCode(absl::StatusCode::kOutOfRange));
+}
+
+TEST(PrefetchingExternalDatasetTest, BufferIsBounded) {
+  auto counting_iterator = std::make_unique<CountingIterator>(100);
+  CountingIterator* counting_iterator_ptr = counting_iterator.get();
+  PrefetchingExternalDatasetIterator iterator(
+      std::move(counting_iterator), {.buffer_size = 4, .num_threads = 2});
+
+  while (counting_iterator_ptr->num_produced() < 4) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  absl::SleepFor(absl::Milliseconds(50));
+  EXPECT_THAT(counting_iterator_ptr->num_produced(), Eq(4));
+
+  // Consuming an element makes room for exactly one more.
+  ASSERT_OK(iterator.GetNext());
+  while (counting_iterator_ptr->num_produced() < 5) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  absl::SleepFor(absl::Milliseconds(50));
+  EXPECT_THAT(counting_iterator_ptr->num_produced(), Eq(5));
+}
+
+TEST(PrefetchingExternalDatasetTest, ErrorReturnedAfterBufferedElements) {
+  PrefetchingExternalDatasetIterator iterator(
+      std::make_unique<CountingIterator>(3, absl::NotFoundError("")),
+      {.buffer_size = 8, .num_threads = 1});
+
+  absl::Status end_status;
+  EXPECT_THAT(ReadAll(iterator, &end_status), ElementsAre("0", "1", "2"));
+  EXPECT_THAT(end_status, IsCode(absl::StatusCode::kNotFound));
+}
+
+TEST(PrefetchingExternalDatasetTest, MultipleThreadsReturnAllElements) {
+  PrefetchingExternalDatasetIterator iterator(
+      std::make_unique<CountingIterator>(1000),
+      {.buffer_size = 16, .num_threads = 4});
+
+  std::vector<std::string> expected;
+  for (int i = 0; i < 1000; ++i) {
+    expected.push_back(absl::StrCat(i));
+  }
+  absl::Status end_status;
+  EXPECT_THAT(ReadAll(iterator, &end_status),
+              UnorderedElementsAreArray(expected));
+  EXPECT_THAT(end_status, IsCode(absl::StatusCode::kOutOfRange));
+}
+
+TEST(PrefetchingExternalDatasetTest, GetNextBatch) {
+  PrefetchingExternalDatasetIterator iterator(
+      std::make_unique<CountingIterator>(5),
+      {.buffer_size = 2, .num_threads = 1});
+
+  std::vector<std::string> elements;
+  ASSERT_OK(iterator.GetNextBatch(3, elements));
+  EXPECT_THAT(elements, ElementsAre("0", "1", "2"));
+  EXPECT_THAT(iterator.GetNextBatch(3, elements),
+              IsCode(absl::StatusCode::kOutOfRange));
+  EXPECT_THAT(elements, ElementsAre("0", "1", "2", "3", "4"));
+}
+
+TEST(PrefetchingExternalDatasetTest, ReportsConsumedElements) {
+  auto counting_iterator = std::make_unique<CountingIterator>(10);
+  CountingIterator* counting_iterator_ptr = counting_iterator.get();
+  PrefetchingExternalDatasetIterator iterator(
+      std::move(counting_iterator), {.buffer_size = 4, .num_threads = 1});
+
+  // Elements returned by GetNext() are consumed right away, while elements
+  // returned by GetNextBatch() are consumed once reported by the caller.
+  ASSERT_OK(iterator.GetNext());
+  std::vector<std::string> elements;
+  ASSERT_OK(iterator.GetNextBatch(2, elements));
+  EXPECT_THAT(counting_iterator_ptr->num_consumed(), Eq(1));
+  iterator.OnElementsConsumed(2, 2);
+  EXPECT_THAT(counting_iterator_ptr->num_consumed(), Eq(3));
+
+  // Buffered elements were read ahead, but not consumed.
+  while (counting_iterator_ptr->num_produced() < 7) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  EXPECT_THAT(counting_iterator_ptr->num_consumed(), Eq(3));
+}
+
+TEST(PrefetchingExternalDatasetTest, CancelUnblocksConsumerAndIterator) {
+  PrefetchingExternalDatasetIterator iterator(
+      std::make_unique<BlockingIterator>(),
+      {.buffer_size = 4, .num_threads = 2});
+
+  absl::StatusOr<std::string> element;
+  std::thread consumer([&iterator, &element]() {
+    element = iterator.GetNext();
+  });
+  iterator.Cancel();
+  consumer.join();
+
+  EXPECT_THAT(element, IsCode(absl::StatusCode::kCancelled));
+  EXPECT_THAT(iterator.GetNext(), IsCode(absl::StatusCode::kCancelled));
+  // The destructor must not block on the wrapped iterator, since the
+  // cancellation was forwarded to it.
+}
+
+TEST(PrefetchingExternalDatasetTest, WithPrefetching) {
+  std::unique_ptr<ExternalDataset> dataset =
+      WithPrefetching(ExternalDataset::FromFunction([]() {
+                        return std::make_unique<CountingIterator>(3);
+                      }),
+                      {.buffer_size = 2});
+
+  std::unique_ptr<ExternalDatasetIterator> iterator = dataset->MakeIterator();
+  EXPECT_THAT(dynamic_cast<PrefetchingExternalDatasetIterator*>(iterator.get()),
+              NotNull());
+  absl::Status end_status;
+  EXPECT_THAT(ReadAll(*iterator, &end_status), ElementsAre("0", "1", "2"));
+  EXPECT_THAT(end_status, IsCode(absl::StatusCode::kOutOfRange));
+}
+
+TEST(PrefetchingExternalDatasetTest, WithPrefetchingDisabled) {
+  std::unique_ptr<ExternalDataset> dataset = ExternalDataset::FromFunction(
+      []() { return std::make_unique<CountingIterator>(0); });
+  ExternalDataset* dataset_ptr = dataset.get();
+
+  EXPECT_THAT(WithPrefetching(std::move(dataset), {}).get(), Eq(dataset_ptr));
+}
+
+}  // namespace
+}  // namespace fcp
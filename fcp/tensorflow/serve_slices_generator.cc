@@ -0,0 +1,191 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fcp/tensorflow/serve_slices_generator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "absl/synchronization/mutex.h"
+#include "fcp/base/digest.h"
+#include "fcp/base/monitoring.h"
+#include "fcp/base/platform.h"
+#include "fcp/base/process_unique_id.h"
+#include "fcp/base/scheduler.h"
+#include "fcp/tensorflow/tf_session.h"
+#include "tensorflow/core/framework/tensor.h"
+
+namespace fcp {
+
+namespace {
+
+// Runs `op` on `session`. TfSession traces the details of any error, so only
+// the op is included in the returned status.
+absl::Status RunOp(TfSession& session,
+                   const TfSession::NamedTensorList& inputs,
+                   absl::string_view op) {
+  if (session.RunOp(inputs, op).is_error()) {
+    return absl::InternalError(absl::StrCat("Failed to run op ", op));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<ServeSlicesGenerator>>
+ServeSlicesGenerator::Create(const std::filesystem::path& tmp_dir,
+                             const absl::Cord& graph, int num_sessions,
+                             SliceStore* store) {
+  if (num_sessions < 1) {
+    return absl::InvalidArgumentError("num_sessions must be positive");
+  }
+  std::vector<std::unique_ptr<TfSession>> sessions;
+  sessions.reserve(num_sessions);
+  for (int i = 0; i < num_sessions; ++i) {
+    auto session = std::make_unique<TfSession>(tmp_dir, graph);
+    if (session->Ready().is_error()) {
+      return absl::InvalidArgumentError(
+          "Failed to create a session for the select_fn graph");
+    }
+    sessions.push_back(std::move(session));
+  }
+  return absl::WrapUnique(new ServeSlicesGenerator(
+      std::string(StripTrailingPathSeparator(tmp_dir.c_str())),
+      std::move(sessions), store));
+}
+
+ServeSlicesGenerator::ServeSlicesGenerator(
+    std::string tmp_dir, std::vector<std::unique_ptr<TfSession>> sessions,
+    SliceStore* store)
+    : tmp_dir_(std::move(tmp_dir)),
+      store_(store),
+      sessions_(std::move(sessions)),
+      workers_(CreateThreadPoolScheduler(sessions_.size())) {}
+
+absl::StatusOr<std::string> ServeSlicesGenerator::Generate(
+    const ServeSlicesRequest& request) {
+  if (request.server_val.size() !=
+      request.select_fn_server_val_input_tensor_names.size()) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Expected one select_fn input tensor name per server_val tensor, got ",
+        request.select_fn_server_val_input_tensor_names.size(), " names for ",
+        request.server_val.size(), " tensors"));
+  }
+  if (request.max_key < 0) {
+    return absl::InvalidArgumentError("max_key must not be negative");
+  }
+  TfSession::NamedTensorList server_val_inputs;
+  for (int i = 0; i < request.server_val.size(); ++i) {
+    server_val_inputs.emplace_back(
+        request.select_fn_server_val_input_tensor_names[i],
+        request.server_val[i]);
+  }
+
+  absl::MutexLock lock(&mu_);
+  const int64_t num_keys = static_cast<int64_t>(request.max_key) + 1;
+  std::vector<std::string> content_ids(num_keys);
+  // Keys are handed out to the sessions one at a time, so that a session
+  // which is slow on some keys doesn't hold up the others.
+  std::atomic<int64_t> next_key = 0;
+  absl::Mutex status_mu;
+  absl::Status status;
+  const int64_t num_workers =
+      std::min(num_keys, static_cast<int64_t>(sessions_.size()));
+  for (int64_t i = 0; i < num_workers; ++i) {
+    TfSession* session = sessions_[i].get();
+    workers_->Schedule([&, session]() {
+      absl::Status session_status =
+          request.initialize_per_key
+              ? absl::OkStatus()
+              : RunOp(*session, {}, request.select_fn_initialize_op);
+      while (session_status.ok()) {
+        const int64_t key = next_key.fetch_add(1);
+        if (key >= num_keys) {
+          break;
+        }
+        absl::StatusOr<std::string> content_id =
+            GenerateSlice(*session, server_val_inputs, request, key);
+        if (!content_id.ok()) {
+          session_status = content_id.status();
+          break;
+        }
+        content_ids[key] = *std::move(content_id);
+      }
+      if (!session_status.ok()) {
+        // Stop the other sessions from starting on further keys.
+        next_key.store(num_keys);
+        absl::MutexLock status_lock(&status_mu);
+        if (status.ok()) {
+          status = session_status;
+        }
+      }
+    });
+  }
+  workers_->WaitUntilIdle();
+  FCP_RETURN_IF_ERROR(status);
+
+  std::string served_at_id =
+      absl::BytesToHexString(ComputeSHA256(absl::StrJoin(content_ids, ",")));
+  FCP_RETURN_IF_ERROR(store_->PutServedAt(served_at_id, content_ids));
+  return served_at_id;
+}
+
+absl::StatusOr<std::string> ServeSlicesGenerator::GenerateSlice(
+    TfSession& session, const TfSession::NamedTensorList& server_val_inputs,
+    const ServeSlicesRequest& request, int32_t key) {
+  if (request.initialize_per_key) {
+    FCP_RETURN_IF_ERROR(RunOp(session, {}, request.select_fn_initialize_op));
+  }
+  std::string filename = ConcatPath(
+      tmp_dir_, absl::StrCat("slice", ProcessUniqueId::Next().value()));
+  TfSession::NamedTensorList inputs = server_val_inputs;
+  inputs.emplace_back(request.select_fn_key_input_tensor_name,
+                      tensorflow::Tensor(key));
+  inputs.emplace_back(request.select_fn_filename_input_tensor_name,
+                      tensorflow::Tensor(filename));
+  // As in TfSession::SaveState, the target is given as a tensor name but run
+  // as an op.
+  absl::Status run_status =
+      RunOp(session, inputs,
+            absl::StripSuffix(request.select_fn_target_tensor_name, ":0"));
+  absl::StatusOr<absl::Cord> slice =
+      run_status.ok() ? ReadFileToCord(filename)
+                      : absl::StatusOr<absl::Cord>(run_status);
+  std::remove(filename.c_str());
+  FCP_RETURN_IF_ERROR(slice.status());
+
+  std::string content_id = absl::BytesToHexString(ComputeSHA256(*slice));
+  FCP_RETURN_IF_ERROR(store_->PutSlice(content_id, *slice));
+  return content_id;
+}
+
+}  // namespace fcp
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FCP_TENSORFLOW_SERVE_SLICES_GENERATOR_H_
+#define FCP_TENSORFLOW_SERVE_SLICES_GENERATOR_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "fcp/base/scheduler.h"
+#include "fcp/tensorflow/tf_session.h"
+#include "tensorflow/core/framework/tensor.h"
+
+namespace fcp {
+
+/**
+ * Stores the slices produced by a ServeSlicesGenerator. Must be thread-safe.
+ */
+class SliceStore {
+ public:
+  virtual ~SliceStore() = default;
+
+  /**
+   * Stores a slice as a blob named by its content ID (the hex-encoded SHA-256
+   * of the slice). May be called more than once for the same blob, e.g. when
+   * several keys select the same slice.
+   */
+  virtual absl::Status PutSlice(absl::string_view content_id,
+                                const absl::Cord& slice) = 0;
+
+  /**
+   * Records the slices served under `served_at_id`: the slice for key `k` is
+   * the blob named `content_ids[k]`. Called once all of the slices have been
+   * stored.
+   */
+  virtual absl::Status PutServedAt(
+      absl::string_view served_at_id,
+      absl::Span<const std::string> content_ids) = 0;
+};
+
+/**
+ * The arguments with which the ServeSlices op invokes its callback; see
+ * ServeSlicesCallback for their meaning.
+ */
+struct ServeSlicesRequest {
+  std::vector<tensorflow::Tensor> server_val;
+  int32_t max_key = 0;
+  std::string select_fn_initialize_op;
+  std::vector<std::string> select_fn_server_val_input_tensor_names;
+  std::string select_fn_key_input_tensor_name;
+  std::string select_fn_filename_input_tensor_name;
+  std::string select_fn_target_tensor_name;
+  // Whether `select_fn_initialize_op` runs before every key, as ServeSlices
+  // specifies, rather than once per session. See ServeSlicesGenerator.
+  bool initialize_per_key = false;
+};
+
+/**
+ * Generates the slices requested by a ServeSlices op, by running its
+ * `select_fn` for each key on a pool of TfSessions.
+ *
+ * Each session runs the `select_fn` initialize op once per request, and then
+ * evaluates keys one after another, so keys are evaluated `num_sessions` at a
+ * time. This departs from the ServeSlices contract, under which the initialize
+ * op runs before each call to `select_fn`: unless `initialize_per_key` is set,
+ * `select_fn` must be stateless across keys, as otherwise a slice would depend
+ * on which session evaluated its key and on which keys it evaluated before.
+ *
+ * The slices are written to a SliceStore as content-addressed blobs, and
+ * the request is served at an ID derived from the contents of all its slices,
+ * so regenerating identical slices yields the same `served_at_id`.
+ */
+class ServeSlicesGenerator {
+ public:
+  /**
+   * @param tmp_dir A directory in which `select_fn` writes slices before they
+   *    are stored. The same constraints apply as for TfSession.
+   * @param graph Serialized GraphDef containing `select_fn`.
+   * @param num_sessions The number of sessions, i.e. the number of keys which
+   *    are evaluated in parallel.
+   * @param store Where the slices are stored. Must outlive the generator.
+   */
+  static absl::StatusOr<std::unique_ptr<ServeSlicesGenerator>> Create(
+      const std::filesystem::path& tmp_dir, const absl::Cord& graph,
+      int num_sessions, SliceStore* store);
+
+  /**
+   * Generates and stores the slices for keys 0 through `request.max_key`, and
+   * returns the `served_at_id` under which they are served. Concurrent calls
+   * are serialized.
+   */
+  absl::StatusOr<std::string> Generate(const ServeSlicesRequest& request)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  ServeSlicesGenerator(std::string tmp_dir,
+                       std::vector<std::unique_ptr<TfSession>> sessions,
+                       SliceStore* store);
+
+  // Generates and stores the slice for `key` using `session`, and returns its
+  // content ID.
+  absl::StatusOr<std::string> GenerateSlice(
+      TfSession& session, const TfSession::NamedTensorList& server_val_inputs,
+      const ServeSlicesRequest& request, int32_t key);
+
+  const std::string tmp_dir_;
+  SliceStore* const store_;
+  absl::Mutex mu_;
+  std::vector<std::unique_ptr<TfSession>> sessions_ ABSL_GUARDED_BY(mu_);
+  std::unique_ptr<Scheduler> workers_;
+};
+
+}  // namespace fcp
+
+#endif  // FCP_TENSORFLOW_SERVE_SLICES_GENERATOR_H_
@@ -0,0 +1,276 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fcp/tensorflow/serve_slices_generator.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "fcp/base/digest.h"
+#include "fcp/base/monitoring.h"
+#include "fcp/tensorflow/testing/tf_helper.h"
+#include "fcp/testing/testing.h"
+#include "tensorflow/cc/framework/scope.h"
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+
+namespace fcp {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsEmpty;
+using ::testing::SizeIs;
+
+constexpr int kNumSessions = 4;
+
+class FakeSliceStore : public SliceStore {
+ public:
+  absl::Status PutSlice(absl::string_view content_id,
+                        const absl::Cord& slice) override {
+    absl::MutexLock lock(&mu_);
+    slices_[content_id] = std::string(slice);
+    return absl::OkStatus();
+  }
+
+  absl::Status PutServedAt(absl::string_view served_at_id,
+                           absl::Span<const std::string> content_ids) override {
+    absl::MutexLock lock(&mu_);
+    served_at_[served_at_id] =
+        std::vector<std::string>(content_ids.begin(), content_ids.end());
+    return absl::OkStatus();
+  }
+
+  // Returns the slices served under `served_at_id`, in key order.
+  std::vector<std::string> GetServedSlices(absl::string_view served_at_id) {
+    absl::MutexLock lock(&mu_);
+    std::vector<std::string> slices;
+    for (const std::string& content_id : served_at_[served_at_id]) {
+      slices.push_back(slices_[content_id]);
+    }
+    return slices;
+  }
+
+  absl::flat_hash_map<std::string, std::string> slices() {
+    absl::MutexLock lock(&mu_);
+    return slices_;
+  }
+
+  int num_served_at() {
+    absl::MutexLock lock(&mu_);
+    return served_at_.size();
+  }
+
+ private:
+  absl::Mutex mu_;
+  absl::flat_hash_map<std::string, std::string> slices_ ABSL_GUARDED_BY(mu_);
+  absl::flat_hash_map<std::string, std::vector<std::string>> served_at_
+      ABSL_GUARDED_BY(mu_);
+};
+
+// Returns a graph whose select_fn writes `server_val + key` (as a string) to
+// `filename`.
+absl::Cord CreateSelectFnGraph() {
+  tensorflow::Scope root = tensorflow::Scope::NewRootScope();
+  auto server_val = tensorflow::ops::Placeholder(root.WithOpName("server_val"),
+                                                 tensorflow::DT_INT32);
+  auto key = tensorflow::ops::Placeholder(root.WithOpName("key"),
+                                          tensorflow::DT_INT32);
+  auto filename = tensorflow::ops::Placeholder(root.WithOpName("filename"),
+                                               tensorflow::DT_STRING);
+  tensorflow::ops::NoOp(root.WithOpName("init"));
+  tensorflow::ops::WriteFile(
+      root.WithOpName("write_slice"), filename,
+      tensorflow::ops::AsString(root, tensorflow::ops::Add(root, server_val,
+                                                           key)));
+  return CreateGraph(&root);
+}
+
+// Returns a graph whose select_fn counts its calls in a variable, which the
+// "init" op resets, and writes `server_val + key + count` to `filename`, where
+// `count` is the number of calls since the last "init".
+absl::Cord CreateStatefulSelectFnGraph() {
+  tensorflow::Scope root = tensorflow::Scope::NewRootScope();
+  auto server_val = tensorflow::ops::Placeholder(root.WithOpName("server_val"),
+                                                 tensorflow::DT_INT32);
+  auto key = tensorflow::ops::Placeholder(root.WithOpName("key"),
+                                          tensorflow::DT_INT32);
+  auto filename = tensorflow::ops::Placeholder(root.WithOpName("filename"),
+                                               tensorflow::DT_STRING);
+  auto count = tensorflow::ops::Variable(root, tensorflow::TensorShape({}),
+                                         tensorflow::DT_INT32);
+  tensorflow::ops::Assign(root.WithOpName("init"), count, 0);
+  auto incremented = tensorflow::ops::AssignAdd(root, count, 1);
+  tensorflow::ops::WriteFile(
+      root.WithOpName("write_slice"), filename,
+      tensorflow::ops::AsString(
+          root, tensorflow::ops::Add(
+                    root, tensorflow::ops::Add(root, server_val, key),
+                    incremented)));
+  return CreateGraph(&root);
+}
+
+ServeSlicesRequest CreateRequest(int32_t server_val, int32_t max_key) {
+  ServeSlicesRequest request;
+  request.server_val.push_back(tensorflow::Tensor(server_val));
+  request.max_key = max_key;
+  request.select_fn_initialize_op = "init";
+  request.select_fn_server_val_input_tensor_names = {"server_val"};
+  request.select_fn_key_input_tensor_name = "key";
+  request.select_fn_filename_input_tensor_name = "filename";
+  request.select_fn_target_tensor_name = "write_slice";
+  return request;
+}
+
+std::unique_ptr<ServeSlicesGenerator> CreateGenerator(
+    FakeSliceStore* store, const absl::Cord& graph = CreateSelectFnGraph(),
+    int num_sessions = kNumSessions) {
+  absl::StatusOr<std::unique_ptr<ServeSlicesGenerator>> generator =
+      ServeSlicesGenerator::Create(testing::TempDir(), graph, num_sessions,
+                                   store);
+  FCP_CHECK(generator.ok()) << generator.status();
+  return *std::move(generator);
+}
+
+TEST(ServeSlicesGeneratorTest, GeneratesSliceForEachKey) {
+  FakeSliceStore store;
+  std::unique_ptr<ServeSlicesGenerator> generator = CreateGenerator(&store);
+
+  absl::StatusOr<std::string> served_at_id =
+      generator->Generate(CreateRequest(/*server_val=*/10, /*max_key=*/99));
+  ASSERT_OK(served_at_id);
+
+  std::vector<std::string> slices = store.GetServedSlices(*served_at_id);
+  ASSERT_THAT(slices, SizeIs(100));
+  for (int key = 0; key < 100; ++key) {
+    EXPECT_THAT(slices[key], Eq(absl::StrCat(10 + key)));
+  }
+  // Slices are stored under the hex-encoded SHA-256 of their contents.
+  for (const auto& [content_id, slice] : store.slices()) {
+    EXPECT_THAT(content_id, Eq(absl::BytesToHexString(ComputeSHA256(slice))));
+  }
+}
+
+TEST(ServeSlicesGeneratorTest, ServedAtIdDependsOnlyOnSlices) {
+  FakeSliceStore store;
+  std::unique_ptr<ServeSlicesGenerator> generator = CreateGenerator(&store);
+
+  absl::StatusOr<std::string> first = generator->Generate(CreateRequest(1, 9));
+  absl::StatusOr<std::string> second =
+      generator->Generate(CreateRequest(1, 9));
+  absl::StatusOr<std::string> different =
+      generator->Generate(CreateRequest(2, 9));
+  ASSERT_OK(first);
+  ASSERT_OK(second);
+  ASSERT_OK(different);
+
+  EXPECT_THAT(*second, Eq(*first));
+  EXPECT_NE(*different, *first);
+  EXPECT_THAT(store.num_served_at(), Eq(2));
+}
+
+TEST(ServeSlicesGeneratorTest, FewerKeysThanSessions) {
+  FakeSliceStore store;
+  std::unique_ptr<ServeSlicesGenerator> generator = CreateGenerator(&store);
+
+  absl::StatusOr<std::string> served_at_id =
+      generator->Generate(CreateRequest(5, 0));
+  ASSERT_OK(served_at_id);
+  EXPECT_THAT(store.GetServedSlices(*served_at_id), ElementsAre("5"));
+}
+
+TEST(ServeSlicesGeneratorTest, StatefulSelectFnReinitializedPerKey) {
+  FakeSliceStore store;
+  std::unique_ptr<ServeSlicesGenerator> generator =
+      CreateGenerator(&store, CreateStatefulSelectFnGraph());
+  ServeSlicesRequest request = CreateRequest(/*server_val=*/10, /*max_key=*/99);
+  request.initialize_per_key = true;
+
+  absl::StatusOr<std::string> served_at_id = generator->Generate(request);
+  ASSERT_OK(served_at_id);
+
+  // Every key sees freshly initialized state, whichever session evaluated it.
+  std::vector<std::string> slices = store.GetServedSlices(*served_at_id);
+  ASSERT_THAT(slices, SizeIs(100));
+  for (int key = 0; key < 100; ++key) {
+    EXPECT_THAT(slices[key], Eq(absl::StrCat(10 + key + 1)));
+  }
+}
+
+TEST(ServeSlicesGeneratorTest, StatefulSelectFnInitializedOncePerSession) {
+  FakeSliceStore store;
+  std::unique_ptr<ServeSlicesGenerator> generator = CreateGenerator(
+      &store, CreateStatefulSelectFnGraph(), /*num_sessions=*/1);
+
+  absl::StatusOr<std::string> served_at_id =
+      generator->Generate(CreateRequest(/*server_val=*/10, /*max_key=*/9));
+  ASSERT_OK(served_at_id);
+
+  // By default, state carries over from one key to the next within a session.
+  std::vector<std::string> slices = store.GetServedSlices(*served_at_id);
+  ASSERT_THAT(slices, SizeIs(10));
+  for (int key = 0; key < 10; ++key) {
+    EXPECT_THAT(slices[key], Eq(absl::StrCat(10 + key + key + 1)));
+  }
+}
+
+TEST(ServeSlicesGeneratorTest, MismatchedServerValInputNames) {
+  FakeSliceStore store;
+  std::unique_ptr<ServeSlicesGenerator> generator = CreateGenerator(&store);
+  ServeSlicesRequest request = CreateRequest(1, 9);
+  request.select_fn_server_val_input_tensor_names.push_back("extra");
+
+  EXPECT_THAT(generator->Generate(request),
+              IsCode(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(store.slices(), IsEmpty());
+}
+
+TEST(ServeSlicesGeneratorTest, FailingSelectFn) {
+  FakeSliceStore store;
+  std::unique_ptr<ServeSlicesGenerator> generator = CreateGenerator(&store);
+  ServeSlicesRequest request = CreateRequest(1, 9);
+  request.select_fn_target_tensor_name = "missing_op";
+
+  EXPECT_THAT(generator->Generate(request),
+              IsCode(absl::StatusCode::kInternal));
+  EXPECT_THAT(store.num_served_at(), Eq(0));
+}
+
+TEST(ServeSlicesGeneratorTest, InvalidGraph) {
+  FakeSliceStore store;
+  EXPECT_THAT(ServeSlicesGenerator::Create(testing::TempDir(),
+                                           absl::Cord("garbage"),
+                                           kNumSessions, &store),
+              IsCode(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace fcp
@@ -15,6 +15,15 @@
  */
 #include "fcp/tensorflow/tensor_crc32.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/crc/crc32c.h"
+#include "absl/strings/string_view.h"
+#include "tensorflow/core/util/work_sharder.h"
+
 namespace fcp {
 namespace tensorflow {
 namespace checksums {
@@ -23,11 +32,59 @@ using ::tensorflow::StringPiece;
 using ::tensorflow::Tensor;
 using ::tensorflow::crc32c::Value;
 
+namespace {
+
+// Tensors are checksummed in blocks of this size. Large enough that combining
+// the block checksums and scheduling the blocks is negligible next to
+// checksumming them.
+constexpr size_t kCRC32BlockSize = 4 << 20;
+
+}  // namespace
+
 uint32_t TensorToCRC32(const Tensor& tensor) {
   StringPiece tensor_data = tensor.tensor_data();
   return Value(tensor_data.data(), tensor_data.size());
 }
 
+uint32_t TensorToCRC32(
+    const Tensor& tensor,
+    const ::tensorflow::DeviceBase::CpuWorkerThreads& worker_threads) {
+  StringPiece tensor_data = tensor.tensor_data();
+  return ParallelCRC32(absl::string_view(tensor_data.data(),
+                                         tensor_data.size()),
+                       kCRC32BlockSize, worker_threads.num_threads,
+                       worker_threads.workers);
+}
+
+uint32_t ParallelCRC32(absl::string_view data, size_t block_size,
+                       int max_parallelism,
+                       ::tensorflow::thread::ThreadPool* workers) {
+  // absl::ComputeCrc32c uses the CPU's CRC instructions where available.
+  if (block_size == 0 || data.size() <= block_size || max_parallelism <= 1 ||
+      workers == nullptr) {
+    return static_cast<uint32_t>(absl::ComputeCrc32c(data));
+  }
+  const int64_t num_blocks = (data.size() + block_size - 1) / block_size;
+  std::vector<absl::crc32c_t> block_crcs(num_blocks);
+  ::tensorflow::Shard(
+      max_parallelism, workers, num_blocks,
+      /*cost_per_unit=*/static_cast<int64_t>(block_size),
+      [&data, &block_crcs, block_size](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          block_crcs[i] =
+              absl::ComputeCrc32c(data.substr(i * block_size, block_size));
+        }
+      });
+  // crc(A || B) can be derived from crc(A), crc(B) and the length of B, in
+  // time logarithmic in the length of B.
+  absl::crc32c_t crc = block_crcs[0];
+  for (int64_t i = 1; i < num_blocks; ++i) {
+    size_t length = std::min(block_size, data.size() - i * block_size);
+    crc = absl::ConcatCrc32c(crc, block_crcs[i], length);
+  }
+  return static_cast<uint32_t>(crc);
+}
+
 }  // namespace checksums
 }  // namespace tensorflow
 }  // namespace fcp
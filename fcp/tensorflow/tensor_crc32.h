@@ -16,8 +16,14 @@
 #ifndef FCP_TENSORFLOW_TENSOR_CRC32_H_
 #define FCP_TENSORFLOW_TENSOR_CRC32_H_
 
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/strings/string_view.h"
+#include "tensorflow/core/framework/device_base.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/hash/crc32c.h"
+#include "tensorflow/core/platform/threadpool.h"
 
 namespace fcp {
 namespace tensorflow {
@@ -26,6 +32,25 @@ namespace checksums {
 /* Computes the CRC32c checksum of the in-memory representation of a Tensor. */
 uint32_t TensorToCRC32(const ::tensorflow::Tensor& tensor);
 
+/*
+ * Same as above, but large tensors are split into blocks which are checksummed
+ * in parallel on `worker_threads`. The result is identical to the sequential
+ * checksum.
+ */
+uint32_t TensorToCRC32(
+    const ::tensorflow::Tensor& tensor,
+    const ::tensorflow::DeviceBase::CpuWorkerThreads& worker_threads);
+
+/*
+ * Computes the CRC32c checksum of `data` by checksumming blocks of
+ * `block_size` bytes independently, using at most `max_parallelism` threads of
+ * `workers`, and then combining the checksums of the blocks. A `block_size` of
+ * 0 checksums `data` in one go, on the calling thread.
+ */
+uint32_t ParallelCRC32(absl::string_view data, size_t block_size,
+                       int max_parallelism,
+                       ::tensorflow::thread::ThreadPool* workers);
+
 }  // namespace checksums
 }  // namespace tensorflow
 }  // namespace fcp
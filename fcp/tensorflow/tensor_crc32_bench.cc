@@ -0,0 +1,78 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+
+#include "fcp/tensorflow/tensor_crc32.h"
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/threadpool.h"
+
+// Open-source version of benchmarking library
+#include "benchmark//benchmark.h"
+
+namespace fcp {
+namespace tensorflow {
+namespace checksums {
+namespace {
+
+constexpr int kNumThreads = 8;
+
+// Returns a uint8 tensor of state.range(0) bytes.
+::tensorflow::Tensor MakeTensor(const benchmark::State& state) {
+  ::tensorflow::Tensor tensor(::tensorflow::DT_UINT8,
+                              ::tensorflow::TensorShape({state.range(0)}));
+  auto flat = tensor.flat<uint8_t>();
+  for (int64_t i = 0; i < flat.size(); ++i) {
+    flat(i) = static_cast<uint8_t>(i * 131);
+  }
+  return tensor;
+}
+
+static void BM_SequentialCRC32(benchmark::State& state) {
+  ::tensorflow::Tensor tensor = MakeTensor(state);
+  for (auto s : state) {
+    benchmark::DoNotOptimize(TensorToCRC32(tensor));
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_ParallelCRC32(benchmark::State& state) {
+  ::tensorflow::Tensor tensor = MakeTensor(state);
+  ::tensorflow::thread::ThreadPool pool(::tensorflow::Env::Default(),
+                                        "crc32_bench", kNumThreads);
+  ::tensorflow::DeviceBase::CpuWorkerThreads worker_threads;
+  worker_threads.num_threads = kNumThreads;
+  worker_threads.workers = &pool;
+  for (auto s : state) {
+    benchmark::DoNotOptimize(TensorToCRC32(tensor, worker_threads));
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+// From 4 KiB up to 256 MiB.
+BENCHMARK(BM_SequentialCRC32)->RangeMultiplier(16)->Range(1 << 12, 1 << 28);
+BENCHMARK(BM_ParallelCRC32)
+    ->RangeMultiplier(16)
+    ->Range(1 << 12, 1 << 28)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace checksums
+}  // namespace tensorflow
+}  // namespace fcp
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fcp/tensorflow/tensor_crc32.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/strings/string_view.h"
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/hash/crc32c.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/threadpool.h"
+
+namespace fcp {
+namespace tensorflow {
+namespace checksums {
+namespace {
+
+using ::testing::Eq;
+
+constexpr int kNumThreads = 4;
+
+std::string CreateData(size_t size) {
+  std::string data(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = static_cast<char>((i * 131) ^ (i >> 8));
+  }
+  return data;
+}
+
+class ParallelCRC32Test : public ::testing::Test {
+ protected:
+  ::tensorflow::thread::ThreadPool pool_{::tensorflow::Env::Default(),
+                                         "parallel_crc32_test", kNumThreads};
+};
+
+TEST_F(ParallelCRC32Test, MatchesSequentialChecksum) {
+  for (size_t size : {0, 1, 63, 64, 65, 1000, 4096, 100003}) {
+    std::string data = CreateData(size);
+    uint32_t expected = ::tensorflow::crc32c::Value(data.data(), data.size());
+    for (size_t block_size : {1, 7, 64, 1024, 1 << 20}) {
+      EXPECT_THAT(ParallelCRC32(data, block_size, kNumThreads, &pool_),
+                  Eq(expected))
+          << "size " << size << ", block size " << block_size;
+    }
+  }
+}
+
+TEST_F(ParallelCRC32Test, KnownValue) {
+  // From RFC 3720 B.4: 32 bytes of zeroes.
+  std::string zeroes(32, '\0');
+  EXPECT_THAT(ParallelCRC32(zeroes, 5, kNumThreads, &pool_), Eq(0x8a9136aa));
+}
+
+TEST_F(ParallelCRC32Test, WithoutThreadPool) {
+  std::string data = CreateData(1000);
+  EXPECT_THAT(ParallelCRC32(data, 64, 1, nullptr),
+              Eq(::tensorflow::crc32c::Value(data.data(), data.size())));
+}
+
+TEST_F(ParallelCRC32Test, ZeroBlockSizeIsSequential) {
+  std::string data = CreateData(1000);
+  EXPECT_THAT(ParallelCRC32(data, 0, kNumThreads, &pool_),
+              Eq(::tensorflow::crc32c::Value(data.data(), data.size())));
+}
+
+TEST_F(ParallelCRC32Test, LargeTensor) {
+  ::tensorflow::Tensor tensor(::tensorflow::DT_INT32,
+                              ::tensorflow::TensorShape({3 << 20}));
+  auto flat = tensor.flat<int32_t>();
+  for (int64_t i = 0; i < flat.size(); ++i) {
+    flat(i) = static_cast<int32_t>(i * 2654435761u);
+  }
+  ::tensorflow::DeviceBase::CpuWorkerThreads worker_threads;
+  worker_threads.num_threads = kNumThreads;
+  worker_threads.workers = &pool_;
+  EXPECT_THAT(TensorToCRC32(tensor, worker_threads),
+              Eq(TensorToCRC32(tensor)));
+}
+
+}  // namespace
+}  // namespace checksums
+}  // namespace tensorflow
+}  // namespace fcp
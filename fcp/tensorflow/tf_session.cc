@@ -16,7 +16,6 @@
 
 #include "fcp/tensorflow/tf_session.h"
 
-#include <cstdio>
 #include <memory>
 #include <string>
 #include <utility>
@@ -34,6 +33,8 @@
 #include "fcp/tensorflow/tracing_schema_generated.h"
 #include "fcp/tracing/tracing_span.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/file_system.h"
 #include "tensorflow/core/protobuf/saver.pb.h"
 #include "tensorflow/core/public/session.h"
 #include "tensorflow/core/public/session_options.h"
@@ -117,12 +118,42 @@ Result<std::unique_ptr<TfSession::NamedTensorMap>> TfSession::GetOutputs(
   return std::move(outputs);
 }
 
+namespace {
+
+// Temporary checkpoints are kept in TensorFlow's in-memory file system, so that
+// saving and restoring state doesn't round-trip through the disk. The save and
+// restore ops access them through tensorflow::Env like any other file.
+constexpr absl::string_view kInMemoryFileSystemPrefix = "ram://";
+
 void DeleteTmpFile(const std::string& tmp_file_name) {
-  if (std::remove(tmp_file_name.c_str()) > 0) {
+  if (!tensorflow::Env::Default()->DeleteFile(tmp_file_name).ok()) {
     Trace<TmpFileNotDeleted>(tmp_file_name);
   }
 }
 
+absl::StatusOr<absl::Cord> ReadTmpFile(const std::string& tmp_file_name) {
+  std::string contents;
+  absl::Status status = tensorflow::ReadFileToString(
+      tensorflow::Env::Default(), tmp_file_name, &contents);
+  if (!status.ok()) {
+    return status;
+  }
+  return absl::Cord(std::move(contents));
+}
+
+absl::Status WriteTmpFile(const std::string& tmp_file_name,
+                          const absl::Cord& contents) {
+  std::unique_ptr<tensorflow::WritableFile> file;
+  FCP_RETURN_IF_ERROR(
+      tensorflow::Env::Default()->NewWritableFile(tmp_file_name, &file));
+  for (absl::string_view chunk : contents.Chunks()) {
+    FCP_RETURN_IF_ERROR(file->Append(chunk));
+  }
+  return file->Close();
+}
+
+}  // namespace
+
 Result<absl::Cord> TfSession::SaveState(const CheckpointOp& op) {
   FCP_TRY(Ready());
   TracingSpan<SaveToCheckpoint> span(
@@ -142,7 +173,7 @@ Result<absl::Cord> TfSession::SaveState(const CheckpointOp& op) {
         RunOp({{def.filename_tensor_name(), tensorflow::Tensor(tmp_file_name)}},
               save_op)
             .Then([&tmp_file_name](Unit u) -> Result<StatusOr<absl::Cord>> {
-              return Result(fcp::ReadFileToCord(tmp_file_name));
+              return Result(ReadTmpFile(tmp_file_name));
             })
             .Then(ExpectOk());
     DeleteTmpFile(tmp_file_name);
@@ -163,7 +194,7 @@ Result<Unit> TfSession::RestoreState(const CheckpointOp& op,
   if (op.has_saver_def()) {
     const tensorflow::SaverDef& def = op.saver_def();
     std::string tmp_file_name = GetTmpCheckpointFileName("restore_checkpoint");
-    res = Result(fcp::WriteCordToFile(tmp_file_name, checkpoint))
+    res = Result(WriteTmpFile(tmp_file_name, checkpoint))
               .Then(ExpectOk())
               .Then([this, &def, &tmp_file_name](Unit u) -> Result<Unit> {
                 return RunOp({{def.filename_tensor_name(),
@@ -192,8 +223,10 @@ Result<Unit> TfSession::RestoreState(const CheckpointOp& op,
 }
 
 std::string TfSession::GetTmpCheckpointFileName(absl::string_view name) {
-  return ConcatPath(
-      tmp_dir_, absl::StrCat(name, ProcessUniqueId::Next().value(), ".ckp"));
+  return absl::StrCat(
+      kInMemoryFileSystemPrefix,
+      ConcatPath(tmp_dir_,
+                 absl::StrCat(name, ProcessUniqueId::Next().value(), ".ckp")));
 }
 
 }  // namespace fcp
@@ -36,10 +36,10 @@ class TfSession {
   /**
    * Starts a tensorflow client session with the provided graph def
    * @param tmp_dir A directory in which to create tmp files used while saving
-   *    or restoring checkpoints. This directory can be the same for multiple
-   *    TfSessions created in the same process, even if they are running
-   *    concurrently, but it must not be the same directory passed to a
-   *    TfSession in a different process.
+   *    or restoring checkpoints. These files are kept in TensorFlow's
+   *    in-memory file system ("ram://"), so the directory needn't exist on
+   *    disk. This directory can be the same for multiple TfSessions created in
+   *    the same process, even if they are running concurrently.
    * @param graph Serialized graph describing how to aggregate client updates
    *    into a global model. Must be parseable into a tesnorflow::GraphDef
    *    proto.
@@ -65,6 +65,9 @@ class TfSession {
   // must be present in the GraphDef that was provided in the constructor.
   Result<Unit> RunOp(absl::string_view op);
 
+  // Overload to allow providing inputs to operations.
+  Result<Unit> RunOp(const NamedTensorList& inputs, absl::string_view op);
+
   // Returns a map of name, output tensor pairs for the outputs specified by
   // output_names.
   Result<std::unique_ptr<NamedTensorMap>> GetOutputs(
@@ -101,8 +104,6 @@ class TfSession {
       const NamedTensorList& restore_inputs);
 
  private:
-  // Overload to allow providing inputs to operations.
-  Result<Unit> RunOp(const NamedTensorList& inputs, absl::string_view op);
   std::string GetTmpCheckpointFileName(absl::string_view name);
 
   std::string tmp_dir_;
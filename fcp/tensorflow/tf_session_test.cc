@@ -210,6 +210,39 @@ TEST(TfSessionTest, SaveAndRestoreCheckpointBytes) {
                        AsTensor<int32_t>({1, 2, 3, 4}, TensorShape({2, 2})));
 }
 
+TEST(TfSessionTest, SaveAndRestoreWithoutTmpDirOnDisk) {
+  tensorflow::Scope root = tensorflow::Scope::NewRootScope();
+  auto a = Const<int32_t>(root, {{1, 2}, {3, 4}});
+  auto filename =
+      Placeholder(root.WithOpName("filename"), tensorflow::DT_STRING);
+  auto save_a = Save(root.WithOpName("save"), filename, {"a"},
+                     std::initializer_list<tensorflow::Input>{a});
+  auto c = Variable(root.WithOpName("c"), {2, 2}, tensorflow::DT_INT32);
+  auto restore = Assign(root.WithOpName("restore"), c,
+                        Restore(root, filename, "a", tensorflow::DT_INT32));
+
+  // Temporary checkpoints are kept in memory, so the directory needn't exist.
+  TestTracingRecorder tracing_recorder;
+  TfSession sess("/does/not/exist", CreateGraph(&root));
+  ASSERT_THAT(sess.Ready(), Not(IsError()));
+
+  CheckpointOp save_checkpoint_op;
+  save_checkpoint_op.mutable_saver_def()->set_save_tensor_name("save");
+  save_checkpoint_op.mutable_saver_def()->set_filename_tensor_name("filename");
+  Result<absl::Cord> save_res = sess.SaveState(save_checkpoint_op);
+  ASSERT_THAT(save_res, Not(IsError()));
+
+  CheckpointOp restore_checkpoint_op;
+  restore_checkpoint_op.mutable_saver_def()->set_restore_op_name("restore");
+  restore_checkpoint_op.mutable_saver_def()->set_filename_tensor_name(
+      "filename");
+  EXPECT_THAT(
+      sess.RestoreState(restore_checkpoint_op, save_res.GetValueOrDie()),
+      Not(IsError()));
+  CheckOutput<int32_t>(&sess, "c",
+                       AsTensor<int32_t>({1, 2, 3, 4}, TensorShape({2, 2})));
+}
+
 TEST(TfSessionTest, SaveCheckpointBytesSaveOpInTensorFormat) {
   // Construct a TensorFlow graph with all desired operations.
   tensorflow::Scope root = tensorflow::Scope::NewRootScope();